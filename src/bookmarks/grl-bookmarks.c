@@ -34,6 +34,7 @@
 
 #include "grl-bookmarks.h"
 #include "bookmarks-resource.h"
+#include "grl-fts-match.h"
 
 #define GRL_ROOT_TITLE "Bookmarks"
 
@@ -54,6 +55,53 @@ GRL_LOG_DOMAIN_STATIC(bookmarks_log_domain);
   "    SELECT DISTINCT id FROM bookmarks) "        \
   "  and parent <> 0)"
 
+#define GRL_SQL_CREATE_INDEX_PARENT                     \
+  "CREATE INDEX IF NOT EXISTS bookmarks_parent_idx "    \
+  "ON bookmarks (parent)"
+
+#define GRL_SQL_CREATE_INDEX_TYPE                       \
+  "CREATE INDEX IF NOT EXISTS bookmarks_type_idx "      \
+  "ON bookmarks (type)"
+
+#define GRL_SQL_CREATE_FTS                              \
+  "CREATE VIRTUAL TABLE bookmarks_fts USING fts5 ("     \
+  "title, desc, "                                       \
+  "content='bookmarks', content_rowid='id', "           \
+  GRL_FTS_TOKENIZE ")"
+
+#define GRL_SQL_REBUILD_FTS                             \
+  "INSERT INTO bookmarks_fts (bookmarks_fts) "          \
+  "VALUES ('rebuild')"
+
+#define GRL_SQL_CHECK_FTS                               \
+  "SELECT rowid FROM bookmarks_fts LIMIT 0"
+
+#define GRL_SQL_CREATE_FTS_TRIGGERS                                     \
+  "CREATE TRIGGER IF NOT EXISTS bookmarks_fts_insert "                  \
+  "AFTER INSERT ON bookmarks BEGIN "                                    \
+  "  INSERT INTO bookmarks_fts (rowid, title, desc) "                   \
+  "  VALUES (new.id, new.title, new.desc); "                            \
+  "END; "                                                               \
+  "CREATE TRIGGER IF NOT EXISTS bookmarks_fts_delete "                  \
+  "AFTER DELETE ON bookmarks BEGIN "                                    \
+  "  INSERT INTO bookmarks_fts (bookmarks_fts, rowid, title, desc) "    \
+  "  VALUES ('delete', old.id, old.title, old.desc); "                  \
+  "END; "                                                               \
+  "CREATE TRIGGER IF NOT EXISTS bookmarks_fts_update "                  \
+  "AFTER UPDATE ON bookmarks BEGIN "                                    \
+  "  INSERT INTO bookmarks_fts (bookmarks_fts, rowid, title, desc) "    \
+  "  VALUES ('delete', old.id, old.title, old.desc); "                  \
+  "  INSERT INTO bookmarks_fts (rowid, title, desc) "                   \
+  "  VALUES (new.id, new.title, new.desc); "                            \
+  "END"
+
+#define GRL_SQL_FTS_FILTER                                              \
+  "id IN (SELECT rowid FROM bookmarks_fts WHERE bookmarks_fts MATCH ?) " \
+  "AND type = ?"
+
+/* Number of bookmarks fetched from the database at once */
+#define FETCH_PAGE_SIZE 50
+
 /* --- Plugin information --- */
 
 #define SOURCE_ID   "grl-bookmarks"
@@ -71,6 +119,8 @@ struct _GrlBookmarksPrivate {
   GomAdapter *adapter;
   GomRepository *repository;
   gboolean notify_changes;
+  /* Set from the adapter thread once the full-text index is ready */
+  gint use_fts;
 };
 
 typedef struct {
@@ -85,6 +135,14 @@ typedef struct {
   gpointer user_data;
 } OperationSpec;
 
+typedef struct {
+  OperationSpec *os;
+  GomResourceGroup *group;
+  guint index;
+  guint fetch_count;
+  guint num_left;
+} FetchSpec;
+
 static GrlBookmarksSource *grl_bookmarks_source_new (void);
 
 static void grl_bookmarks_source_finalize (GObject *plugin);
@@ -208,11 +266,45 @@ GRL_PLUGIN_DEFINE (GRL_MAJOR,
    source_class->notify_change_stop = grl_bookmarks_source_notify_change_stop;
 }
 
+/* Runs in the adapter thread */
+static void
+create_indexes (GomAdapter *adapter,
+                gpointer    user_data)
+{
+  GrlBookmarksSource *source = user_data;
+  GError *error = NULL;
+
+  if (!gom_adapter_execute_sql (adapter, GRL_SQL_CREATE_INDEX_PARENT, &error) ||
+      !gom_adapter_execute_sql (adapter, GRL_SQL_CREATE_INDEX_TYPE, &error)) {
+    GRL_WARNING ("Failed to create database indexes: %s", error->message);
+    g_clear_error (&error);
+  }
+
+  /* The full-text index is filled from the existing bookmarks when it is
+     created, and kept up to date by triggers afterwards */
+  if (gom_adapter_execute_sql (adapter, GRL_SQL_CREATE_FTS, NULL)) {
+    gom_adapter_execute_sql (adapter, GRL_SQL_REBUILD_FTS, NULL);
+  } else if (!gom_adapter_execute_sql (adapter, GRL_SQL_CHECK_FTS, &error)) {
+    GRL_INFO ("Full-text search not available: %s", error->message);
+    g_clear_error (&error);
+    return;
+  }
+
+  if (!gom_adapter_execute_sql (adapter, GRL_SQL_CREATE_FTS_TRIGGERS, &error)) {
+    GRL_WARNING ("Failed to create full-text index triggers: %s", error->message);
+    g_clear_error (&error);
+    return;
+  }
+
+  g_atomic_int_set (&source->priv->use_fts, TRUE);
+}
+
 static void
 migrate_cb (GObject      *object,
             GAsyncResult *result,
             gpointer      user_data)
 {
+   GrlBookmarksSource *source = user_data;
    gboolean ret;
    GError *error = NULL;
 
@@ -220,7 +312,10 @@ migrate_cb (GObject      *object,
    if (!ret) {
      GRL_WARNING ("Failed to migrate database: %s", error->message);
      g_error_free (error);
+     return;
    }
+
+   gom_adapter_queue_write (source->priv->adapter, create_indexes, source);
 }
 
 G_DEFINE_TYPE_WITH_PRIVATE (GrlBookmarksSource, grl_bookmarks_source, GRL_TYPE_SOURCE)
@@ -437,37 +532,29 @@ bookmark_resolve (GrlSourceResolveSpec *rs)
 }
 
 static void
-find_cb (GObject      *object,
-         GAsyncResult *res,
-         gpointer      user_data)
+free_fetch_spec (FetchSpec *fs)
 {
-  GomResourceGroup *group;
-  OperationSpec *os = user_data;
-  GError *local_error = NULL;
-  GError *error = NULL;
-  guint idx, count, num_left;
+  g_clear_object (&fs->group);
+  g_slice_free (OperationSpec, fs->os);
+  g_slice_free (FetchSpec, fs);
+}
 
-  group = gom_repository_find_finish (GOM_REPOSITORY (object),
-                                      res,
-                                      &local_error);
-  if (!group) {
-    GRL_WARNING ("Failed to find bookmarks: %s", local_error->message);
-    error = g_error_new (GRL_CORE_ERROR,
-                         os->error_code,
-                         _("Failed to find bookmarks: %s"), local_error->message);
-    g_error_free (local_error);
-    os->callback (os->source, os->operation_id, NULL, 0, os->user_data, error);
-    g_error_free (error);
-    goto out;
-  }
+static void fetch_page (FetchSpec *fs);
 
-  count = gom_resource_group_get_count (group);
-  if (os->skip >= count) {
-    os->callback (os->source, os->operation_id, NULL, 0, os->user_data, NULL);
-    goto out;
-  }
+static void
+fetch_cb (GObject      *object,
+          GAsyncResult *res,
+          gpointer      user_data)
+{
+  FetchSpec *fs = user_data;
+  OperationSpec *os = fs->os;
+  GError *local_error = NULL;
+  GError *error = NULL;
+  guint idx, last;
 
-  if (!gom_resource_group_fetch_sync (group, os->skip, os->count, &local_error)) {
+  if (!gom_resource_group_fetch_finish (GOM_RESOURCE_GROUP (object),
+                                        res,
+                                        &local_error)) {
     GRL_WARNING ("Failed to find bookmarks: %s", local_error->message);
     error = g_error_new (GRL_CORE_ERROR,
                          os->error_code,
@@ -475,34 +562,94 @@ find_cb (GObject      *object,
     g_error_free (local_error);
     os->callback (os->source, os->operation_id, NULL, 0, os->user_data, error);
     g_error_free (error);
-    goto out;
+    free_fetch_spec (fs);
+    return;
   }
 
-  num_left = MIN (count - os->skip, os->count);
-  for (idx = os->skip; num_left > 0 ; idx++) {
+  /* Emit this page right away, before fetching the next one */
+  last = fs->index + fs->fetch_count;
+  for (idx = fs->index; idx < last; idx++) {
     GomResource *resource;
     GrlMedia *media;
 
-    resource = gom_resource_group_get_index (group, idx);
+    resource = gom_resource_group_get_index (fs->group, idx);
     media = build_media_from_resource (NULL, resource, os->type_filter);
+    fs->num_left--;
     if (media == NULL) {
-      num_left--;
-      if (num_left == 0)
+      if (fs->num_left == 0)
         os->callback (os->source, os->operation_id, NULL, 0, os->user_data, NULL);
       continue;
     }
     os->callback (os->source,
                   os->operation_id,
                   media,
-                  --num_left,
+                  fs->num_left,
                   os->user_data,
                   NULL);
   }
+  fs->index = last;
+
+  if (fs->num_left > 0) {
+    fetch_page (fs);
+  } else {
+    free_fetch_spec (fs);
+  }
+}
+
+static void
+fetch_page (FetchSpec *fs)
+{
+  fs->fetch_count = MIN (fs->num_left, FETCH_PAGE_SIZE);
+  gom_resource_group_fetch_async (fs->group,
+                                  fs->index,
+                                  fs->fetch_count,
+                                  fetch_cb,
+                                  fs);
+}
+
+static void
+find_cb (GObject      *object,
+         GAsyncResult *res,
+         gpointer      user_data)
+{
+  GomResourceGroup *group;
+  OperationSpec *os = user_data;
+  FetchSpec *fs;
+  GError *local_error = NULL;
+  GError *error = NULL;
+  guint count;
+
+  group = gom_repository_find_finish (GOM_REPOSITORY (object),
+                                      res,
+                                      &local_error);
+  if (!group) {
+    GRL_WARNING ("Failed to find bookmarks: %s", local_error->message);
+    error = g_error_new (GRL_CORE_ERROR,
+                         os->error_code,
+                         _("Failed to find bookmarks: %s"), local_error->message);
+    g_error_free (local_error);
+    os->callback (os->source, os->operation_id, NULL, 0, os->user_data, error);
+    g_error_free (error);
+    g_slice_free (OperationSpec, os);
+    return;
+  }
 
-  g_object_unref (group);
+  count = gom_resource_group_get_count (group);
+  if (os->skip >= count) {
+    os->callback (os->source, os->operation_id, NULL, 0, os->user_data, NULL);
+    g_object_unref (group);
+    g_slice_free (OperationSpec, os);
+    return;
+  }
 
-out:
-  g_slice_free (OperationSpec, os);
+  /* Fetch the requested window page by page, so results are sent as soon
+     as they are available */
+  fs = g_slice_new0 (FetchSpec);
+  fs->os = os;
+  fs->group = group;
+  fs->index = os->skip;
+  fs->num_left = MIN (count - os->skip, os->count);
+  fetch_page (fs);
 }
 
 static void
@@ -574,6 +721,31 @@ substr_filter (const char *column,
   return filter;
 }
 
+static GomFilter *
+fts_filter (const gchar *match)
+{
+  GArray *array;
+  GValue value = { 0, };
+  GomFilter *filter;
+
+  array = g_array_new (FALSE, FALSE, sizeof (GValue));
+  g_array_set_clear_func (array, (GDestroyNotify) g_value_unset);
+
+  g_value_init (&value, G_TYPE_STRING);
+  g_value_set_string (&value, match);
+  g_array_append_val (array, value);
+
+  memset (&value, 0, sizeof (GValue));
+  g_value_init (&value, G_TYPE_INT);
+  g_value_set_int (&value, BOOKMARKS_TYPE_STREAM);
+  g_array_append_val (array, value);
+
+  filter = gom_filter_new_sql (GRL_SQL_FTS_FILTER, array);
+  g_array_unref (array);
+
+  return filter;
+}
+
 static void
 produce_bookmarks_from_text (OperationSpec *os, const gchar *text)
 {
@@ -582,6 +754,19 @@ produce_bookmarks_from_text (OperationSpec *os, const gchar *text)
 
   GRL_DEBUG ("produce_bookmarks_from_text");
 
+  /* Substring matching through the full-text index, when available */
+  if (text && g_atomic_int_get (&GRL_BOOKMARKS_SOURCE (os->source)->priv->use_fts)) {
+    gchar *match = grl_fts_match_expression (text);
+
+    if (match) {
+      filter = fts_filter (match);
+      g_free (match);
+      produce_bookmarks_from_filter (os, filter);
+      g_object_unref (filter);
+      return;
+    }
+  }
+
   /* WHERE (title LIKE '%text%' OR desc LIKE '%text%') AND type == BOOKMARKS_TYPE_STREAM */
 
   like1 = substr_filter ("title", text);
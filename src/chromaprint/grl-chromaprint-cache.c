@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "grl-file-cache.h"
+#include "grl-chromaprint-cache.h"
+
+/* Values are "(decode duration, duration, fingerprint)" */
+#define FINGERPRINT_TYPE "(uis)"
+
+struct _GrlChromaprintCache {
+  GrlFileCache *cache;
+};
+
+/**
+ * grl_chromaprint_cache_new:
+ * @max_entries: Maximum number of fingerprints kept
+ * Returns: (transfer full): A new #GrlChromaprintCache, holding the
+ * fingerprints saved by previous instances.
+ */
+GrlChromaprintCache *
+grl_chromaprint_cache_new (guint max_entries)
+{
+  GrlChromaprintCache *cache;
+
+  cache = g_slice_new0 (GrlChromaprintCache);
+  cache->cache = grl_file_cache_new ("chromaprint" G_DIR_SEPARATOR_S "fingerprints",
+                                     G_VARIANT_TYPE (FINGERPRINT_TYPE),
+                                     max_entries);
+
+  return cache;
+}
+
+/* Saves the pending changes before freeing @cache */
+void
+grl_chromaprint_cache_free (GrlChromaprintCache *cache)
+{
+  grl_file_cache_free (cache->cache);
+  g_slice_free (GrlChromaprintCache, cache);
+}
+
+/**
+ * grl_chromaprint_cache_lookup:
+ * @cache: Instance of #GrlChromaprintCache
+ * @uri: URI of the file
+ * @info: Information about the file, with its standard::size,
+ * time::modified and unix::inode attributes
+ * @decode_duration: Seconds of audio the fingerprint must be computed from
+ * @fingerprint: (out) (transfer full): Return location for the fingerprint
+ * @duration: (out): Return location for the duration of the file
+ * Returns: %TRUE if the fingerprint of this version of the file is known.
+ */
+gboolean
+grl_chromaprint_cache_lookup (GrlChromaprintCache *cache,
+                              const gchar *uri,
+                              GFileInfo *info,
+                              guint decode_duration,
+                              gchar **fingerprint,
+                              gint *duration)
+{
+  GVariant *value;
+  guint value_decode_duration;
+  gboolean found;
+
+  value = grl_file_cache_lookup (cache->cache, uri, info);
+  if (value == NULL)
+    return FALSE;
+
+  g_variant_get_child (value, 0, "u", &value_decode_duration);
+  found = value_decode_duration == decode_duration;
+  if (found)
+    g_variant_get (value, "(uis)", NULL, duration, fingerprint);
+  g_variant_unref (value);
+
+  return found;
+}
+
+/**
+ * grl_chromaprint_cache_store:
+ * @cache: Instance of #GrlChromaprintCache
+ * @uri: URI of the file
+ * @info: Information about the file, as in grl_chromaprint_cache_lookup()
+ * @decode_duration: Seconds of audio the fingerprint was computed from
+ * @fingerprint: The fingerprint of the file
+ * @duration: The duration of the file, in seconds
+ */
+void
+grl_chromaprint_cache_store (GrlChromaprintCache *cache,
+                             const gchar *uri,
+                             GFileInfo *info,
+                             guint decode_duration,
+                             const gchar *fingerprint,
+                             gint duration)
+{
+  grl_file_cache_store (cache->cache, uri, info,
+                        g_variant_new (FINGERPRINT_TYPE,
+                                       decode_duration, duration, fingerprint));
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef _GRL_CHROMAPRINT_CACHE_H_
+#define _GRL_CHROMAPRINT_CACHE_H_
+
+#include <gio/gio.h>
+
+/* Number of fingerprints kept */
+#define GRL_CHROMAPRINT_CACHE_MAX_ENTRIES 16384
+
+/* Cache of the fingerprints already computed, keyed by the URI of the file
+ * along with its size, modification time and inode. It is saved in the user
+ * cache directory. */
+typedef struct _GrlChromaprintCache GrlChromaprintCache;
+
+GrlChromaprintCache *grl_chromaprint_cache_new (guint max_entries);
+
+void grl_chromaprint_cache_free (GrlChromaprintCache *cache);
+
+gboolean grl_chromaprint_cache_lookup (GrlChromaprintCache *cache,
+                                       const gchar *uri,
+                                       GFileInfo *info,
+                                       guint decode_duration,
+                                       gchar **fingerprint,
+                                       gint *duration);
+
+void grl_chromaprint_cache_store (GrlChromaprintCache *cache,
+                                  const gchar *uri,
+                                  GFileInfo *info,
+                                  guint decode_duration,
+                                  const gchar *fingerprint,
+                                  gint duration);
+
+#endif /* _GRL_CHROMAPRINT_CACHE_H_ */
@@ -28,11 +28,12 @@
 #include <glib/gi18n-lib.h>
 
 #include "grl-chromaprint.h"
+#include "grl-chromaprint-cache.h"
 
 /* --------- Logging  -------- */
 
 #define GRL_LOG_DOMAIN_DEFAULT chromaprint_log_domain
-GRL_LOG_DOMAIN_STATIC (chromaprint_log_domain);
+GRL_LOG_DOMAIN (chromaprint_log_domain);
 
 /* --- Plugin information --- */
 
@@ -45,12 +46,33 @@ GRL_LOG_DOMAIN_STATIC (chromaprint_log_domain);
 
 static GrlKeyID GRL_CHROMAPRINT_METADATA_KEY_FINGERPRINT = GRL_METADATA_KEY_INVALID;
 
+/* --- Configuration --- */
+
+#define GRILO_CONF_MAX_DECODE_DURATION "max-decode-duration"
+
+/* Seconds of audio fingerprinted, as AcoustID expects */
+#define DEFAULT_MAX_DECODE_DURATION 120
+
+/* Files decoded at the same time */
+#define MAX_PIPELINES 2
+
 /* GStreamer Elements */
 #define GST_BIN_AUDIO           "grl-gst-audiobin"
 #define GST_ELEMENT_CHROMAPRINT "grl-gst-chromaprint"
 
+/* Posted once enough audio was fingerprinted */
+#define GST_MESSAGE_DECODE_DONE "grl-chromaprint-decode-done"
+
 struct _GrlChromaprintPrivate {
   GList *supported_keys;
+  GrlChromaprintCache *cache;
+  guint max_decode_duration;
+
+  /* All the DecodePipeline, and the ones not decoding a file */
+  GList *pipelines;
+  GQueue *idle_pipelines;
+  /* OperationSpec waiting for a pipeline */
+  GQueue *pending;
 };
 
 typedef struct _OperationSpec {
@@ -61,26 +83,26 @@ typedef struct _OperationSpec {
   gpointer    user_data;
   gint        duration;
   gchar      *fingerprint;
-  GstElement *pipeline;
+  gchar      *uri;
+  GFileInfo  *info;
   GrlSourceResolveCb callback;
 } OperationSpec;
 
-/* Copied from gst-plugins-base/gst/playback/gstplay-enum.h */
-typedef enum
-{
-  GST_PLAY_FLAG_VIDEO = (1 << 0),
-  GST_PLAY_FLAG_AUDIO = (1 << 1),
-  GST_PLAY_FLAG_TEXT = (1 << 2),
-  GST_PLAY_FLAG_VIS = (1 << 3),
-  GST_PLAY_FLAG_SOFT_VOLUME = (1 << 4),
-  GST_PLAY_FLAG_NATIVE_AUDIO = (1 << 5),
-  GST_PLAY_FLAG_NATIVE_VIDEO = (1 << 6),
-  GST_PLAY_FLAG_DOWNLOAD = (1 << 7),
-  GST_PLAY_FLAG_BUFFERING = (1 << 8),
-  GST_PLAY_FLAG_DEINTERLACE = (1 << 9),
-  GST_PLAY_FLAG_SOFT_COLORBALANCE = (1 << 10),
-  GST_PLAY_FLAG_FORCE_FILTERS = (1 << 11),
-} GstPlayFlags;
+/* uridecodebin ! audioconvert ! audioresample ! chromaprint ! fakesink,
+ * reused from one file to the next */
+typedef struct {
+  GrlChromaprintSource *source;
+  GstElement *pipeline;
+  GstElement *decoder;
+  GstElement *chromaprint;
+  guint       bus_watch_id;
+  OperationSpec *os;
+
+  /* Accessed from the streaming thread */
+  GstClockTime decoded;
+  GstClockTime max_decoded;
+  gint         done;
+} DecodePipeline;
 
 static const GList *grl_chromaprint_source_supported_keys (GrlSource *source);
 
@@ -96,6 +118,10 @@ static void grl_chromaprint_source_finalize (GObject *object);
 
 static GrlChromaprintSource* grl_chromaprint_source_new (void);
 
+static void decode_pipeline_free (DecodePipeline *dp);
+
+static void cancel_operation_spec (OperationSpec *os);
+
 /* ================== Chromaprint Plugin  ================= */
 
 static gboolean
@@ -104,6 +130,7 @@ grl_chromaprint_plugin_init (GrlRegistry *registry,
                              GList       *configs)
 {
   GrlChromaprintSource *source;
+  GrlConfig *config;
 
   GRL_LOG_DOMAIN_INIT (chromaprint_log_domain, "chromaprint");
 
@@ -112,6 +139,22 @@ grl_chromaprint_plugin_init (GrlRegistry *registry,
   gst_init (NULL, NULL);
 
   source = grl_chromaprint_source_new ();
+
+  if (configs) {
+    config = GRL_CONFIG (configs->data);
+    if (grl_config_has_param (config, GRILO_CONF_MAX_DECODE_DURATION)) {
+      gint max_decode_duration;
+
+      max_decode_duration = grl_config_get_int (config,
+                                                GRILO_CONF_MAX_DECODE_DURATION);
+      if (max_decode_duration > 0)
+        source->priv->max_decode_duration = max_decode_duration;
+      else
+        GRL_WARNING ("Invalid %s: %d", GRILO_CONF_MAX_DECODE_DURATION,
+                     max_decode_duration);
+    }
+  }
+
   grl_registry_register_source (registry,
                                 plugin,
                                 GRL_SOURCE (source),
@@ -194,18 +237,40 @@ grl_chromaprint_source_init (GrlChromaprintSource *source)
     grl_metadata_key_list_new (GRL_CHROMAPRINT_METADATA_KEY_FINGERPRINT,
                                GRL_METADATA_KEY_DURATION,
                                GRL_METADATA_KEY_INVALID);
+
+  source->priv->cache =
+    grl_chromaprint_cache_new (GRL_CHROMAPRINT_CACHE_MAX_ENTRIES);
+  source->priv->max_decode_duration = DEFAULT_MAX_DECODE_DURATION;
+  source->priv->idle_pipelines = g_queue_new ();
+  source->priv->pending = g_queue_new ();
 }
 
 static void
 grl_chromaprint_source_finalize (GObject *object)
 {
   GrlChromaprintSource *source;
+  GList *l;
 
   GRL_DEBUG ("grl_chromaprint_source_finalize");
 
   source = GRL_CHROMAPRINT_SOURCE (object);
 
+  /* Operations decoding or waiting for a pipeline are not left without
+   * their callback */
+  for (l = source->priv->pipelines; l != NULL; l = l->next) {
+    DecodePipeline *dp = l->data;
+
+    if (dp->os != NULL)
+      cancel_operation_spec (g_steal_pointer (&dp->os));
+  }
+  g_queue_free_full (source->priv->pending,
+                     (GDestroyNotify) cancel_operation_spec);
+
   g_list_free (source->priv->supported_keys);
+  g_list_free_full (source->priv->pipelines,
+                    (GDestroyNotify) decode_pipeline_free);
+  g_queue_free (source->priv->idle_pipelines);
+  grl_chromaprint_cache_free (source->priv->cache);
 
   G_OBJECT_CLASS (grl_chromaprint_source_parent_class)->finalize (object);
 }
@@ -228,9 +293,23 @@ free_operation_spec (OperationSpec *os)
 {
   g_list_free (os->keys);
   g_clear_pointer (&os->fingerprint, g_free);
+  g_clear_pointer (&os->uri, g_free);
+  g_clear_object (&os->info);
   g_slice_free (OperationSpec, os);
 }
 
+static void
+cancel_operation_spec (OperationSpec *os)
+{
+  GError *error;
+
+  error = g_error_new_literal (G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                               "Operation was cancelled");
+  os->callback (os->source, os->operation_id, os->media, os->user_data, error);
+  g_error_free (error);
+  free_operation_spec (os);
+}
+
 static void
 chromaprint_build_media (OperationSpec *os)
 {
@@ -278,39 +357,76 @@ resolve_end:
   free_operation_spec (os);
 }
 
+static void decode_pipeline_run (DecodePipeline *dp,
+                                 OperationSpec  *os);
+
+/* Hands @dp to the next pending operation, if any */
+static void
+decode_pipeline_release (DecodePipeline *dp)
+{
+  GrlChromaprintSourcePrivate *priv = dp->source->priv;
+  OperationSpec *os;
+
+  os = g_queue_pop_head (priv->pending);
+  if (os != NULL)
+    decode_pipeline_run (dp, os);
+  else
+    g_queue_push_tail (priv->idle_pipelines, dp);
+}
+
+static void
+decode_pipeline_finish (DecodePipeline *dp,
+                        gboolean        success)
+{
+  OperationSpec *os = dp->os;
+  GrlChromaprintSourcePrivate *priv = dp->source->priv;
+
+  if (success) {
+    gint64 len;
+    gchar *str;
+
+    g_object_get (G_OBJECT (dp->chromaprint), "fingerprint", &str, NULL);
+    if (gst_element_query_duration (dp->pipeline, GST_FORMAT_TIME, &len))
+      os->duration = GST_TIME_AS_SECONDS (len);
+    os->fingerprint = str;
+  }
+
+  gst_element_set_state (dp->pipeline, GST_STATE_NULL);
+  dp->os = NULL;
+
+  if (os->fingerprint != NULL && os->info != NULL) {
+    grl_chromaprint_cache_store (priv->cache, os->uri, os->info,
+                                 priv->max_decode_duration,
+                                 os->fingerprint, os->duration);
+  }
+
+  chromaprint_gstreamer_done (os);
+  decode_pipeline_release (dp);
+}
 
 static gboolean
 bus_call (GstBus     *bus,
           GstMessage *msg,
           gpointer    user_data)
 {
-  OperationSpec *os;
+  DecodePipeline *dp;
 
-  os = (OperationSpec *) user_data;
+  dp = (DecodePipeline *) user_data;
+
+  /* Left over from a previous file */
+  if (dp->os == NULL)
+    return TRUE;
 
   switch (GST_MESSAGE_TYPE (msg)) {
 
-    case GST_MESSAGE_EOS: {
-      gint64 len;
-      guint  seconds;
-      gchar *str;
-      GstElement *chromaprint;
-
-      chromaprint = gst_bin_get_by_name (GST_BIN (os->pipeline),
-                                         GST_ELEMENT_CHROMAPRINT);
-      g_object_get (G_OBJECT (chromaprint), "fingerprint", &str, NULL);
-      gst_element_query_duration (os->pipeline, GST_FORMAT_TIME, &len);
-      seconds = GST_TIME_AS_SECONDS (len);
-
-      gst_element_set_state (os->pipeline, GST_STATE_NULL);
-      gst_object_unref (GST_OBJECT (os->pipeline));
-      gst_object_unref (GST_OBJECT (chromaprint));
-
-      os->duration = seconds;
-      os->fingerprint = str;
-      chromaprint_gstreamer_done (os);
-      return FALSE;
-    }
+    case GST_MESSAGE_APPLICATION:
+      if (!gst_message_has_name (msg, GST_MESSAGE_DECODE_DONE))
+        break;
+      /* fall through */
+
+    case GST_MESSAGE_EOS:
+      decode_pipeline_finish (dp, TRUE);
+      break;
 
     case GST_MESSAGE_ERROR: {
       gchar  *debug;
@@ -322,10 +438,8 @@ bus_call (GstBus     *bus,
       GRL_DEBUG ("Error: %s\n", error->message);
       g_error_free (error);
 
-      gst_element_set_state (os->pipeline, GST_STATE_NULL);
-      gst_object_unref (GST_OBJECT (os->pipeline));
-      chromaprint_gstreamer_done (os);
-      return FALSE;
+      decode_pipeline_finish (dp, FALSE);
+      break;
     }
 
     default:
@@ -335,65 +449,214 @@ bus_call (GstBus     *bus,
   return TRUE;
 }
 
+/* Stops decoding once chromaprint got the audio it needs, instead of
+ * going through the rest of the file */
+static GstPadProbeReturn
+decoded_buffer_probe (GstPad          *pad,
+                      GstPadProbeInfo *info,
+                      gpointer         user_data)
+{
+  DecodePipeline *dp = user_data;
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+  if (g_atomic_int_get (&dp->done))
+    return GST_PAD_PROBE_DROP;
+
+  if (GST_BUFFER_DURATION_IS_VALID (buffer))
+    dp->decoded += GST_BUFFER_DURATION (buffer);
+
+  if (dp->decoded < dp->max_decoded)
+    return GST_PAD_PROBE_OK;
+
+  g_atomic_int_set (&dp->done, TRUE);
+  gst_element_post_message (dp->pipeline,
+                            gst_message_new_application (GST_OBJECT (dp->pipeline),
+                                                         gst_structure_new_empty (GST_MESSAGE_DECODE_DONE)));
+
+  return GST_PAD_PROBE_OK;
+}
+
 static void
-chromaprint_execute_resolve (OperationSpec *os)
+decode_pipeline_free (DecodePipeline *dp)
 {
-  GstElement *playbin, *sink, *chromaprint;
-  GstBus *bus;
-  gchar *uri;
-  gint flags;
+  gst_element_set_state (dp->pipeline, GST_STATE_NULL);
+  g_source_remove (dp->bus_watch_id);
+  gst_object_unref (dp->chromaprint);
+  gst_object_unref (dp->pipeline);
+  g_slice_free (DecodePipeline, dp);
+}
 
-  uri = get_uri_to_file (grl_media_get_url (os->media));
+/* Links the first audio stream of the file, others are not decoded */
+static void
+decoder_pad_added (GstElement *decoder,
+                   GstPad     *pad,
+                   gpointer    user_data)
+{
+  GstElement *convert = user_data;
+  GstPad *sink_pad;
+  GstCaps *caps;
+
+  sink_pad = gst_element_get_static_pad (convert, "sink");
+  if (gst_pad_is_linked (sink_pad))
+    goto pad_added_end;
+
+  caps = gst_pad_get_current_caps (pad);
+  if (caps == NULL)
+    caps = gst_pad_query_caps (pad, NULL);
+
+  if (g_str_has_prefix (gst_structure_get_name (gst_caps_get_structure (caps, 0)),
+                        "audio/") &&
+      gst_pad_link (pad, sink_pad) != GST_PAD_LINK_OK) {
+    GRL_DEBUG ("Could not link the decoded audio");
+  }
+  gst_caps_unref (caps);
+
+pad_added_end:
+  gst_object_unref (sink_pad);
+}
+
+static DecodePipeline *
+decode_pipeline_new (GrlChromaprintSource *source)
+{
+  const gchar *factories[] = { "uridecodebin", "audioconvert",
+                               "audioresample", "chromaprint", "fakesink" };
+  GstElement *elements[G_N_ELEMENTS (factories)] = { NULL, };
+  GstElement *decoder, *convert, *resample, *chromaprint, *sink;
+  GstElement *pipeline;
+  DecodePipeline *dp;
+  GstCaps *caps;
+  GstBus *bus;
+  GstPad *pad;
+  guint i;
 
   /* Create the elemtens */
-  playbin = gst_element_factory_make ("playbin", "playbin");
-  if (playbin == NULL) {
-      GRL_WARNING ("error upon creation of 'playbin' element");
-      goto err_playbin;
+  for (i = 0; i < G_N_ELEMENTS (factories); i++) {
+    elements[i] = gst_element_factory_make (factories[i], NULL);
+    if (elements[i] == NULL) {
+      GRL_WARNING ("error upon creation of '%s' element", factories[i]);
+      goto err_element;
+    }
   }
 
-  sink = gst_element_factory_make ("fakesink", "sink");
-  if (sink == NULL) {
-      GRL_WARNING ("error upon creation of 'fakesink' element");
-      goto err_sink;
+  decoder = elements[0];
+  convert = elements[1];
+  resample = elements[2];
+  chromaprint = elements[3];
+  sink = elements[4];
+
+  /* Only decode audio, as fast as possible */
+  caps = gst_caps_new_empty_simple ("audio/x-raw");
+  g_object_set (decoder,
+                "caps", caps,
+                "expose-all-streams", FALSE,
+                NULL);
+  gst_caps_unref (caps);
+  g_object_set (sink, "sync", FALSE, NULL);
+  g_object_set (chromaprint,
+                "duration", source->priv->max_decode_duration,
+                NULL);
+
+  pipeline = gst_pipeline_new ("grl-chromaprint");
+  gst_bin_add_many (GST_BIN (pipeline),
+                    decoder, convert, resample, chromaprint, sink, NULL);
+  if (!gst_element_link_many (convert, resample, chromaprint, sink, NULL)) {
+    GRL_WARNING ("error upon linking the chromaprint pipeline");
+    gst_object_unref (pipeline);
+    return NULL;
   }
+  g_signal_connect (decoder, "pad-added",
+                    G_CALLBACK (decoder_pad_added), convert);
+
+  dp = g_slice_new0 (DecodePipeline);
+  dp->source = source;
+  dp->pipeline = pipeline;
+  dp->decoder = decoder;
+  dp->chromaprint = gst_object_ref (chromaprint);
+  dp->max_decoded = source->priv->max_decode_duration * GST_SECOND;
+
+  /* On the source pad, so chromaprint has processed the buffers counted */
+  pad = gst_element_get_static_pad (chromaprint, "src");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+                     decoded_buffer_probe, dp, NULL);
+  gst_object_unref (pad);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+  dp->bus_watch_id = gst_bus_add_watch (bus, bus_call, dp);
+  gst_object_unref (bus);
 
-  chromaprint = gst_element_factory_make ("chromaprint", GST_ELEMENT_CHROMAPRINT);
-  if (chromaprint == NULL) {
-      GRL_WARNING ("error upon creation of 'chromaprint' element");
-      goto err_chromaprint;
+  return dp;
+
+err_element:
+  for (i = 0; i < G_N_ELEMENTS (factories); i++) {
+    if (elements[i] != NULL)
+      gst_object_unref (elements[i]);
   }
+  return NULL;
+}
 
-  g_object_set (playbin,
-                "uri", uri,
-                "audio-filter", chromaprint,
-                "audio-sink", sink,
-                NULL);
-  g_free (uri);
+static void
+decode_pipeline_run (DecodePipeline *dp,
+                     OperationSpec  *os)
+{
+  dp->os = os;
+  dp->decoded = 0;
+  g_atomic_int_set (&dp->done, FALSE);
 
-  /* Disable video from playbin */
-  g_object_get (playbin, "flags", &flags, NULL);
-  flags &= ~GST_PLAY_FLAG_VIDEO;
-  g_object_set (playbin, "flags", flags, NULL);
+  g_object_set (dp->decoder, "uri", os->uri, NULL);
+  gst_element_set_state (dp->pipeline, GST_STATE_PLAYING);
+}
 
-  bus = gst_pipeline_get_bus (GST_PIPELINE (playbin));
-  gst_bus_add_watch (bus, bus_call, os);
-  gst_object_unref (bus);
+/* Decodes the file of @os in an idle pipeline, creating it if there are
+ * less than MAX_PIPELINES, or waits for one to be released */
+static void
+chromaprint_execute_resolve (OperationSpec *os)
+{
+  GrlChromaprintSource *source = GRL_CHROMAPRINT_SOURCE (os->source);
+  DecodePipeline *dp;
+
+  dp = g_queue_pop_head (source->priv->idle_pipelines);
+  if (dp == NULL) {
+    if (g_list_length (source->priv->pipelines) >= MAX_PIPELINES) {
+      g_queue_push_tail (source->priv->pending, os);
+      return;
+    }
 
-  os->pipeline = playbin;
-  gst_element_set_state (playbin, GST_STATE_PLAYING);
-  return;
+    dp = decode_pipeline_new (source);
+    if (dp == NULL) {
+      os->callback (os->source, os->operation_id, os->media, os->user_data, NULL);
+      free_operation_spec (os);
+      return;
+    }
+    source->priv->pipelines = g_list_prepend (source->priv->pipelines, dp);
+  }
 
-err_chromaprint:
-  gst_object_unref (chromaprint);
-err_sink:
-  gst_object_unref (sink);
-err_playbin:
-  gst_object_unref (playbin);
-  g_clear_pointer (&uri, g_free);
+  decode_pipeline_run (dp, os);
+}
 
-  os->callback (os->source, os->operation_id, os->media, os->user_data, NULL);
-  free_operation_spec (os);
+static void
+chromaprint_got_file_info (GObject      *source_object,
+                           GAsyncResult *result,
+                           gpointer      user_data)
+{
+  OperationSpec *os = user_data;
+  GrlChromaprintSourcePrivate *priv = GRL_CHROMAPRINT_SOURCE (os->source)->priv;
+  GError *error = NULL;
+
+  os->info = g_file_query_info_finish (G_FILE (source_object), result, &error);
+  if (os->info == NULL) {
+    /* Not cached, but it may still be decoded */
+    GRL_DEBUG ("Could not get information of %s: %s", os->uri, error->message);
+    g_error_free (error);
+  } else if (grl_chromaprint_cache_lookup (priv->cache, os->uri, os->info,
+                                           priv->max_decode_duration,
+                                           &os->fingerprint,
+                                           &os->duration)) {
+    GRL_DEBUG ("Using cached fingerprint of %s", os->uri);
+    chromaprint_gstreamer_done (os);
+    return;
+  }
+
+  chromaprint_execute_resolve (os);
 }
 
 
@@ -403,6 +666,7 @@ grl_chromaprint_source_resolve (GrlSource            *source,
                                 GrlSourceResolveSpec *rs)
 {
   OperationSpec *os = NULL;
+  GFile *file;
 
   GRL_DEBUG ("chromaprint_resolve");
 
@@ -413,9 +677,17 @@ grl_chromaprint_source_resolve (GrlSource            *source,
   os->callback = rs->callback;
   os->media = rs->media;
   os->user_data = rs->user_data;
+  os->uri = get_uri_to_file (grl_media_get_url (os->media));
 
   /* FIXME: here we should resolve depending on media type (audio/video) */
-  chromaprint_execute_resolve (os);
+  file = g_file_new_for_uri (os->uri);
+  g_file_query_info_async (file,
+                           G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                           G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                           G_FILE_ATTRIBUTE_UNIX_INODE,
+                           G_FILE_QUERY_INFO_NONE, G_PRIORITY_DEFAULT, NULL,
+                           chromaprint_got_file_info, os);
+  g_object_unref (file);
 }
 
 static gboolean
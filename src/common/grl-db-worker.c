@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib/gi18n-lib.h>
+#include <grilo.h>
+
+#include "grl-db-worker.h"
+
+#define GRL_LOG_DOMAIN_DEFAULT db_worker_log_domain
+GRL_LOG_DOMAIN_STATIC(db_worker_log_domain);
+
+struct _GrlDbWorker {
+  gchar *db_path;
+  GrlDbWorkerFunc init_func;
+  sqlite3 *db;
+  GThread *thread;
+  GAsyncQueue *jobs;
+};
+
+typedef struct {
+  GrlDbWorkerFunc func;
+  GTask *task;
+  gboolean result;
+  GError *error;
+} GrlDbWorkerJob;
+
+/* ======================= Worker thread ==================== */
+
+static void
+open_database (GrlDbWorker *worker)
+{
+  GError *error = NULL;
+  gint r;
+
+  GRL_DEBUG ("Opening database connection to '%s'...", worker->db_path);
+  r = sqlite3_open (worker->db_path, &worker->db);
+
+  if (r) {
+    GRL_WARNING ("Failed to open database '%s': %s",
+                 worker->db_path, sqlite3_errmsg (worker->db));
+    g_clear_pointer (&worker->db, sqlite3_close);
+    return;
+  }
+
+  if (worker->init_func && !worker->init_func (worker->db, NULL, &error)) {
+    GRL_WARNING ("Failed to initialize database '%s': %s",
+                 worker->db_path, error ? error->message : "unknown error");
+    g_clear_error (&error);
+    g_clear_pointer (&worker->db, sqlite3_close);
+    return;
+  }
+
+  GRL_DEBUG ("  OK");
+}
+
+/* Runs in the main context the job was pushed from, so the task, its source
+ * object and its data are only ever released there */
+static gboolean
+complete_job (gpointer user_data)
+{
+  GrlDbWorkerJob *job = user_data;
+
+  if (job->error) {
+    g_task_return_error (job->task, job->error);
+  } else {
+    g_task_return_boolean (job->task, job->result);
+  }
+
+  g_object_unref (job->task);
+  g_slice_free (GrlDbWorkerJob, job);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+run_job (GrlDbWorker *worker, GrlDbWorkerJob *job)
+{
+  GSource *source;
+
+  if (!worker->db) {
+    job->error = g_error_new_literal (GRL_CORE_ERROR,
+                                      GRL_CORE_ERROR_QUERY_FAILED,
+                                      _("No database connection"));
+  } else {
+    job->result = job->func (worker->db,
+                             g_task_get_task_data (job->task),
+                             &job->error);
+  }
+
+  source = g_idle_source_new ();
+  g_source_set_priority (source, G_PRIORITY_DEFAULT);
+  g_source_set_callback (source, complete_job, job, NULL);
+  g_source_attach (source, g_task_get_context (job->task));
+  g_source_unref (source);
+}
+
+static gpointer
+grl_db_worker_thread (gpointer user_data)
+{
+  GrlDbWorker *worker = user_data;
+  GrlDbWorkerJob *job;
+
+  open_database (worker);
+
+  /* A job without function asks the thread to quit */
+  while ((job = g_async_queue_pop (worker->jobs))->func)
+    run_job (worker, job);
+  g_slice_free (GrlDbWorkerJob, job);
+
+  g_clear_pointer (&worker->db, sqlite3_close);
+
+  return NULL;
+}
+
+/* ======================= Public API ==================== */
+
+/**
+ * grl_db_worker_new:
+ * @db_path: path of the SQLite database
+ * @init_func: (nullable): function run once in the worker thread right after
+ * opening the database, to create tables and so on
+ *
+ * Spawns a thread owning the connection to @db_path. The database is opened
+ * from the thread itself, so this never blocks the caller.
+ *
+ * Returns: a new #GrlDbWorker
+ */
+GrlDbWorker *
+grl_db_worker_new (const gchar *db_path,
+                   GrlDbWorkerFunc init_func)
+{
+  GrlDbWorker *worker;
+
+  if (!db_worker_log_domain) {
+    GRL_LOG_DOMAIN_INIT (db_worker_log_domain, "db-worker");
+  }
+
+  worker = g_slice_new0 (GrlDbWorker);
+  worker->db_path = g_strdup (db_path);
+  worker->init_func = init_func;
+  worker->jobs = g_async_queue_new ();
+  worker->thread = g_thread_new ("grl-db-worker", grl_db_worker_thread, worker);
+
+  return worker;
+}
+
+/**
+ * grl_db_worker_free:
+ * @worker: a #GrlDbWorker
+ *
+ * Waits for the already pushed jobs to be run, then closes the database and
+ * stops the thread. The callbacks of those jobs are still called once their
+ * main context is iterated.
+ */
+void
+grl_db_worker_free (GrlDbWorker *worker)
+{
+  g_async_queue_push (worker->jobs, g_slice_new0 (GrlDbWorkerJob));
+  g_thread_join (worker->thread);
+
+  g_async_queue_unref (worker->jobs);
+  g_free (worker->db_path);
+  g_slice_free (GrlDbWorker, worker);
+}
+
+/**
+ * grl_db_worker_push:
+ * @worker: a #GrlDbWorker
+ * @source_object: (nullable): the #GObject passed to @callback, kept alive
+ * until the job is completed
+ * @func: the function to run in the worker thread
+ * @data: data passed to @func
+ * @data_destroy: (nullable): destroy notify for @data, called in the
+ * current thread-default main context
+ * @callback: (nullable): called in the current thread-default main context
+ * once @func has run
+ * @user_data: data passed to @callback
+ *
+ * Queues @func to be run in the worker thread. Jobs are run in the order
+ * they were pushed.
+ */
+void
+grl_db_worker_push (GrlDbWorker *worker,
+                    gpointer source_object,
+                    GrlDbWorkerFunc func,
+                    gpointer data,
+                    GDestroyNotify data_destroy,
+                    GAsyncReadyCallback callback,
+                    gpointer user_data)
+{
+  GrlDbWorkerJob *job;
+
+  g_return_if_fail (func != NULL);
+
+  job = g_slice_new0 (GrlDbWorkerJob);
+  job->func = func;
+  job->task = g_task_new (source_object, NULL, callback, user_data);
+  g_task_set_task_data (job->task, data, data_destroy);
+
+  g_async_queue_push (worker->jobs, job);
+}
+
+/**
+ * grl_db_worker_finish:
+ * @result: the #GAsyncResult passed to the job callback
+ * @error: return location for a #GError
+ *
+ * Returns: the value returned by the job function
+ */
+gboolean
+grl_db_worker_finish (GAsyncResult *result,
+                      GError **error)
+{
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
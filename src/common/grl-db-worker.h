@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef _GRL_DB_WORKER_H_
+#define _GRL_DB_WORKER_H_
+
+#include <gio/gio.h>
+#include <sqlite3.h>
+
+/* A dedicated thread owning a SQLite connection. Jobs are run in order on
+   that thread, and their completion is reported in the main context of the
+   thread that pushed them. */
+
+typedef struct _GrlDbWorker GrlDbWorker;
+
+/* Runs in the worker thread. Returns FALSE and sets @error on failure. */
+typedef gboolean (*GrlDbWorkerFunc) (sqlite3 *db,
+                                     gpointer data,
+                                     GError **error);
+
+GrlDbWorker *grl_db_worker_new (const gchar *db_path,
+                                GrlDbWorkerFunc init_func);
+
+void grl_db_worker_free (GrlDbWorker *worker);
+
+void grl_db_worker_push (GrlDbWorker *worker,
+                         gpointer source_object,
+                         GrlDbWorkerFunc func,
+                         gpointer data,
+                         GDestroyNotify data_destroy,
+                         GAsyncReadyCallback callback,
+                         gpointer user_data);
+
+gboolean grl_db_worker_finish (GAsyncResult *result,
+                               GError **error);
+
+#endif /* _GRL_DB_WORKER_H_ */
@@ -0,0 +1,400 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <grilo.h>
+
+#include "grl-file-cache.h"
+
+#define GRL_LOG_DOMAIN_DEFAULT file_cache_log_domain
+GRL_LOG_DOMAIN_STATIC(file_cache_log_domain);
+
+/* Seconds to wait after a change before saving the cache, so the values
+   computed while browsing a folder are saved at once */
+#define SAVE_DELAY 10
+
+/* The file holds a "(ua(sttt<value>))" GVariant: the format version, then
+   "(uri, size, mtime, inode, value)" entries, least recently used first.
+   A file of another version, or in the other byte order, is ignored. */
+#define FILE_CACHE_VERSION 0x47524c01
+
+typedef struct {
+  gchar    *uri;
+  guint64   size;
+  guint64   mtime;
+  guint64   inode;
+  GVariant *value;
+} FileCacheEntry;
+
+struct _GrlFileCache {
+  guint         max_entries;
+  gchar        *path;
+  GVariantType *value_type;
+  GVariantType *entries_type;
+  /* URI -> GList link in lru */
+  GHashTable   *entries;
+  /* FileCacheEntry, most recently used first */
+  GQueue       *lru;
+  guint         save_id;
+};
+
+/* ======================= Utilities ==================== */
+
+static void
+file_cache_entry_free (FileCacheEntry *entry)
+{
+  g_free (entry->uri);
+  g_variant_unref (entry->value);
+  g_slice_free (FileCacheEntry, entry);
+}
+
+static void
+file_cache_entry_set_info (FileCacheEntry *entry,
+                           GFileInfo *info)
+{
+  entry->size = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_STANDARD_SIZE);
+  entry->mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+  entry->inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+}
+
+static void
+cache_remove_link (GrlFileCache *cache,
+                   GList *link)
+{
+  FileCacheEntry *entry = link->data;
+
+  g_hash_table_remove (cache->entries, entry->uri);
+  g_queue_delete_link (cache->lru, link);
+  file_cache_entry_free (entry);
+}
+
+static void
+cache_push (GrlFileCache *cache,
+            FileCacheEntry *entry)
+{
+  GList *link;
+
+  link = g_hash_table_lookup (cache->entries, entry->uri);
+  if (link != NULL)
+    cache_remove_link (cache, link);
+
+  g_queue_push_head (cache->lru, entry);
+  g_hash_table_insert (cache->entries, entry->uri, cache->lru->head);
+
+  /* Evict least recently used */
+  while (g_queue_get_length (cache->lru) > cache->max_entries)
+    cache_remove_link (cache, cache->lru->tail);
+}
+
+static GVariantType *
+cache_file_type (GrlFileCache *cache)
+{
+  const GVariantType *members[2];
+
+  members[0] = G_VARIANT_TYPE_UINT32;
+  members[1] = cache->entries_type;
+
+  return g_variant_type_new_tuple (members, 2);
+}
+
+static void
+cache_load (GrlFileCache *cache)
+{
+  GVariantType *type;
+  GVariant *data, *entries, *child;
+  GError *error = NULL;
+  gchar *contents;
+  gsize length;
+  gsize i, n;
+
+  if (!g_file_get_contents (cache->path, &contents, &length, &error)) {
+    if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+      GRL_DEBUG ("Could not load cache: %s", error->message);
+    g_error_free (error);
+    return;
+  }
+
+  /* Not trusted: a damaged file only yields empty or wrong values */
+  type = cache_file_type (cache);
+  data = g_variant_new_from_data (type, contents, length, FALSE,
+                                  g_free, contents);
+  g_variant_ref_sink (data);
+  g_variant_type_free (type);
+
+  child = g_variant_get_child_value (data, 0);
+  if (g_variant_get_uint32 (child) != FILE_CACHE_VERSION) {
+    GRL_DEBUG ("Ignoring cache %s, written in another format", cache->path);
+    g_variant_unref (child);
+    g_variant_unref (data);
+    return;
+  }
+  g_variant_unref (child);
+
+  entries = g_variant_get_child_value (data, 1);
+  n = g_variant_n_children (entries);
+  for (i = 0; i < n; i++) {
+    FileCacheEntry *entry;
+    const gchar *uri;
+
+    entry = g_slice_new0 (FileCacheEntry);
+    g_variant_get_child (entries, i, "(&sttt@*)",
+                         &uri, &entry->size, &entry->mtime, &entry->inode,
+                         &entry->value);
+
+    if (uri[0] == '\0') {
+      file_cache_entry_free (entry);
+      continue;
+    }
+
+    /* Do not keep the whole file around for each value */
+    child = g_variant_get_normal_form (entry->value);
+    g_variant_unref (entry->value);
+    entry->value = child;
+
+    entry->uri = g_strdup (uri);
+    cache_push (cache, entry);
+  }
+  g_variant_unref (entries);
+  g_variant_unref (data);
+
+  GRL_DEBUG ("Loaded %u entries from %s",
+             g_queue_get_length (cache->lru), cache->path);
+}
+
+static GBytes *
+cache_serialize (GrlFileCache *cache)
+{
+  GVariantBuilder builder;
+  GVariant *data;
+  GBytes *bytes;
+  GList *link;
+
+  g_variant_builder_init (&builder, cache->entries_type);
+  for (link = cache->lru->tail; link != NULL; link = link->prev) {
+    FileCacheEntry *entry = link->data;
+
+    g_variant_builder_add (&builder, "(sttt@*)",
+                           entry->uri, entry->size, entry->mtime, entry->inode,
+                           entry->value);
+  }
+
+  data = g_variant_new ("(u@*)",
+                        FILE_CACHE_VERSION,
+                        g_variant_builder_end (&builder));
+  g_variant_ref_sink (data);
+  bytes = g_variant_get_data_as_bytes (data);
+  g_variant_unref (data);
+
+  return bytes;
+}
+
+static void
+cache_saved (GObject *source_object,
+             GAsyncResult *result,
+             gpointer user_data)
+{
+  GError *error = NULL;
+
+  if (!g_file_replace_contents_finish (G_FILE (source_object), result,
+                                       NULL, &error)) {
+    GRL_DEBUG ("Could not save cache: %s", error->message);
+    g_error_free (error);
+  }
+}
+
+static gboolean
+cache_save_cb (gpointer user_data)
+{
+  GrlFileCache *cache = user_data;
+  GFile *file;
+  GBytes *bytes;
+
+  cache->save_id = 0;
+
+  file = g_file_new_for_path (cache->path);
+  bytes = cache_serialize (cache);
+  g_file_replace_contents_bytes_async (file, bytes, NULL, FALSE,
+                                       G_FILE_CREATE_PRIVATE |
+                                       G_FILE_CREATE_REPLACE_DESTINATION,
+                                       NULL, cache_saved, NULL);
+  g_bytes_unref (bytes);
+  g_object_unref (file);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* ======================= Public API ==================== */
+
+/**
+ * grl_file_cache_new:
+ * @name: path of the cache file, relative to the grilo-plugins directory
+ * in the user cache directory
+ * @value_type: type of the values stored
+ * @max_entries: maximum number of values kept
+ *
+ * Returns: (transfer full): a new #GrlFileCache, holding the values saved
+ * by previous instances.
+ */
+GrlFileCache *
+grl_file_cache_new (const gchar *name,
+                    const GVariantType *value_type,
+                    guint max_entries)
+{
+  GrlFileCache *cache;
+  const GVariantType *members[5];
+  GVariantType *entry_type;
+  gchar *dir;
+
+  if (!file_cache_log_domain) {
+    GRL_LOG_DOMAIN_INIT (file_cache_log_domain, "file-cache");
+  }
+
+  cache = g_slice_new0 (GrlFileCache);
+  cache->max_entries = MAX (max_entries, 1);
+  cache->entries = g_hash_table_new (g_str_hash, g_str_equal);
+  cache->lru = g_queue_new ();
+
+  members[0] = G_VARIANT_TYPE_STRING;
+  members[1] = G_VARIANT_TYPE_UINT64;
+  members[2] = G_VARIANT_TYPE_UINT64;
+  members[3] = G_VARIANT_TYPE_UINT64;
+  members[4] = value_type;
+  entry_type = g_variant_type_new_tuple (members, 5);
+  cache->entries_type = g_variant_type_new_array (entry_type);
+  g_variant_type_free (entry_type);
+  cache->value_type = g_variant_type_copy (value_type);
+
+  cache->path = g_build_filename (g_get_user_cache_dir (),
+                                  "grilo-plugins",
+                                  name,
+                                  NULL);
+  dir = g_path_get_dirname (cache->path);
+  if (g_mkdir_with_parents (dir, 0700) != 0)
+    GRL_WARNING ("Could not create cache directory %s", dir);
+  g_free (dir);
+
+  cache_load (cache);
+
+  return cache;
+}
+
+/**
+ * grl_file_cache_free:
+ * @cache: a #GrlFileCache
+ *
+ * Saves the pending changes, then frees @cache.
+ */
+void
+grl_file_cache_free (GrlFileCache *cache)
+{
+  if (cache->save_id != 0) {
+    GBytes *bytes;
+    GError *error = NULL;
+
+    g_source_remove (cache->save_id);
+    bytes = cache_serialize (cache);
+    if (!g_file_set_contents (cache->path,
+                              g_bytes_get_data (bytes, NULL),
+                              g_bytes_get_size (bytes),
+                              &error)) {
+      GRL_DEBUG ("Could not save cache: %s", error->message);
+      g_error_free (error);
+    }
+    g_bytes_unref (bytes);
+  }
+
+  g_queue_free_full (cache->lru, (GDestroyNotify) file_cache_entry_free);
+  g_hash_table_unref (cache->entries);
+  g_variant_type_free (cache->entries_type);
+  g_variant_type_free (cache->value_type);
+  g_free (cache->path);
+  g_slice_free (GrlFileCache, cache);
+}
+
+/**
+ * grl_file_cache_lookup:
+ * @cache: a #GrlFileCache
+ * @uri: URI of the file
+ * @info: information about the file, with its standard::size,
+ * time::modified and unix::inode attributes
+ *
+ * Returns: (transfer full) (nullable): the value stored for this version
+ * of the file, or %NULL
+ */
+GVariant *
+grl_file_cache_lookup (GrlFileCache *cache,
+                       const gchar *uri,
+                       GFileInfo *info)
+{
+  FileCacheEntry current;
+  FileCacheEntry *entry;
+  GList *link;
+
+  link = g_hash_table_lookup (cache->entries, uri);
+  if (link == NULL)
+    return NULL;
+
+  entry = link->data;
+  file_cache_entry_set_info (&current, info);
+  if (entry->size != current.size ||
+      entry->mtime != current.mtime ||
+      entry->inode != current.inode) {
+    GRL_DEBUG ("Dropping outdated value of %s", uri);
+    cache_remove_link (cache, link);
+    return NULL;
+  }
+
+  /* Most recently used */
+  g_queue_unlink (cache->lru, link);
+  g_queue_push_head_link (cache->lru, link);
+
+  return g_variant_ref (entry->value);
+}
+
+/**
+ * grl_file_cache_store:
+ * @cache: a #GrlFileCache
+ * @uri: URI of the file
+ * @info: information about the file, as in grl_file_cache_lookup()
+ * @value: the value computed from the file, of the type given to
+ * grl_file_cache_new(). If floating, it is consumed.
+ */
+void
+grl_file_cache_store (GrlFileCache *cache,
+                      const gchar *uri,
+                      GFileInfo *info,
+                      GVariant *value)
+{
+  FileCacheEntry *entry;
+
+  g_return_if_fail (g_variant_is_of_type (value, cache->value_type));
+
+  entry = g_slice_new0 (FileCacheEntry);
+  entry->uri = g_strdup (uri);
+  entry->value = g_variant_ref_sink (value);
+  file_cache_entry_set_info (entry, info);
+  cache_push (cache, entry);
+
+  if (cache->save_id == 0)
+    cache->save_id = g_timeout_add_seconds (SAVE_DELAY, cache_save_cb, cache);
+}
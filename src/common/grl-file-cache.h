@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef _GRL_FILE_CACHE_H_
+#define _GRL_FILE_CACHE_H_
+
+#include <gio/gio.h>
+
+/* Least recently used cache of values computed from the content of files,
+   such as hashes or fingerprints. Values are keyed by the URI of the file,
+   and only returned while the file keeps the size, modification time and
+   inode it had when they were stored. The cache is saved as a GVariant in
+   the user cache directory, a few seconds after it changes and when it is
+   freed. */
+
+typedef struct _GrlFileCache GrlFileCache;
+
+GrlFileCache *grl_file_cache_new (const gchar *name,
+                                  const GVariantType *value_type,
+                                  guint max_entries);
+
+void grl_file_cache_free (GrlFileCache *cache);
+
+GVariant *grl_file_cache_lookup (GrlFileCache *cache,
+                                 const gchar *uri,
+                                 GFileInfo *info);
+
+void grl_file_cache_store (GrlFileCache *cache,
+                           const gchar *uri,
+                           GFileInfo *info,
+                           GVariant *value);
+
+#endif /* _GRL_FILE_CACHE_H_ */
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "grl-fts-match.h"
+
+/**
+ * grl_fts_match_expression:
+ * @text: the text searched by the user
+ *
+ * Builds an SQLite FTS5 query matching @text as a whole. The text is
+ * quoted, so the FTS5 query syntax in @text is matched literally.
+ *
+ * On a table using the GRL_FTS_TOKENIZE tokenizer, this finds @text
+ * anywhere in a column, as LIKE '%text%' does, but through the index. The
+ * trigram tokenizer can not match less than three characters, so for
+ * shorter texts there is no expression and callers use LIKE instead.
+ *
+ * Returns: (transfer full) (nullable): the match expression, or %NULL if
+ * @text is too short
+ */
+gchar *
+grl_fts_match_expression (const gchar *text)
+{
+  GString *match;
+  const gchar *p;
+
+  if (text == NULL || g_utf8_strlen (text, -1) < GRL_FTS_MIN_LENGTH)
+    return NULL;
+
+  match = g_string_new ("\"");
+  for (p = text; *p; p++) {
+    if (*p == '"')
+      g_string_append_c (match, '"');
+    g_string_append_c (match, *p);
+  }
+  g_string_append_c (match, '"');
+
+  return g_string_free (match, FALSE);
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef _GRL_FTS_MATCH_H_
+#define _GRL_FTS_MATCH_H_
+
+#include <glib.h>
+
+/* Tokenizer of the FTS5 tables searched with grl_fts_match_expression(),
+ * which needs SQLite 3.34 or later */
+#define GRL_FTS_TOKENIZE "tokenize = 'trigram'"
+
+/* Shortest text the trigram tokenizer can match */
+#define GRL_FTS_MIN_LENGTH 3
+
+gchar *grl_fts_match_expression (const gchar *text);
+
+#endif /* _GRL_FTS_MATCH_H_ */
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "grl-lru-cache.h"
+
+typedef struct {
+  gchar    *key;
+  gpointer  value;
+} GrlLruCacheEntry;
+
+struct _GrlLruCache {
+  guint           max_entries;
+  GDestroyNotify  value_destroy;
+  /* Key -> GList link in lru */
+  GHashTable     *entries;
+  /* GrlLruCacheEntry, most recently used first */
+  GQueue         *lru;
+};
+
+/* ======================= Utilities ==================== */
+
+static void
+cache_remove_link (GrlLruCache *cache,
+                   GList *link)
+{
+  GrlLruCacheEntry *entry = link->data;
+
+  g_hash_table_remove (cache->entries, entry->key);
+  g_queue_delete_link (cache->lru, link);
+
+  if (cache->value_destroy != NULL)
+    cache->value_destroy (entry->value);
+  g_free (entry->key);
+  g_slice_free (GrlLruCacheEntry, entry);
+}
+
+/* ======================= Public API ==================== */
+
+/**
+ * grl_lru_cache_new:
+ * @max_entries: maximum number of values kept
+ * @value_destroy: (nullable): function to free the values
+ *
+ * Returns: (transfer full): a new, empty #GrlLruCache
+ */
+GrlLruCache *
+grl_lru_cache_new (guint max_entries,
+                   GDestroyNotify value_destroy)
+{
+  GrlLruCache *cache;
+
+  cache = g_slice_new (GrlLruCache);
+  cache->max_entries = MAX (max_entries, 1);
+  cache->value_destroy = value_destroy;
+  cache->entries = g_hash_table_new (g_str_hash, g_str_equal);
+  cache->lru = g_queue_new ();
+
+  return cache;
+}
+
+void
+grl_lru_cache_free (GrlLruCache *cache)
+{
+  grl_lru_cache_remove_all (cache);
+  g_queue_free (cache->lru);
+  g_hash_table_unref (cache->entries);
+  g_slice_free (GrlLruCache, cache);
+}
+
+guint
+grl_lru_cache_size (GrlLruCache *cache)
+{
+  return g_queue_get_length (cache->lru);
+}
+
+/**
+ * grl_lru_cache_lookup:
+ * @cache: a #GrlLruCache
+ * @key: the key to look up
+ * @value: (out) (optional) (transfer none): return location for the value
+ *
+ * Looks up @key, which becomes the most recently used one.
+ *
+ * Returns: %TRUE if @key is cached, even if its value is %NULL
+ */
+gboolean
+grl_lru_cache_lookup (GrlLruCache *cache,
+                      const gchar *key,
+                      gpointer *value)
+{
+  GList *link;
+
+  link = g_hash_table_lookup (cache->entries, key);
+  if (link == NULL)
+    return FALSE;
+
+  /* Most recently used */
+  g_queue_unlink (cache->lru, link);
+  g_queue_push_head_link (cache->lru, link);
+
+  if (value != NULL)
+    *value = ((GrlLruCacheEntry *) link->data)->value;
+
+  return TRUE;
+}
+
+/**
+ * grl_lru_cache_insert:
+ * @cache: a #GrlLruCache
+ * @key: the key
+ * @value: (transfer full) (nullable): the value, replacing any other value
+ * of @key
+ *
+ * Adds @key as the most recently used one, evicting the least recently used
+ * ones when there are too many.
+ */
+void
+grl_lru_cache_insert (GrlLruCache *cache,
+                      const gchar *key,
+                      gpointer value)
+{
+  GrlLruCacheEntry *entry;
+
+  grl_lru_cache_remove (cache, key);
+
+  entry = g_slice_new (GrlLruCacheEntry);
+  entry->key = g_strdup (key);
+  entry->value = value;
+
+  g_queue_push_head (cache->lru, entry);
+  g_hash_table_insert (cache->entries, entry->key, cache->lru->head);
+
+  /* Evict least recently used */
+  while (g_queue_get_length (cache->lru) > cache->max_entries)
+    cache_remove_link (cache, cache->lru->tail);
+}
+
+void
+grl_lru_cache_remove (GrlLruCache *cache,
+                      const gchar *key)
+{
+  GList *link;
+
+  link = g_hash_table_lookup (cache->entries, key);
+  if (link != NULL)
+    cache_remove_link (cache, link);
+}
+
+/**
+ * grl_lru_cache_foreach_remove:
+ * @cache: a #GrlLruCache
+ * @func: called with each key and value, and @user_data. Returns %TRUE to
+ * remove the entry.
+ * @user_data: data passed to @func
+ */
+void
+grl_lru_cache_foreach_remove (GrlLruCache *cache,
+                              GHRFunc func,
+                              gpointer user_data)
+{
+  GList *link, *next;
+
+  for (link = cache->lru->head; link != NULL; link = next) {
+    GrlLruCacheEntry *entry = link->data;
+
+    next = link->next;
+    if (func (entry->key, entry->value, user_data))
+      cache_remove_link (cache, link);
+  }
+}
+
+void
+grl_lru_cache_remove_all (GrlLruCache *cache)
+{
+  while (!g_queue_is_empty (cache->lru))
+    cache_remove_link (cache, cache->lru->head);
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef _GRL_LRU_CACHE_H_
+#define _GRL_LRU_CACHE_H_
+
+#include <glib.h>
+
+/* In-memory map from strings to values, keeping only the most recently used
+   ones. */
+
+typedef struct _GrlLruCache GrlLruCache;
+
+GrlLruCache *grl_lru_cache_new (guint max_entries,
+                                GDestroyNotify value_destroy);
+
+void grl_lru_cache_free (GrlLruCache *cache);
+
+guint grl_lru_cache_size (GrlLruCache *cache);
+
+gboolean grl_lru_cache_lookup (GrlLruCache *cache,
+                               const gchar *key,
+                               gpointer *value);
+
+void grl_lru_cache_insert (GrlLruCache *cache,
+                           const gchar *key,
+                           gpointer value);
+
+void grl_lru_cache_remove (GrlLruCache *cache,
+                           const gchar *key);
+
+void grl_lru_cache_foreach_remove (GrlLruCache *cache,
+                                   GHRFunc func,
+                                   gpointer user_data);
+
+void grl_lru_cache_remove_all (GrlLruCache *cache);
+
+#endif /* _GRL_LRU_CACHE_H_ */
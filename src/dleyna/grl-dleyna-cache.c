@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "grl-lru-cache.h"
+#include "grl-dleyna-cache.h"
+
+struct _GrlDleynaCache {
+  /* Bumped whenever objects are dropped, so replies to requests made
+   * before are not cached */
+  guint        generation;
+  /* Object path -> (Properties filter -> a{sv}) */
+  GrlLruCache *objects;
+  /* Object path and children request -> aa{sv}. Kept apart from the
+   * objects, as the pages of a single container are not bounded. */
+  GrlLruCache *pages;
+};
+
+static gchar *
+page_key (const gchar *object_path,
+          const gchar *request)
+{
+  return g_strconcat (object_path, "\n", request, NULL);
+}
+
+static gboolean
+page_of_object (gpointer key,
+                gpointer value,
+                gpointer user_data)
+{
+  return g_str_has_prefix (key, user_data);
+}
+
+GrlDleynaCache *
+grl_dleyna_cache_new (guint max_objects,
+                      guint max_pages)
+{
+  GrlDleynaCache *cache;
+
+  cache = g_slice_new (GrlDleynaCache);
+  cache->generation = 0;
+  cache->objects = grl_lru_cache_new (max_objects,
+                                      (GDestroyNotify) g_hash_table_unref);
+  cache->pages = grl_lru_cache_new (max_pages,
+                                    (GDestroyNotify) g_variant_unref);
+
+  return cache;
+}
+
+void
+grl_dleyna_cache_free (GrlDleynaCache *cache)
+{
+  grl_lru_cache_free (cache->pages);
+  grl_lru_cache_free (cache->objects);
+  g_slice_free (GrlDleynaCache, cache);
+}
+
+/* Returns: the value to pass when inserting the reply of a request made now */
+guint
+grl_dleyna_cache_get_generation (GrlDleynaCache *cache)
+{
+  return cache->generation;
+}
+
+/* Returns: (transfer full): the properties of @object_path retrieved with
+ * @filter, or %NULL if they are not cached */
+GVariant *
+grl_dleyna_cache_lookup_properties (GrlDleynaCache *cache,
+                                    const gchar *object_path,
+                                    const gchar *filter)
+{
+  GHashTable *object;
+  GVariant *properties;
+
+  if (!grl_lru_cache_lookup (cache->objects, object_path, (gpointer *) &object))
+    return NULL;
+
+  properties = g_hash_table_lookup (object, filter);
+
+  return (properties != NULL) ? g_variant_ref (properties) : NULL;
+}
+
+/* Caches @properties, unless objects were dropped since @generation */
+void
+grl_dleyna_cache_insert_properties (GrlDleynaCache *cache,
+                                    guint generation,
+                                    const gchar *object_path,
+                                    const gchar *filter,
+                                    GVariant *properties)
+{
+  GHashTable *object;
+
+  if (generation != cache->generation)
+    return;
+
+  if (!grl_lru_cache_lookup (cache->objects, object_path, (gpointer *) &object)) {
+    object = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                    g_free, (GDestroyNotify) g_variant_unref);
+    grl_lru_cache_insert (cache->objects, object_path, object);
+  }
+
+  g_hash_table_insert (object,
+                       g_strdup (filter),
+                       g_variant_ref_sink (properties));
+}
+
+/* Returns: (transfer full): the page of children of @object_path replied
+ * to @request, or %NULL if it is not cached */
+GVariant *
+grl_dleyna_cache_lookup_children (GrlDleynaCache *cache,
+                                  const gchar *object_path,
+                                  const gchar *request)
+{
+  GVariant *children = NULL;
+  gchar *key;
+
+  key = page_key (object_path, request);
+  grl_lru_cache_lookup (cache->pages, key, (gpointer *) &children);
+  g_free (key);
+
+  return (children != NULL) ? g_variant_ref (children) : NULL;
+}
+
+/* Caches @children, unless objects were dropped since @generation */
+void
+grl_dleyna_cache_insert_children (GrlDleynaCache *cache,
+                                  guint generation,
+                                  const gchar *object_path,
+                                  const gchar *request,
+                                  GVariant *children)
+{
+  gchar *key;
+
+  if (generation != cache->generation)
+    return;
+
+  key = page_key (object_path, request);
+  grl_lru_cache_insert (cache->pages, key, g_variant_ref_sink (children));
+  g_free (key);
+}
+
+/* Drops the properties and children of @object_path */
+void
+grl_dleyna_cache_remove (GrlDleynaCache *cache,
+                         const gchar *object_path)
+{
+  gchar *prefix;
+
+  cache->generation++;
+
+  grl_lru_cache_remove (cache->objects, object_path);
+
+  prefix = page_key (object_path, "");
+  grl_lru_cache_foreach_remove (cache->pages, page_of_object, prefix);
+  g_free (prefix);
+}
+
+void
+grl_dleyna_cache_clear (GrlDleynaCache *cache)
+{
+  cache->generation++;
+
+  grl_lru_cache_remove_all (cache->objects);
+  grl_lru_cache_remove_all (cache->pages);
+}
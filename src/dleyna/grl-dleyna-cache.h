@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef _GRL_DLEYNA_CACHE_H_
+#define _GRL_DLEYNA_CACHE_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Number of objects whose properties are kept in memory */
+#define GRL_DLEYNA_CACHE_MAX_OBJECTS 256
+
+/* Number of pages of children kept in memory, across all containers */
+#define GRL_DLEYNA_CACHE_MAX_PAGES 64
+
+/* Properties and pages of children of the most recently used objects of a
+ * server, until the server reports they changed. */
+typedef struct _GrlDleynaCache GrlDleynaCache;
+
+GrlDleynaCache *grl_dleyna_cache_new (guint max_objects,
+                                      guint max_pages);
+
+void grl_dleyna_cache_free (GrlDleynaCache *cache);
+
+guint grl_dleyna_cache_get_generation (GrlDleynaCache *cache);
+
+GVariant *grl_dleyna_cache_lookup_properties (GrlDleynaCache *cache,
+                                              const gchar *object_path,
+                                              const gchar *filter);
+
+void grl_dleyna_cache_insert_properties (GrlDleynaCache *cache,
+                                         guint generation,
+                                         const gchar *object_path,
+                                         const gchar *filter,
+                                         GVariant *properties);
+
+GVariant *grl_dleyna_cache_lookup_children (GrlDleynaCache *cache,
+                                            const gchar *object_path,
+                                            const gchar *request);
+
+void grl_dleyna_cache_insert_children (GrlDleynaCache *cache,
+                                       guint generation,
+                                       const gchar *object_path,
+                                       const gchar *request,
+                                       GVariant *children);
+
+void grl_dleyna_cache_remove (GrlDleynaCache *cache,
+                              const gchar *object_path);
+
+void grl_dleyna_cache_clear (GrlDleynaCache *cache);
+
+G_END_DECLS
+
+#endif /* _GRL_DLEYNA_CACHE_H_ */
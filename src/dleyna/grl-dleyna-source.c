@@ -24,6 +24,7 @@
 
 #include "config.h"
 
+#include "grl-dleyna-cache.h"
 #include "grl-dleyna-source.h"
 #include "grl-dleyna-utils.h"
 
@@ -56,12 +57,19 @@
 #define DLEYNA_TYPE_FILTER_CONTAINER      \
   "Type derivedfrom \"container\""
 
+/* Number of objects requested at once by browse, search and query */
+#define DLEYNA_PAGE_SIZE 256
+
+/* Number of medias built and sent per main loop iteration */
+#define DLEYNA_EMIT_BATCH 16
+
 #define GRL_LOG_DOMAIN_DEFAULT dleyna_log_domain
 GRL_LOG_DOMAIN_EXTERN(dleyna_log_domain);
 
 struct _GrlDleynaSourcePrivate {
   GrlDleynaServer *server;
   GHashTable *uploads;
+  GrlDleynaCache *cache;
   gboolean search_enabled;
   gboolean browse_filtered_enabled;
 };
@@ -79,6 +87,49 @@ typedef enum {
   CONTAINER_TYPE_NOT_CONTAINER
 } ContainerType;
 
+/* Results of a browse, search or query, fetched by pages while the previous
+ * one is sent */
+typedef struct {
+  GrlSource *source;
+  GrlDleynaMediaContainer2 *container;
+  /* SearchObjects criteria, or NULL to use ListChildren */
+  gchar *query;
+  gchar const **filter;
+  GCancellable *cancellable;
+  gint error_code;
+  guint operation_id;
+  GrlSourceResultCb callback;
+  gpointer user_data;
+  /* Offset and size of the next page to request. Servers may return fewer
+   * objects than requested, so the offset advances by the received ones. */
+  guint offset;
+  guint requested;
+  /* Container whose children are listed, if they can be cached */
+  gchar *cache_path;
+  gchar *cache_request;
+  guint cache_generation;
+  /* Objects left to request, unless unlimited */
+  guint wanted;
+  gboolean unlimited;
+  /* Page being sent, and the one received after it */
+  GVariant *page;
+  gsize page_pos;
+  gsize page_len;
+  GVariant *next_page;
+  gboolean fetching;
+  /* Whether no more pages will be requested */
+  gboolean exhausted;
+  gboolean finished;
+  guint idle_id;
+} PagedResults;
+
+/* Resolve in progress, whose properties are cached once retrieved */
+typedef struct {
+  GrlSourceResolveSpec *rs;
+  gchar *filter;
+  guint cache_generation;
+} ResolveData;
+
 typedef enum {
   DLEYNA_CHANGE_TYPE_ADD = 1,
   DLEYNA_CHANGE_TYPE_MOD = 2,
@@ -90,6 +141,7 @@ typedef enum {
 /* ================== Prototypes ================== */
 
 static void            grl_dleyna_source_dispose              (GObject *object);
+static void            grl_dleyna_source_finalize             (GObject *object);
 static void            grl_dleyna_source_set_property         (GObject *object,
                                                                guint prop_id,
                                                                const GValue *value,
@@ -138,6 +190,7 @@ grl_dleyna_source_class_init (GrlDleynaSourceClass * klass)
   GrlSourceClass *source_class = GRL_SOURCE_CLASS (klass);
 
   gobject_class->dispose = grl_dleyna_source_dispose;
+  gobject_class->finalize = grl_dleyna_source_finalize;
   gobject_class->get_property = grl_dleyna_source_get_property;
   gobject_class->set_property = grl_dleyna_source_set_property;
 
@@ -175,6 +228,8 @@ grl_dleyna_source_init (GrlDleynaSource *source)
   source->priv = grl_dleyna_source_get_instance_private (source);
   source->priv->uploads = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
                                                  (GDestroyNotify)grl_dleyna_source_upload_destroy);
+  source->priv->cache = grl_dleyna_cache_new (GRL_DLEYNA_CACHE_MAX_OBJECTS,
+                                              GRL_DLEYNA_CACHE_MAX_PAGES);
 }
 
 static void
@@ -187,6 +242,16 @@ grl_dleyna_source_dispose (GObject *object)
   G_OBJECT_CLASS (grl_dleyna_source_parent_class)->dispose (object);
 }
 
+static void
+grl_dleyna_source_finalize (GObject *object)
+{
+  GrlDleynaSource *source = GRL_DLEYNA_SOURCE (object);
+
+  grl_dleyna_cache_free (source->priv->cache);
+
+  G_OBJECT_CLASS (grl_dleyna_source_parent_class)->finalize (object);
+}
+
 static void
 grl_dleyna_source_set_property (GObject *object,
                                 guint prop_id,
@@ -342,6 +407,9 @@ grl_dleyna_source_store_upload_completed (GrlSourceStoreSpec *ss,
     return;
   }
 
+  /* The server will report the change, but not necessarily right away */
+  grl_dleyna_cache_clear (GRL_DLEYNA_SOURCE (ss->source)->priv->cache);
+
   if (object_path != NULL) {
     grl_dleyna_source_media_set_id_from_object_path (ss->media, object_path);
   }
@@ -389,6 +457,53 @@ grl_dleyna_source_store_upload_update_cb (GrlDleynaSource      *self,
   grl_dleyna_source_store_upload_completed (ss, NULL, error);
 }
 
+static void
+grl_dleyna_source_system_update_id_cb (GrlDleynaSource *source,
+                                       GParamSpec      *pspec,
+                                       gpointer         user_data)
+{
+  /* Something changed somewhere on the server */
+  GRL_DEBUG ("%s", G_STRFUNC);
+  grl_dleyna_cache_clear (source->priv->cache);
+}
+
+static void
+grl_dleyna_source_container_update_ids_cb (GrlDleynaSource *source,
+                                           GVariant        *container_paths_ids,
+                                           gpointer         user_data)
+{
+  GVariantIter iter;
+  const gchar *object_path;
+  guint32 update_id;
+
+  g_variant_iter_init (&iter, container_paths_ids);
+  while (g_variant_iter_next (&iter, "(&ou)", &object_path, &update_id)) {
+    GRL_DEBUG ("%s %s:%u", G_STRFUNC, object_path, update_id);
+    grl_dleyna_cache_remove (source->priv->cache, object_path);
+  }
+}
+
+static void
+grl_dleyna_source_invalidate_changed_cb (GrlDleynaSource *source,
+                                         GVariant        *changes,
+                                         gpointer         user_data)
+{
+  GVariantIter iter;
+  GVariant *change;
+  const gchar *object_path;
+
+  g_variant_iter_init (&iter, changes);
+  while ((change = g_variant_iter_next_value (&iter))) {
+    if (g_variant_lookup (change, "Path", "&o", &object_path)) {
+      grl_dleyna_cache_remove (source->priv->cache, object_path);
+    }
+    if (g_variant_lookup (change, "Parent", "&o", &object_path)) {
+      grl_dleyna_cache_remove (source->priv->cache, object_path);
+    }
+    g_variant_unref (change);
+  }
+}
+
 static void
 grl_dleyna_source_set_server (GrlDleynaSource *source,
                               GrlDleynaServer *server)
@@ -405,6 +520,18 @@ grl_dleyna_source_set_server (GrlDleynaSource *source,
 
   g_signal_connect_object (device, "notify::search-caps", G_CALLBACK (grl_dleyna_source_update_caps_cb),
                            source, G_CONNECT_SWAPPED);
+
+  /* Cached properties and children are dropped as the server reports
+   * changes to them */
+  g_signal_connect_object (device, "notify::system-update-id",
+                           G_CALLBACK (grl_dleyna_source_system_update_id_cb),
+                           source, G_CONNECT_SWAPPED);
+  g_signal_connect_object (device, "container-update-ids",
+                           G_CALLBACK (grl_dleyna_source_container_update_ids_cb),
+                           source, G_CONNECT_SWAPPED);
+  g_signal_connect_object (device, "changed",
+                           G_CALLBACK (grl_dleyna_source_invalidate_changed_cb),
+                           source, G_CONNECT_SWAPPED);
   grl_dleyna_source_update_caps_cb (G_OBJECT (source), NULL, device);
 
   g_signal_connect_object (device, "upload-update", G_CALLBACK(grl_dleyna_source_store_upload_update_cb),
@@ -747,43 +874,280 @@ build_variant_from_media (GrlMedia  *media,
 }
 
 static void
-grl_dleyna_source_results (GrlSource *source,
-                           GError *error,
-                           gint code,
-                           GVariant *results,
-                           guint operation_id,
-                           GrlSourceResultCb callback,
-                           gpointer user_data)
+grl_dleyna_source_results_free (PagedResults *pr)
+{
+  g_clear_pointer (&pr->page, g_variant_unref);
+  g_clear_pointer (&pr->next_page, g_variant_unref);
+  g_object_unref (pr->cancellable);
+  g_object_unref (pr->container);
+  g_free (pr->cache_request);
+  g_free (pr->cache_path);
+  g_free (pr->filter);
+  g_free (pr->query);
+  g_slice_free (PagedResults, pr);
+}
+
+/* Ends the operation, unless its last result was already sent. The results
+ * are freed once the page being fetched, if any, is received. */
+static void
+grl_dleyna_source_results_finish (PagedResults *pr,
+                                  const GError *error)
+{
+  if (!pr->finished) {
+    pr->finished = TRUE;
+    pr->callback (pr->source, pr->operation_id, NULL, 0, pr->user_data, error);
+  }
+
+  if (pr->idle_id != 0) {
+    g_source_remove (pr->idle_id);
+    pr->idle_id = 0;
+  }
+
+  if (!pr->fetching) {
+    grl_dleyna_source_results_free (pr);
+  }
+}
+
+static guint
+grl_dleyna_source_results_remaining (PagedResults *pr)
 {
-  GVariantIter iter;
-  GVariant *item;
   gsize remaining;
 
-  GRL_DEBUG (G_STRFUNC);
+  if (!pr->exhausted || pr->fetching) {
+    return GRL_SOURCE_REMAINING_UNKNOWN;
+  }
 
-  if (error != NULL) {
-    GRL_WARNING ("%s error:%s", G_STRFUNC, error->message);
-    error = grl_dleyna_source_convert_error (error, code);
-    callback (source, operation_id, NULL, 0, user_data, error);
-    g_error_free (error);
-    return;
+  remaining = pr->page_len - pr->page_pos;
+  if (pr->next_page != NULL) {
+    remaining += g_variant_n_children (pr->next_page);
   }
 
-  remaining = g_variant_n_children (results);
-  if (remaining == 0) {
-    GRL_DEBUG ("%s no results", G_STRFUNC);
-    callback (source, operation_id, NULL, 0, user_data, NULL);
-    return;
+  return remaining;
+}
+
+static void grl_dleyna_source_results_fetch (PagedResults *pr);
+
+/* Builds and sends a batch of medias, switching to the next page and
+ * requesting the one after it when the current page is over */
+static gboolean
+grl_dleyna_source_results_emit (gpointer user_data)
+{
+  PagedResults *pr = user_data;
+  guint sent = 0;
+
+  if (g_cancellable_is_cancelled (pr->cancellable)) {
+    pr->idle_id = 0;
+    grl_dleyna_source_results_finish (pr, NULL);
+    return G_SOURCE_REMOVE;
   }
 
-  g_variant_iter_init (&iter, results);
-  while ((item = g_variant_iter_next_value (&iter))) {
+  while (sent < DLEYNA_EMIT_BATCH) {
+    GVariant *item;
     GrlMedia *media;
+    guint remaining;
+
+    if (pr->page_pos == pr->page_len) {
+      g_clear_pointer (&pr->page, g_variant_unref);
+
+      if (pr->next_page == NULL) {
+        pr->idle_id = 0;
+        /* Otherwise sending resumes when the next page is received */
+        if (pr->exhausted && !pr->fetching) {
+          grl_dleyna_source_results_finish (pr, NULL);
+        }
+        return G_SOURCE_REMOVE;
+      }
+
+      pr->page = g_steal_pointer (&pr->next_page);
+      pr->page_pos = 0;
+      pr->page_len = g_variant_n_children (pr->page);
+
+      if (!pr->exhausted && !pr->fetching) {
+        grl_dleyna_source_results_fetch (pr);
+      }
+      continue;
+    }
+
+    item = g_variant_get_child_value (pr->page, pr->page_pos++);
     media = build_media_from_variant (item);
-    GRL_DEBUG ("%s %s", G_STRFUNC, grl_media_get_id (media));
-    callback (source, operation_id, media, --remaining, user_data, NULL);
     g_variant_unref (item);
+
+    remaining = grl_dleyna_source_results_remaining (pr);
+    GRL_DEBUG ("%s %s", G_STRFUNC, grl_media_get_id (media));
+    pr->callback (pr->source, pr->operation_id, media, remaining, pr->user_data, NULL);
+    sent++;
+
+    if (remaining == 0) {
+      pr->finished = TRUE;
+      pr->idle_id = 0;
+      grl_dleyna_source_results_finish (pr, NULL);
+      return G_SOURCE_REMOVE;
+    }
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
+/* Queues @page to be sent after the current one */
+static void
+grl_dleyna_source_results_received (PagedResults *pr,
+                                    GVariant     *page)
+{
+  gsize received = g_variant_n_children (page);
+
+  pr->offset += received;
+  if (!pr->unlimited) {
+    pr->wanted -= MIN (pr->wanted, received);
+  }
+
+  /* A short page does not mean the last one, as servers may cap the size of
+   * their replies: the results only end with an empty page */
+  if (received == 0 || (!pr->unlimited && pr->wanted == 0)) {
+    pr->exhausted = TRUE;
+  }
+
+  pr->next_page = page;
+
+  if (pr->idle_id == 0) {
+    pr->idle_id = g_idle_add (grl_dleyna_source_results_emit, pr);
+    g_source_set_name_by_id (pr->idle_id, "[dleyna] grl_dleyna_source_results_emit");
+  }
+}
+
+static void
+grl_dleyna_source_results_page_cb (GObject      *object,
+                                   GAsyncResult *res,
+                                   gpointer      user_data)
+{
+  GrlDleynaMediaContainer2 *container = GRL_DLEYNA_MEDIA_CONTAINER2 (object);
+  PagedResults *pr = user_data;
+  GVariant *page = NULL;
+  GError *error = NULL;
+
+  GRL_DEBUG (G_STRFUNC);
+
+  if (pr->query != NULL) {
+    grl_dleyna_media_container2_call_search_objects_finish (container, &page, res, &error);
+  }
+  else {
+    grl_dleyna_media_container2_call_list_children_finish (container, &page, res, &error);
+  }
+  pr->fetching = FALSE;
+
+  if (pr->finished) {
+    g_clear_pointer (&page, g_variant_unref);
+    g_clear_error (&error);
+    grl_dleyna_source_results_free (pr);
+    return;
+  }
+
+  if (error != NULL) {
+    /* Cancelled operations end without an error */
+    if (g_cancellable_is_cancelled (pr->cancellable)) {
+      g_clear_error (&error);
+    }
+    else {
+      GRL_WARNING ("%s error:%s", G_STRFUNC, error->message);
+      error = grl_dleyna_source_convert_error (error, pr->error_code);
+    }
+    grl_dleyna_source_results_finish (pr, error);
+    g_clear_error (&error);
+    return;
+  }
+
+  if (pr->cache_path != NULL) {
+    grl_dleyna_cache_insert_children (GRL_DLEYNA_SOURCE (pr->source)->priv->cache, pr->cache_generation,
+                                      pr->cache_path, pr->cache_request, page);
   }
+
+  grl_dleyna_source_results_received (pr, page);
+}
+
+static void
+grl_dleyna_source_results_fetch (PagedResults *pr)
+{
+  pr->requested = DLEYNA_PAGE_SIZE;
+  if (!pr->unlimited) {
+    pr->requested = MIN (pr->requested, pr->wanted);
+  }
+
+  GRL_DEBUG ("%s offset:%u max:%u", G_STRFUNC, pr->offset, pr->requested);
+
+  if (pr->cache_path != NULL) {
+    GrlDleynaCache *cache = GRL_DLEYNA_SOURCE (pr->source)->priv->cache;
+    GVariant *page;
+    gchar *filter;
+
+    filter = g_strjoinv (",", (gchar **) pr->filter);
+    g_free (pr->cache_request);
+    pr->cache_request = g_strdup_printf ("%s\n%u\n%u\n%s", pr->query ? pr->query : "",
+                                         pr->offset, pr->requested, filter);
+    g_free (filter);
+
+    page = grl_dleyna_cache_lookup_children (cache, pr->cache_path, pr->cache_request);
+    if (page != NULL) {
+      GRL_DEBUG ("%s using cached children of %s", G_STRFUNC, pr->cache_path);
+      grl_dleyna_source_results_received (pr, page);
+      return;
+    }
+
+    pr->cache_generation = grl_dleyna_cache_get_generation (cache);
+  }
+
+  pr->fetching = TRUE;
+  if (pr->query != NULL) {
+    grl_dleyna_media_container2_call_search_objects (pr->container, pr->query, pr->offset, pr->requested,
+                                                     pr->filter, pr->cancellable,
+                                                     grl_dleyna_source_results_page_cb, pr);
+  }
+  else {
+    grl_dleyna_media_container2_call_list_children (pr->container, pr->offset, pr->requested,
+                                                    pr->filter, pr->cancellable,
+                                                    grl_dleyna_source_results_page_cb, pr);
+  }
+}
+
+/* Lists the children of @container, or the objects matching @query under it,
+ * in pages of DLEYNA_PAGE_SIZE objects. The next page is requested while the
+ * medias of the current one are built and sent from idle callbacks, so large
+ * containers neither need a single huge reply nor block the main loop.
+ * If @cache_path is set, the pages are the children of that container and
+ * are cached. */
+static void
+grl_dleyna_source_results (GrlSource                *source,
+                           GrlDleynaMediaContainer2 *container,
+                           const gchar              *cache_path,
+                           const gchar              *query,
+                           gchar const             **filter,
+                           GrlOperationOptions      *options,
+                           GCancellable             *cancellable,
+                           gint                      error_code,
+                           guint                     operation_id,
+                           GrlSourceResultCb         callback,
+                           gpointer                  user_data)
+{
+  PagedResults *pr;
+  gint count;
+
+  pr = g_slice_new0 (PagedResults);
+  pr->source = source;
+  pr->container = g_object_ref (container);
+  pr->cache_path = g_strdup (cache_path);
+  pr->query = g_strdup (query);
+  pr->filter = filter;
+  pr->cancellable = g_object_ref (cancellable);
+  pr->error_code = error_code;
+  pr->operation_id = operation_id;
+  pr->callback = callback;
+  pr->user_data = user_data;
+  pr->offset = grl_operation_options_get_skip (options);
+
+  /* Grilo uses -1 to say "no limit", as dLeyna does with 0 */
+  count = grl_operation_options_get_count (options);
+  pr->unlimited = (count <= 0);
+  pr->wanted = MAX (0, count);
+
+  grl_dleyna_source_results_fetch (pr);
 }
 
 static gchar const **
@@ -903,11 +1267,15 @@ grl_dleyna_source_resolve_browse_objects_cb (GObject      *object,
 {
   ContainerType container_type = CONTAINER_TYPE_UNKNOWN;
   GrlDleynaMediaDevice *device = GRL_DLEYNA_MEDIA_DEVICE (object);
-  GrlSourceResolveSpec *rs = user_data;
+  ResolveData *data = user_data;
+  GrlSourceResolveSpec *rs = data->rs;
   GVariant *results, *dict, *item_error;
   GError *error = NULL;
+  gchar *filter = data->filter;
+  guint cache_generation = data->cache_generation;
 
   GRL_DEBUG (G_STRFUNC);
+  g_slice_free (ResolveData, data);
   grl_dleyna_media_device_call_browse_objects_finish (device, &results, res, &error);
 
   if (error != NULL) {
@@ -915,6 +1283,7 @@ grl_dleyna_source_resolve_browse_objects_cb (GObject      *object,
     error = grl_dleyna_source_convert_error (error, GRL_CORE_ERROR_RESOLVE_FAILED);
     rs->callback (rs->source, rs->operation_id, rs->media, rs->user_data, error);
     g_error_free (error);
+    g_free (filter);
     return;
   }
 
@@ -933,71 +1302,19 @@ grl_dleyna_source_resolve_browse_objects_cb (GObject      *object,
                         _("Failed to retrieve item properties (BrowseObjects error %d: %s)"), id, message);
     rs->callback (rs->source, rs->operation_id, rs->media, rs->user_data, error);
     g_error_free (error);
+    g_free (filter);
     return;
   }
 
+  grl_dleyna_cache_insert_properties (GRL_DLEYNA_SOURCE (rs->source)->priv->cache, cache_generation,
+                                      grl_dleyna_source_media_get_object_path (rs->media), filter, dict);
+
   populate_media_from_variant (rs->media, dict, container_type);
   rs->callback (rs->source, rs->operation_id, rs->media, rs->user_data, NULL);
-}
 
-static void
-grl_dleyna_source_search_search_objects_cb (GObject      *object,
-                                            GAsyncResult *res,
-                                            gpointer      user_data)
-{
-  GrlDleynaMediaContainer2 *container = GRL_DLEYNA_MEDIA_CONTAINER2 (object);
-  GrlSourceSearchSpec *ss = user_data;
-  GVariant *results;
-  GError *error = NULL;
-
-  GRL_DEBUG (G_STRFUNC);
-  grl_dleyna_media_container2_call_search_objects_finish (container, &results, res, &error);
-  grl_dleyna_source_results (ss->source, error, GRL_CORE_ERROR_SEARCH_FAILED, results, ss->operation_id, ss->callback, ss->user_data);
-}
-
-static void
-grl_dleyna_source_query_search_objects_cb (GObject      *object,
-                                           GAsyncResult *res,
-                                           gpointer      user_data)
-{
-  GrlDleynaMediaContainer2 *container = GRL_DLEYNA_MEDIA_CONTAINER2 (object);
-  GrlSourceQuerySpec *qs = user_data;
-  GVariant *results;
-  GError *error = NULL;
-
-  GRL_DEBUG (G_STRFUNC);
-  grl_dleyna_media_container2_call_search_objects_finish (container, &results, res, &error);
-  grl_dleyna_source_results (qs->source, error, GRL_CORE_ERROR_QUERY_FAILED, results, qs->operation_id, qs->callback, qs->user_data);
-}
-
-static void
-grl_dleyna_source_browse_list_children_cb (GObject      *object,
-                                           GAsyncResult *res,
-                                           gpointer      user_data)
-{
-  GrlDleynaMediaContainer2 *container = GRL_DLEYNA_MEDIA_CONTAINER2 (object);
-  GrlSourceBrowseSpec *bs = user_data;
-  GVariant *children;
-  GError *error = NULL;
-
-  GRL_DEBUG (G_STRFUNC);
-  grl_dleyna_media_container2_call_list_children_finish (container, &children, res, &error);
-  grl_dleyna_source_results (bs->source, error, GRL_CORE_ERROR_BROWSE_FAILED, children, bs->operation_id, bs->callback, bs->user_data);
-}
-
-static void
-grl_dleyna_source_browse_search_objects_cb (GObject      *object,
-                                            GAsyncResult *res,
-                                            gpointer      user_data)
-{
-  GrlDleynaMediaContainer2 *container = GRL_DLEYNA_MEDIA_CONTAINER2 (object);
-  GrlSourceBrowseSpec *bs = user_data;
-  GVariant *children;
-  GError *error = NULL;
-
-  GRL_DEBUG (G_STRFUNC);
-  grl_dleyna_media_container2_call_search_objects_finish (container, &children, res, &error);
-  grl_dleyna_source_results (bs->source, error, GRL_CORE_ERROR_BROWSE_FAILED, children, bs->operation_id, bs->callback, bs->user_data);
+  g_variant_unref (dict);
+  g_variant_unref (results);
+  g_free (filter);
 }
 
 static void
@@ -1115,6 +1432,8 @@ grl_dleyna_source_store_metadata_update_cb (GObject      *obj,
     return;
   }
 
+  grl_dleyna_cache_clear (GRL_DLEYNA_SOURCE (sms->source)->priv->cache);
+
   /* Drop from the set of keys to be stored the writable ones */
   failed_keys = g_list_copy (sms->keys);
   for (w = grl_dleyna_source_writable_keys (sms->source); w != NULL; w = g_list_next (w))
@@ -1140,6 +1459,9 @@ grl_dleyna_source_remove_delete_cb (GObject      *obj,
     GRL_WARNING ("%s error:%s", G_STRFUNC, error->message);
     error = grl_dleyna_source_convert_error (error, GRL_CORE_ERROR_REMOVE_FAILED);
   }
+  else {
+    grl_dleyna_cache_clear (GRL_DLEYNA_SOURCE (rs->source)->priv->cache);
+  }
 
   rs->callback (rs->source, rs->media, rs->user_data, error);
   g_clear_error (&error);
@@ -1378,6 +1700,8 @@ grl_dleyna_source_resolve (GrlSource *source,
   GCancellable *cancellable;
   GPtrArray *filter;
   GList *iter;
+  GVariant *properties;
+  ResolveData *data;
   gchar const *media_id;
   gchar const *object_path;
   gchar const *object_paths[] = { NULL, NULL };
@@ -1404,18 +1728,35 @@ grl_dleyna_source_resolve (GrlSource *source,
     return;
   }
 
-  cancellable = g_cancellable_new ();
-  grl_operation_set_data_full (rs->operation_id, cancellable, g_object_unref);
-
   filter = g_ptr_array_new ();
   for (iter = rs->keys; iter != NULL; iter = g_list_next (iter)) {
     properties_add_for_key (filter, GRLPOINTER_TO_KEYID (iter->data));
   }
   g_ptr_array_add (filter, NULL); /* nul-terminate the strvector */
 
+  data = g_slice_new (ResolveData);
+  data->rs = rs;
+  data->filter = g_strjoinv (",", (gchar **) filter->pdata);
+  data->cache_generation = grl_dleyna_cache_get_generation (self->priv->cache);
+
+  properties = grl_dleyna_cache_lookup_properties (self->priv->cache, object_path, data->filter);
+  if (properties != NULL) {
+    GRL_DEBUG ("%s using cached properties of %s", G_STRFUNC, object_path);
+    populate_media_from_variant (rs->media, properties, CONTAINER_TYPE_UNKNOWN);
+    rs->callback (rs->source, rs->operation_id, rs->media, rs->user_data, NULL);
+    g_variant_unref (properties);
+    g_free (data->filter);
+    g_slice_free (ResolveData, data);
+    g_ptr_array_unref (filter);
+    return;
+  }
+
+  cancellable = g_cancellable_new ();
+  grl_operation_set_data_full (rs->operation_id, cancellable, g_object_unref);
+
   grl_dleyna_media_device_call_browse_objects (device, object_paths,
                                                (const gchar * const*)filter->pdata, cancellable,
-                                               grl_dleyna_source_resolve_browse_objects_cb, rs);
+                                               grl_dleyna_source_resolve_browse_objects_cb, data);
   g_ptr_array_unref (filter);
 }
 
@@ -1430,7 +1771,7 @@ grl_dleyna_source_browse (GrlSource *source,
   GrlTypeFilter type_filter;
   gchar const *object_path;
   gchar const **filter;
-  guint offset, limit;
+  gchar *query = NULL;
   GError *error = NULL;
 
   GRL_DEBUG (G_STRFUNC);
@@ -1440,10 +1781,6 @@ grl_dleyna_source_browse (GrlSource *source,
 
   root = grl_dleyna_server_get_media_container (self->priv->server);
   connection = g_dbus_proxy_get_connection (G_DBUS_PROXY (root));
-  filter = build_properties_filter (bs->keys);
-  offset = grl_operation_options_get_skip (bs->options);
-  /* Grilo uses -1 to say "no limit" while dLeyna expect 0 for the same purpose */
-  limit = MAX (0, grl_operation_options_get_count (bs->options));
 
   object_path = grl_dleyna_source_media_get_object_path (bs->container);
   if (object_path == NULL) {
@@ -1456,29 +1793,26 @@ grl_dleyna_source_browse (GrlSource *source,
                                                           G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS,
                                                           DLEYNA_DBUS_NAME, object_path, cancellable, &error);
   if (error != NULL) {
-    grl_dleyna_source_results (bs->source, error, GRL_CORE_ERROR_BROWSE_FAILED, NULL, bs->operation_id, bs->callback, bs->user_data);
-    goto out;
+    GRL_WARNING ("%s error:%s", G_STRFUNC, error->message);
+    error = grl_dleyna_source_convert_error (error, GRL_CORE_ERROR_BROWSE_FAILED);
+    bs->callback (bs->source, bs->operation_id, NULL, 0, bs->user_data, error);
+    g_error_free (error);
+    return;
   }
 
   /* invoke SearchObjects instead of ListChildren if we need to filter by type */
   type_filter = grl_operation_options_get_type_filter (bs->options);
   if (type_filter != GRL_TYPE_FILTER_ALL) {
-    gchar *query;
-
     query = build_browse_query (type_filter, object_path);
     GRL_DEBUG ("%s browse:%s", G_STRFUNC, query);
-    grl_dleyna_media_container2_call_search_objects (container, query, offset, limit, filter, cancellable,
-                                                     grl_dleyna_source_browse_search_objects_cb, bs);
-    g_free (query);
-  }
-  else {
-    grl_dleyna_media_container2_call_list_children (container, offset, limit, filter, cancellable,
-                                                    grl_dleyna_source_browse_list_children_cb, bs);
   }
 
-out:
+  filter = build_properties_filter (bs->keys);
+  grl_dleyna_source_results (bs->source, container, object_path, query, filter, bs->options, cancellable,
+                             GRL_CORE_ERROR_BROWSE_FAILED, bs->operation_id, bs->callback, bs->user_data);
+
   g_object_unref (container);
-  g_free (filter);
+  g_free (query);
 }
 
 static void
@@ -1490,24 +1824,19 @@ grl_dleyna_source_search (GrlSource *source,
   GCancellable *cancellable;
   gchar const **filter;
   gchar *query;
-  guint skip, count;
 
   GRL_DEBUG (G_STRFUNC);
 
   cancellable = g_cancellable_new ();
   grl_operation_set_data_full (ss->operation_id, cancellable, g_object_unref);
 
-  skip = grl_operation_options_get_skip (ss->options);
-  /* Grilo uses -1 to say "no limit" while dLeyna expect 0 for the same purpose */
-  count = MAX (0, grl_operation_options_get_count (ss->options));
   filter = build_properties_filter (ss->keys);
   query = build_search_query (grl_operation_options_get_type_filter (ss->options), ss->text);
 
   GRL_DEBUG ("%s query:'%s'", G_STRFUNC, query);
   root = grl_dleyna_server_get_media_container (self->priv->server);
-  grl_dleyna_media_container2_call_search_objects (root, query, skip, count, filter,
-                                                   cancellable, grl_dleyna_source_search_search_objects_cb, ss);
-  g_free (filter);
+  grl_dleyna_source_results (ss->source, root, NULL, query, filter, ss->options, cancellable,
+                             GRL_CORE_ERROR_SEARCH_FAILED, ss->operation_id, ss->callback, ss->user_data);
   g_free (query);
 }
 
@@ -1530,21 +1859,16 @@ grl_dleyna_source_query (GrlSource *source,
   GrlDleynaMediaContainer2 *root;
   GCancellable *cancellable;
   gchar const **filter;
-  guint skip, count;
 
   GRL_DEBUG (G_STRFUNC);
 
   cancellable = g_cancellable_new ();
   grl_operation_set_data_full (qs->operation_id, cancellable, g_object_unref);
 
-  skip = grl_operation_options_get_skip (qs->options);
-  /* Grilo uses -1 to say "no limit" while dLeyna expect 0 for the same purpose */
-  count = MAX (0, grl_operation_options_get_count (qs->options));
   filter = build_properties_filter (qs->keys);
   root = grl_dleyna_server_get_media_container (self->priv->server);
-  grl_dleyna_media_container2_call_search_objects (root, qs->query, skip, count, filter,
-                                                   cancellable, grl_dleyna_source_query_search_objects_cb, qs);
-  g_free (filter);
+  grl_dleyna_source_results (qs->source, root, NULL, qs->query, filter, qs->options, cancellable,
+                             GRL_CORE_ERROR_QUERY_FAILED, qs->operation_id, qs->callback, qs->user_data);
 }
 
 static void
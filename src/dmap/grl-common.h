@@ -29,8 +29,7 @@ typedef struct {
   GrlSource *source;
   GrlMedia *container;
   guint op_id;
-  GHRFunc predicate;
-  gchar *predicate_data;
+  gchar *search_text;
   guint skip;
   guint count;
   gpointer user_data;
@@ -18,23 +18,24 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
-/* This DAAP database implementation maintains a series of hash tables that
- * represent sets of media. The tables include: root, albums, and artists.
+/* This DAAP database implementation maintains a series of indexes that
+ * represent sets of media. The indexes include: root, albums, and artists.
  * Root contains albums and artists, and albums and artists each contain
  * the set of albums and artists in the database, respectively. Thus this
  * database implementation imposes a hierarchical structure, whereas DAAP
  * normally provides a flat structure.
  *
- * Each hash table/set is a mapping between a GrlMedia container and a series of
- * GrlMedia objects (either more GrlMedia container objects, or, in the case of a
- * leaf, GrlMediaAudio objects). The constant GrlMedia container objects (e.g.,
- * albums_container and artists_container) facilitate this, along with additional
- * GrlMediaAudio objects that the grl_daap_db_add function creates.
+ * Each set is a mapping between a container and a sorted array of either
+ * more sets or, in the case of a leaf, tracks. The constant sets (e.g.,
+ * albums and artists) facilitate this, along with the tracks that the
+ * grl_daap_db_add function stores. Tracks are kept in a compact array, with
+ * their strings in a string chunk, and GrlMedia objects are only created
+ * for the media actually returned by browse and search.
  *
  * An application will normally first browse using the NULL container,
- * and thus will first receive albums_container and artists_container. Browsing
- * albums_container will provide the application the GrlMedia container objects in
- * albums. Further browsing one of these objects will provide the
+ * and thus will first receive the albums and artists containers. Browsing
+ * the albums container will provide the application a GrlMedia container
+ * for each album. Further browsing one of these objects will provide the
  * application with the songs contained therein.
  *
  * Grilo IDs must be unique. Here the convention is:
@@ -61,6 +62,7 @@
 #include "grl-daap-compat.h"
 #include "grl-common.h"
 #include "grl-daap-db.h"
+#include "grl-dmap-index.h"
 
 #define ALBUMS_ID    "albums"
 #define ALBUMS_NAME  _("Albums")
@@ -70,16 +72,43 @@
 /* Media ID's start at max and go down. Container ID's start at 1 and go up. */
 static guint nextid = G_MAXINT; /* NOTE: this should be G_MAXUINT, but iPhoto can't handle it. */
 
+typedef struct {
+  const gchar *title;
+  const gchar *album;
+  const gchar *artist;
+  const gchar *genre;
+  const gchar *url;
+  /* By album, then disc and track number, then title */
+  const gchar *sort_key;
+  gint32       duration;
+  gint32       bitrate;
+  gint32       disc;
+  gint32       track;
+  guint        id;
+  gboolean     has_video;
+} DaapTrack;
+
 struct GrlDaapDbPrivate {
-  /* Contains each album container (tracked with albums hash table) */
-  GrlMedia *albums_container;
+  /* Contains the albums and artists sets */
+  GrlDmapSet   *root;
+
+  /* Contains each album set */
+  GrlDmapSet   *albums;
+
+  /* Contains each artist set */
+  GrlDmapSet   *artists;
+
+  /* Container ID -> GrlDmapSet */
+  GHashTable   *sets;
+
+  /* DaapTrack, in the order they were added */
+  GArray       *tracks;
 
-  /* Contains each artist container (tracked with artist hash table) */
-  GrlMedia *artists_container;
+  /* Strings of tracks and sets. Artists, albums and genres are only
+   * stored once. */
+  GStringChunk *strings;
 
-  GHashTable  *root;
-  GHashTable  *albums;
-  GHashTable  *artists;
+  GrlDmapTokenIndex *tokens;
 };
 
 enum {
@@ -87,18 +116,6 @@ enum {
   PROP_RECORD_FACTORY,
 };
 
-static guint
-container_hash (gconstpointer a)
-{
-  return g_str_hash (grl_media_get_id (GRL_MEDIA (a)));
-}
-
-static gboolean
-container_equal (gconstpointer a, gconstpointer b)
-{
-  return g_str_equal (grl_media_get_id (GRL_MEDIA (a)), grl_media_get_id (GRL_MEDIA (b)));
-}
-
 GrlDaapDb *
 grl_daap_db_new (void)
 {
@@ -130,28 +147,174 @@ grl_daap_db_count (const DmapDb *db)
 }
 
 static void
-set_insert (GHashTable *category, const char *category_name, char *set_name, GrlMedia *media)
+set_insert (GrlDaapDb *db, GrlDmapSet *category, const char *category_name, const char *set_name, guint position)
 {
   gchar      *id = NULL;
-  GrlMedia   *container;
-  GHashTable *set;
+  gchar      *sort_key;
+  GrlDmapSet *set;
 
   id = g_strdup_printf ("%s-%s", category_name, set_name);
 
-  container = grl_media_container_new ();
-  grl_media_set_id (container, id);
-  grl_media_set_title (container, set_name);
-
-  set = g_hash_table_lookup (category, container);
+  set = g_hash_table_lookup (db->priv->sets, id);
   if (NULL == set) {
-    set = g_hash_table_new_full (container_hash, container_equal, g_object_unref, NULL);
-    g_hash_table_insert (category, g_object_ref (container), set);
+    sort_key = grl_dmap_sort_key (set_name);
+    set = grl_dmap_set_new (id,
+                            set_name,
+                            g_string_chunk_insert (db->priv->strings, sort_key),
+                            FALSE);
+    g_free (sort_key);
+
+    g_hash_table_insert (db->priv->sets, set->id, set);
+    grl_dmap_index_add (category->children, set, set->sort_key);
   }
 
-  g_hash_table_insert (set, g_object_ref (media), NULL);
+  grl_dmap_index_add (set->children,
+                      GUINT_TO_POINTER (position),
+                      g_array_index (db->priv->tracks, DaapTrack, position).sort_key);
 
   g_free (id);
-  g_object_unref (container);
+}
+
+/* Sorts by album, then disc and track number, then title */
+static gchar *
+track_sort_key (const gchar *album,
+                gint32 disc,
+                gint32 track,
+                const gchar *title)
+{
+  GString *key;
+
+  key = g_string_new (NULL);
+  grl_dmap_sort_key_append (key, album);
+  g_string_append_printf (key, "%05d%05d",
+                          CLAMP (disc, 0, 99999),
+                          CLAMP (track, 0, 99999));
+  grl_dmap_sort_key_append (key, title);
+
+  return g_string_free (key, FALSE);
+}
+
+static const gchar *
+chunk_insert (GStringChunk *chunk, const gchar *str)
+{
+  return NULL != str ? g_string_chunk_insert (chunk, str) : NULL;
+}
+
+static const gchar *
+chunk_insert_const (GStringChunk *chunk, const gchar *str)
+{
+  return NULL != str ? g_string_chunk_insert_const (chunk, str) : NULL;
+}
+
+static guint
+add_track (GrlDaapDb *db,
+           const gchar *title,
+           const gchar *album,
+           const gchar *artist,
+           const gchar *genre,
+           const gchar *url,
+           gint duration,
+           gint32 bitrate,
+           gint32 disc,
+           gint32 track,
+           gboolean has_video)
+{
+  DaapTrack daap_track;
+  gchar *sort_key;
+  guint position;
+
+  sort_key = track_sort_key (album, disc, track, title);
+
+  daap_track.title     = chunk_insert (db->priv->strings, title);
+  daap_track.album     = chunk_insert_const (db->priv->strings, album);
+  daap_track.artist    = chunk_insert_const (db->priv->strings, artist);
+  daap_track.genre     = chunk_insert_const (db->priv->strings, genre);
+  daap_track.url       = chunk_insert (db->priv->strings, url);
+  daap_track.sort_key  = g_string_chunk_insert (db->priv->strings, sort_key);
+  daap_track.duration  = duration;
+  daap_track.bitrate   = bitrate;
+  daap_track.disc      = disc;
+  daap_track.track     = track;
+  daap_track.id        = nextid;
+  daap_track.has_video = has_video;
+
+  position = db->priv->tracks->len;
+  g_array_append_val (db->priv->tracks, daap_track);
+
+  set_insert (db, db->priv->artists, ARTISTS_ID, daap_track.artist, position);
+  set_insert (db, db->priv->albums,  ALBUMS_ID,  daap_track.album,  position);
+
+  grl_dmap_token_index_add (db->priv->tokens, position, title);
+  grl_dmap_token_index_add (db->priv->tokens, position, artist);
+  grl_dmap_token_index_add (db->priv->tokens, position, album);
+
+  g_free (sort_key);
+
+  return --nextid;
+}
+
+static GrlMedia *
+track_to_media (DaapTrack *track)
+{
+  gchar    *id_s = NULL;
+  GrlMedia *media;
+
+  id_s = g_strdup_printf ("%u", track->id);
+
+  if (track->has_video == TRUE) {
+    media = grl_media_video_new ();
+  } else {
+    media = grl_media_audio_new ();
+  }
+
+  grl_media_set_id (media, id_s);
+  grl_media_set_duration (media, track->duration);
+
+  if (track->title) {
+    grl_media_set_title (media, track->title);
+  }
+
+  if (track->url) {
+    grl_media_set_url (media, track->url);
+  }
+
+  if (track->has_video == FALSE) {
+    grl_media_set_bitrate (media, track->bitrate);
+    grl_media_set_track_number (media, track->track);
+
+    if (track->disc != 0) {
+      grl_media_set_album_disc_number (media, track->disc);
+    }
+
+    if (track->album) {
+      grl_media_set_album (media, track->album);
+    }
+
+    if (track->artist) {
+      grl_media_set_artist (media, track->artist);
+    }
+
+    if (track->genre) {
+      grl_media_set_genre (media, track->genre);
+    }
+  }
+
+  g_free (id_s);
+
+  return media;
+}
+
+static GrlMedia *
+set_to_media (GrlDmapSet *set)
+{
+  GrlMedia *media;
+
+  media = grl_media_container_new ();
+  grl_media_set_id (media, set->id);
+  grl_media_set_title (media, set->title);
+  grl_media_set_childcount (media, grl_dmap_index_get_length (set->children));
+
+  return media;
 }
 
 guint
@@ -167,14 +330,13 @@ grl_daap_db_add (DmapDb *_db, DmapRecord *_record, GError **error)
   gint32  bitrate = 0,
              disc = 0,
             track = 0;
-  gchar  *id_s    = NULL,
-         *title   = NULL,
+  gchar  *title   = NULL,
          *album   = NULL,
          *artist  = NULL,
          *genre   = NULL,
          *url     = NULL;
   gboolean has_video;
-  GrlMedia *media;
+  guint id;
 
   g_object_get (record,
                "songalbum", &album,
@@ -189,66 +351,52 @@ grl_daap_db_add (DmapDb *_db, DmapRecord *_record, GError **error)
                "has-video", &has_video,
                 NULL);
 
-  id_s = g_strdup_printf ("%u", nextid);
-
-  if (has_video == TRUE) {
-    media = grl_media_video_new ();
-  } else {
-    media = grl_media_audio_new ();
-  }
-
-  grl_media_set_id (media, id_s);
-  grl_media_set_duration (media, duration);
-
-  if (title) {
-    grl_media_set_title (media, title);
-  }
-
   if (url) {
     /* Replace URL's daap:// with http:// */
     url[0] = 'h'; url[1] = 't'; url[2] = 't'; url[3] = 'p';
-    grl_media_set_url (media, url);
   }
 
-  if (has_video == FALSE) {
-    grl_media_set_bitrate (media, bitrate);
-    grl_media_set_track_number (media, track);
+  id = add_track (db, title, album, artist, genre, url,
+                  duration, bitrate, disc, track, has_video);
 
-    if (disc != 0) {
-      grl_media_set_album_disc_number (media, disc);
-    }
-
-    if (album) {
-      grl_media_set_album (media, album);
-    }
-
-    if (artist) {
-      grl_media_set_artist (media, artist);
-    }
-
-    if (genre) {
-      grl_media_set_genre (media, genre);
-    }
-  }
-
-  set_insert (db->priv->artists, ARTISTS_ID, artist, media);
-  set_insert (db->priv->albums,  ALBUMS_ID,  album,  media);
-
-  g_free (id_s);
-  g_object_unref (media);
   g_free (album);
   g_free (artist);
   g_free (genre);
   g_free (title);
   g_free (url);
 
-  return --nextid;
+  return id;
 }
 
-static gboolean
-same_media (GrlMedia *a, GrlMedia *b)
+/* Makes room in @db, which must be empty, for @n_tracks tracks */
+void
+grl_daap_db_reserve (GrlDaapDb *db, guint n_tracks)
 {
-  return strcmp (grl_media_get_id (a), grl_media_get_id (b)) == 0;
+  g_assert (GRL_IS_DAAP_DB (db));
+  g_return_if_fail (db->priv->tracks->len == 0);
+
+  g_array_unref (db->priv->tracks);
+  db->priv->tracks = g_array_sized_new (FALSE, FALSE, sizeof (DaapTrack), n_tracks);
+}
+
+guint
+grl_daap_db_get_n_tracks (GrlDaapDb *db)
+{
+  g_assert (GRL_IS_DAAP_DB (db));
+
+  return db->priv->tracks->len;
+}
+
+static GrlMedia *
+set_get_media (GrlDaapDb *db, GrlDmapSet *set, guint position)
+{
+  gpointer item = grl_dmap_index_get (set->children, position);
+
+  if (set->has_sets) {
+    return set_to_media (item);
+  }
+
+  return track_to_media (&g_array_index (db->priv->tracks, DaapTrack, GPOINTER_TO_UINT (item)));
 }
 
 void
@@ -263,100 +411,82 @@ grl_daap_db_browse (GrlDaapDb *db,
 {
   g_assert (GRL_IS_DAAP_DB (db));
 
-  int i;
-  guint remaining;
-  GHashTable *hash_table;
-  GHashTableIter iter;
-  gpointer key, val;
+  guint i, length, remaining;
+  GrlDmapSet *set;
 
   const gchar *container_id = grl_media_get_id (container);
   if (NULL == container_id) {
-    hash_table = db->priv->root;
-  } else if (same_media (container, GRL_MEDIA (db->priv->albums_container))) {
-    hash_table = db->priv->albums;
-  } else if (same_media (container, GRL_MEDIA (db->priv->artists_container))) {
-    hash_table = db->priv->artists;
+    set = db->priv->root;
   } else {
-    hash_table = g_hash_table_lookup (db->priv->artists, container);
-    if (NULL == hash_table) {
-      hash_table = g_hash_table_lookup (db->priv->albums, container);
-    }
+    set = g_hash_table_lookup (db->priv->sets, container_id);
   }
 
   /* Should not be NULL; this means the container requested
      does not exist in the database. */
-  if (NULL == hash_table) {
+  if (NULL == set) {
     GError *error = g_error_new (GRL_CORE_ERROR,
                                  GRL_CORE_ERROR_BROWSE_FAILED,
                                  _("Invalid container identifier %s"),
                                  container_id);
     func (source, op_id, NULL, 0, user_data, error);
-    goto done;
+    g_error_free (error);
+    return;
   }
 
-  remaining = g_hash_table_size (hash_table) - skip;
-  remaining = remaining < count ? remaining : count;
-  g_hash_table_iter_init (&iter, hash_table);
-  for (i = 0; g_hash_table_iter_next (&iter, &key, &val) && i < skip + count; i++) {
-    if (i < skip) {
-      continue;
-    }
-    if (grl_media_is_container (key)) {
-      grl_media_set_childcount (key, g_hash_table_size (val));
-    }
-    func (source, op_id, GRL_MEDIA (g_object_ref (key)), --remaining, user_data, NULL);
+  length = grl_dmap_index_get_length (set->children);
+  if (skip >= length) {
+    func (source, op_id, NULL, 0, user_data, NULL);
+    return;
+  }
+
+  remaining = MIN (length - skip, count);
+  for (i = skip; remaining > 0; i++) {
+    func (source, op_id, set_get_media (db, set, i), --remaining, user_data, NULL);
   }
-done:
-  return;
 }
 
 void
 grl_daap_db_search (GrlDaapDb *db,
                     GrlSource *source,
                     guint op_id,
-                    GHRFunc predicate,
-                    gpointer pred_user_data,
+                    const gchar *text,
+                    guint skip,
+                    guint count,
                     GrlSourceResultCb func,
                     gpointer user_data)
 {
   g_assert (GRL_IS_DAAP_DB (db));
 
-  gint i, j, k;
-  guint remaining = 0;
-  gpointer key1, val1, key2, val2;
-  GHashTable *hash_tables[] = { db->priv->albums, db->priv->artists };
-
-  /* Use hash table to avoid duplicates */
-  GHashTable *results = NULL;
-  GHashTableIter iter1, iter2;
-
-  results = g_hash_table_new (g_str_hash, g_str_equal);
-
-  /* For albums and artists... */
-  for (i = 0; i < G_N_ELEMENTS (hash_tables); i++) {
-    g_hash_table_iter_init (&iter1, hash_tables[i]);
-    /* For each album or artist in above... */
-    for (j = 0; g_hash_table_iter_next (&iter1, &key1, &val1); j++) {
-      if (grl_media_is_container (key1)) {
-        g_hash_table_iter_init (&iter2, val1);
-        /* For each media item in above... */
-        for (k = 0; g_hash_table_iter_next (&iter2, &key2, &val2); k++) {
-          const char *id = grl_media_get_id (GRL_MEDIA (key2));
-          /* If the predicate returns true, add to results set. */
-          if (predicate (key2, val2, pred_user_data)
-           && ! g_hash_table_contains (results, id)) {
-            remaining++;
-            g_hash_table_insert (results, (gpointer) id, key2);
-          }
-        }
-      }
-    }
+  guint i, length, position, remaining;
+  GArray *results = NULL;
+
+  /* Without text, everything matches */
+  if (NULL != text && '\0' != *text) {
+    results = grl_dmap_token_index_search (db->priv->tokens, text);
+    length = results->len;
+  } else {
+    length = db->priv->tracks->len;
   }
 
-  /* Process results set. */
-  g_hash_table_iter_init (&iter1, results);
-  for (i = 0; g_hash_table_iter_next (&iter1, &key1, &val1); i++) {
-    func (source, op_id, GRL_MEDIA (g_object_ref (val1)), --remaining, user_data, NULL);
+  if (skip >= length) {
+    func (source, op_id, NULL, 0, user_data, NULL);
+    goto done;
+  }
+
+  remaining = MIN (length - skip, count);
+  for (i = skip; remaining > 0; i++) {
+    position = NULL != results ? g_array_index (results, guint, i) : i;
+    func (source,
+          op_id,
+          track_to_media (&g_array_index (db->priv->tracks, DaapTrack, position)),
+          --remaining,
+          user_data,
+          NULL);
+  }
+
+done:
+  if (NULL != results) {
+    g_array_unref (results);
   }
 }
 
@@ -392,21 +522,20 @@ grl_daap_db_init (GrlDaapDb *db)
 {
   db->priv = grl_daap_db_get_instance_private (db);
 
-  db->priv->albums_container  = grl_media_container_new ();
-  db->priv->artists_container = grl_media_container_new ();
+  db->priv->strings = g_string_chunk_new (64 * 1024);
+  db->priv->tracks  = g_array_new (FALSE, FALSE, sizeof (DaapTrack));
+  db->priv->tokens  = grl_dmap_token_index_new ();
+  db->priv->sets    = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) grl_dmap_set_free);
 
-  grl_media_set_id (GRL_MEDIA (db->priv->albums_container), ALBUMS_ID);
-  grl_media_set_title (GRL_MEDIA (db->priv->albums_container), ALBUMS_NAME);
+  db->priv->root    = grl_dmap_set_new (NULL, NULL, NULL, TRUE);
+  db->priv->albums  = grl_dmap_set_new (ALBUMS_ID, ALBUMS_NAME, "0", TRUE);
+  db->priv->artists = grl_dmap_set_new (ARTISTS_ID, ARTISTS_NAME, "1", TRUE);
 
-  grl_media_set_id (GRL_MEDIA (db->priv->artists_container), ARTISTS_ID);
-  grl_media_set_title (GRL_MEDIA (db->priv->artists_container), ARTISTS_NAME);
+  g_hash_table_insert (db->priv->sets, db->priv->albums->id, db->priv->albums);
+  g_hash_table_insert (db->priv->sets, db->priv->artists->id, db->priv->artists);
 
-  db->priv->root    = g_hash_table_new_full (container_hash, container_equal, g_object_unref, (GDestroyNotify) g_hash_table_destroy);
-  db->priv->albums  = g_hash_table_new_full (container_hash, container_equal, g_object_unref, (GDestroyNotify) g_hash_table_destroy);
-  db->priv->artists = g_hash_table_new_full (container_hash, container_equal, g_object_unref, (GDestroyNotify) g_hash_table_destroy);
-
-  g_hash_table_insert (db->priv->root, g_object_ref (db->priv->albums_container),  db->priv->albums);
-  g_hash_table_insert (db->priv->root, g_object_ref (db->priv->artists_container), db->priv->artists);
+  grl_dmap_index_add (db->priv->root->children, db->priv->albums, db->priv->albums->sort_key);
+  grl_dmap_index_add (db->priv->root->children, db->priv->artists, db->priv->artists->sort_key);
 }
 
 static void
@@ -416,11 +545,14 @@ grl_daap_db_finalize (GObject *object)
 
   GRL_DEBUG ("Finalizing GrlDaapDb");
 
-  g_object_unref (db->priv->albums_container);
-  g_object_unref (db->priv->artists_container);
+  g_hash_table_destroy (db->priv->sets);
+  grl_dmap_set_free (db->priv->root);
+
+  grl_dmap_token_index_free (db->priv->tokens);
+  g_array_unref (db->priv->tracks);
+  g_string_chunk_free (db->priv->strings);
 
-  g_hash_table_destroy (db->priv->albums);
-  g_hash_table_destroy (db->priv->artists);
+  G_OBJECT_CLASS (grl_daap_db_parent_class)->finalize (object);
 }
 
 static void
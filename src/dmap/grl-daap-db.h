@@ -80,11 +80,16 @@ void grl_daap_db_browse (GrlDaapDb *db,
 void grl_daap_db_search (GrlDaapDb *db,
                          GrlSource *source,
                          guint op_id,
-                         GHRFunc predicate,
-                         gpointer pred_user_data,
+                         const gchar *text,
+                         guint skip,
+                         guint count,
                          GrlSourceResultCb func,
                          gpointer user_data);
 
+void grl_daap_db_reserve (GrlDaapDb *db, guint n_tracks);
+
+guint grl_daap_db_get_n_tracks (GrlDaapDb *db);
+
 GrlDaapDb *grl_daap_db_new (void);
 
 GType grl_daap_db_get_type (void);
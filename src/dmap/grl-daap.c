@@ -28,6 +28,7 @@
 #include <errno.h>
 #include <grilo.h>
 #include <glib/gi18n-lib.h>
+#include <glib/gstdio.h>
 #include <gio/gio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -50,6 +51,11 @@ GRL_LOG_DOMAIN_STATIC (daap_log_domain);
 #define SOURCE_ID_TEMPLATE   "grl-daap-%s"
 #define SOURCE_DESC_TEMPLATE _("A source for browsing the DAAP server “%s”")
 
+/* Version, revision of the catalog and number of tracks, which are kept
+ * across sessions to size the database of a server before connecting */
+#define SNAPSHOT_TYPE    "(uuu)"
+#define SNAPSHOT_VERSION 3
+
 /* --- Grilo DAAP Private --- */
 
 struct _GrlDaapSourcePrivate {
@@ -83,6 +89,9 @@ static void grl_daap_service_removed_cb (DmapMdnsBrowser *browser,
                                          const gchar *service_name,
                                          GrlPlugin *plugin);
 
+static void grl_daap_connected (DmapConnection *connection,
+                                ResultCbAndArgsAndDb *cb_and_db);
+
 /* ===================== Globals  ======================= */
 static DmapMdnsBrowser *browser;
 /* Maps URIs to DBs */
@@ -235,8 +244,9 @@ grl_daap_do_search (ResultCbAndArgsAndDb *cb_and_db)
   grl_daap_db_search (GRL_DAAP_DB (cb_and_db->db),
                       cb_and_db->cb.source,
                       cb_and_db->cb.op_id,
-                      (GHRFunc) cb_and_db->cb.predicate,
-                      cb_and_db->cb.predicate_data,
+                      cb_and_db->cb.search_text,
+                      cb_and_db->cb.skip,
+                      cb_and_db->cb.count,
                       cb_and_db->cb.callback,
                       cb_and_db->cb.user_data);
 
@@ -264,6 +274,7 @@ browse_connected_cb (DmapConnection       *connection,
                             error);
     g_error_free (error);
   } else {
+    grl_daap_connected (connection, cb_and_db);
     grl_daap_do_browse (cb_and_db);
   }
 }
@@ -289,6 +300,7 @@ search_connected_cb (DmapConnection       *connection,
                             error);
     g_error_free (error);
   } else {
+    grl_daap_connected (connection, cb_and_db);
     grl_daap_do_search (cb_and_db);
   }
 }
@@ -334,27 +346,184 @@ grl_daap_service_removed_cb (DmapMdnsBrowser *browser,
 }
 
 static void
-grl_daap_connect (gchar *name, gchar *host, guint port, ResultCbAndArgsAndDb *cb_and_db, DmapConnectionFunc callback)
+grl_daap_connect (gchar *name, gchar *host, guint port, DmapDb *db, DmapConnectionFunc callback, gpointer user_data)
 {
   DmapRecordFactory *factory;
   DmapConnection *connection;
 
   factory = DMAP_RECORD_FACTORY (grl_daap_record_factory_new ());
-  connection = DMAP_CONNECTION (dmap_av_connection_new (name, host, port, DMAP_DB (cb_and_db->db), factory));
-  dmap_connection_start (connection, (DmapConnectionFunc) callback, cb_and_db);
+  connection = DMAP_CONNECTION (dmap_av_connection_new (name, host, port, db, factory));
+  dmap_connection_start (connection, (DmapConnectionFunc) callback, user_data);
+}
+
+static gint
+grl_daap_connection_get_revision (DmapConnection *connection)
+{
+  gint revision = 0;
+
+  if (g_object_class_find_property (G_OBJECT_GET_CLASS (connection), "revision-number")) {
+    g_object_get (connection, "revision-number", &revision, NULL);
+  }
+
+  return revision;
+}
+
+/* Snapshots are named after the server name and address, so that two
+ * servers announcing the same name do not share one. */
+static gchar *
+grl_daap_snapshot_path (DmapMdnsService *service)
+{
+  gchar *name, *host, *key, *checksum, *path;
+  guint port;
+
+  name = grl_dmap_service_get_name (service);
+  host = grl_dmap_service_get_host (service);
+  port = grl_dmap_service_get_port (service);
+
+  key = g_strdup_printf ("%s\n%s:%u", name, host, port);
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+  path = g_build_filename (g_get_user_cache_dir (),
+                           "grilo-plugins",
+                           "daap",
+                           checksum,
+                           NULL);
+
+  g_free (checksum);
+  g_free (key);
+  g_free (host);
+  g_free (name);
+
+  return path;
 }
 
+/* Returns: whether @path holds a snapshot, in which case @revision and
+ * @n_tracks are set to the revision and size of the catalog it describes */
 static gboolean
-grl_daap_match (GrlMedia *media, gpointer val, gpointer user_data)
+grl_daap_load_snapshot (const gchar *path, guint *revision, guint *n_tracks)
 {
-  g_assert (grl_media_is_audio (media) || grl_media_is_video (media));
+  GVariant *snapshot;
+  GBytes *bytes;
+  gchar *contents;
+  gsize length;
+  guint version;
+
+  if (!g_file_get_contents (path, &contents, &length, NULL)) {
+    return FALSE;
+  }
+
+  bytes = g_bytes_new_take (contents, length);
+  snapshot = g_variant_new_from_bytes (G_VARIANT_TYPE (SNAPSHOT_TYPE), bytes, FALSE);
+  g_variant_ref_sink (snapshot);
+  g_variant_get (snapshot, SNAPSHOT_TYPE, &version, revision, n_tracks);
+  g_variant_unref (snapshot);
+  g_bytes_unref (bytes);
 
-  if (NULL == user_data) {
-    return TRUE;
+  if (SNAPSHOT_VERSION != version) {
+    GRL_DEBUG ("Dropping outdated DAAP snapshot %s", path);
+    g_unlink (path);
+    return FALSE;
   }
 
-  const char *title = grl_media_get_title (media);
-  return strstr (title, user_data) != NULL;
+  return TRUE;
+}
+
+static void
+snapshot_saved_cb (GObject *object,
+                   GAsyncResult *res,
+                   gpointer user_data)
+{
+  GError *error = NULL;
+
+  if (!g_file_replace_contents_finish (G_FILE (object), res, NULL, &error)) {
+    GRL_WARNING ("Could not save DAAP snapshot: %s", error->message);
+    g_error_free (error);
+  }
+}
+
+static void
+grl_daap_save_snapshot (const gchar *path, guint revision, guint n_tracks)
+{
+  GVariant *snapshot;
+  GBytes *bytes;
+  GFile *file;
+  gchar *dir;
+
+  GRL_DEBUG ("Saving DAAP snapshot of %u tracks at revision %u to %s",
+             n_tracks, revision, path);
+
+  dir = g_path_get_dirname (path);
+  if (g_mkdir_with_parents (dir, 0700) != 0) {
+    GRL_WARNING ("Could not create cache directory %s", dir);
+  }
+  g_free (dir);
+
+  snapshot = g_variant_new (SNAPSHOT_TYPE, SNAPSHOT_VERSION, revision, n_tracks);
+  g_variant_ref_sink (snapshot);
+  bytes = g_variant_get_data_as_bytes (snapshot);
+  g_variant_unref (snapshot);
+
+  file = g_file_new_for_path (path);
+  g_file_replace_contents_bytes_async (file,
+                                       bytes,
+                                       NULL,
+                                       FALSE,
+                                       G_FILE_CREATE_PRIVATE,
+                                       NULL,
+                                       snapshot_saved_cb,
+                                       NULL);
+
+  g_object_unref (file);
+  g_bytes_unref (bytes);
+}
+
+/* Returns: (transfer full): an empty database for the server of
+ * @dmap_source, sized after the catalog it had in the last session */
+static DmapDb *
+grl_daap_db_new_for_source (GrlDaapSource *dmap_source)
+{
+  GrlDaapDb *db;
+  gchar *path;
+  guint revision, n_tracks;
+
+  db = grl_daap_db_new ();
+
+  path = grl_daap_snapshot_path (dmap_source->priv->service);
+  if (grl_daap_load_snapshot (path, &revision, &n_tracks)) {
+    GRL_DEBUG ("Expecting %u tracks from DAAP snapshot %s", n_tracks, path);
+    grl_daap_db_reserve (db, n_tracks);
+  }
+  g_free (path);
+
+  return DMAP_DB (db);
+}
+
+static void
+grl_daap_connected (DmapConnection *connection,
+                    ResultCbAndArgsAndDb *cb_and_db)
+{
+  GrlDaapSource *dmap_source = GRL_DAAP_SOURCE (cb_and_db->cb.source);
+  gchar *path;
+  guint revision, n_tracks, saved_revision, saved_n_tracks;
+
+  /* Already connected */
+  if (connection == NULL) {
+    return;
+  }
+
+  revision = grl_daap_connection_get_revision (connection);
+  n_tracks = grl_daap_db_get_n_tracks (GRL_DAAP_DB (cb_and_db->db));
+
+  /* The snapshot is only rewritten when the catalog changed */
+  path = grl_daap_snapshot_path (dmap_source->priv->service);
+  if (revision == 0 ||
+      !grl_daap_load_snapshot (path, &saved_revision, &saved_n_tracks) ||
+      saved_revision != revision ||
+      saved_n_tracks != n_tracks) {
+    grl_daap_save_snapshot (path, revision, n_tracks);
+  } else {
+    GRL_DEBUG ("DAAP catalog unchanged at revision %u", revision);
+  }
+  g_free (path);
 }
 
 /* ================== API Implementation ================ */
@@ -411,7 +580,7 @@ grl_daap_source_browse (GrlSource *source,
     gchar *name, *host;
     guint port;
 
-    cb_and_db->db = DMAP_DB (grl_daap_db_new ());
+    cb_and_db->db = grl_daap_db_new_for_source (dmap_source);
 
     name = grl_dmap_service_get_name (dmap_source->priv->service);
     host = grl_dmap_service_get_host (dmap_source->priv->service);
@@ -420,8 +589,9 @@ grl_daap_source_browse (GrlSource *source,
     grl_daap_connect (name,
                       host,
                       port,
-                      cb_and_db,
-                      (DmapConnectionFunc) browse_connected_cb);
+                      cb_and_db->db,
+                      (DmapConnectionFunc) browse_connected_cb,
+                      cb_and_db);
 
     g_hash_table_insert (connections, g_strdup (url), cb_and_db->db);
 
@@ -447,8 +617,9 @@ static void grl_daap_source_search (GrlSource *source,
   cb_and_db->cb.source         = ss->source;
   cb_and_db->cb.container      = NULL;
   cb_and_db->cb.op_id          = ss->operation_id;
-  cb_and_db->cb.predicate      = (GHRFunc) grl_daap_match;
-  cb_and_db->cb.predicate_data = ss->text;
+  cb_and_db->cb.search_text    = ss->text;
+  cb_and_db->cb.skip           = grl_operation_options_get_skip (ss->options);
+  cb_and_db->cb.count          = grl_operation_options_get_count (ss->options);
   cb_and_db->cb.user_data      = ss->user_data;
 
   if ((cb_and_db->db = g_hash_table_lookup (connections, url))) {
@@ -459,7 +630,7 @@ static void grl_daap_source_search (GrlSource *source,
     gchar *name, *host;
     guint port;
 
-    cb_and_db->db = DMAP_DB (grl_daap_db_new ());
+    cb_and_db->db = grl_daap_db_new_for_source (dmap_source);
 
     name = grl_dmap_service_get_name (dmap_source->priv->service);
     host = grl_dmap_service_get_host (dmap_source->priv->service);
@@ -468,8 +639,9 @@ static void grl_daap_source_search (GrlSource *source,
     grl_daap_connect (name,
                       host,
                       port,
-                      cb_and_db,
-                      (DmapConnectionFunc) search_connected_cb);
+                      cb_and_db->db,
+                      (DmapConnectionFunc) search_connected_cb,
+                      cb_and_db);
 
     g_hash_table_insert (connections, g_strdup (url), cb_and_db->db);
 
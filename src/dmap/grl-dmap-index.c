@@ -0,0 +1,355 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <grilo.h>
+
+#include "grl-dmap-index.h"
+
+typedef struct {
+  const gchar *key;
+  gpointer     item;
+} IndexEntry;
+
+struct _GrlDmapIndex {
+  /* IndexEntry */
+  GArray   *entries;
+  gboolean  sorted;
+};
+
+struct _GrlDmapTokenIndex {
+  /* Token -> GArray of the items having it */
+  GHashTable *items;
+  /* Every token, sorted to find the ones starting with a prefix */
+  GPtrArray  *tokens;
+  gboolean    sorted;
+};
+
+static gint
+index_entry_compare (gconstpointer a,
+                     gconstpointer b)
+{
+  const IndexEntry *entry_a = a;
+  const IndexEntry *entry_b = b;
+
+  return strcmp (entry_a->key, entry_b->key);
+}
+
+GrlDmapIndex *
+grl_dmap_index_new (void)
+{
+  GrlDmapIndex *index;
+
+  index = g_slice_new (GrlDmapIndex);
+  index->entries = g_array_new (FALSE, FALSE, sizeof (IndexEntry));
+  index->sorted = TRUE;
+
+  return index;
+}
+
+void
+grl_dmap_index_free (GrlDmapIndex *index)
+{
+  g_array_unref (index->entries);
+  g_slice_free (GrlDmapIndex, index);
+}
+
+/* @sort_key must stay valid as long as @index */
+void
+grl_dmap_index_add (GrlDmapIndex *index,
+                    gpointer item,
+                    const gchar *sort_key)
+{
+  IndexEntry entry;
+
+  entry.key = sort_key;
+  entry.item = item;
+  g_array_append_val (index->entries, entry);
+
+  index->sorted = FALSE;
+}
+
+guint
+grl_dmap_index_get_length (GrlDmapIndex *index)
+{
+  return index->entries->len;
+}
+
+gpointer
+grl_dmap_index_get (GrlDmapIndex *index,
+                    guint position)
+{
+  g_return_val_if_fail (position < index->entries->len, NULL);
+
+  if (!index->sorted) {
+    /* Stable, so items with the same key stay in the order they came */
+    g_array_sort (index->entries, index_entry_compare);
+    index->sorted = TRUE;
+  }
+
+  return g_array_index (index->entries, IndexEntry, position).item;
+}
+
+GrlDmapSet *
+grl_dmap_set_new (const gchar *id,
+                  const gchar *title,
+                  const gchar *sort_key,
+                  gboolean has_sets)
+{
+  GrlDmapSet *set;
+
+  set = g_slice_new (GrlDmapSet);
+  set->id = g_strdup (id);
+  set->title = title;
+  set->sort_key = sort_key;
+  set->has_sets = has_sets;
+  set->children = grl_dmap_index_new ();
+
+  return set;
+}
+
+void
+grl_dmap_set_free (GrlDmapSet *set)
+{
+  grl_dmap_index_free (set->children);
+  g_free (set->id);
+  g_slice_free (GrlDmapSet, set);
+}
+
+/* Returns: (transfer full): a key to sort @text in the user locale */
+gchar *
+grl_dmap_sort_key (const gchar *text)
+{
+  gchar *folded, *key;
+
+  if (text == NULL)
+    return g_strdup ("");
+
+  folded = g_utf8_casefold (text, -1);
+  key = g_utf8_collate_key (folded, -1);
+  g_free (folded);
+
+  return key;
+}
+
+/* Appends to @key a field sorted as @text in the user locale, so keys made
+ * of several fields sort by the first one, then the next, and so on.
+ * Collate keys may contain any byte but NUL: 0x01 is escaped as 0x01 0x02
+ * and the field ends with 0x01 0x01, which sorts before anything a longer
+ * field could go on with. */
+void
+grl_dmap_sort_key_append (GString *key,
+                          const gchar *text)
+{
+  gchar *field;
+  const gchar *p;
+
+  field = grl_dmap_sort_key (text);
+  for (p = field; *p != '\0'; p++) {
+    if (*p == '\001')
+      g_string_append (key, "\001\002");
+    else
+      g_string_append_c (key, *p);
+  }
+  g_string_append (key, "\001\001");
+  g_free (field);
+}
+
+GrlDmapTokenIndex *
+grl_dmap_token_index_new (void)
+{
+  GrlDmapTokenIndex *index;
+
+  index = g_slice_new (GrlDmapTokenIndex);
+  index->items = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                        g_free,
+                                        (GDestroyNotify) g_array_unref);
+  index->tokens = g_ptr_array_new ();
+  index->sorted = TRUE;
+
+  return index;
+}
+
+void
+grl_dmap_token_index_free (GrlDmapTokenIndex *index)
+{
+  g_ptr_array_unref (index->tokens);
+  g_hash_table_unref (index->items);
+  g_slice_free (GrlDmapTokenIndex, index);
+}
+
+static void
+token_index_insert (GrlDmapTokenIndex *index,
+                    const gchar *token,
+                    guint item)
+{
+  GArray *items;
+  gchar *key;
+
+  items = g_hash_table_lookup (index->items, token);
+  if (items == NULL) {
+    key = g_strdup (token);
+    items = g_array_new (FALSE, FALSE, sizeof (guint));
+    g_hash_table_insert (index->items, key, items);
+    g_ptr_array_add (index->tokens, key);
+    index->sorted = FALSE;
+  } else if (items->len > 0 &&
+             g_array_index (items, guint, items->len - 1) == item) {
+    /* Same word twice in the text of this item */
+    return;
+  }
+
+  g_array_append_val (items, item);
+}
+
+/* Indexes the words of @text, and their ASCII forms */
+void
+grl_dmap_token_index_add (GrlDmapTokenIndex *index,
+                          guint item,
+                          const gchar *text)
+{
+  gchar **tokens, **ascii_tokens;
+  guint i;
+
+  if (text == NULL)
+    return;
+
+  tokens = g_str_tokenize_and_fold (text, NULL, &ascii_tokens);
+  for (i = 0; tokens[i] != NULL; i++)
+    token_index_insert (index, tokens[i], item);
+  for (i = 0; ascii_tokens[i] != NULL; i++)
+    token_index_insert (index, ascii_tokens[i], item);
+
+  g_strfreev (tokens);
+  g_strfreev (ascii_tokens);
+}
+
+static gint
+token_compare (gconstpointer a,
+               gconstpointer b)
+{
+  return strcmp (*(const gchar **) a, *(const gchar **) b);
+}
+
+static gint
+item_compare (gconstpointer a,
+              gconstpointer b)
+{
+  guint item_a = *(const guint *) a;
+  guint item_b = *(const guint *) b;
+
+  return (item_a > item_b) - (item_a < item_b);
+}
+
+/* Adds to @matches the items having a token starting with @prefix */
+static void
+token_index_match_prefix (GrlDmapTokenIndex *index,
+                          const gchar *prefix,
+                          GHashTable *matches)
+{
+  gsize prefix_len = strlen (prefix);
+  guint low = 0, high = index->tokens->len;
+
+  /* First token not before @prefix */
+  while (low < high) {
+    guint middle = low + (high - low) / 2;
+
+    if (strcmp (g_ptr_array_index (index->tokens, middle), prefix) < 0)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+
+  for (; low < index->tokens->len; low++) {
+    const gchar *token = g_ptr_array_index (index->tokens, low);
+    GArray *items;
+    guint i;
+
+    if (strncmp (token, prefix, prefix_len) != 0)
+      break;
+
+    items = g_hash_table_lookup (index->items, token);
+    for (i = 0; i < items->len; i++)
+      g_hash_table_add (matches,
+                        GUINT_TO_POINTER (g_array_index (items, guint, i)));
+  }
+}
+
+/* Returns: (transfer full): the items having, for each word of @text, a
+ * word starting with it, in increasing order. */
+GArray *
+grl_dmap_token_index_search (GrlDmapTokenIndex *index,
+                             const gchar *text)
+{
+  GHashTable *results = NULL;
+  GArray *found;
+  GHashTableIter iter;
+  gpointer item;
+  gchar **tokens;
+  guint i;
+
+  if (!index->sorted) {
+    g_ptr_array_sort (index->tokens, token_compare);
+    index->sorted = TRUE;
+  }
+
+  found = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  tokens = g_str_tokenize_and_fold (text, NULL, NULL);
+  for (i = 0; tokens[i] != NULL; i++) {
+    GHashTable *matches;
+
+    matches = g_hash_table_new (g_direct_hash, g_direct_equal);
+    token_index_match_prefix (index, tokens[i], matches);
+
+    /* Only keep the items matching every word */
+    if (results != NULL) {
+      g_hash_table_iter_init (&iter, results);
+      while (g_hash_table_iter_next (&iter, &item, NULL)) {
+        if (!g_hash_table_contains (matches, item))
+          g_hash_table_iter_remove (&iter);
+      }
+      g_hash_table_unref (matches);
+    } else {
+      results = matches;
+    }
+
+    if (g_hash_table_size (results) == 0)
+      break;
+  }
+  g_strfreev (tokens);
+
+  if (results == NULL)
+    return found;
+
+  g_hash_table_iter_init (&iter, results);
+  while (g_hash_table_iter_next (&iter, &item, NULL)) {
+    guint position = GPOINTER_TO_UINT (item);
+    g_array_append_val (found, position);
+  }
+  g_hash_table_unref (results);
+
+  g_array_sort (found, item_compare);
+
+  return found;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+#ifndef _GRL_DMAP_INDEX_H_
+#define _GRL_DMAP_INDEX_H_
+
+#include <grilo.h>
+
+/* The items of a container, in a stable order, so any page of it can be
+ * read at its offset. Items are sorted by the key given when adding them,
+ * the first time the index is read after a change. */
+typedef struct _GrlDmapIndex GrlDmapIndex;
+
+GrlDmapIndex *grl_dmap_index_new (void);
+
+void grl_dmap_index_free (GrlDmapIndex *index);
+
+void grl_dmap_index_add (GrlDmapIndex *index,
+                         gpointer item,
+                         const gchar *sort_key);
+
+guint grl_dmap_index_get_length (GrlDmapIndex *index);
+
+gpointer grl_dmap_index_get (GrlDmapIndex *index,
+                             guint position);
+
+/* A container of the database, whose children are either containers or
+ * media. The title and the sort key are not copied. */
+typedef struct {
+  gchar        *id;
+  const gchar  *title;
+  const gchar  *sort_key;
+  /* Whether children are sets, or media */
+  gboolean      has_sets;
+  GrlDmapIndex *children;
+} GrlDmapSet;
+
+GrlDmapSet *grl_dmap_set_new (const gchar *id,
+                              const gchar *title,
+                              const gchar *sort_key,
+                              gboolean has_sets);
+
+void grl_dmap_set_free (GrlDmapSet *set);
+
+/* Lower case words of the text of each item, to find the items whose
+ * words start with each of the words searched for. Items are numbers,
+ * added in increasing order. */
+typedef struct _GrlDmapTokenIndex GrlDmapTokenIndex;
+
+GrlDmapTokenIndex *grl_dmap_token_index_new (void);
+
+void grl_dmap_token_index_free (GrlDmapTokenIndex *index);
+
+void grl_dmap_token_index_add (GrlDmapTokenIndex *index,
+                               guint item,
+                               const gchar *text);
+
+GArray *grl_dmap_token_index_search (GrlDmapTokenIndex *index,
+                                     const gchar *text);
+
+gchar *grl_dmap_sort_key (const gchar *text);
+
+void grl_dmap_sort_key_append (GString *key,
+                               const gchar *text);
+
+#endif /* _GRL_DMAP_INDEX_H_ */
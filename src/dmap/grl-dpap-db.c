@@ -35,6 +35,7 @@
 #include "grl-dpap-compat.h"
 #include "grl-common.h"
 #include "grl-dpap-db.h"
+#include "grl-dmap-index.h"
 
 #define PHOTOS_ID     "photos"
 #define PHOTOS_NAME _("Photos")
@@ -42,12 +43,32 @@
 /* Media IDs start at max and go down. Container IDs start at 1 and go up. */
 static guint nextid = G_MAXINT; /* NOTE: this should be G_MAXUINT, but iPhoto can't handle it. */
 
+typedef struct {
+  const gchar *title;
+  const gchar *url;
+  const gchar *sort_key;
+  gint         width;
+  gint         height;
+  guint        id;
+} DpapImage;
+
 struct GrlDpapDbPrivate {
-  /* Contains each picture container (tracked with photos hash table) */
-  GrlMedia *photos_container;
+  /* Contains the photos set */
+  GrlDmapSet   *root;
+
+  /* Contains each picture set */
+  GrlDmapSet   *photos;
+
+  /* Container ID -> GrlDmapSet */
+  GHashTable   *sets;
+
+  /* DpapImage, in the order they were added */
+  GArray       *images;
 
-  GHashTable  *root;
-  GHashTable  *photos;
+  /* Strings of images and sets */
+  GStringChunk *strings;
+
+  GrlDmapTokenIndex *tokens;
 };
 
 enum {
@@ -55,18 +76,6 @@ enum {
   PROP_RECORD_FACTORY,
 };
 
-static guint
-container_hash (gconstpointer a)
-{
-  return g_str_hash (grl_media_get_id (GRL_MEDIA (a)));
-}
-
-static gboolean
-container_equal (gconstpointer a, gconstpointer b)
-{
-  return g_str_equal (grl_media_get_id (GRL_MEDIA (a)), grl_media_get_id (GRL_MEDIA (b)));
-}
-
 GrlDpapDb *
 grl_dpap_db_new (void)
 {
@@ -98,28 +107,32 @@ grl_dpap_db_count (const DmapDb *db)
 }
 
 static void
-set_insert (GHashTable *category, const char *category_name, char *set_name, GrlMedia *media)
+set_insert (GrlDpapDb *db, GrlDmapSet *category, const char *category_name, const char *set_name, guint position)
 {
   gchar      *id = NULL;
-  GrlMedia   *container;
-  GHashTable *set;
+  gchar      *sort_key;
+  GrlDmapSet *set;
 
   id = g_strdup_printf ("%s-%s", category_name, set_name);
 
-  container = grl_media_container_new ();
-  grl_media_set_id (container, id);
-  grl_media_set_title (container, set_name);
-
-  set = g_hash_table_lookup (category, container);
+  set = g_hash_table_lookup (db->priv->sets, id);
   if (set == NULL) {
-    set = g_hash_table_new_full (container_hash, container_equal, g_object_unref, NULL);
-    g_hash_table_insert (category, g_object_ref (container), set);
+    sort_key = grl_dmap_sort_key (set_name);
+    set = grl_dmap_set_new (id,
+                            g_string_chunk_insert_const (db->priv->strings, set_name),
+                            g_string_chunk_insert (db->priv->strings, sort_key),
+                            FALSE);
+    g_free (sort_key);
+
+    g_hash_table_insert (db->priv->sets, set->id, set);
+    grl_dmap_index_add (category->children, set, set->sort_key);
   }
 
-  g_hash_table_insert (set, g_object_ref (media), NULL);
+  grl_dmap_index_add (set->children,
+                      GUINT_TO_POINTER (position),
+                      g_array_index (db->priv->images, DpapImage, position).sort_key);
 
   g_free (id);
-  g_object_unref (container);
 }
 
 guint
@@ -137,13 +150,14 @@ grl_dpap_db_add (DmapDb *_db, DmapRecord *_record, GError **error)
               creationdate  = 0,
               rating        = 0;
   GArray     *thumbnail     = NULL;
-  gchar      *id_s          = NULL,
-             *filename      = NULL,
+  gchar      *filename      = NULL,
              *aspectratio   = NULL,
              *format        = NULL,
              *comments      = NULL,
              *url           = NULL;
-  GrlMedia   *media;
+  gchar      *sort_key;
+  DpapImage   image;
+  guint       position;
 
   g_object_get (record,
                "large-filesize", &largefilesize,
@@ -159,28 +173,27 @@ grl_dpap_db_add (DmapDb *_db, DmapRecord *_record, GError **error)
                "location", &url,
                 NULL);
 
-  id_s = g_strdup_printf ("%u", nextid);
-
-  media = grl_media_image_new ();
-
-  grl_media_set_id (media, id_s);
-
-  if (filename)
-    grl_media_set_title (media, filename);
-
   if (url) {
     /* Replace URL's dpap:// with http:// */
     memcpy (url, "http", 4);
-    grl_media_set_url (media, url);
   }
 
-  grl_media_set_width (media, width);
-  grl_media_set_height (media, height);
+  sort_key = grl_dmap_sort_key (filename);
 
-  set_insert (db->priv->photos,  PHOTOS_ID, "Unknown",  media);
+  image.title    = filename ? g_string_chunk_insert (db->priv->strings, filename) : NULL;
+  image.url      = url ? g_string_chunk_insert (db->priv->strings, url) : NULL;
+  image.sort_key = g_string_chunk_insert (db->priv->strings, sort_key);
+  image.width    = width;
+  image.height   = height;
+  image.id       = nextid;
 
-  g_free (id_s);
-  g_object_unref (media);
+  position = db->priv->images->len;
+  g_array_append_val (db->priv->images, image);
+
+  set_insert (db, db->priv->photos, PHOTOS_ID, "Unknown", position);
+  grl_dmap_token_index_add (db->priv->tokens, position, filename);
+
+  g_free (sort_key);
   g_free (filename);
   g_free (aspectratio);
   g_free (format);
@@ -191,10 +204,49 @@ grl_dpap_db_add (DmapDb *_db, DmapRecord *_record, GError **error)
   return --nextid;
 }
 
-static gboolean
-same_media (GrlMedia *a, GrlMedia *b)
+static GrlMedia *
+image_to_media (DpapImage *image)
 {
-  return strcmp (grl_media_get_id (a), grl_media_get_id (b)) == 0;
+  gchar    *id_s;
+  GrlMedia *media;
+
+  id_s = g_strdup_printf ("%u", image->id);
+
+  media = grl_media_image_new ();
+
+  grl_media_set_id (media, id_s);
+
+  if (image->title)
+    grl_media_set_title (media, image->title);
+
+  if (image->url)
+    grl_media_set_url (media, image->url);
+
+  grl_media_set_width (media, image->width);
+  grl_media_set_height (media, image->height);
+
+  g_free (id_s);
+
+  return media;
+}
+
+static GrlMedia *
+set_get_media (GrlDpapDb *db, GrlDmapSet *set, guint position)
+{
+  gpointer item = grl_dmap_index_get (set->children, position);
+  GrlDmapSet *child;
+  GrlMedia *media;
+
+  if (!set->has_sets)
+    return image_to_media (&g_array_index (db->priv->images, DpapImage, GPOINTER_TO_UINT (item)));
+
+  child = item;
+  media = grl_media_container_new ();
+  grl_media_set_id (media, child->id);
+  grl_media_set_title (media, child->title);
+  grl_media_set_childcount (media, grl_dmap_index_get_length (child->children));
+
+  return media;
 }
 
 void
@@ -209,94 +261,80 @@ grl_dpap_db_browse (GrlDpapDb *db,
 {
   g_assert (GRL_IS_DPAP_DB (db));
 
-  int i;
-  guint remaining;
-  GHashTable *hash_table;
-  GHashTableIter iter;
-  gpointer key, val;
+  guint i, length, remaining;
+  GrlDmapSet *set;
 
   const gchar *container_id = grl_media_get_id (container);
-  if (container_id == NULL) {
-    hash_table = db->priv->root;
-  } else if (same_media (container, GRL_MEDIA (db->priv->photos_container))) {
-    hash_table = db->priv->photos;
-  } else {
-    hash_table = g_hash_table_lookup (db->priv->photos, container);
-  }
+  if (container_id == NULL)
+    set = db->priv->root;
+  else
+    set = g_hash_table_lookup (db->priv->sets, container_id);
 
   /* Should not be NULL; this means the container requested
      does not exist in the database. */
-  if (hash_table == NULL) {
+  if (set == NULL) {
     GError *error = g_error_new (GRL_CORE_ERROR,
                                  GRL_CORE_ERROR_BROWSE_FAILED,
                                 "Invalid container identifier %s",
                                  container_id);
     func (source, op_id, NULL, 0, user_data, error);
-    goto done;
+    g_error_free (error);
+    return;
   }
 
-  remaining = g_hash_table_size (hash_table) - skip;
-  remaining = remaining < count ? remaining : count;
-  g_hash_table_iter_init (&iter, hash_table);
-  for (i = 0; g_hash_table_iter_next (&iter, &key, &val) && i < skip + count; i++) {
-    if (i < skip)
-      continue;
-    if (grl_media_is_container (key))
-      grl_media_set_childcount (key, g_hash_table_size (val));
-    func (source, op_id, GRL_MEDIA (g_object_ref (key)), --remaining, user_data, NULL);
+  length = grl_dmap_index_get_length (set->children);
+  if (skip >= length) {
+    func (source, op_id, NULL, 0, user_data, NULL);
+    return;
   }
-done:
-  return;
+
+  remaining = MIN (length - skip, count);
+  for (i = skip; remaining > 0; i++)
+    func (source, op_id, set_get_media (db, set, i), --remaining, user_data, NULL);
 }
 
 void
 grl_dpap_db_search (GrlDpapDb *db,
                     GrlSource *source,
                     guint op_id,
-                    GHRFunc predicate,
-                    gpointer pred_user_data,
+                    const gchar *text,
+                    guint skip,
+                    guint count,
                     GrlSourceResultCb func,
                     gpointer user_data)
 {
   g_assert (GRL_IS_DPAP_DB (db));
 
-  gint i, j, k;
-  guint remaining = 0;
-  gpointer key1, val1, key2, val2;
-  GHashTable *hash_tables[] = { db->priv->photos };
-
-  /* Use hash table to avoid duplicates */
-  GHashTable *results = NULL;
-  GHashTableIter iter1, iter2;
-
-  results = g_hash_table_new (g_str_hash, g_str_equal);
-
-  /* For photos ... */
-  for (i = 0; i < G_N_ELEMENTS (hash_tables); i++) {
-    g_hash_table_iter_init (&iter1, hash_tables[i]);
-    /* For each album or artist in above... */
-    for (j = 0; g_hash_table_iter_next (&iter1, &key1, &val1); j++) {
-      if (grl_media_is_container (key1)) {
-        g_hash_table_iter_init (&iter2, val1);
-        /* For each media item in above... */
-        for (k = 0; g_hash_table_iter_next (&iter2, &key2, &val2); k++) {
-          const char *id = grl_media_get_id (GRL_MEDIA (key2));
-          /* If the predicate returns true, add to results set. */
-          if (predicate (key2, val2, pred_user_data)
-           && ! g_hash_table_contains (results, id)) {
-            remaining++;
-            g_hash_table_insert (results, (gpointer) id, key2);
-          }
-        }
-      }
-    }
+  guint i, length, position, remaining;
+  GArray *results = NULL;
+
+  /* Without text, everything matches */
+  if (text != NULL && *text != '\0') {
+    results = grl_dmap_token_index_search (db->priv->tokens, text);
+    length = results->len;
+  } else {
+    length = db->priv->images->len;
   }
 
-  /* Process results set. */
-  g_hash_table_iter_init (&iter1, results);
-  for (i = 0; g_hash_table_iter_next (&iter1, &key1, &val1); i++) {
-    func (source, op_id, GRL_MEDIA (g_object_ref (val1)), --remaining, user_data, NULL);
+  if (skip >= length) {
+    func (source, op_id, NULL, 0, user_data, NULL);
+    goto done;
   }
+
+  remaining = MIN (length - skip, count);
+  for (i = skip; remaining > 0; i++) {
+    position = results != NULL ? g_array_index (results, guint, i) : i;
+    func (source,
+          op_id,
+          image_to_media (&g_array_index (db->priv->images, DpapImage, position)),
+          --remaining,
+          user_data,
+          NULL);
+  }
+
+done:
+  if (results != NULL)
+    g_array_unref (results);
 }
 
 static void
@@ -331,15 +369,16 @@ grl_dpap_db_init (GrlDpapDb *db)
 {
   db->priv = grl_dpap_db_get_instance_private (db);
 
-  db->priv->photos_container  = grl_media_container_new ();
-
-  grl_media_set_id (GRL_MEDIA (db->priv->photos_container), PHOTOS_ID);
-  grl_media_set_title (GRL_MEDIA (db->priv->photos_container), PHOTOS_NAME);
+  db->priv->strings = g_string_chunk_new (64 * 1024);
+  db->priv->images  = g_array_new (FALSE, FALSE, sizeof (DpapImage));
+  db->priv->tokens  = grl_dmap_token_index_new ();
+  db->priv->sets    = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) grl_dmap_set_free);
 
-  db->priv->root   = g_hash_table_new_full (container_hash, container_equal, g_object_unref, (GDestroyNotify) g_hash_table_destroy);
-  db->priv->photos = g_hash_table_new_full (container_hash, container_equal, g_object_unref, (GDestroyNotify) g_hash_table_destroy);
+  db->priv->root   = grl_dmap_set_new (NULL, NULL, NULL, TRUE);
+  db->priv->photos = grl_dmap_set_new (PHOTOS_ID, PHOTOS_NAME, "0", TRUE);
 
-  g_hash_table_insert (db->priv->root, g_object_ref (db->priv->photos_container), db->priv->photos);
+  g_hash_table_insert (db->priv->sets, db->priv->photos->id, db->priv->photos);
+  grl_dmap_index_add (db->priv->root->children, db->priv->photos, db->priv->photos->sort_key);
 }
 
 static void
@@ -349,9 +388,14 @@ grl_dpap_db_finalize (GObject *object)
 
   GRL_DEBUG ("Finalizing GrlDpapDb");
 
-  g_object_unref (db->priv->photos_container);
+  g_hash_table_destroy (db->priv->sets);
+  grl_dmap_set_free (db->priv->root);
+
+  grl_dmap_token_index_free (db->priv->tokens);
+  g_array_unref (db->priv->images);
+  g_string_chunk_free (db->priv->strings);
 
-  g_hash_table_destroy (db->priv->photos);
+  G_OBJECT_CLASS (grl_dpap_db_parent_class)->finalize (object);
 }
 
 static void
@@ -79,8 +79,9 @@ void grl_dpap_db_browse (GrlDpapDb *_db,
 void grl_dpap_db_search (GrlDpapDb *_db,
                          GrlSource *source,
                          guint op_id,
-                         GHRFunc predicate,
-                         gpointer pred_user_data,
+                         const gchar *text,
+                         guint skip,
+                         guint count,
                          GrlSourceResultCb func,
                          gpointer user_data);
 
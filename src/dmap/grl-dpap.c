@@ -239,8 +239,9 @@ grl_dpap_do_search (ResultCbAndArgsAndDb *cb_and_db)
   grl_dpap_db_search (GRL_DPAP_DB (cb_and_db->db),
                       cb_and_db->cb.source,
                       cb_and_db->cb.op_id,
-                      (GHRFunc) cb_and_db->cb.predicate,
-                      cb_and_db->cb.predicate_data,
+                      cb_and_db->cb.search_text,
+                      cb_and_db->cb.skip,
+                      cb_and_db->cb.count,
                       cb_and_db->cb.callback,
                       cb_and_db->cb.user_data);
 
@@ -348,18 +349,6 @@ grl_dpap_connect (gchar *name, gchar *host, guint port, ResultCbAndArgsAndDb *cb
   dmap_connection_start (connection, (DmapConnectionFunc) callback, cb_and_db);
 }
 
-static gboolean
-grl_dpap_match (GrlMedia *media, gpointer val, gpointer user_data)
-{
-  g_assert (grl_media_is_image (media));
-
-  if (user_data == NULL)
-    return TRUE;
-
-  const char *title = grl_media_get_title (media);
-  return strstr (title, user_data) != NULL;
-}
-
 /* ================== API Implementation ================ */
 
 static const GList *
@@ -445,8 +434,9 @@ static void grl_dpap_source_search (GrlSource *source,
   cb_and_db->cb.source         = ss->source;
   cb_and_db->cb.container      = NULL;
   cb_and_db->cb.op_id          = ss->operation_id;
-  cb_and_db->cb.predicate      = (GHRFunc) grl_dpap_match;
-  cb_and_db->cb.predicate_data = ss->text;
+  cb_and_db->cb.search_text    = ss->text;
+  cb_and_db->cb.skip           = grl_operation_options_get_skip (ss->options);
+  cb_and_db->cb.count          = grl_operation_options_get_count (ss->options);
   cb_and_db->cb.user_data      = ss->user_data;
 
   if ((cb_and_db->db = g_hash_table_lookup (connections, url))) {
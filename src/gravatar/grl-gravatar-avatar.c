@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include <string.h>
+
+#include "grl-lru-cache.h"
+#include "grl-gravatar-avatar.h"
+
+#define GRAVATAR_URL "https://www.gravatar.com/avatar/%s.jpg"
+
+/* Field -> avatar URL, NULL if the field has no email address */
+struct _GrlGravatarCache {
+  GrlLruCache *fields;
+};
+
+/* Characters matched by "[\w-]" */
+static gboolean
+is_word_char (const gchar *p, const gchar **next)
+{
+  guchar c = *p;
+  gunichar uc;
+
+  if (c < 0x80) {
+    *next = p + 1;
+    return g_ascii_isalnum (c) || c == '_' || c == '-';
+  }
+
+  uc = g_utf8_get_char_validated (p, -1);
+  if (uc == (gunichar) -1 || uc == (gunichar) -2)
+    return FALSE;
+
+  *next = g_utf8_next_char (p);
+  return g_unichar_isalnum (uc);
+}
+
+/* Returns: the end of the word characters starting at @p */
+static const gchar *
+skip_word (const gchar *p)
+{
+  const gchar *next;
+
+  while (*p != '\0' && is_word_char (p, &next))
+    p = next;
+
+  return p;
+}
+
+/* Returns: the end of the domain starting at @p, that is, two or more
+ * words separated by dots, or %NULL if there is none. */
+static const gchar *
+skip_domain (const gchar *p)
+{
+  const gchar *end, *label_end;
+  guint labels = 0;
+
+  end = skip_word (p);
+  if (end == p)
+    return NULL;
+
+  labels++;
+  while (*end == '.') {
+    label_end = skip_word (end + 1);
+    if (label_end == end + 1)
+      break;
+    end = label_end;
+    labels++;
+  }
+
+  return labels >= 2 ? end : NULL;
+}
+
+/**
+ * grl_gravatar_find_email:
+ * @text: Text to look for an email address in
+ * @email: (out): Return location for the start of the first email address
+ * @length: (out): Return location for the length of the email address
+ *
+ * Finds the same email addresses as the "[\w-]+@([\w-]+\.)+[\w-]+" regular
+ * expression, without the cost of running it.
+ *
+ * Returns: %TRUE if @text contains an email address.
+ */
+gboolean
+grl_gravatar_find_email (const gchar *text,
+                         const gchar **email,
+                         gsize *length)
+{
+  const gchar *at, *start, *end, *p, *next;
+
+  for (at = strchr (text, '@'); at != NULL; at = strchr (at + 1, '@')) {
+    /* Start of the word characters right before '@' */
+    start = at;
+    while ((p = g_utf8_find_prev_char (text, start)) != NULL &&
+           is_word_char (p, &next) && next == start)
+      start = p;
+    if (start == at)
+      continue;
+
+    end = skip_domain (at + 1);
+    if (end == NULL)
+      continue;
+
+    *email = start;
+    *length = end - start;
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* Returns: (transfer full): the avatar URL of the first email address in
+ * @field, or %NULL if there is none */
+gchar *
+grl_gravatar_get_avatar_url (const gchar *field)
+{
+  gchar *lowercased_field;
+  gchar *email_hash;
+  gchar *avatar = NULL;
+  const gchar *email;
+  gsize length;
+
+  if (!field || !strchr (field, '@'))
+    return NULL;
+
+  lowercased_field = g_utf8_strdown (field, -1);
+
+  if (grl_gravatar_find_email (lowercased_field, &email, &length)) {
+    email_hash = g_compute_checksum_for_data (G_CHECKSUM_MD5,
+                                              (const guchar *) email,
+                                              length);
+    avatar = g_strdup_printf (GRAVATAR_URL, email_hash);
+    g_free (email_hash);
+  }
+  g_free (lowercased_field);
+
+  return avatar;
+}
+
+GrlGravatarCache *
+grl_gravatar_cache_new (guint max_fields)
+{
+  GrlGravatarCache *cache;
+
+  cache = g_slice_new (GrlGravatarCache);
+  cache->fields = grl_lru_cache_new (max_fields, g_free);
+
+  return cache;
+}
+
+void
+grl_gravatar_cache_free (GrlGravatarCache *cache)
+{
+  grl_lru_cache_free (cache->fields);
+  g_slice_free (GrlGravatarCache, cache);
+}
+
+/* Returns: (transfer full): the avatar URL of @field, or %NULL if it has no
+ * email address */
+gchar *
+grl_gravatar_cache_get_avatar_url (GrlGravatarCache *cache,
+                                   const gchar *field)
+{
+  gchar *avatar_url;
+
+  if (!field)
+    return NULL;
+
+  if (!grl_lru_cache_lookup (cache->fields, field, (gpointer *) &avatar_url)) {
+    avatar_url = grl_gravatar_get_avatar_url (field);
+    grl_lru_cache_insert (cache->fields, field, avatar_url);
+  }
+
+  return g_strdup (avatar_url);
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef _GRL_GRAVATAR_AVATAR_H_
+#define _GRL_GRAVATAR_AVATAR_H_
+
+#include <glib.h>
+
+/* Number of fields whose avatar is remembered */
+#define GRL_GRAVATAR_CACHE_MAX_FIELDS 4096
+
+gboolean grl_gravatar_find_email (const gchar *text,
+                                  const gchar **email,
+                                  gsize *length);
+
+gchar *grl_gravatar_get_avatar_url (const gchar *field);
+
+/* Avatar URLs of the most recently resolved fields, including the fields
+ * without an email address, as the same artists and authors come back
+ * over and over. */
+typedef struct _GrlGravatarCache GrlGravatarCache;
+
+GrlGravatarCache *grl_gravatar_cache_new (guint max_fields);
+
+void grl_gravatar_cache_free (GrlGravatarCache *cache);
+
+gchar *grl_gravatar_cache_get_avatar_url (GrlGravatarCache *cache,
+                                          const gchar *field);
+
+#endif /* _GRL_GRAVATAR_AVATAR_H_ */
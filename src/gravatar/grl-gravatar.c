@@ -36,10 +36,6 @@
 #define GRL_LOG_DOMAIN_DEFAULT gravatar_log_domain
 GRL_LOG_DOMAIN_STATIC(gravatar_log_domain);
 
-/* -------- Gravatar API -------- */
-
-#define GRAVATAR_URL "https://www.gravatar.com/avatar/%s.jpg"
-
 /* ------- Pluging Info -------- */
 
 #define SOURCE_ID   GRAVATAR_PLUGIN_ID
@@ -48,6 +44,8 @@ GRL_LOG_DOMAIN_STATIC(gravatar_log_domain);
 
 static GrlGravatarSource *grl_gravatar_source_new (void);
 
+static void grl_gravatar_source_finalize (GObject *object);
+
 static void grl_gravatar_source_resolve (GrlSource *source,
                                          GrlSourceResolveSpec *rs);
 
@@ -153,11 +151,24 @@ grl_gravatar_source_class_init (GrlGravatarSourceClass * klass)
   source_class->supported_keys = grl_gravatar_source_supported_keys;
   source_class->may_resolve = grl_gravatar_source_may_resolve;
   source_class->resolve = grl_gravatar_source_resolve;
+
+  G_OBJECT_CLASS (source_class)->finalize = grl_gravatar_source_finalize;
 }
 
 static void
 grl_gravatar_source_init (GrlGravatarSource *source)
 {
+  source->cache = grl_gravatar_cache_new (GRL_GRAVATAR_CACHE_MAX_FIELDS);
+}
+
+static void
+grl_gravatar_source_finalize (GObject *object)
+{
+  GrlGravatarSource *source = GRL_GRAVATAR_SOURCE (object);
+
+  grl_gravatar_cache_free (source->cache);
+
+  G_OBJECT_CLASS (grl_gravatar_source_parent_class)->finalize (object);
 }
 
 G_DEFINE_TYPE (GrlGravatarSource,
@@ -196,37 +207,6 @@ register_gravatar_key (GrlRegistry *registry,
   return key;
 }
 
-static gchar *
-get_avatar (const gchar *field) {
-  GMatchInfo *match_info = NULL;
-  gchar *avatar = NULL;
-  gchar *email;
-  gchar *email_hash;
-  gchar *lowercased_field;
-  static GRegex *email_regex = NULL;
-
-  if (!field) {
-    return NULL;
-  }
-
-  lowercased_field = g_utf8_strdown (field, -1);
-
-  if (!email_regex) {
-    email_regex = g_regex_new ("[\\w-]+@([\\w-]+\\.)+[\\w-]+", G_REGEX_OPTIMIZE, 0, NULL);
-  }
-
-  if (g_regex_match (email_regex, lowercased_field, 0, &match_info)) {
-    email = g_match_info_fetch (match_info, 0);
-    email_hash = g_compute_checksum_for_string (G_CHECKSUM_MD5, email, -1);
-    avatar = g_strdup_printf (GRAVATAR_URL, email_hash);
-    g_free (email);
-    g_free (email_hash);
-  }
-  g_match_info_free (match_info);
-
-  return avatar;
-}
-
 /**
  * Returns: TRUE if @dependency is in @media, FALSE else.
  * When returning FALSE, if @missing_keys is not NULL it is populated with a
@@ -245,7 +225,8 @@ has_dependency (GrlMedia *media, GrlKeyID dependency, GList **missing_keys)
 }
 
 static void
-set_avatar (GrlData *data,
+set_avatar (GrlGravatarSource *source,
+            GrlData *data,
             GrlKeyID key)
 {
   gint length, i;
@@ -256,7 +237,8 @@ set_avatar (GrlData *data,
 
   for (i = 0; i < length; i++) {
     relkeys = grl_data_get_related_keys (data, key, i);
-    avatar_url = get_avatar (grl_related_keys_get_string (relkeys, key));
+    avatar_url = grl_gravatar_cache_get_avatar_url (source->cache,
+                                                    grl_related_keys_get_string (relkeys, key));
     if (avatar_url) {
       grl_related_keys_set_string (relkeys, key, avatar_url);
       g_free (avatar_url);
@@ -328,11 +310,15 @@ grl_gravatar_source_resolve (GrlSource *source,
   }
 
   if (artist_avatar_required) {
-    set_avatar (GRL_DATA (rs->media), GRL_METADATA_KEY_ARTIST);
+    set_avatar (GRL_GRAVATAR_SOURCE (source),
+                GRL_DATA (rs->media),
+                GRL_METADATA_KEY_ARTIST);
   }
 
   if (author_avatar_required) {
-    set_avatar (GRL_DATA (rs->media), GRL_METADATA_KEY_AUTHOR);
+    set_avatar (GRL_GRAVATAR_SOURCE (source),
+                GRL_DATA (rs->media),
+                GRL_METADATA_KEY_AUTHOR);
   }
 
   rs->callback (source, rs->operation_id, rs->media, rs->user_data, NULL);
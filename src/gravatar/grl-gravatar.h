@@ -27,6 +27,8 @@
 
 #include <grilo.h>
 
+#include "grl-gravatar-avatar.h"
+
 #define GRL_GRAVATAR_SOURCE_TYPE                \
   (grl_gravatar_source_get_type ())
 
@@ -59,6 +61,8 @@ struct _GrlGravatarSource {
 
   GrlSource parent;
 
+  GrlGravatarCache *cache;
+
 };
 
 typedef struct _GrlGravatarSourceClass GrlGravatarSourceClass;
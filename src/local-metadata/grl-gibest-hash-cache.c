@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "grl-file-cache.h"
+#include "grl-gibest-hash-cache.h"
+
+struct _GrlGibestHashCache {
+  GrlFileCache *cache;
+};
+
+/**
+ * grl_gibest_hash_cache_new:
+ * @max_entries: Maximum number of hashes kept
+ * Returns: (transfer full): A new #GrlGibestHashCache, holding the hashes
+ * saved by previous instances.
+ */
+GrlGibestHashCache *
+grl_gibest_hash_cache_new (guint max_entries)
+{
+  GrlGibestHashCache *cache;
+
+  cache = g_slice_new0 (GrlGibestHashCache);
+  cache->cache = grl_file_cache_new ("local-metadata" G_DIR_SEPARATOR_S "gibest-hashes",
+                                     G_VARIANT_TYPE_UINT64,
+                                     max_entries);
+
+  return cache;
+}
+
+/* Saves the pending changes before freeing @cache */
+void
+grl_gibest_hash_cache_free (GrlGibestHashCache *cache)
+{
+  grl_file_cache_free (cache->cache);
+  g_slice_free (GrlGibestHashCache, cache);
+}
+
+/**
+ * grl_gibest_hash_cache_lookup:
+ * @cache: Instance of #GrlGibestHashCache
+ * @uri: URI of the file
+ * @info: Information about the file, with its standard::size,
+ * time::modified and unix::inode attributes
+ * @hash: (out): Return location for the hash
+ * Returns: %TRUE if the hash of this version of the file is known.
+ */
+gboolean
+grl_gibest_hash_cache_lookup (GrlGibestHashCache *cache,
+                              const gchar *uri,
+                              GFileInfo *info,
+                              guint64 *hash)
+{
+  GVariant *value;
+
+  value = grl_file_cache_lookup (cache->cache, uri, info);
+  if (value == NULL)
+    return FALSE;
+
+  *hash = g_variant_get_uint64 (value);
+  g_variant_unref (value);
+
+  return TRUE;
+}
+
+/**
+ * grl_gibest_hash_cache_store:
+ * @cache: Instance of #GrlGibestHashCache
+ * @uri: URI of the file
+ * @info: Information about the file, as in grl_gibest_hash_cache_lookup()
+ * @hash: The hash of the file
+ */
+void
+grl_gibest_hash_cache_store (GrlGibestHashCache *cache,
+                             const gchar *uri,
+                             GFileInfo *info,
+                             guint64 hash)
+{
+  grl_file_cache_store (cache->cache, uri, info, g_variant_new_uint64 (hash));
+}
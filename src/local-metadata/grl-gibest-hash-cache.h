@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef _GRL_GIBEST_HASH_CACHE_H_
+#define _GRL_GIBEST_HASH_CACHE_H_
+
+#include <gio/gio.h>
+
+/* Number of hashes kept */
+#define GRL_GIBEST_HASH_CACHE_MAX_ENTRIES 32768
+
+/* Cache of the gibest hashes already computed, keyed by the URI of the file
+ * along with its size, modification time and inode, so a file that changed
+ * is hashed again. It is saved in the user cache directory. */
+typedef struct _GrlGibestHashCache GrlGibestHashCache;
+
+GrlGibestHashCache *grl_gibest_hash_cache_new (guint max_entries);
+
+void grl_gibest_hash_cache_free (GrlGibestHashCache *cache);
+
+gboolean grl_gibest_hash_cache_lookup (GrlGibestHashCache *cache,
+                                       const gchar *uri,
+                                       GFileInfo *info,
+                                       guint64 *hash);
+
+void grl_gibest_hash_cache_store (GrlGibestHashCache *cache,
+                                  const gchar *uri,
+                                  GFileInfo *info,
+                                  guint64 hash);
+
+#endif /* _GRL_GIBEST_HASH_CACHE_H_ */
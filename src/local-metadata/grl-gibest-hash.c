@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2010-2011 Igalia S.L.
+ *
+ * Contact: Guillaume Emont <gemont@igalia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "grl-gibest-hash.h"
+
+/* Private functions */
+
+#if defined(__SSE2__)
+
+static guint64
+sum_chunks (const guint64 *head,
+            const guint64 *tail)
+{
+  __m128i acc0 = _mm_setzero_si128 ();
+  __m128i acc1 = _mm_setzero_si128 ();
+  guint64 lanes[2];
+  gsize i;
+
+  /* Two accumulators to not wait on the previous addition */
+  for (i = 0; i < GRL_GIBEST_HASH_CHUNK_WORDS; i += 4) {
+    acc0 = _mm_add_epi64 (acc0, _mm_loadu_si128 ((const __m128i *) (head + i)));
+    acc1 = _mm_add_epi64 (acc1, _mm_loadu_si128 ((const __m128i *) (head + i + 2)));
+    acc0 = _mm_add_epi64 (acc0, _mm_loadu_si128 ((const __m128i *) (tail + i)));
+    acc1 = _mm_add_epi64 (acc1, _mm_loadu_si128 ((const __m128i *) (tail + i + 2)));
+  }
+
+  _mm_storeu_si128 ((__m128i *) lanes, _mm_add_epi64 (acc0, acc1));
+
+  return lanes[0] + lanes[1];
+}
+
+#else
+
+static guint64
+sum_chunks (const guint64 *head,
+            const guint64 *tail)
+{
+  guint64 acc[4] = { 0, };
+  gsize i;
+
+  /* Independent accumulators, that compilers can vectorize */
+  for (i = 0; i < GRL_GIBEST_HASH_CHUNK_WORDS; i += 4) {
+    acc[0] += head[i] + tail[i];
+    acc[1] += head[i + 1] + tail[i + 1];
+    acc[2] += head[i + 2] + tail[i + 2];
+    acc[3] += head[i + 3] + tail[i + 3];
+  }
+
+  return acc[0] + acc[1] + acc[2] + acc[3];
+}
+
+#endif
+
+/* Reads @count bytes at @offset, unless the end of the file is reached */
+static gboolean
+pread_all (int fd,
+           gpointer buffer,
+           gsize count,
+           goffset offset,
+           GError **error)
+{
+  gchar *data = buffer;
+
+  while (count > 0) {
+    gssize n_bytes = pread (fd, data, count, offset);
+
+    if (n_bytes < 0) {
+      int errsv = errno;
+
+      if (errsv == EINTR)
+        continue;
+
+      g_set_error_literal (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                           g_strerror (errsv));
+      return FALSE;
+    }
+
+    if (n_bytes == 0) {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                           "Unexpected end of file");
+      return FALSE;
+    }
+
+    data += n_bytes;
+    count -= n_bytes;
+    offset += n_bytes;
+  }
+
+  return TRUE;
+}
+
+/* Public functions */
+
+/**
+ * grl_gibest_hash_compute:
+ * @head: The first %GRL_GIBEST_HASH_CHUNK_SIZE bytes of the file
+ * @tail: The last %GRL_GIBEST_HASH_CHUNK_SIZE bytes of the file
+ * @file_size: The size of the file
+ * Returns: The hash of the file.
+ */
+guint64
+grl_gibest_hash_compute (const guint64 *head,
+                         const guint64 *tail,
+                         guint64 file_size)
+{
+  return sum_chunks (head, tail) + file_size;
+}
+
+/**
+ * grl_gibest_hash_fd:
+ * @fd: A file descriptor open for reading
+ * @hash: (out): Return location for the hash
+ * @error: Return location for an error
+ * Returns: %TRUE if the file could be hashed. Files smaller than
+ * %GRL_GIBEST_HASH_CHUNK_SIZE are not.
+ */
+gboolean
+grl_gibest_hash_fd (int fd,
+                    guint64 *hash,
+                    GError **error)
+{
+  guint64 buffer[2][GRL_GIBEST_HASH_CHUNK_WORDS];
+  struct stat st;
+
+  if (fstat (fd, &st) < 0) {
+    int errsv = errno;
+
+    g_set_error_literal (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                         g_strerror (errsv));
+    return FALSE;
+  }
+
+  if (st.st_size < GRL_GIBEST_HASH_CHUNK_SIZE) {
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                         "File is too small");
+    return FALSE;
+  }
+
+  if (!pread_all (fd, buffer[0], GRL_GIBEST_HASH_CHUNK_SIZE, 0, error) ||
+      !pread_all (fd, buffer[1], GRL_GIBEST_HASH_CHUNK_SIZE,
+                  st.st_size - GRL_GIBEST_HASH_CHUNK_SIZE, error))
+    return FALSE;
+
+  *hash = grl_gibest_hash_compute (buffer[0], buffer[1], st.st_size);
+
+  return TRUE;
+}
+
+/**
+ * grl_gibest_hash_stream:
+ * @stream: A seekable stream positioned at the beginning of the file
+ * @cancellable: (nullable): A #GCancellable
+ * @hash: (out): Return location for the hash
+ * @error: Return location for an error
+ * Returns: %TRUE if the file could be hashed. This is the fallback for the
+ * files without a local path.
+ */
+gboolean
+grl_gibest_hash_stream (GInputStream *stream,
+                        GCancellable *cancellable,
+                        guint64 *hash,
+                        GError **error)
+{
+  guint64 buffer[2][GRL_GIBEST_HASH_CHUNK_WORDS];
+  goffset file_size;
+
+  if (!g_input_stream_read_all (stream, buffer[0], GRL_GIBEST_HASH_CHUNK_SIZE,
+                                NULL, cancellable, error))
+    return FALSE;
+
+  if (!g_seekable_seek (G_SEEKABLE (stream), -GRL_GIBEST_HASH_CHUNK_SIZE,
+                        G_SEEK_END, cancellable, error))
+    return FALSE;
+
+  if (!g_input_stream_read_all (stream, buffer[1], GRL_GIBEST_HASH_CHUNK_SIZE,
+                                NULL, cancellable, error))
+    return FALSE;
+
+  file_size = g_seekable_tell (G_SEEKABLE (stream));
+  if (file_size < GRL_GIBEST_HASH_CHUNK_SIZE) {
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                         "File is too small");
+    return FALSE;
+  }
+
+  *hash = grl_gibest_hash_compute (buffer[0], buffer[1], file_size);
+
+  return TRUE;
+}
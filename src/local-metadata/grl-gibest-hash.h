@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2010-2011 Igalia S.L.
+ *
+ * Contact: Guillaume Emont <gemont@igalia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef _GRL_GIBEST_HASH_H_
+#define _GRL_GIBEST_HASH_H_
+
+#include <gio/gio.h>
+
+/* The hash is the sum of the 64-bit words of the first and last chunks of
+ * the file, plus its size. */
+#define GRL_GIBEST_HASH_CHUNK_SIZE (2 << 15)
+#define GRL_GIBEST_HASH_CHUNK_WORDS (GRL_GIBEST_HASH_CHUNK_SIZE / 8)
+
+guint64 grl_gibest_hash_compute (const guint64 *head,
+                                 const guint64 *tail,
+                                 guint64 file_size);
+
+gboolean grl_gibest_hash_fd (int fd,
+                             guint64 *hash,
+                             GError **error);
+
+gboolean grl_gibest_hash_stream (GInputStream *stream,
+                                 GCancellable *cancellable,
+                                 guint64 *hash,
+                                 GError **error);
+
+#endif /* _GRL_GIBEST_HASH_H_ */
@@ -25,27 +25,72 @@
 #endif
 
 #define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include <grilo.h>
 #include <gio/gio.h>
+#include <glib/gstdio.h>
 #include <glib/gi18n-lib.h>
 #include <libmediaart/mediaart.h>
 
 #include "grl-local-metadata.h"
+#include "grl-gibest-hash.h"
+#include "grl-gibest-hash-cache.h"
 
 #define GRL_LOG_DOMAIN_DEFAULT local_metadata_log_domain
-GRL_LOG_DOMAIN_STATIC(local_metadata_log_domain);
+GRL_LOG_DOMAIN(local_metadata_log_domain);
 
 #define SOURCE_ID   "grl-local-metadata"
 #define SOURCE_NAME _("Local Metadata Provider")
 #define SOURCE_DESC _("A source providing locally available metadata")
 
+/* Number of files hashed at the same time. Hashing is bound by I/O, so
+ * reading more files at once only makes disks seek more. */
+#define HASH_MAX_THREADS 2
+
+/* Files of a same directory resolved together are looked up by listing
+ * that directory once, when there are at least this many of them */
+#define INFO_BATCH_MIN 4
+/* Listing stops after this many entries per file looked up, and the files
+ * not found by then are looked up on their own, so a few files of a large
+ * directory do not cost a listing of all of it */
+#define INFO_BATCH_LIST_RATIO 16
+
+#define INFO_ATTRIBUTES                       \
+  G_FILE_ATTRIBUTE_THUMBNAIL_PATH ","         \
+  G_FILE_ATTRIBUTE_THUMBNAIL_IS_VALID ","     \
+  G_FILE_ATTRIBUTE_STANDARD_SIZE ","          \
+  G_FILE_ATTRIBUTE_TIME_MODIFIED ","          \
+  G_FILE_ATTRIBUTE_UNIX_INODE
+
+/* Known album art files, checked against the media art directory at most
+ * once per interval */
+#define ALBUM_ART_CACHE_MAX 512
+#define ALBUM_ART_CHECK_INTERVAL G_USEC_PER_SEC
+#define ALBUM_ART_FOUND   GINT_TO_POINTER (1)
+#define ALBUM_ART_MISSING GINT_TO_POINTER (2)
+
 /**/
 
 struct _GrlLocalMetadataSourcePriv {
   GrlKeyID hash_keyid;
+  GrlGibestHashCache *hash_cache;
+  GThreadPool *hash_pool;
+
+  /* Parent directory URI -> GList of InfoRequest waiting to be looked up */
+  GHashTable *pending_infos;
+  guint flush_infos_id;
+
+  /* Album art URI -> ALBUM_ART_FOUND or ALBUM_ART_MISSING */
+  GHashTable *album_art;
+  /* Album art URI -> GList of ResolveData waiting for it to be checked */
+  GHashTable *pending_album_art;
+  gint64 album_art_mtime;
+  gint64 album_art_checked;
 };
 
 /**/
@@ -59,6 +104,8 @@ typedef enum {
 
 static GrlLocalMetadataSource *grl_local_metadata_source_new (void);
 
+static void grl_local_metadata_source_finalize (GObject *object);
+
 static void grl_local_metadata_source_resolve (GrlSource *source,
                                                GrlSourceResolveSpec *rs);
 
@@ -134,18 +181,53 @@ grl_local_metadata_source_new (void)
 static void
 grl_local_metadata_source_class_init (GrlLocalMetadataSourceClass * klass)
 {
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GrlSourceClass *source_class = GRL_SOURCE_CLASS (klass);
 
+  gobject_class->finalize = grl_local_metadata_source_finalize;
+
   source_class->supported_keys = grl_local_metadata_source_supported_keys;
   source_class->cancel = grl_local_metadata_source_cancel;
   source_class->may_resolve = grl_local_metadata_source_may_resolve;
   source_class->resolve = grl_local_metadata_source_resolve;
 }
 
+static void run_gibest_hash (gpointer data,
+                             gpointer user_data);
+
 static void
 grl_local_metadata_source_init (GrlLocalMetadataSource *source)
 {
     source->priv = grl_local_metadata_source_get_instance_private (source);
+    source->priv->hash_cache =
+      grl_gibest_hash_cache_new (GRL_GIBEST_HASH_CACHE_MAX_ENTRIES);
+    source->priv->hash_pool = g_thread_pool_new (run_gibest_hash, NULL,
+                                                 HASH_MAX_THREADS, FALSE,
+                                                 NULL);
+    source->priv->pending_infos = g_hash_table_new_full (g_str_hash,
+                                                         g_str_equal,
+                                                         g_free, NULL);
+    source->priv->album_art = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                     g_free, NULL);
+    source->priv->pending_album_art = g_hash_table_new_full (g_str_hash,
+                                                             g_str_equal,
+                                                             g_free, NULL);
+}
+
+static void
+grl_local_metadata_source_finalize (GObject *object)
+{
+  GrlLocalMetadataSource *source = GRL_LOCAL_METADATA_SOURCE (object);
+
+  g_clear_handle_id (&source->priv->flush_infos_id, g_source_remove);
+  /* Queued hashes are still run, or their callbacks would never be */
+  g_thread_pool_free (source->priv->hash_pool, FALSE, TRUE);
+  grl_gibest_hash_cache_free (source->priv->hash_cache);
+  g_hash_table_destroy (source->priv->pending_infos);
+  g_hash_table_destroy (source->priv->album_art);
+  g_hash_table_destroy (source->priv->pending_album_art);
+
+  G_OBJECT_CLASS (grl_local_metadata_source_parent_class)->finalize (object);
 }
 
 
@@ -220,6 +302,20 @@ resolve_data_ensure_cancellable (ResolveData *resolve_data)
   return cancellable;
 }
 
+static void
+set_gibest_hash (ResolveData *resolve_data,
+                 guint64      hash)
+{
+  GrlLocalMetadataSourcePrivate *priv;
+  char *str;
+
+  priv = GRL_LOCAL_METADATA_SOURCE (resolve_data->source)->priv;
+
+  str = g_strdup_printf ("%" G_GINT64_FORMAT, hash);
+  grl_data_set_string (GRL_DATA (resolve_data->rs->media), priv->hash_keyid, str);
+  g_free (str);
+}
+
 static void
 extract_gibest_hash_done (GObject      *source_object,
                           GAsyncResult *res,
@@ -227,14 +323,27 @@ extract_gibest_hash_done (GObject      *source_object,
 {
   GError *error = NULL;
   ResolveData *resolve_data = user_data;
+  GrlLocalMetadataSourcePrivate *priv;
+  guint64 *hash;
+
+  priv = GRL_LOCAL_METADATA_SOURCE (resolve_data->source)->priv;
+
+  hash = g_task_propagate_pointer (G_TASK (res), &error);
+  if (hash != NULL) {
+    gchar *uri = g_file_get_uri (G_FILE (source_object));
+
+    grl_gibest_hash_cache_store (priv->hash_cache, uri,
+                                 g_task_get_task_data (G_TASK (res)),
+                                 *hash);
+    set_gibest_hash (resolve_data, *hash);
+    g_free (uri);
+    g_free (hash);
+  }
 
-  g_task_propagate_boolean (G_TASK (res), &error);
   resolve_data_finish_operation (resolve_data, "image", error);
   g_clear_error (&error);
 }
 
-#define CHUNK_N_BYTES (2 << 15)
-
 static void
 extract_gibest_hash (GTask        *task,
                      gpointer      source_object,
@@ -242,98 +351,125 @@ extract_gibest_hash (GTask        *task,
                      GCancellable *cancellable)
 {
   GFile *file = source_object;
-  guint64 buffer[2][CHUNK_N_BYTES/8];
-  GInputStream *stream = NULL;
-  gssize n_bytes, file_size;
   GError *error = NULL;
-  guint64 hash = 0;
-  gint i;
-  char *str;
-  ResolveData *resolve_data = task_data;
-  GrlLocalMetadataSourcePrivate *priv;
-
-  priv = GRL_LOCAL_METADATA_SOURCE (resolve_data->source)->priv;
-
-  stream = G_INPUT_STREAM (g_file_read (file, cancellable, &error));
-  if (stream == NULL)
-    goto fail;
-
-  /* Extract start/end chunks of the file */
-  n_bytes = g_input_stream_read (stream, buffer[0], CHUNK_N_BYTES, cancellable, &error);
-  if (n_bytes == -1)
-    goto fail;
-
-  if (!g_seekable_seek (G_SEEKABLE (stream), -CHUNK_N_BYTES, G_SEEK_END, cancellable, &error))
-    goto fail;
-
-  n_bytes = g_input_stream_read (stream, buffer[1], CHUNK_N_BYTES, cancellable, &error);
-  if (n_bytes == -1)
-    goto fail;
-
-  for (i = 0; i < G_N_ELEMENTS (buffer[0]); i++)
-    hash += buffer[0][i] + buffer[1][i];
+  guint64 hash;
+  guint64 *result;
+  gboolean success;
+  gchar *path;
+
+  path = g_file_get_path (file);
+  if (path != NULL) {
+    /* Read both chunks straight from the file */
+    int fd = g_open (path, O_RDONLY | O_CLOEXEC, 0);
+
+    if (fd < 0) {
+      int errsv = errno;
+
+      error = g_error_new_literal (G_IO_ERROR, g_io_error_from_errno (errsv),
+                                   g_strerror (errsv));
+      success = FALSE;
+    } else {
+      success = grl_gibest_hash_fd (fd, &hash, &error);
+      close (fd);
+    }
+    g_free (path);
+  } else {
+    GInputStream *stream;
 
-  file_size = g_seekable_tell (G_SEEKABLE (stream));
+    stream = G_INPUT_STREAM (g_file_read (file, cancellable, &error));
+    success = (stream != NULL &&
+               grl_gibest_hash_stream (stream, cancellable, &hash, &error));
+    g_clear_object (&stream);
+  }
 
-  if (file_size < CHUNK_N_BYTES)
-    goto fail;
+  if (!success) {
+    GRL_DEBUG ("Could not get file hash: %s", error->message);
+    g_task_return_error (task, error);
+    return;
+  }
 
-  /* Include file size */
-  hash += file_size;
-  g_object_unref (stream);
+  result = g_new (guint64, 1);
+  *result = hash;
+  g_task_return_pointer (task, result, g_free);
+}
 
-  str = g_strdup_printf ("%" G_GINT64_FORMAT, hash);
-  grl_data_set_string (GRL_DATA (resolve_data->rs->media), priv->hash_keyid, str);
-  g_free (str);
+/* Runs in hash_pool */
+static void
+run_gibest_hash (gpointer data,
+                 gpointer user_data)
+{
+  GTask *task = data;
 
-  g_task_return_boolean (task, TRUE);
-  return;
+  if (!g_task_return_error_if_cancelled (task)) {
+    extract_gibest_hash (task,
+                         g_task_get_source_object (task),
+                         g_task_get_task_data (task),
+                         g_task_get_cancellable (task));
+  }
 
-fail:
-  GRL_DEBUG ("Could not get file hash: %s\n", error ? error->message : "Unknown error");
-  g_task_return_error (task, error);
-  g_clear_object (&stream);
+  g_object_unref (task);
 }
 
 static void
 extract_gibest_hash_async (ResolveData          *resolve_data,
                            GFile                *file,
+                           GFileInfo            *info,
                            GCancellable         *cancellable)
 {
+  GrlLocalMetadataSourcePrivate *priv;
   GTask *task;
+  gchar *uri;
+  guint64 hash;
+
+  priv = GRL_LOCAL_METADATA_SOURCE (resolve_data->source)->priv;
+
+  uri = g_file_get_uri (file);
+  if (grl_gibest_hash_cache_lookup (priv->hash_cache, uri, info, &hash)) {
+    GRL_DEBUG ("Using cached hash for %s", uri);
+    g_free (uri);
+    set_gibest_hash (resolve_data, hash);
+    resolve_data_finish_operation (resolve_data, "image", NULL);
+    return;
+  }
+  g_free (uri);
 
   task = g_task_new (G_OBJECT (file), cancellable, extract_gibest_hash_done,
                      resolve_data);
-  g_task_run_in_thread (task, extract_gibest_hash);
+  g_task_set_task_data (task, g_object_ref (info), g_object_unref);
+  g_thread_pool_push (priv->hash_pool, task, NULL);
 }
 
 static void resolve_album_art (ResolveData         *resolve_data,
                                resolution_flags_t   flags);
 
+/* Takes the result of looking up @file, which is either @info or @error */
 static void
-got_file_info (GFile *file,
-               GAsyncResult *result,
-               gpointer user_data)
+handle_file_info (ResolveData  *resolve_data,
+                  GFile        *file,
+                  GFileInfo    *info,
+                  const GError *info_error)
 {
   GCancellable *cancellable;
-  GFileInfo *info;
   GError *error = NULL;
   const gchar *thumbnail_path;
   gboolean thumbnail_is_valid;
   GrlLocalMetadataSourcePrivate *priv;
-  ResolveData *resolve_data = user_data;
   GrlSourceResolveSpec *rs = resolve_data->rs;
   resolution_flags_t flags;
 
-  GRL_DEBUG ("got_file_info");
-
   priv = GRL_LOCAL_METADATA_SOURCE (resolve_data->source)->priv;
 
   cancellable = resolve_data_ensure_cancellable (resolve_data);
 
-  info = g_file_query_info_finish (file, result, &error);
-  if (error)
+  if (info_error) {
+    error = g_error_copy (info_error);
     goto error;
+  }
+
+  flags = get_resolution_flags (rs->keys, priv);
+
+  if (!(flags & FLAG_THUMBNAIL))
+    goto hash;
 
   thumbnail_path =
       g_file_info_get_attribute_byte_string (info, G_FILE_ATTRIBUTE_THUMBNAIL_PATH);
@@ -357,8 +493,6 @@ got_file_info (GFile *file,
               grl_media_get_url (rs->media));
   }
 
-  flags = get_resolution_flags (rs->keys, priv);
-
   if (grl_media_is_audio (rs->media) &&
       !(thumbnail_path && thumbnail_is_valid)) {
     /* We couldn't get a per-track thumbnail; try for a per-album one,
@@ -366,13 +500,14 @@ got_file_info (GFile *file,
     resolve_album_art (resolve_data, flags);
   }
 
+hash:
   if (flags & FLAG_GIBEST_HASH) {
-    extract_gibest_hash_async (resolve_data, file, cancellable);
+    extract_gibest_hash_async (resolve_data, file, info, cancellable);
   } else {
     resolve_data_finish_operation (resolve_data, "image", NULL);
   }
 
-  goto exit;
+  return;
 
 error:
     {
@@ -385,9 +520,250 @@ error:
       g_error_free (error);
       g_error_free (new_error);
     }
+}
 
-exit:
-    g_clear_object (&info);
+static void
+got_file_info (GFile *file,
+               GAsyncResult *result,
+               gpointer user_data)
+{
+  GFileInfo *info;
+  GError *error = NULL;
+
+  GRL_DEBUG ("got_file_info");
+
+  info = g_file_query_info_finish (file, result, &error);
+  handle_file_info (user_data, file, info, error);
+
+  g_clear_error (&error);
+  g_clear_object (&info);
+}
+
+typedef struct {
+  ResolveData *resolve_data;
+  GFile *file;
+} InfoRequest;
+
+typedef struct {
+  GrlLocalMetadataSource *source;
+  GFile *dir;
+  GList *requests;
+  /* Names of the files of the requests */
+  GHashTable *wanted;
+  /* File name -> GFileInfo, for the wanted files listed so far */
+  GHashTable *infos;
+  guint listed;
+} InfoBatch;
+
+static void
+info_request_run (InfoRequest *request)
+{
+  g_file_query_info_async (request->file, INFO_ATTRIBUTES,
+                           G_FILE_QUERY_INFO_NONE, G_PRIORITY_DEFAULT,
+                           resolve_data_ensure_cancellable (request->resolve_data),
+                           (GAsyncReadyCallback) got_file_info,
+                           request->resolve_data);
+  g_object_unref (request->file);
+  g_slice_free (InfoRequest, request);
+}
+
+static void
+info_batch_free (InfoBatch *batch)
+{
+  g_hash_table_destroy (batch->wanted);
+  g_hash_table_destroy (batch->infos);
+  g_object_unref (batch->dir);
+  g_object_unref (batch->source);
+  g_slice_free (InfoBatch, batch);
+}
+
+/* Hands the listed information to each request of @batch. Files missing
+ * from the listing are looked up on their own. */
+static void
+info_batch_done (InfoBatch *batch)
+{
+  GList *l;
+
+  for (l = batch->requests; l != NULL; l = l->next) {
+    InfoRequest *request = l->data;
+    GCancellable *cancellable;
+    GFileInfo *info;
+    gchar *name;
+
+    name = g_file_get_basename (request->file);
+    info = g_hash_table_lookup (batch->infos, name);
+    g_free (name);
+
+    if (info == NULL) {
+      info_request_run (request);
+      continue;
+    }
+
+    cancellable = resolve_data_ensure_cancellable (request->resolve_data);
+    if (g_cancellable_is_cancelled (cancellable)) {
+      GError *error = g_error_new_literal (G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                                           "Operation was cancelled");
+      handle_file_info (request->resolve_data, request->file, NULL, error);
+      g_error_free (error);
+    } else {
+      handle_file_info (request->resolve_data, request->file, info, NULL);
+    }
+
+    g_object_unref (request->file);
+    g_slice_free (InfoRequest, request);
+  }
+
+  g_list_free (batch->requests);
+  info_batch_free (batch);
+}
+
+static void
+info_batch_next_files (GObject      *source_object,
+                       GAsyncResult *result,
+                       gpointer      user_data)
+{
+  GFileEnumerator *enumerator = G_FILE_ENUMERATOR (source_object);
+  InfoBatch *batch = user_data;
+  GError *error = NULL;
+  GList *files, *l;
+
+  files = g_file_enumerator_next_files_finish (enumerator, result, &error);
+  if (error) {
+    GRL_DEBUG ("Could not list directory: %s", error->message);
+    g_error_free (error);
+  }
+
+  for (l = files; l != NULL; l = l->next) {
+    GFileInfo *info = l->data;
+    const gchar *name = g_file_info_get_name (info);
+
+    batch->listed++;
+    if (g_hash_table_contains (batch->wanted, name))
+      g_hash_table_insert (batch->infos, g_strdup (name), info);
+    else
+      g_object_unref (info);
+  }
+
+  if (files != NULL &&
+      g_hash_table_size (batch->infos) < g_hash_table_size (batch->wanted) &&
+      batch->listed < g_hash_table_size (batch->wanted) * INFO_BATCH_LIST_RATIO) {
+    g_list_free (files);
+    g_file_enumerator_next_files_async (enumerator, 256, G_PRIORITY_DEFAULT,
+                                        NULL, info_batch_next_files, batch);
+    return;
+  }
+
+  g_list_free (files);
+
+  g_object_unref (enumerator);
+  info_batch_done (batch);
+}
+
+static void
+info_batch_enumerated (GObject      *source_object,
+                       GAsyncResult *result,
+                       gpointer      user_data)
+{
+  GFileEnumerator *enumerator;
+  InfoBatch *batch = user_data;
+  GError *error = NULL;
+
+  enumerator = g_file_enumerate_children_finish (G_FILE (source_object),
+                                                 result, &error);
+  if (enumerator == NULL) {
+    GRL_DEBUG ("Could not list directory: %s", error->message);
+    g_error_free (error);
+    info_batch_done (batch);
+    return;
+  }
+
+  g_file_enumerator_next_files_async (enumerator, 256, G_PRIORITY_DEFAULT,
+                                      NULL, info_batch_next_files, batch);
+}
+
+static gboolean
+flush_info_requests (gpointer user_data)
+{
+  GrlLocalMetadataSource *source = user_data;
+  GHashTableIter iter;
+  gpointer key, value;
+
+  source->priv->flush_infos_id = 0;
+
+  g_hash_table_iter_init (&iter, source->priv->pending_infos);
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    GList *requests = g_list_reverse (value);
+    InfoBatch *batch;
+    GList *l;
+
+    if (g_list_length (requests) < INFO_BATCH_MIN) {
+      g_list_free_full (requests, (GDestroyNotify) info_request_run);
+      continue;
+    }
+
+    GRL_DEBUG ("Looking up %u files of %s at once",
+               g_list_length (requests), (const gchar *) key);
+
+    batch = g_slice_new0 (InfoBatch);
+    batch->source = g_object_ref (source);
+    batch->dir = g_file_new_for_uri (key);
+    batch->requests = requests;
+    batch->wanted = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                           g_free, NULL);
+    batch->infos = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                          g_free, g_object_unref);
+    for (l = requests; l != NULL; l = l->next) {
+      InfoRequest *request = l->data;
+
+      g_hash_table_add (batch->wanted, g_file_get_basename (request->file));
+    }
+
+    g_file_enumerate_children_async (batch->dir,
+                                     G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                     INFO_ATTRIBUTES,
+                                     G_FILE_QUERY_INFO_NONE,
+                                     G_PRIORITY_DEFAULT, NULL,
+                                     info_batch_enumerated, batch);
+  }
+
+  g_hash_table_remove_all (source->priv->pending_infos);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Looks up the information about @file. Requests made in the same main
+ * loop iteration are grouped by directory. */
+static void
+query_file_info (ResolveData *resolve_data,
+                 GFile       *file)
+{
+  GrlLocalMetadataSource *source;
+  InfoRequest *request;
+  GFile *parent;
+  GList *requests;
+  gchar *dir_uri;
+
+  source = GRL_LOCAL_METADATA_SOURCE (resolve_data->source);
+
+  request = g_slice_new (InfoRequest);
+  request->resolve_data = resolve_data;
+  request->file = g_object_ref (file);
+
+  parent = g_file_get_parent (file);
+  if (parent == NULL) {
+    info_request_run (request);
+    return;
+  }
+
+  dir_uri = g_file_get_uri (parent);
+  g_object_unref (parent);
+
+  requests = g_hash_table_lookup (source->priv->pending_infos, dir_uri);
+  requests = g_list_prepend (requests, request);
+  g_hash_table_insert (source->priv->pending_infos, dir_uri, requests);
+
+  if (source->priv->flush_infos_id == 0)
+    source->priv->flush_infos_id = g_idle_add (flush_info_requests, source);
 }
 
 static void
@@ -395,60 +771,101 @@ resolve_image (ResolveData         *resolve_data,
                resolution_flags_t   flags)
 {
   GFile *file;
-  GCancellable *cancellable;
 
   GRL_DEBUG ("resolve_image");
 
   resolve_data_start_operation (resolve_data, "image");
 
-  if (flags & FLAG_THUMBNAIL) {
-    const gchar *attributes;
-
+  if (flags & (FLAG_THUMBNAIL | FLAG_GIBEST_HASH)) {
     file = g_file_new_for_uri (grl_media_get_url (resolve_data->rs->media));
-
-    cancellable = resolve_data_ensure_cancellable (resolve_data);
-
-    attributes = G_FILE_ATTRIBUTE_THUMBNAIL_PATH "," \
-                 G_FILE_ATTRIBUTE_THUMBNAIL_IS_VALID;
-
-    g_file_query_info_async (file, attributes,
-                             G_FILE_QUERY_INFO_NONE, G_PRIORITY_DEFAULT, cancellable,
-                             (GAsyncReadyCallback)got_file_info, resolve_data);
+    query_file_info (resolve_data, file);
     g_object_unref (file);
   } else {
     resolve_data_finish_operation (resolve_data, "image", NULL);
   }
 }
 
+/* Forgets the known album art files if the media art directory changed
+ * since they were checked */
+static void
+album_art_cache_validate (GrlLocalMetadataSourcePrivate *priv,
+                          GFile                         *cache_file)
+{
+  GStatBuf st;
+  GFile *dir;
+  gchar *path;
+  gint64 now, mtime = 0;
+
+  now = g_get_monotonic_time ();
+  if (now - priv->album_art_checked < ALBUM_ART_CHECK_INTERVAL)
+    return;
+  priv->album_art_checked = now;
+
+  dir = g_file_get_parent (cache_file);
+  path = g_file_get_path (dir);
+  if (path != NULL && g_stat (path, &st) == 0)
+    mtime = st.st_mtime;
+  g_free (path);
+  g_object_unref (dir);
+
+  /* A change within the same second as the last one would not update the
+   * modification time: do not trust it until it is a bit older */
+  if (mtime != priv->album_art_mtime ||
+      mtime >= g_get_real_time () / G_USEC_PER_SEC - 1) {
+    g_hash_table_remove_all (priv->album_art);
+    priv->album_art_mtime = mtime;
+  }
+}
+
 static void
 resolve_album_art_cb (GObject       *source_object,
                       GAsyncResult  *result,
                       gpointer       user_data)
 {
+  GrlLocalMetadataSource *source = user_data;
   GFile *cache_file;
-  ResolveData *resolve_data;
   GFileInfo *info = NULL;
   GError *error = NULL;
+  GList *waiting, *l;
+  gchar *cache_uri;
 
   cache_file = G_FILE (source_object);
-  resolve_data = user_data;
+  cache_uri = g_file_get_uri (cache_file);
 
   info = g_file_query_info_finish (cache_file, result, &error);
 
-  if (info != NULL) {
-    /* Success, the album art exists. */
-    gchar *cache_uri = g_file_get_uri (cache_file);
-    grl_media_set_thumbnail (resolve_data->rs->media, cache_uri);
-    g_free (cache_uri);
-  } else if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND)) {
+  if (info == NULL &&
+      g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND)) {
     /* Ignore G_IO_ERROR_NOT_FOUND. */
     g_clear_error (&error);
   }
 
-  resolve_data_finish_operation (resolve_data, "album-art", error);
+  if (error == NULL) {
+    if (g_hash_table_size (source->priv->album_art) >= ALBUM_ART_CACHE_MAX)
+      g_hash_table_remove_all (source->priv->album_art);
+    g_hash_table_insert (source->priv->album_art, g_strdup (cache_uri),
+                         info != NULL ? ALBUM_ART_FOUND : ALBUM_ART_MISSING);
+  }
 
+  waiting = g_hash_table_lookup (source->priv->pending_album_art, cache_uri);
+  g_hash_table_remove (source->priv->pending_album_art, cache_uri);
+
+  for (l = waiting; l != NULL; l = l->next) {
+    ResolveData *resolve_data = l->data;
+
+    if (info != NULL) {
+      /* Success, the album art exists. */
+      grl_media_set_thumbnail (resolve_data->rs->media, cache_uri);
+    }
+
+    resolve_data_finish_operation (resolve_data, "album-art", error);
+  }
+
+  g_list_free (waiting);
+  g_free (cache_uri);
   g_clear_object (&info);
   g_clear_error (&error);
+  g_object_unref (source);
 }
 
 static void
@@ -456,29 +873,53 @@ resolve_album_art (ResolveData         *resolve_data,
                    resolution_flags_t   flags)
 {
   const gchar *artist, *album;
-  GCancellable *cancellable = NULL;
   GFile *cache_file = NULL;
+  GrlLocalMetadataSource *source;
+  gpointer known;
+  GList *waiting;
+  gchar *cache_uri;
 
   resolve_data_start_operation (resolve_data, "album-art");
 
+  source = GRL_LOCAL_METADATA_SOURCE (resolve_data->source);
   artist = grl_media_get_artist (resolve_data->rs->media);
   album = grl_media_get_album (resolve_data->rs->media);
 
   if (!artist || !album)
     goto done;
 
-  cancellable = resolve_data_ensure_cancellable (resolve_data);
-
   media_art_get_file (artist, album, "album", &cache_file);
 
-  if (cache_file) {
-    /* Check whether the cache file exists. */
-    resolve_data_start_operation (resolve_data, "album-art");
+  if (!cache_file) {
+    GRL_DEBUG ("Found no thumbnail for artist %s and album %s", artist, album);
+    goto done;
+  }
+
+  album_art_cache_validate (source->priv, cache_file);
+  cache_uri = g_file_get_uri (cache_file);
+
+  known = g_hash_table_lookup (source->priv->album_art, cache_uri);
+  if (known != NULL) {
+    if (known == ALBUM_ART_FOUND)
+      grl_media_set_thumbnail (resolve_data->rs->media, cache_uri);
+    g_free (cache_uri);
+    goto done;
+  }
+
+  /* Check whether the cache file exists, once for all the tracks of the
+   * album being resolved. */
+  resolve_data_start_operation (resolve_data, "album-art");
+  if (g_hash_table_lookup_extended (source->priv->pending_album_art, cache_uri,
+                                    NULL, (gpointer *) &waiting)) {
+    waiting = g_list_append (waiting, resolve_data);
+    g_hash_table_insert (source->priv->pending_album_art, cache_uri, waiting);
+  } else {
+    waiting = g_list_append (NULL, resolve_data);
+    g_hash_table_insert (source->priv->pending_album_art, cache_uri, waiting);
     g_file_query_info_async (cache_file, G_FILE_ATTRIBUTE_ACCESS_CAN_READ,
                              G_FILE_QUERY_INFO_NONE, G_PRIORITY_DEFAULT,
-                             cancellable, resolve_album_art_cb, resolve_data);
-  } else {
-    GRL_DEBUG ("Found no thumbnail for artist %s and album %s", artist, album);
+                             NULL, resolve_album_art_cb,
+                             g_object_ref (source));
   }
 
 done:
@@ -24,14 +24,17 @@
 #include "config.h"
 #endif
 
+#include <errno.h>
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <glib/gi18n-lib.h>
 #include <grilo.h>
 #include <sqlite3.h>
+#include <libsoup/soup.h>
 #include <net/grl-net.h>
 
 #include "grl-magnatune.h"
+#include "grl-fts-match.h"
 
 /* --------- Logging  -------- */
 
@@ -48,39 +51,51 @@ GRL_LOG_DOMAIN_STATIC(magnatune_log_domain);
     "ON (alb.album_id = son.album_id) "                         \
   "LEFT OUTER JOIN artists art "                                \
     "ON (art.artists_id = alb.artist_id) "                      \
-  "WHERE (art.name like '%%%s%%') "                             \
-    "OR (alb.name like '%%%s%%') "                              \
-    "OR (son.name like '%%%s%%') "                              \
-    "LIMIT %u OFFSET %u"
+  "WHERE (art.name like ?) "                                    \
+    "OR (alb.name like ?) "                                     \
+    "OR (son.name like ?) "                                     \
+    "LIMIT ? OFFSET ?"
+
+#define GRL_SQL_SONGS_QUERY_FTS                                 \
+  "SELECT DISTINCT son.song_id, art.name, alb.name, son.name, " \
+    "son.track_no, son.duration, son.mp3 "                      \
+  "FROM songs son "                                             \
+  "LEFT OUTER JOIN albums alb "                                 \
+    "ON (alb.album_id = son.album_id) "                         \
+  "LEFT OUTER JOIN artists art "                                \
+    "ON (art.artists_id = alb.artist_id) "                      \
+  "WHERE son.rowid IN "                                         \
+    "(SELECT rowid FROM songs_fts WHERE songs_fts MATCH ?) "    \
+    "LIMIT ? OFFSET ?"
 
 #define GRL_SQL_ARTISTS_QUERY_ALL                               \
   "SELECT DISTINCT art.artists_id, art.name "                   \
   "FROM artists art "                                           \
-    "LIMIT %u OFFSET %u"
+    "LIMIT ? OFFSET ?"
 
 #define GRL_SQL_ALBUMS_QUERY_ALL                                \
   "SELECT DISTINCT alb.album_id, alb.name "                     \
   "FROM albums alb "                                            \
-    "LIMIT %u OFFSET %u"
+    "LIMIT ? OFFSET ?"
 
 #define GRL_SQL_GENRES_QUERY_ALL                                \
   "SELECT DISTINCT gen.genre_id, gen.name "                     \
   "FROM genres gen "                                            \
-    "LIMIT %u OFFSET %u"
+    "LIMIT ? OFFSET ?"
 
 #define GRL_SQL_ALBUMS_BY_GENRE                                 \
   "SELECT DISTINCT alb.album_id, alb.name "                     \
   "FROM albums alb "                                            \
   "LEFT OUTER JOIN genres_albums genalb "                       \
     "ON (alb.album_id = genalb.album_id) "                      \
-  "WHERE (genalb.genre_id = %u) "                               \
-    "LIMIT %u OFFSET %u"
+  "WHERE (genalb.genre_id = ?) "                                \
+    "LIMIT ? OFFSET ?"
 
 #define GRL_SQL_ALBUMS_BY_ARTIST                                \
   "SELECT DISTINCT alb.album_id, alb.name "                     \
   "FROM albums alb "                                            \
-  "WHERE (alb.artist_id = %u) "                                 \
-    "LIMIT %u OFFSET %u"
+  "WHERE (alb.artist_id = ?) "                                  \
+    "LIMIT ? OFFSET ?"
 
 #define GRL_SQL_SONGS_BY_ALBUM                                  \
   "SELECT DISTINCT son.song_id, art.name, alb.name, son.name, " \
@@ -90,8 +105,54 @@ GRL_LOG_DOMAIN_STATIC(magnatune_log_domain);
     "ON (alb.album_id = son.album_id) "                         \
   "LEFT OUTER JOIN artists art "                                \
     "ON (art.artists_id = alb.artist_id) "                      \
-  "WHERE (alb.album_id = %u) "                                  \
-    "LIMIT %u OFFSET %u"
+  "WHERE (alb.album_id = ?) "                                   \
+    "LIMIT ? OFFSET ?"
+
+/* Built once for each downloaded catalog. grl_indexes records that they
+   were, and whether the full-text index could be built too */
+#define GRL_SQL_BUILD_INDEXES                                   \
+  "BEGIN TRANSACTION; "                                         \
+  "CREATE INDEX IF NOT EXISTS grl_songs_album_idx "             \
+    "ON songs (album_id); "                                     \
+  "CREATE INDEX IF NOT EXISTS grl_albums_artist_idx "           \
+    "ON albums (artist_id); "                                   \
+  "CREATE INDEX IF NOT EXISTS grl_genres_albums_genre_idx "     \
+    "ON genres_albums (genre_id); "                             \
+  "DROP TABLE IF EXISTS grl_indexes; "                          \
+  "CREATE TABLE grl_indexes (fts INTEGER NOT NULL); "           \
+  "INSERT INTO grl_indexes (fts) VALUES (0); "                  \
+  "COMMIT TRANSACTION"
+
+/* Fails on SQLite builds without FTS5 or its trigram tokenizer, leaving
+   searches to LIKE */
+#define GRL_SQL_BUILD_FTS                                       \
+  "BEGIN TRANSACTION; "                                         \
+  "DROP TABLE IF EXISTS songs_fts; "                            \
+  "CREATE VIRTUAL TABLE songs_fts "                             \
+    "USING fts5 (artist, album, song, "                         \
+    GRL_FTS_TOKENIZE "); "                                      \
+  "INSERT INTO songs_fts (rowid, artist, album, song) "         \
+    "SELECT son.rowid, art.name, alb.name, son.name "           \
+    "FROM songs son "                                           \
+    "LEFT OUTER JOIN albums alb "                               \
+      "ON (alb.album_id = son.album_id) "                       \
+    "LEFT OUTER JOIN artists art "                              \
+      "ON (art.artists_id = alb.artist_id); "                   \
+  "UPDATE grl_indexes SET fts = 1; "                            \
+  "COMMIT TRANSACTION"
+
+#define GRL_SQL_QUICK_CHECK                                     \
+  "PRAGMA quick_check"
+
+#define GRL_SQL_CHECK_INDEXES                                   \
+  "SELECT fts FROM grl_indexes"
+
+/* The catalog is only read, so map it instead of copying it into the
+   page cache */
+#define GRL_SQL_MMAP_SIZE                                       \
+  "PRAGMA mmap_size=268435456"
+
+#define DB_BUSY_TIMEOUT 5000
 
 /* --- Files --- */
 
@@ -100,6 +161,10 @@ GRL_LOG_DOMAIN_STATIC(magnatune_log_domain);
 #define GRL_SQL_CRC     "grl-magnatune-db.crc"
 #define GRL_SQL_NEW_CRC "grl-magnatune-new.crc"
 
+/* Download in progress, and the validator it can be resumed against */
+#define GRL_SQL_PART_DB  "grl-magnatune-new.db.part"
+#define GRL_SQL_PART_TAG "grl-magnatune-new.db.tag"
+
 /* --- URLs --- */
 
 #define URL_GET_DB     "http://he3.magnatune.com/info/sqlite_normalized.db"
@@ -147,8 +212,39 @@ typedef enum {
   MAGNATUNE_NUM_CAT,
 } MagnatuneCategory;
 
+typedef enum {
+  MAGNATUNE_STMT_ARTISTS_ALL,
+  MAGNATUNE_STMT_ALBUMS_ALL,
+  MAGNATUNE_STMT_GENRES_ALL,
+  MAGNATUNE_STMT_ALBUMS_BY_GENRE,
+  MAGNATUNE_STMT_ALBUMS_BY_ARTIST,
+  MAGNATUNE_STMT_SONGS_BY_ALBUM,
+  MAGNATUNE_STMT_SONGS_SEARCH,
+  MAGNATUNE_STMT_SONGS_SEARCH_FTS,
+  MAGNATUNE_NUM_STMT,
+} MagnatuneStmt;
+
+static const gchar *magnatune_stmt_sql[MAGNATUNE_NUM_STMT] = {
+  [MAGNATUNE_STMT_ARTISTS_ALL] = GRL_SQL_ARTISTS_QUERY_ALL,
+  [MAGNATUNE_STMT_ALBUMS_ALL] = GRL_SQL_ALBUMS_QUERY_ALL,
+  [MAGNATUNE_STMT_GENRES_ALL] = GRL_SQL_GENRES_QUERY_ALL,
+  [MAGNATUNE_STMT_ALBUMS_BY_GENRE] = GRL_SQL_ALBUMS_BY_GENRE,
+  [MAGNATUNE_STMT_ALBUMS_BY_ARTIST] = GRL_SQL_ALBUMS_BY_ARTIST,
+  [MAGNATUNE_STMT_SONGS_BY_ALBUM] = GRL_SQL_SONGS_BY_ALBUM,
+  [MAGNATUNE_STMT_SONGS_SEARCH] = GRL_SQL_SONGS_QUERY_ALL,
+  [MAGNATUNE_STMT_SONGS_SEARCH_FTS] = GRL_SQL_SONGS_QUERY_FTS,
+};
+
 struct _GrlMagnatunePrivate {
   sqlite3 *db;
+  /* Prepared once per connection, reset after each use */
+  sqlite3_stmt *stmts[MAGNATUNE_NUM_STMT];
+  gboolean has_fts;
+  /* Indexing a copy of the catalog opened without indexes */
+  GTask *index_task;
+  /* Operations waiting for the catalog to be downloaded */
+  GList *pending_ops;
+  gboolean downloading;
 };
 
 struct _OperationSpec;
@@ -172,6 +268,16 @@ typedef struct _OperationSpec OperationSpec;
 
 typedef GrlMedia* (MagnatuneBuildMediaFn)(sqlite3_stmt *);
 
+typedef struct {
+  GrlMagnatuneSource *source;
+  SoupSession *session;
+  SoupMessage *msg;
+  gchar *part_path;
+  gchar *tag_path;
+  goffset offset;
+  goffset expected;
+} MagnatuneDownload;
+
 static GrlMagnatuneSource *grl_magnatune_source_new(void);
 
 static void grl_magnatune_source_finalize(GObject *object);
@@ -184,7 +290,13 @@ static void grl_magnatune_source_search(GrlSource *source,
 static void grl_magnatune_source_browse(GrlSource *source,
                                         GrlSourceBrowseSpec *bs);
 
-static void magnatune_get_db_async(OperationSpec *os);
+static void magnatune_get_db_async(GrlMagnatuneSource *source,
+                                   OperationSpec *os);
+
+static gboolean magnatune_open_db(GrlMagnatuneSource *source,
+                                  const gchar *db_path);
+
+static void magnatune_close_db(GrlMagnatuneSource *source);
 
 /* ================== Magnatune Plugin  ================= */
 
@@ -265,7 +377,6 @@ grl_magnatune_source_class_init(GrlMagnatuneSourceClass * klass)
 static void
 grl_magnatune_source_init(GrlMagnatuneSource *source)
 {
-  gint ret;
   gchar *path;
   gchar *db_path;
   gchar *crc_path;
@@ -298,15 +409,7 @@ grl_magnatune_source_init(GrlMagnatuneSource *source)
         GRL_DEBUG("New crc file in use.");
     }
 
-    GRL_DEBUG("Opening database connection.");
-    ret = sqlite3_open(db_path, &source->priv->db);
-    if (ret != SQLITE_OK) {
-      GRL_WARNING("Failed to open database '%s': %s",
-                  db_path,
-                  sqlite3_errmsg(source->priv->db));
-      sqlite3_close(source->priv->db);
-      source->priv->db = NULL;
-    }
+    magnatune_open_db(source, db_path);
   } else {
     GRL_DEBUG("No database was found. Download when user interact.");
   }
@@ -327,15 +430,229 @@ grl_magnatune_source_finalize(GObject *object)
 
   source = GRL_MAGNATUNE_SOURCE(object);
 
-  if (source->priv->db != NULL) {
-    sqlite3_close(source->priv->db);
-  }
+  magnatune_close_db(source);
 
   G_OBJECT_CLASS(grl_magnatune_source_parent_class)->finalize(object);
 }
 
 /* ======================= Utilities ==================== */
 
+static gboolean
+magnatune_build_indexes(const gchar *db_path)
+{
+  sqlite3 *db = NULL;
+  gchar *sql_error = NULL;
+  gint64 start;
+  gint ret;
+
+  GRL_DEBUG("Building indexes of '%s'", db_path);
+  start = g_get_monotonic_time();
+
+  ret = sqlite3_open_v2(db_path, &db, SQLITE_OPEN_READWRITE, NULL);
+  if (ret == SQLITE_OK) {
+    sqlite3_busy_timeout(db, DB_BUSY_TIMEOUT);
+    ret = sqlite3_exec(db, GRL_SQL_BUILD_INDEXES, NULL, NULL, &sql_error);
+  }
+
+  if (ret != SQLITE_OK) {
+    GRL_WARNING("Failed to build indexes of '%s': %s",
+                db_path,
+                sql_error ? sql_error : sqlite3_errmsg(db));
+    g_clear_pointer(&sql_error, sqlite3_free);
+    if (db != NULL)
+      sqlite3_exec(db, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+    sqlite3_close(db);
+    return FALSE;
+  }
+
+  /* Without full-text index, grl_indexes keeps fts at 0 */
+  if (sqlite3_exec(db, GRL_SQL_BUILD_FTS, NULL, NULL, &sql_error) != SQLITE_OK) {
+    GRL_DEBUG("No full-text index for '%s', searches use LIKE: %s",
+              db_path, sql_error ? sql_error : sqlite3_errmsg(db));
+    g_clear_pointer(&sql_error, sqlite3_free);
+    sqlite3_exec(db, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+  }
+
+  GRL_DEBUG("Indexes built in %" G_GINT64_FORMAT " ms",
+            (g_get_monotonic_time() - start) / 1000);
+
+  sqlite3_close(db);
+
+  return TRUE;
+}
+
+typedef struct {
+  gchar *db_path;
+  gchar *copy_path;
+} MagnatuneIndexJob;
+
+static void
+magnatune_index_job_free(MagnatuneIndexJob *job)
+{
+  g_free(job->db_path);
+  g_free(job->copy_path);
+  g_slice_free(MagnatuneIndexJob, job);
+}
+
+static void
+magnatune_build_index_thread(GTask *task,
+                             gpointer source_object,
+                             gpointer task_data,
+                             GCancellable *cancellable)
+{
+  MagnatuneIndexJob *job = task_data;
+  GFile *src;
+  GFile *dst;
+  GError *err = NULL;
+
+  /* The catalog in use is only read: the indexes are built into a copy,
+     swapped in from the main thread once done */
+  src = g_file_new_for_path(job->db_path);
+  dst = g_file_new_for_path(job->copy_path);
+  g_file_copy(src, dst, G_FILE_COPY_OVERWRITE, cancellable,
+              NULL, NULL, &err);
+  g_object_unref(src);
+  g_object_unref(dst);
+
+  if (err != NULL) {
+    g_task_return_error(task, err);
+    return;
+  }
+
+  if (!magnatune_build_indexes(job->copy_path)) {
+    g_unlink(job->copy_path);
+    g_task_return_new_error(task,
+                            G_IO_ERROR,
+                            G_IO_ERROR_FAILED,
+                            "Failed to build indexes of '%s'",
+                            job->copy_path);
+    return;
+  }
+
+  g_task_return_boolean(task, TRUE);
+}
+
+static void
+magnatune_build_index_done(GObject *object,
+                           GAsyncResult *res,
+                           gpointer user_data)
+{
+  GrlMagnatuneSource *source = GRL_MAGNATUNE_SOURCE(object);
+  MagnatuneIndexJob *job = g_task_get_task_data(G_TASK(res));
+  gint saved_errno;
+  GError *err = NULL;
+
+  if (!g_task_propagate_boolean(G_TASK(res), &err)) {
+    GRL_WARNING("Failed to index the catalog: %s", err->message);
+    g_error_free(err);
+    if (source->priv->index_task == G_TASK(res))
+      source->priv->index_task = NULL;
+    return;
+  }
+
+  /* A new catalog was opened meanwhile, the copy is outdated */
+  if (source->priv->index_task != G_TASK(res)) {
+    g_unlink(job->copy_path);
+    return;
+  }
+  source->priv->index_task = NULL;
+
+  /* The rename is atomic: the current connection keeps reading the old
+     catalog until it is reopened below */
+  if (g_rename(job->copy_path, job->db_path) != 0) {
+    saved_errno = errno;
+    GRL_WARNING("Failed to replace '%s': %s",
+                job->db_path, g_strerror(saved_errno));
+    g_unlink(job->copy_path);
+    return;
+  }
+
+  GRL_DEBUG("Catalog indexes ready.");
+  magnatune_close_db(source);
+  magnatune_open_db(source, job->db_path);
+}
+
+static gboolean
+magnatune_open_db(GrlMagnatuneSource *source, const gchar *db_path)
+{
+  sqlite3_stmt *sql_stmt = NULL;
+  MagnatuneIndexJob *job;
+  GTask *task;
+
+  GRL_DEBUG("Opening database connection.");
+  if (sqlite3_open_v2(db_path,
+                      &source->priv->db,
+                      SQLITE_OPEN_READONLY,
+                      NULL) != SQLITE_OK) {
+    GRL_WARNING("Failed to open database '%s': %s",
+                db_path,
+                sqlite3_errmsg(source->priv->db));
+    sqlite3_close(source->priv->db);
+    source->priv->db = NULL;
+    return FALSE;
+  }
+
+  sqlite3_exec(source->priv->db, GRL_SQL_MMAP_SIZE, NULL, NULL, NULL);
+  sqlite3_busy_timeout(source->priv->db, DB_BUSY_TIMEOUT);
+
+  /* A catalog without indexes gets them built once, in a thread.
+     Meanwhile, or if SQLite has no FTS5, searches use the LIKE query */
+  if (sqlite3_prepare_v2(source->priv->db, GRL_SQL_CHECK_INDEXES, -1,
+                         &sql_stmt, NULL) == SQLITE_OK &&
+      sqlite3_step(sql_stmt) == SQLITE_ROW) {
+    source->priv->has_fts = sqlite3_column_int(sql_stmt, 0) != 0;
+  } else {
+    job = g_slice_new0(MagnatuneIndexJob);
+    job->db_path = g_strdup(db_path);
+    job->copy_path = g_strconcat(db_path, ".index", NULL);
+
+    task = g_task_new(source, NULL, magnatune_build_index_done, NULL);
+    g_task_set_task_data(task, job, (GDestroyNotify) magnatune_index_job_free);
+    source->priv->index_task = task;
+    g_task_run_in_thread(task, magnatune_build_index_thread);
+    g_object_unref(task);
+  }
+  sqlite3_finalize(sql_stmt);
+
+  return TRUE;
+}
+
+static void
+magnatune_close_db(GrlMagnatuneSource *source)
+{
+  gint i;
+
+  for (i = 0; i < MAGNATUNE_NUM_STMT; i++)
+    g_clear_pointer(&source->priv->stmts[i], sqlite3_finalize);
+
+  g_clear_pointer(&source->priv->db, sqlite3_close);
+  source->priv->has_fts = FALSE;
+  /* An index built for the closed catalog must not replace the next one */
+  source->priv->index_task = NULL;
+}
+
+static sqlite3_stmt *
+magnatune_get_stmt(OperationSpec *os, MagnatuneStmt stmt_id, GError **error)
+{
+  GrlMagnatuneSource *source = GRL_MAGNATUNE_SOURCE(os->source);
+  sqlite3_stmt **sql_stmt = &source->priv->stmts[stmt_id];
+
+  if (*sql_stmt == NULL
+      && sqlite3_prepare_v2(source->priv->db, magnatune_stmt_sql[stmt_id], -1,
+                            sql_stmt, NULL) != SQLITE_OK) {
+    *error = g_error_new(GRL_CORE_ERROR,
+                         os->error_code,
+                         _("Failed to get table from magnatune db: %s"),
+                         sqlite3_errmsg(source->priv->db));
+    g_clear_pointer(sql_stmt, sqlite3_finalize);
+    return NULL;
+  }
+
+  sqlite3_clear_bindings(*sql_stmt);
+
+  return *sql_stmt;
+}
+
 static void
 magnatune_get_crc_done(GObject *source_object,
                        GAsyncResult *res,
@@ -390,108 +707,382 @@ magnatune_get_crc_async(void)
                            NULL);
 }
 
+static SoupMessageHeaders *
+magnatune_request_headers(SoupMessage *msg)
+{
+#if SOUP_CHECK_VERSION(2, 99, 1)
+  return soup_message_get_request_headers(msg);
+#else
+  return msg->request_headers;
+#endif
+}
+
+static SoupMessageHeaders *
+magnatune_response_headers(SoupMessage *msg)
+{
+#if SOUP_CHECK_VERSION(2, 99, 1)
+  return soup_message_get_response_headers(msg);
+#else
+  return msg->response_headers;
+#endif
+}
+
+static guint
+magnatune_status(SoupMessage *msg)
+{
+#if SOUP_CHECK_VERSION(2, 99, 1)
+  return soup_message_get_status(msg);
+#else
+  return msg->status_code;
+#endif
+}
+
 static void
-magnatune_get_db_done(GObject *source_object,
-                      GAsyncResult *res,
-                      gpointer user_data)
+magnatune_download_free(MagnatuneDownload *dl)
 {
-  gchar *db_path = NULL;
-  gchar *new_db_path = NULL;
-  gchar *content = NULL;
-  gsize length = 0;
-  gboolean ret = FALSE;
-  gboolean first_run = FALSE;
-  GError *err = NULL;
-  GError *err_fn = NULL;
-  OperationSpec *os = NULL;
-  GrlMagnatuneSource *source = NULL;
+  g_clear_object(&dl->msg);
+  g_clear_object(&dl->session);
+  g_object_unref(dl->source);
+  g_free(dl->part_path);
+  g_free(dl->tag_path);
+  g_slice_free(MagnatuneDownload, dl);
+}
+
+static void
+magnatune_get_db_done(MagnatuneDownload *dl, GError *error)
+{
+  GrlMagnatuneSource *source = dl->source;
+  OperationSpec *os;
+  GList *ops;
+  GList *l;
+  GError *err;
 
   GRL_DEBUG("magnatune_get_db_done");
-  os = (OperationSpec *) user_data;
-  ret = grl_net_wc_request_finish(GRL_NET_WC(source_object),
-                                  res,
-                                  &content,
-                                  &length,
-                                  &err_fn);
-  g_object_unref(source_object);
 
-  if (ret == FALSE) {
+  if (error != NULL)
+    GRL_WARNING("Failed to get database from magnatune: %s", error->message);
+
+  ops = g_list_reverse(source->priv->pending_ops);
+  source->priv->pending_ops = NULL;
+  source->priv->downloading = FALSE;
+
+  for (l = ops; l; l = l->next) {
+    os = l->data;
+
+    if (error == NULL) {
+      /* execute application's request */
+      os->magnatune_cb(os);
+      continue;
+    }
+
     err = g_error_new(GRL_CORE_ERROR,
                       GRL_CORE_ERROR_MEDIA_NOT_FOUND,
                       _("Failed to get database from magnatune: %s"),
-                      err_fn->message);
-    g_error_free(err_fn);
+                      error->message);
+    os->callback(os->source, os->operation_id, NULL, 0, os->user_data, err);
+    g_error_free(err);
+    g_slice_free(OperationSpec, os);
+  }
+
+  g_list_free(ops);
+  g_clear_error(&error);
+  magnatune_download_free(dl);
+}
+
+static void
+magnatune_verify_db_thread(GTask *task,
+                           gpointer source_object,
+                           gpointer task_data,
+                           GCancellable *cancellable)
+{
+  const gchar *part_path = task_data;
+  sqlite3 *db = NULL;
+  sqlite3_stmt *sql_stmt = NULL;
+  gboolean ok = FALSE;
+
+  /* A truncated or mangled file would fail the check, and a file that is
+     not the catalog would fail to prepare the queries */
+  if (sqlite3_open_v2(part_path, &db, SQLITE_OPEN_READONLY, NULL) == SQLITE_OK
+      && sqlite3_prepare_v2(db, GRL_SQL_QUICK_CHECK, -1,
+                            &sql_stmt, NULL) == SQLITE_OK
+      && sqlite3_step(sql_stmt) == SQLITE_ROW) {
+    ok = g_strcmp0((const gchar *) sqlite3_column_text(sql_stmt, 0),
+                   "ok") == 0;
+  }
+  g_clear_pointer(&sql_stmt, sqlite3_finalize);
+
+  if (ok) {
+    ok = sqlite3_prepare_v2(db, GRL_SQL_SONGS_QUERY_ALL, -1,
+                            &sql_stmt, NULL) == SQLITE_OK;
+    sqlite3_finalize(sql_stmt);
+  }
+  sqlite3_close(db);
+
+  if (!ok) {
+    g_task_return_new_error(task,
+                            G_IO_ERROR,
+                            G_IO_ERROR_INVALID_DATA,
+                            "Downloaded database is corrupted");
+    return;
+  }
+
+  /* Index before the swap, so the new catalog is searchable right away */
+  magnatune_build_indexes(part_path);
+
+  g_task_return_boolean(task, TRUE);
+}
+
+static void
+magnatune_verify_db_done(GObject *source_object,
+                         GAsyncResult *res,
+                         gpointer user_data)
+{
+  MagnatuneDownload *dl = user_data;
+  GrlMagnatuneSource *source = dl->source;
+  gchar *db_path;
+  gchar *crc_path;
+  gchar *new_crc_path;
+  gint saved_errno;
+  GError *err = NULL;
 
-    if (os != NULL)
-      os->callback(os->source, os->operation_id, NULL, 0, os->user_data, err);
+  GRL_DEBUG("magnatune_verify_db_done");
+
+  if (!g_task_propagate_boolean(G_TASK(res), &err)) {
+    /* Resuming would only append to broken data */
+    g_unlink(dl->part_path);
+    g_unlink(dl->tag_path);
+    magnatune_get_db_done(dl, err);
+    return;
+  }
 
+  db_path = g_build_filename(g_get_user_data_dir(), "grilo-plugins",
+                             GRL_SQL_DB, NULL);
+  crc_path = g_build_filename(g_get_user_data_dir(), "grilo-plugins",
+                              GRL_SQL_CRC, NULL);
+  new_crc_path = g_build_filename(g_get_user_data_dir(), "grilo-plugins",
+                                  GRL_SQL_NEW_CRC, NULL);
+
+  /* The rename is atomic: the current connection keeps reading the old
+     catalog until it is reopened below */
+  if (g_rename(dl->part_path, db_path) != 0) {
+    saved_errno = errno;
+    err = g_error_new(G_IO_ERROR,
+                      g_io_error_from_errno(saved_errno),
+                      "%s", g_strerror(saved_errno));
   } else {
-    db_path = g_build_filename(g_get_user_data_dir(), "grilo-plugins",
-                               GRL_SQL_DB, NULL);
+    GRL_DEBUG("New database in use.");
+    g_unlink(dl->tag_path);
 
-    /* If this is a first run, new database must be ready to use */
-    if (g_file_test(db_path, G_FILE_TEST_EXISTS) == FALSE) {
-      new_db_path = db_path;
-      first_run = TRUE;
-    } else {
-      g_free(db_path);
-      new_db_path = g_build_filename(g_get_user_data_dir(), "grilo-plugins",
-                                     GRL_SQL_NEW_DB, NULL);
+    if (g_file_test(new_crc_path, G_FILE_TEST_EXISTS) == TRUE
+        && g_rename(new_crc_path, crc_path) == 0) {
+      GRL_DEBUG("New crc file in use.");
     }
 
-    GRL_WARNING("Saving database to path '%s'", new_db_path);
-    ret = g_file_set_contents(new_db_path,
-                              content,
-                              length,
-                              &err_fn);
-
-    if (ret == FALSE) {
-      err = g_error_new(GRL_CORE_ERROR,
-                        GRL_CORE_ERROR_MEDIA_NOT_FOUND,
-                        _("Failed to save database from magnatune: “%s”"),
-                        err_fn->message);
-      g_error_free(err_fn);
-
-      if (os != NULL)
-        os->callback(os->source, os->operation_id, NULL, 0, os->user_data, err);
-
-    } else if (first_run == TRUE) {
-      source = GRL_MAGNATUNE_SOURCE(os->source);
-
-      if (source->priv->db == NULL) {
-        GRL_DEBUG("Opening database connection.");
-        if (sqlite3_open(db_path, &source->priv->db) != SQLITE_OK) {
-          GRL_WARNING("Failed to open database '%s': %s",
-                      db_path,
-                      sqlite3_errmsg(source->priv->db));
-          sqlite3_close(source->priv->db);
-          source->priv->db = NULL;
-        }
-      }
+    magnatune_close_db(source);
+    if (!magnatune_open_db(source, db_path)) {
+      err = g_error_new(G_IO_ERROR,
+                        G_IO_ERROR_FAILED,
+                        "Failed to open database '%s'",
+                        db_path);
     }
+  }
+
+  g_free(new_crc_path);
+  g_free(crc_path);
+  g_free(db_path);
+
+  magnatune_get_db_done(dl, err);
+}
+
+static void
+magnatune_verify_db(MagnatuneDownload *dl)
+{
+  GTask *task;
+
+  GRL_DEBUG("magnatune_verify_db");
+
+  task = g_task_new(dl->source, NULL, magnatune_verify_db_done, dl);
+  g_task_set_task_data(task, g_strdup(dl->part_path), g_free);
+  g_task_run_in_thread(task, magnatune_verify_db_thread);
+  g_object_unref(task);
+}
+
+static void
+magnatune_get_db_spliced(GObject *source_object,
+                         GAsyncResult *res,
+                         gpointer user_data)
+{
+  MagnatuneDownload *dl = user_data;
+  gssize written;
+  GError *err = NULL;
+
+  GRL_DEBUG("magnatune_get_db_spliced");
 
-    g_free(new_db_path);
+  /* What was written so far stays on disk, to be resumed next time */
+  written = g_output_stream_splice_finish(G_OUTPUT_STREAM(source_object),
+                                          res,
+                                          &err);
+  if (written < 0) {
+    magnatune_get_db_done(dl, err);
+    return;
   }
 
-  if (ret == TRUE && os != NULL) {
-    /* execute application's request */
-    os->magnatune_cb(os);
+  if (dl->expected > 0 && written != dl->expected) {
+    err = g_error_new(G_IO_ERROR,
+                      G_IO_ERROR_PARTIAL_INPUT,
+                      "Got %" G_GSSIZE_FORMAT " of %" G_GOFFSET_FORMAT " bytes",
+                      written, dl->expected);
+    magnatune_get_db_done(dl, err);
+    return;
   }
+
+  GRL_DEBUG("Database downloaded, %" G_GOFFSET_FORMAT " bytes",
+            dl->offset + written);
+  magnatune_verify_db(dl);
 }
 
 static void
-magnatune_get_db_async(OperationSpec *os)
+magnatune_get_db_sent(GObject *source_object,
+                      GAsyncResult *res,
+                      gpointer user_data)
 {
-  GrlNetWc *wc = NULL;
+  MagnatuneDownload *dl = user_data;
+  SoupMessageHeaders *headers;
+  GInputStream *in;
+  GOutputStream *out = NULL;
+  GFile *file;
+  const gchar *tag;
+  guint status;
+  GError *err = NULL;
+
+  GRL_DEBUG("magnatune_get_db_sent");
+
+  in = soup_session_send_finish(SOUP_SESSION(source_object), res, &err);
+  if (in == NULL) {
+    magnatune_get_db_done(dl, err);
+    return;
+  }
+
+  status = magnatune_status(dl->msg);
+  headers = magnatune_response_headers(dl->msg);
+  file = g_file_new_for_path(dl->part_path);
+
+  if (status == SOUP_STATUS_PARTIAL_CONTENT && dl->offset > 0) {
+    GRL_DEBUG("Resuming database download at %" G_GOFFSET_FORMAT " bytes",
+              dl->offset);
+    out = G_OUTPUT_STREAM(g_file_append_to(file, G_FILE_CREATE_NONE,
+                                           NULL, &err));
+
+  } else if (status == SOUP_STATUS_OK) {
+    /* Starting over, remember what the download can be resumed against.
+       Weak entity tags can not be used in If-Range */
+    dl->offset = 0;
+    tag = soup_message_headers_get_one(headers, "ETag");
+    if (tag == NULL || g_str_has_prefix(tag, "W/"))
+      tag = soup_message_headers_get_one(headers, "Last-Modified");
+
+    g_unlink(dl->tag_path);
+    if (tag != NULL)
+      g_file_set_contents(dl->tag_path, tag, -1, NULL);
+
+    out = G_OUTPUT_STREAM(g_file_replace(file, NULL, FALSE,
+                                         G_FILE_CREATE_NONE, NULL, &err));
+
+  } else if (status == SOUP_STATUS_REQUESTED_RANGE_NOT_SATISFIABLE
+             && dl->offset > 0) {
+    /* Nothing left to get, the file was complete already */
+    g_object_unref(in);
+    g_object_unref(file);
+    magnatune_verify_db(dl);
+    return;
+
+  } else {
+    err = g_error_new(G_IO_ERROR,
+                      G_IO_ERROR_FAILED,
+                      "Unexpected HTTP status %u",
+                      status);
+  }
+  g_object_unref(file);
+
+  if (out == NULL) {
+    g_object_unref(in);
+    magnatune_get_db_done(dl, err);
+    return;
+  }
+
+  if (soup_message_headers_get_encoding(headers) == SOUP_ENCODING_CONTENT_LENGTH)
+    dl->expected = soup_message_headers_get_content_length(headers);
+
+  /* Stream the catalog to disk as it arrives */
+  g_output_stream_splice_async(out,
+                               in,
+                               G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE |
+                               G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                               G_PRIORITY_LOW,
+                               NULL,
+                               magnatune_get_db_spliced,
+                               dl);
+  g_object_unref(out);
+  g_object_unref(in);
+}
+
+static void
+magnatune_get_db_async(GrlMagnatuneSource *source, OperationSpec *os)
+{
+  MagnatuneDownload *dl;
+  SoupMessageHeaders *headers;
+  GStatBuf file_st;
+  gchar *tag = NULL;
 
   GRL_DEBUG("magnatune_get_db_async");
 
-  wc = grl_net_wc_new();
-  grl_net_wc_request_async(wc,
-                           URL_GET_DB,
-                           NULL,
-                           magnatune_get_db_done,
-                           os);
+  if (os != NULL)
+    source->priv->pending_ops = g_list_prepend(source->priv->pending_ops, os);
+
+  /* Only one download at a time, the others wait for it */
+  if (source->priv->downloading)
+    return;
+
+  source->priv->downloading = TRUE;
+
+  if (source->priv->db == NULL)
+    magnatune_get_crc_async();
+
+  dl = g_slice_new0(MagnatuneDownload);
+  dl->source = g_object_ref(source);
+  dl->part_path = g_build_filename(g_get_user_data_dir(), "grilo-plugins",
+                                   GRL_SQL_PART_DB, NULL);
+  dl->tag_path = g_build_filename(g_get_user_data_dir(), "grilo-plugins",
+                                  GRL_SQL_PART_TAG, NULL);
+
+  dl->session = soup_session_new();
+  dl->msg = soup_message_new("GET", URL_GET_DB);
+  headers = magnatune_request_headers(dl->msg);
+
+  /* Resume a previous download, unless the catalog changed since then */
+  if (g_stat(dl->part_path, &file_st) == 0
+      && file_st.st_size > 0
+      && g_file_get_contents(dl->tag_path, &tag, NULL, NULL)) {
+    dl->offset = file_st.st_size;
+    soup_message_headers_set_range(headers, dl->offset, -1);
+    soup_message_headers_replace(headers, "If-Range", tag);
+    g_free(tag);
+  }
+
+#if SOUP_CHECK_VERSION(2, 99, 1)
+  soup_session_send_async(dl->session,
+                          dl->msg,
+                          G_PRIORITY_DEFAULT,
+                          NULL,
+                          magnatune_get_db_sent,
+                          dl);
+#else
+  soup_session_send_async(dl->session,
+                          dl->msg,
+                          NULL,
+                          magnatune_get_db_sent,
+                          dl);
+#endif
 }
 
 static void
@@ -499,6 +1090,7 @@ magnatune_check_update_done(GObject *source_object,
                             GAsyncResult *res,
                             gpointer user_data)
 {
+  GrlMagnatuneSource *source = GRL_MAGNATUNE_SOURCE(user_data);
   gchar *crc_path = NULL;
   gchar *new_crc_path = NULL;
   gchar *new_crc = NULL;
@@ -532,17 +1124,19 @@ magnatune_check_update_done(GObject *source_object,
                         &err);
 
     if (g_strcmp0(new_crc, old_crc) != 0) {
-      magnatune_get_db_async(NULL);
+      magnatune_get_db_async(source, NULL);
     }
 
     g_free(new_crc_path);
     g_free(crc_path);
     g_free(old_crc);
   }
+
+  g_object_unref(source);
 }
 
 static void
-magnatune_check_update(void)
+magnatune_check_update(GrlMagnatuneSource *source)
 {
   gchar *db_path = NULL;
   gchar *new_db_path = NULL;
@@ -582,7 +1176,7 @@ magnatune_check_update(void)
                                  URL_GET_CRC,
                                  NULL,
                                  magnatune_check_update_done,
-                                 NULL);
+                                 g_object_ref(source));
       }
       g_free(new_crc_path);
     }
@@ -700,29 +1294,21 @@ build_media_id_name_from_stmt(sqlite3_stmt *sql_stmt)
 
 static GList*
 magnatune_sqlite_execute(OperationSpec *os,
-                         gchar *sql,
+                         sqlite3_stmt *sql_stmt,
                          MagnatuneBuildMediaFn build_media_fn,
                          GError **error)
 {
   GrlMedia *media = NULL;
   sqlite3 *db = NULL;
-  sqlite3_stmt *sql_stmt = NULL;
   gint ret = 0;
+  gint64 start;
   GError *err = NULL;
   GList *list_medias = NULL;
 
   GRL_DEBUG("magnatune_sqlite_execute");
 
   db = GRL_MAGNATUNE_SOURCE(os->source)->priv->db;
-
-  ret = sqlite3_prepare_v2(db, sql, strlen(sql), &sql_stmt, NULL);
-  if (ret != SQLITE_OK) {
-    err = g_error_new(GRL_CORE_ERROR,
-                      os->error_code,
-                      _("Failed to get table from magnatune db: %s"),
-                      sqlite3_errmsg(db));
-    goto end_sqlite_execute;
-  }
+  start = g_get_monotonic_time();
 
   while ((ret = sqlite3_step(sql_stmt)) == SQLITE_BUSY);
 
@@ -744,8 +1330,13 @@ magnatune_sqlite_execute(OperationSpec *os,
 
   list_medias = g_list_reverse(list_medias);
 
+  GRL_DEBUG("Query returned %u rows in %" G_GINT64_FORMAT " us",
+            g_list_length(list_medias),
+            g_get_monotonic_time() - start);
+
 end_sqlite_execute:
-  sqlite3_finalize(sql_stmt);
+  /* Statements are cached, release their read lock */
+  sqlite3_reset(sql_stmt);
 
   if (err != NULL) {
     *error = err;
@@ -807,7 +1398,11 @@ magnatune_execute_browse(OperationSpec *os)
 {
   MagnatuneBuildMediaFn *build_fn;
   GrlMedia *media = NULL;
-  const gchar *container_id = NULL;  gchar *sql = NULL;
+  const gchar *container_id = NULL;
+  MagnatuneStmt stmt_id = MAGNATUNE_NUM_STMT;
+  sqlite3_stmt *sql_stmt = NULL;
+  gboolean bind_id = TRUE;
+  gint idx = 1;
   gchar **touple = NULL;
   gchar *new_container_id = NULL;
   gchar *category_str_id = NULL;
@@ -830,35 +1425,36 @@ magnatune_execute_browse(OperationSpec *os)
   build_fn = build_media_id_name_from_stmt;
 
   if (strcmp(touple[0], "root") == 0) {
+    bind_id = FALSE;
     switch (id) {
     case MAGNATUNE_ARTIST_CAT:
       category_str_id = g_strdup("artist");
-      sql = g_strdup_printf(GRL_SQL_ARTISTS_QUERY_ALL, os->count, os->skip);
+      stmt_id = MAGNATUNE_STMT_ARTISTS_ALL;
       break;
 
     case MAGNATUNE_ALBUM_CAT:
       category_str_id = g_strdup("album");
-      sql = g_strdup_printf(GRL_SQL_ALBUMS_QUERY_ALL, os->count, os->skip);
+      stmt_id = MAGNATUNE_STMT_ALBUMS_ALL;
       break;
 
     case MAGNATUNE_GENRE_CAT:
       category_str_id = g_strdup("genre");
-      sql = g_strdup_printf(GRL_SQL_GENRES_QUERY_ALL, os->count, os->skip);
+      stmt_id = MAGNATUNE_STMT_GENRES_ALL;
       break;
     }
 
   } else if (strcmp(touple[0], "artist") == 0) {
     category_str_id = g_strdup("album");
-    sql = g_strdup_printf(GRL_SQL_ALBUMS_BY_ARTIST, id, os->count, os->skip);
+    stmt_id = MAGNATUNE_STMT_ALBUMS_BY_ARTIST;
 
   } else if (strcmp(touple[0], "album") == 0) {
     category_str_id = g_strdup("track");
-    sql = g_strdup_printf(GRL_SQL_SONGS_BY_ALBUM, id, os->count, os->skip);
+    stmt_id = MAGNATUNE_STMT_SONGS_BY_ALBUM;
     build_fn = build_media_track_from_stmt;
 
   } else if (strcmp(touple[0], "genre") == 0) {
     category_str_id = g_strdup("album");
-    sql = g_strdup_printf(GRL_SQL_ALBUMS_BY_GENRE, id, os->count, os->skip);
+    stmt_id = MAGNATUNE_STMT_ALBUMS_BY_GENRE;
 
   } else {
     err = g_error_new(GRL_CORE_ERROR,
@@ -868,12 +1464,19 @@ magnatune_execute_browse(OperationSpec *os)
   }
   g_strfreev(touple);
 
-  if (sql == NULL || err != NULL)
+  if (stmt_id == MAGNATUNE_NUM_STMT || err != NULL)
+    goto end_browse;
+
+  sql_stmt = magnatune_get_stmt(os, stmt_id, &err);
+  if (sql_stmt == NULL)
     goto end_browse;
 
   /* We have the right sql-query, execute */
-  list_medias = magnatune_sqlite_execute(os, sql, build_fn, &err);
-  g_free(sql);
+  if (bind_id)
+    sqlite3_bind_int(sql_stmt, idx++, id);
+  sqlite3_bind_int64(sql_stmt, idx++, os->count);
+  sqlite3_bind_int64(sql_stmt, idx++, os->skip);
+  list_medias = magnatune_sqlite_execute(os, sql_stmt, build_fn, &err);
 
   if (list_medias == NULL)
     goto end_browse;
@@ -912,8 +1515,12 @@ end_browse:
 static void
 magnatune_execute_search(OperationSpec *os)
 {
+  GrlMagnatuneSource *source = GRL_MAGNATUNE_SOURCE(os->source);
   GrlMedia *media = NULL;
-  gchar *sql = NULL;
+  sqlite3_stmt *sql_stmt = NULL;
+  gchar *match = NULL;
+  gchar *like = NULL;
+  gint idx = 1;
   GList *list_medias = NULL;
   GList *iter = NULL;
   gint num_medias = 0;
@@ -922,15 +1529,31 @@ magnatune_execute_search(OperationSpec *os)
 
   GRL_DEBUG("magnatune_execute_search");
 
-  sql = g_strdup_printf(GRL_SQL_SONGS_QUERY_ALL,
-                        os->text, os->text, os->text,
-                        os->count, os->skip);
+  if (source->priv->has_fts && (match = grl_fts_match_expression(os->text))) {
+    sql_stmt = magnatune_get_stmt(os, MAGNATUNE_STMT_SONGS_SEARCH_FTS, &err);
+    if (sql_stmt != NULL)
+      sqlite3_bind_text(sql_stmt, idx++, match, -1, g_free);
+    else
+      g_free(match);
+  } else {
+    sql_stmt = magnatune_get_stmt(os, MAGNATUNE_STMT_SONGS_SEARCH, &err);
+    if (sql_stmt != NULL) {
+      like = g_strdup_printf("%%%s%%", os->text);
+      sqlite3_bind_text(sql_stmt, idx++, like, -1, SQLITE_TRANSIENT);
+      sqlite3_bind_text(sql_stmt, idx++, like, -1, SQLITE_TRANSIENT);
+      sqlite3_bind_text(sql_stmt, idx++, like, -1, g_free);
+    }
+  }
+
+  if (sql_stmt == NULL)
+    goto end_search;
 
+  sqlite3_bind_int64(sql_stmt, idx++, os->count);
+  sqlite3_bind_int64(sql_stmt, idx++, os->skip);
   list_medias = magnatune_sqlite_execute(os,
-                                         sql,
+                                         sql_stmt,
                                          build_media_track_from_stmt,
                                          &err);
-  g_free(sql);
 
   if (list_medias == NULL)
     goto end_search;
@@ -1004,11 +1627,10 @@ grl_magnatune_source_search(GrlSource *source, GrlSourceSearchSpec *ss)
   if (GRL_MAGNATUNE_SOURCE(source)->priv->db == NULL) {
     /* Get database first, then execute the search */
     os->magnatune_cb = magnatune_execute_search;
-    magnatune_get_crc_async();
-    magnatune_get_db_async(os);
+    magnatune_get_db_async(GRL_MAGNATUNE_SOURCE(source), os);
   } else {
     magnatune_execute_search(os);
-    magnatune_check_update();
+    magnatune_check_update(GRL_MAGNATUNE_SOURCE(source));
   }
 }
 
@@ -1028,13 +1650,16 @@ grl_magnatune_source_browse(GrlSource *source, GrlSourceBrowseSpec *bs)
   os->error_code = GRL_CORE_ERROR_BROWSE_FAILED;
   os->magnatune_cb = NULL;
 
-  if (GRL_MAGNATUNE_SOURCE(source)->priv->db == NULL) {
+  if (GRL_MAGNATUNE_SOURCE(source)->priv->db != NULL) {
+    magnatune_execute_browse(os);
+    magnatune_check_update(GRL_MAGNATUNE_SOURCE(source));
+  } else if (grl_media_get_id(bs->container) == NULL) {
+    /* Root categories do not need the catalog, get it meanwhile */
+    magnatune_get_db_async(GRL_MAGNATUNE_SOURCE(source), NULL);
+    magnatune_execute_browse(os);
+  } else {
     /* Get database first, then execute the browse */
     os->magnatune_cb = magnatune_execute_browse;
-    magnatune_get_crc_async();
-    magnatune_get_db_async(os);
-  } else {
-    magnatune_execute_browse(os);
-    magnatune_check_update();
+    magnatune_get_db_async(GRL_MAGNATUNE_SOURCE(source), os);
   }
 }
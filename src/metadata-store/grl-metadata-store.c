@@ -31,6 +31,7 @@
 #include <sqlite3.h>
 #include <string.h>
 
+#include "grl-db-worker.h"
 #include "grl-metadata-store.h"
 
 #define GRL_LOG_DOMAIN_DEFAULT metadata_store_log_domain
@@ -42,6 +43,13 @@ GRL_LOG_DOMAIN_STATIC(metadata_store_log_domain);
 
 #define GRL_SQL_DB  "grl-metadata-store.db"
 
+#define GRILO_CONF_WRITE_BEHIND              "write-behind"
+#define GRILO_CONF_FLUSH_INTERVAL            "flush-interval"
+#define GRILO_CONF_FLUSH_INTERVAL_DEFAULT    5
+#define GRILO_CONF_FLUSH_MAX_PENDING         "flush-max-pending"
+#define GRILO_CONF_FLUSH_MAX_PENDING_DEFAULT 64
+#define GRILO_CONF_SYNCHRONOUS               "synchronous"
+
 #define GRL_SQL_CREATE_TABLE_STORE			 \
   "CREATE TABLE IF NOT EXISTS store ("			 \
   "source_id TEXT,"					 \
@@ -61,10 +69,16 @@ GRL_LOG_DOMAIN_STATIC(metadata_store_log_domain);
   "ALTER TABLE store ADD COLUMN "                        \
   "type_id INTEGER"
 
-#define GRL_SQL_GET_METADATA				\
+#define GRL_SQL_CREATE_INDEX_STORE                       \
+  "CREATE INDEX IF NOT EXISTS store_source_media_idx "   \
+  "ON store (source_id, media_id)"
+
+#define GRL_SQL_GET_METADATA_BATCH                      \
   "SELECT * FROM store "				\
-  "WHERE source_id=? AND media_id=? "			\
-  "LIMIT 1"
+  "WHERE source_id=? AND media_id IN (%s)"
+
+/* Maximum number of media ids bound in a single batched resolve query */
+#define RESOLVE_BATCH_SIZE 256
 
 #define GRL_SQL_UPDATE_METADATA			\
   "UPDATE store SET %s "			\
@@ -93,10 +107,80 @@ GRL_LOG_DOMAIN_STATIC(metadata_store_log_domain);
   "WHERE %s "                                   \
   "LIMIT %u OFFSET %u"
 
+#define GRL_SQL_SET_SYNCHRONOUS                 \
+  "PRAGMA synchronous=%s"
+
+#define GRL_SQL_BEGIN_TRANSACTION "BEGIN TRANSACTION"
+#define GRL_SQL_COMMIT_TRANSACTION "COMMIT TRANSACTION"
+#define GRL_SQL_ROLLBACK_TRANSACTION "ROLLBACK TRANSACTION"
+
 struct _GrlMetadataStorePrivate {
-  sqlite3 *db;
+  /* All SQLite calls are run in this worker thread */
+  GrlDbWorker *worker;
+
+  /* Write-behind buffer: coalesced StoreRow entries not yet
+     committed to the database */
+  gboolean write_behind;
+  guint flush_interval;
+  guint flush_max_pending;
+  GHashTable *pending;
+  guint flush_id;
+
+  /* Resolves queued during the current main loop iteration, run as a
+     single batched query from an idle callback */
+  GQueue *resolves;
+  guint resolve_id;
 };
 
+/* Plain copy of a row of the store table, so values can be moved between
+   the main thread and the database worker without touching GrlMedia from
+   the worker */
+typedef struct {
+  gchar *source_id;
+  gchar *media_id;
+  gint type_id;
+  gint play_count;
+  gdouble rating;
+  gint last_position;
+  gchar *last_played;
+  gint favourite;
+  /* Keys holding a value, for rows to be written */
+  GList *keys;
+} StoreRow;
+
+typedef struct {
+  GrlSourceResolveSpec *rs;
+  const gchar *source_id;
+  const gchar *media_id;
+} PendingResolve;
+
+typedef struct {
+  GrlMetadataStoreSource *source;
+  GList *resolves;
+  gchar *source_id;
+  GPtrArray *media_ids;
+  /* media_id -> StoreRow, filled by the worker */
+  GHashTable *rows;
+} ResolveBatch;
+
+typedef struct {
+  GrlSourceStoreMetadataSpec *sms;
+  StoreRow *row;
+  GList *failed_keys;
+} StoreData;
+
+typedef struct {
+  GrlSourceSearchSpec *ss;
+  gchar *sql;
+  gboolean filter_favourite;
+  gboolean favourite;
+  gchar *filter_source;
+  gboolean filter_type;
+  gint type_filter[3];
+  /* StoreRow results, filled by the worker */
+  GList *rows;
+} SearchData;
+
 enum {
   STORE_SOURCE_ID = 0,
   STORE_MEDIA_ID,
@@ -141,6 +225,23 @@ static GrlCaps *grl_metadata_store_source_get_caps (GrlSource *source,
 static void grl_metadata_store_source_search (GrlSource *source,
                                               GrlSourceSearchSpec *ss);
 
+static gboolean init_db (sqlite3 *db, gpointer data, GError **error);
+
+static void flush_pending_writes (GrlMetadataStoreSource *source);
+
+static gboolean flush_pending_writes_cb (gpointer user_data);
+
+static void set_synchronous (GrlMetadataStoreSource *source, const gchar *mode);
+
+static guint store_row_hash (gconstpointer key);
+
+static gboolean store_row_equal (gconstpointer a, gconstpointer b);
+
+static void store_row_free (StoreRow *row);
+
+static void pending_resolve_free (PendingResolve *pr);
+static void cancel_pending_resolves (GrlMetadataStoreSource *source);
+
 gboolean grl_metadata_store_source_plugin_init (GrlRegistry *registry,
                                                 GrlPlugin *plugin,
                                                 GList *configs);
@@ -163,6 +264,36 @@ grl_metadata_store_source_plugin_init (GrlRegistry *registry,
   bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
 
   GrlMetadataStoreSource *source = grl_metadata_store_source_new ();
+
+  if (configs && configs->data) {
+    GrlConfig *config = GRL_CONFIG (configs->data);
+
+    if (grl_config_has_param (config, GRILO_CONF_WRITE_BEHIND)) {
+      source->priv->write_behind =
+        grl_config_get_boolean (config, GRILO_CONF_WRITE_BEHIND);
+    }
+    if (grl_config_has_param (config, GRILO_CONF_FLUSH_INTERVAL)) {
+      source->priv->flush_interval =
+        MAX (grl_config_get_int (config, GRILO_CONF_FLUSH_INTERVAL), 1);
+    }
+    if (grl_config_has_param (config, GRILO_CONF_FLUSH_MAX_PENDING)) {
+      source->priv->flush_max_pending =
+        MAX (grl_config_get_int (config, GRILO_CONF_FLUSH_MAX_PENDING), 1);
+    }
+    if (grl_config_has_param (config, GRILO_CONF_SYNCHRONOUS)) {
+      gchar *synchronous;
+
+      synchronous = grl_config_get_string (config, GRILO_CONF_SYNCHRONOUS);
+      set_synchronous (source, synchronous);
+      g_free (synchronous);
+    }
+  }
+
+  if (source->priv->write_behind) {
+    GRL_INFO ("Write-behind enabled: flushing every %u seconds or %u entries",
+              source->priv->flush_interval, source->priv->flush_max_pending);
+  }
+
   grl_registry_register_source (registry,
                                 plugin,
                                 GRL_SOURCE (source),
@@ -218,7 +349,16 @@ grl_metadata_store_source_class_finalize (GObject *object)
 {
   GrlMetadataStoreSource *source = GRL_METADATA_STORE_SOURCE (object);
 
-  sqlite3_close (source->priv->db);
+  /* Do not lose buffered updates on shutdown */
+  flush_pending_writes (source);
+  g_hash_table_unref (source->priv->pending);
+
+  g_clear_handle_id (&source->priv->resolve_id, g_source_remove);
+  cancel_pending_resolves (source);
+  g_queue_free (source->priv->resolves);
+
+  /* Waits for the queued jobs, including the flush above */
+  grl_db_worker_free (source->priv->worker);
 
   G_OBJECT_CLASS (grl_metadata_store_source_parent_class)->finalize (object);
 }
@@ -226,13 +366,19 @@ grl_metadata_store_source_class_finalize (GObject *object)
 static void
 grl_metadata_store_source_init (GrlMetadataStoreSource *source)
 {
-  gint r;
   gchar *path;
   gchar *db_path;
-  gchar *sql_error = NULL;
 
   source->priv = grl_metadata_store_source_get_instance_private (source);
 
+  source->priv->flush_interval = GRILO_CONF_FLUSH_INTERVAL_DEFAULT;
+  source->priv->flush_max_pending = GRILO_CONF_FLUSH_MAX_PENDING_DEFAULT;
+  source->priv->pending = g_hash_table_new_full (store_row_hash,
+                                                 store_row_equal,
+                                                 (GDestroyNotify) store_row_free,
+                                                 NULL);
+  source->priv->resolves = g_queue_new ();
+
   path = g_strconcat (g_get_user_data_dir (),
                       G_DIR_SEPARATOR_S, "grilo-plugins",
                       NULL);
@@ -241,24 +387,23 @@ grl_metadata_store_source_init (GrlMetadataStoreSource *source)
     g_mkdir_with_parents (path, 0775);
   }
 
-  GRL_DEBUG ("Opening database connection...");
   db_path = g_strconcat (path, G_DIR_SEPARATOR_S, GRL_SQL_DB, NULL);
-  r = sqlite3_open (db_path, &source->priv->db);
+  source->priv->worker = grl_db_worker_new (db_path, init_db);
   g_free (path);
-
-  if (r) {
-    g_critical ("Failed to open database '%s': %s",
-                db_path, sqlite3_errmsg (source->priv->db));
-    sqlite3_close (source->priv->db);
-    g_free (db_path);
-    return;
-  }
   g_free (db_path);
+}
 
-  GRL_DEBUG ("  OK");
+/* ======================= Utilities ==================== */
+
+/* Runs in the database worker */
+static gboolean
+init_db (sqlite3 *db, gpointer data, GError **error)
+{
+  gint r;
+  gchar *sql_error = NULL;
 
   GRL_DEBUG ("Checking database tables...");
-  r = sqlite3_exec (source->priv->db, GRL_SQL_CREATE_TABLE_STORE,
+  r = sqlite3_exec (db, GRL_SQL_CREATE_TABLE_STORE,
 		    NULL, NULL, &sql_error);
 
   if (r) {
@@ -268,102 +413,145 @@ grl_metadata_store_source_init (GrlMetadataStoreSource *source)
     } else {
       GRL_WARNING ("Failed to create database tables.");
     }
-    sqlite3_close (source->priv->db);
-    return;
+    g_set_error_literal (error,
+                         GRL_CORE_ERROR,
+                         GRL_CORE_ERROR_QUERY_FAILED,
+                         _("Failed to create database tables"));
+    return FALSE;
   }
 
   // For backwards compatibility, add newer columns if they don't exist
   // in the old database.
-  sqlite3_exec (source->priv->db, GRL_SQL_ALTER_TABLE_ADD_FAVOURITE,
+  sqlite3_exec (db, GRL_SQL_ALTER_TABLE_ADD_FAVOURITE,
                 NULL, NULL, NULL);
 
-  sqlite3_exec (source->priv->db, GRL_SQL_ALTER_TABLE_ADD_TYPE_ID,
+  sqlite3_exec (db, GRL_SQL_ALTER_TABLE_ADD_TYPE_ID,
+                NULL, NULL, NULL);
+
+  sqlite3_exec (db, GRL_SQL_CREATE_INDEX_STORE,
                 NULL, NULL, NULL);
 
   GRL_DEBUG ("  OK");
-}
 
-/* ======================= Utilities ==================== */
+  return TRUE;
+}
 
-static sqlite3_stmt *
-query_metadata_store (sqlite3 *db,
-		      const gchar *source_id,
-		      const gchar *media_id)
+static guint
+store_row_hash (gconstpointer key)
 {
-  gint r, idx;
-  sqlite3_stmt *sql_stmt = NULL;
+  const StoreRow *row = key;
 
-  GRL_DEBUG ("get_metadata");
+  return g_str_hash (row->source_id) * 31 + g_str_hash (row->media_id);
+}
 
-  r = sqlite3_prepare_v2 (db, GRL_SQL_GET_METADATA, -1, &sql_stmt, NULL);
+static gboolean
+store_row_equal (gconstpointer a, gconstpointer b)
+{
+  const StoreRow *row_a = a;
+  const StoreRow *row_b = b;
 
-  if (r != SQLITE_OK) {
-    GRL_WARNING ("Failed to get metadata: %s", sqlite3_errmsg (db));
-    return NULL;
-  }
+  return g_str_equal (row_a->source_id, row_b->source_id) &&
+    g_str_equal (row_a->media_id, row_b->media_id);
+}
 
-  idx = 0;
-  sqlite3_bind_text(sql_stmt, ++idx, source_id, -1, SQLITE_STATIC);
-  sqlite3_bind_text(sql_stmt, ++idx, media_id, -1, SQLITE_STATIC);
+static StoreRow *
+store_row_new (const gchar *source_id, const gchar *media_id, gint type_id)
+{
+  StoreRow *row = g_slice_new0 (StoreRow);
 
-  return sql_stmt;
+  row->source_id = g_strdup (source_id);
+  row->media_id = g_strdup (media_id);
+  row->type_id = type_id;
+
+  return row;
 }
 
 static void
-fill_metadata_from_stmt (GrlMedia *media, GList *keys, sqlite3_stmt *stmt)
+store_row_free (StoreRow *row)
 {
-  GList *iter;
-  gint play_count, last_position, favourite;
-  gdouble rating;
-  gchar *last_played;
+  g_free (row->source_id);
+  g_free (row->media_id);
+  g_free (row->last_played);
+  g_list_free (row->keys);
+  g_slice_free (StoreRow, row);
+}
 
-  iter = keys;
-  while (iter) {
-    GrlKeyID key = GRLPOINTER_TO_KEYID (iter->data);
-    if (key == GRL_METADATA_KEY_PLAY_COUNT) {
-      play_count = sqlite3_column_int (stmt, STORE_PLAY_COUNT);
-      grl_media_set_play_count (media, play_count);
-    } else if (key == GRL_METADATA_KEY_RATING) {
-      rating = sqlite3_column_double (stmt, STORE_RATING);
-      grl_media_set_rating (media, rating, 5.00);
-    } else if (key == GRL_METADATA_KEY_LAST_PLAYED) {
-      GDateTime *date;
-      last_played = (gchar *) sqlite3_column_text (stmt, STORE_LAST_PLAYED);
-      date = grl_date_time_from_iso8601 (last_played);
-      if (date) {
-        grl_media_set_last_played (media, date);
-        g_date_time_unref (date);
-      } else {
-        GRL_WARNING ("Unable to set 'last-played', as '%s' date is invalid",
-                     last_played);
-      }
-    } else if (key == GRL_METADATA_KEY_LAST_POSITION) {
-      last_position = sqlite3_column_int (stmt, STORE_LAST_POSITION);
-      grl_media_set_last_position (media, last_position);
-    } else if (key == GRL_METADATA_KEY_FAVOURITE) {
-      favourite = sqlite3_column_int (stmt, STORE_FAVOURITE);
-      grl_media_set_favourite (media, (gboolean) favourite);
-    }
-    iter = g_list_next (iter);
-  }
+static StoreRow *
+store_row_new_from_stmt (sqlite3_stmt *stmt)
+{
+  StoreRow *row;
+
+  row = store_row_new ((const gchar *) sqlite3_column_text (stmt, STORE_SOURCE_ID),
+                       (const gchar *) sqlite3_column_text (stmt, STORE_MEDIA_ID),
+                       sqlite3_column_int (stmt, STORE_TYPE_ID));
+  row->play_count = sqlite3_column_int (stmt, STORE_PLAY_COUNT);
+  row->rating = sqlite3_column_double (stmt, STORE_RATING);
+  row->last_position = sqlite3_column_int (stmt, STORE_LAST_POSITION);
+  row->last_played =
+    g_strdup ((const gchar *) sqlite3_column_text (stmt, STORE_LAST_PLAYED));
+  row->favourite = sqlite3_column_int (stmt, STORE_FAVOURITE);
+
+  return row;
 }
 
+/* Copies the value of @key from @media into @row */
 static void
-fill_metadata (GrlMedia *media, GList *keys, sqlite3_stmt *stmt)
+store_row_set_from_media (StoreRow *row, GrlKeyID key, GrlMedia *media)
 {
-  gint r;
+  if (key == GRL_METADATA_KEY_RATING) {
+    row->rating = grl_media_get_rating (media);
+  } else if (key == GRL_METADATA_KEY_PLAY_COUNT) {
+    row->play_count = grl_media_get_play_count (media);
+  } else if (key == GRL_METADATA_KEY_LAST_POSITION) {
+    row->last_position = grl_media_get_last_position (media);
+  } else if (key == GRL_METADATA_KEY_LAST_PLAYED) {
+    GDateTime *date;
+    g_clear_pointer (&row->last_played, g_free);
+    date = grl_media_get_last_played (media);
+    if (date) {
+      row->last_played = g_date_time_format (date, "%F %T");
+    }
+  } else if (key == GRL_METADATA_KEY_FAVOURITE) {
+    row->favourite = (gint) grl_media_get_favourite (media);
+  }
 
-  while ((r = sqlite3_step (stmt)) == SQLITE_BUSY);
+  if (!g_list_find (row->keys, GRLKEYID_TO_POINTER (key))) {
+    row->keys = g_list_append (row->keys, GRLKEYID_TO_POINTER (key));
+  }
+}
 
-  if (r != SQLITE_ROW) {
-    /* No info in DB for this item, bail out silently */
-    sqlite3_finalize (stmt);
-    return;
+static void
+set_media_key_from_row (GrlMedia *media, GrlKeyID key, StoreRow *row)
+{
+  if (key == GRL_METADATA_KEY_PLAY_COUNT) {
+    grl_media_set_play_count (media, row->play_count);
+  } else if (key == GRL_METADATA_KEY_RATING) {
+    grl_media_set_rating (media, row->rating, 5.00);
+  } else if (key == GRL_METADATA_KEY_LAST_PLAYED) {
+    GDateTime *date;
+    date = grl_date_time_from_iso8601 (row->last_played);
+    if (date) {
+      grl_media_set_last_played (media, date);
+      g_date_time_unref (date);
+    } else {
+      GRL_WARNING ("Unable to set 'last-played', as '%s' date is invalid",
+                   row->last_played);
+    }
+  } else if (key == GRL_METADATA_KEY_LAST_POSITION) {
+    grl_media_set_last_position (media, row->last_position);
+  } else if (key == GRL_METADATA_KEY_FAVOURITE) {
+    grl_media_set_favourite (media, (gboolean) row->favourite);
   }
+}
 
-  fill_metadata_from_stmt (media, keys, stmt);
+static void
+fill_metadata_from_row (GrlMedia *media, GList *keys, StoreRow *row)
+{
+  GList *iter;
 
-  sqlite3_finalize (stmt);
+  for (iter = keys; iter; iter = g_list_next (iter)) {
+    set_media_key_from_row (media, GRLPOINTER_TO_KEYID (iter->data), row);
+  }
 }
 
 static const gchar *
@@ -405,19 +593,14 @@ get_media_type (GrlMedia *media)
   return MEDIA;
 }
 
+/* Runs in the database worker */
 static gboolean
 bind_and_exec (sqlite3 *db,
 	       const gchar *sql,
-	       const gchar *source_id,
-	       const gchar *media_id,
-	       GList *col_names,
-	       GList *keys,
-	       GrlMedia *media)
+	       StoreRow *row)
 {
   gint r;
-  gint int_value;
-  double double_value;
-  GList *iter_names, *iter_keys;
+  GList *iter_keys;
   guint count;
   sqlite3_stmt *stmt;
 
@@ -427,51 +610,36 @@ bind_and_exec (sqlite3 *db,
 
   if (r != SQLITE_OK) {
     GRL_WARNING ("Failed to update metadata for '%s - %s': %s",
-                     source_id, media_id, sqlite3_errmsg (db));
+                     row->source_id, row->media_id, sqlite3_errmsg (db));
     sqlite3_finalize (stmt);
     return FALSE;
   }
 
   /* Bind media type */
-  sqlite3_bind_int (stmt, 1, get_media_type (media));
+  sqlite3_bind_int (stmt, 1, row->type_id);
 
   /* Bind column values */
   count = 2;
-  iter_names = col_names;
-  iter_keys = keys;
-  while (iter_names) {
-    if (iter_names->data) {
-      GrlKeyID key = GRLPOINTER_TO_KEYID (iter_keys->data);
-      if (key == GRL_METADATA_KEY_RATING) {
-	double_value = grl_media_get_rating (media);
-	sqlite3_bind_double (stmt, count, double_value);
-      } else if (key == GRL_METADATA_KEY_PLAY_COUNT) {
-	int_value = grl_media_get_play_count (media);
-	sqlite3_bind_int (stmt, count, int_value);
-      } else if (key == GRL_METADATA_KEY_LAST_POSITION) {
-	int_value = grl_media_get_last_position (media);
-	sqlite3_bind_int (stmt, count, int_value);
-      } else if (key == GRL_METADATA_KEY_LAST_PLAYED) {
-	GDateTime *date;
-	char *date_str;
-	date = grl_media_get_last_played (media);
-	if (date) {
-	  date_str = g_date_time_format (date, "%F %T");
-	  sqlite3_bind_text (stmt, count, date_str, -1, SQLITE_STATIC);
-	  g_free (date_str);
-	}
-      } else if (key == GRL_METADATA_KEY_FAVOURITE) {
-        int_value = (gint) grl_media_get_favourite (media);
-        sqlite3_bind_int (stmt, count, int_value);
+  for (iter_keys = row->keys; iter_keys; iter_keys = g_list_next (iter_keys)) {
+    GrlKeyID key = GRLPOINTER_TO_KEYID (iter_keys->data);
+    if (key == GRL_METADATA_KEY_RATING) {
+      sqlite3_bind_double (stmt, count, row->rating);
+    } else if (key == GRL_METADATA_KEY_PLAY_COUNT) {
+      sqlite3_bind_int (stmt, count, row->play_count);
+    } else if (key == GRL_METADATA_KEY_LAST_POSITION) {
+      sqlite3_bind_int (stmt, count, row->last_position);
+    } else if (key == GRL_METADATA_KEY_LAST_PLAYED) {
+      if (row->last_played) {
+        sqlite3_bind_text (stmt, count, row->last_played, -1, SQLITE_STATIC);
       }
-      count++;
+    } else if (key == GRL_METADATA_KEY_FAVOURITE) {
+      sqlite3_bind_int (stmt, count, row->favourite);
     }
-    iter_keys = g_list_next (iter_keys);
-    iter_names = g_list_next (iter_names);
+    count++;
   }
 
-  sqlite3_bind_text (stmt, count++, source_id, -1, SQLITE_STATIC);
-  sqlite3_bind_text (stmt, count++, media_id, -1, SQLITE_STATIC);
+  sqlite3_bind_text (stmt, count++, row->source_id, -1, SQLITE_STATIC);
+  sqlite3_bind_text (stmt, count++, row->media_id, -1, SQLITE_STATIC);
 
   /* execute query */
   while ((r = sqlite3_step (stmt)) == SQLITE_BUSY);
@@ -483,15 +651,11 @@ bind_and_exec (sqlite3 *db,
 
 static gboolean
 prepare_and_exec_update (sqlite3 *db,
-			 const gchar *source_id,
-			 const gchar *media_id,
-			 GList *col_names,
-			 GList *keys,
-			 GrlMedia *media)
+			 StoreRow *row)
 {
   gchar *sql;
   gint r;
-  GList *iter_names;
+  GList *iter_keys;
   GString *sql_buf;
   gchar *sql_set;
 
@@ -499,19 +663,15 @@ prepare_and_exec_update (sqlite3 *db,
 
   /* Prepare sql "set" for update query */
   sql_buf = g_string_new ("type_id=?");
-  iter_names = col_names;
-  while (iter_names) {
-    gchar *col_name = (gchar *) iter_names->data;
-    if (col_name) {
-      g_string_append_printf (sql_buf, " , %s=?", col_name);
-    }
-    iter_names = g_list_next (iter_names);
+  for (iter_keys = row->keys; iter_keys; iter_keys = g_list_next (iter_keys)) {
+    g_string_append_printf (sql_buf, " , %s=?",
+                            get_column_name_from_key_id (GRLPOINTER_TO_KEYID (iter_keys->data)));
   }
   sql_set = g_string_free (sql_buf, FALSE);
 
   /* Execute query */
   sql = g_strdup_printf (GRL_SQL_UPDATE_METADATA, sql_set);
-  r = bind_and_exec (db, sql, source_id, media_id, col_names, keys, media);
+  r = bind_and_exec (db, sql, row);
   g_free (sql);
   g_free (sql_set);
 
@@ -520,15 +680,11 @@ prepare_and_exec_update (sqlite3 *db,
 
 static gboolean
 prepare_and_exec_insert (sqlite3 *db,
-			 const gchar *source_id,
-			 const gchar *media_id,
-			 GList *col_names,
-			 GList *keys,
-			 GrlMedia *media)
+			 StoreRow *row)
 {
   gchar *sql;
   gint r;
-  GList *iter_names;
+  GList *iter_keys;
   GString *sql_buf_cols, *sql_buf_values;
   gchar *sql_cols, *sql_values;
 
@@ -537,21 +693,17 @@ prepare_and_exec_insert (sqlite3 *db,
   /* Prepare sql for insert query */
   sql_buf_cols = g_string_new ("");
   sql_buf_values = g_string_new ("");
-  iter_names = col_names;
-  while (iter_names) {
-    gchar *col_name = (gchar *) iter_names->data;
-    if (col_name) {
-      g_string_append_printf (sql_buf_cols, "%s, ", col_name);
-      g_string_append (sql_buf_values, "?, ");
-    }
-    iter_names = g_list_next (iter_names);
+  for (iter_keys = row->keys; iter_keys; iter_keys = g_list_next (iter_keys)) {
+    g_string_append_printf (sql_buf_cols, "%s, ",
+                            get_column_name_from_key_id (GRLPOINTER_TO_KEYID (iter_keys->data)));
+    g_string_append (sql_buf_values, "?, ");
   }
   sql_cols = g_string_free (sql_buf_cols, FALSE);
   sql_values = g_string_free (sql_buf_values, FALSE);
 
   /* Execute query */
   sql = g_strdup_printf (GRL_SQL_INSERT_METADATA, sql_cols, sql_values);
-  r = bind_and_exec (db, sql, source_id, media_id, col_names, keys, media);
+  r = bind_and_exec (db, sql, row);
   g_free (sql);
   g_free (sql_cols);
   g_free (sql_values);
@@ -559,222 +711,738 @@ prepare_and_exec_insert (sqlite3 *db,
   return r;
 }
 
-static GList *
-write_keys (sqlite3 *db,
-            const gchar *source_id,
-            const gchar *media_id,
-            GrlSourceStoreMetadataSpec *sms,
-            GError **error)
+/* Runs in the database worker. All the keys in @row must be writable. */
+static gboolean
+write_row (sqlite3 *db, StoreRow *row, GError **error)
 {
-  GList *col_names = NULL;
-  GList *iter;
-  GList *failed_keys = NULL;
-  guint supported_keys = 0;
   gint r;
 
-  /* Get DB column names for each key to be updated */
-  iter = sms->keys;
-  while (iter) {
-    const gchar *col_name =
-        get_column_name_from_key_id (GRLPOINTER_TO_KEYID (iter->data));
-    if (!col_name) {
-      GRL_WARNING ("Key %" GRL_KEYID_FORMAT " is not supported for "
-                       "writing, ignoring...",
-                 GRLPOINTER_TO_KEYID (iter->data));
-      failed_keys = g_list_prepend (failed_keys, iter->data);
-    } else {
-      supported_keys++;
-    }
-    col_names = g_list_prepend (col_names, (gchar *) col_name);
-    iter = g_list_next (iter);
-  }
-  col_names = g_list_reverse (col_names);
-
-  if (supported_keys == 0) {
-    GRL_WARNING ("Failed to update metadata, none of the specified "
-                     "keys is writable");
-    *error = g_error_new (GRL_CORE_ERROR,
-                          GRL_CORE_ERROR_STORE_METADATA_FAILED,
-                          _("Failed to update metadata: %s"),
-                          _("specified keys are not writable"));
-    goto done;
-  }
-
-  r = prepare_and_exec_update (db,
-			       source_id,
-			       media_id,
-			       col_names,
-			       sms->keys,
-			       sms->media);
+  r = prepare_and_exec_update (db, row);
 
   if (!r) {
     GRL_WARNING ("Failed to update metadata for '%s - %s': %s",
-                     source_id, media_id, sqlite3_errmsg (db));
-    g_list_free (failed_keys);
-    failed_keys = g_list_copy (sms->keys);
-    *error = g_error_new (GRL_CORE_ERROR,
-                          GRL_CORE_ERROR_STORE_METADATA_FAILED,
-                          _("Failed to update metadata: %s"),
-                          sqlite3_errmsg (db));
-    goto done;
+                     row->source_id, row->media_id, sqlite3_errmsg (db));
+    g_set_error (error,
+                 GRL_CORE_ERROR,
+                 GRL_CORE_ERROR_STORE_METADATA_FAILED,
+                 _("Failed to update metadata: %s"),
+                 sqlite3_errmsg (db));
+    return FALSE;
   }
 
   if (sqlite3_changes (db) == 0) {
     /* We have to create the row */
-    r = prepare_and_exec_insert (db,
-				 source_id,
-				 media_id,
-				 col_names,
-				 sms->keys,
-				 sms->media);
+    r = prepare_and_exec_insert (db, row);
   }
 
   if (!r) {
     GRL_WARNING ("Failed to update metadata for '%s - %s': %s",
-                     source_id, media_id, sqlite3_errmsg (db));
-    g_list_free (failed_keys);
-    failed_keys = g_list_copy (sms->keys);
-    *error = g_error_new_literal (GRL_CORE_ERROR,
-                                  GRL_CORE_ERROR_STORE_METADATA_FAILED,
-                                  _("Failed to update metadata"));
-    goto done;
+                     row->source_id, row->media_id, sqlite3_errmsg (db));
+    g_set_error_literal (error,
+                         GRL_CORE_ERROR,
+                         GRL_CORE_ERROR_STORE_METADATA_FAILED,
+                         _("Failed to update metadata"));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+write_row_job (sqlite3 *db, gpointer data, GError **error)
+{
+  StoreData *sd = data;
+
+  return write_row (db, sd->row, error);
+}
+
+/* Copies the writable keys in @keys from @media into @row. Returns the keys
+   that can not be written */
+static GList *
+fill_row_from_media (StoreRow *row, GList *keys, GrlMedia *media)
+{
+  GList *iter;
+  GList *failed_keys = NULL;
+
+  for (iter = keys; iter; iter = g_list_next (iter)) {
+    GrlKeyID key = GRLPOINTER_TO_KEYID (iter->data);
+
+    if (!get_column_name_from_key_id (key)) {
+      GRL_WARNING ("Key %" GRL_KEYID_FORMAT " is not supported for "
+                   "writing, ignoring...", key);
+      failed_keys = g_list_prepend (failed_keys, iter->data);
+    } else {
+      store_row_set_from_media (row, key, media);
+    }
   }
 
- done:
-  g_list_free (col_names);
   return failed_keys;
 }
 
 static GrlMedia *
-create_media (sqlite3_stmt * stmt, GList *keys)
+new_media_from_type (gint media_type)
 {
-  GrlMedia *media;
-  gint media_type;
-
-  media_type = sqlite3_column_int (stmt, STORE_TYPE_ID);
   switch (media_type) {
   case MEDIA_AUDIO:
-    media = grl_media_audio_new ();
-    break;
+    return grl_media_audio_new ();
   case MEDIA_VIDEO:
-    media = grl_media_video_new ();
-    break;
+    return grl_media_video_new ();
   case MEDIA_IMAGE:
-    media = grl_media_image_new ();
-    break;
+    return grl_media_image_new ();
   case MEDIA_CONTAINER:
-    media = grl_media_container_new ();
-    break;
+    return grl_media_container_new ();
   default:
-    media = grl_media_new ();
+    return grl_media_new ();
   }
+}
 
-  grl_media_set_source (media,
-                    (const gchar *) sqlite3_column_text (stmt, STORE_SOURCE_ID));
-  grl_media_set_id (media,
-                    (const gchar *) sqlite3_column_text (stmt, STORE_MEDIA_ID));
-  fill_metadata_from_stmt (media, keys, stmt);
+static GrlMedia *
+create_media (StoreRow *row, GList *keys)
+{
+  GrlMedia *media;
+
+  media = new_media_from_type (row->type_id);
+
+  grl_media_set_source (media, row->source_id);
+  grl_media_set_id (media, row->media_id);
+  fill_metadata_from_row (media, keys, row);
 
   return media;
 }
 
-/* ================== API Implementation ================ */
-
-static const GList *
-grl_metadata_store_source_supported_keys (GrlSource *source)
+static gboolean
+set_synchronous_job (sqlite3 *db, gpointer data, GError **error)
 {
-  static GList *keys = NULL;
-  if (!keys) {
-    keys = grl_metadata_key_list_new (GRL_METADATA_KEY_RATING,
-                                      GRL_METADATA_KEY_PLAY_COUNT,
-                                      GRL_METADATA_KEY_LAST_PLAYED,
-                                      GRL_METADATA_KEY_LAST_POSITION,
-                                      GRL_METADATA_KEY_FAVOURITE,
-                                      NULL);
+  gchar *sql;
+  gchar *sql_error = NULL;
+
+  sql = g_strdup_printf (GRL_SQL_SET_SYNCHRONOUS, (const gchar *) data);
+  if (sqlite3_exec (db, sql, NULL, NULL, &sql_error) != SQLITE_OK) {
+    GRL_WARNING ("Failed to set synchronous mode: %s", sql_error);
+    g_clear_pointer (&sql_error, sqlite3_free);
   }
-  return keys;
+  g_free (sql);
+
+  return TRUE;
 }
 
-static const GList *
-grl_metadata_store_source_writable_keys (GrlSource *source)
+static void
+set_synchronous (GrlMetadataStoreSource *source, const gchar *mode)
 {
-  static GList *keys = NULL;
-  if (!keys) {
-    keys = grl_metadata_key_list_new (GRL_METADATA_KEY_RATING,
-                                      GRL_METADATA_KEY_PLAY_COUNT,
-                                      GRL_METADATA_KEY_LAST_PLAYED,
-                                      GRL_METADATA_KEY_LAST_POSITION,
-                                      GRL_METADATA_KEY_FAVOURITE,
-                                      NULL);
+  if (g_strcmp0 (mode, "off") != 0 &&
+      g_strcmp0 (mode, "normal") != 0 &&
+      g_strcmp0 (mode, "full") != 0) {
+    GRL_WARNING ("Invalid value '%s' for '%s', expected 'off', 'normal' or 'full'",
+                 mode, GRILO_CONF_SYNCHRONOUS);
+    return;
   }
-  return keys;
+
+  grl_db_worker_push (source->priv->worker, NULL,
+                      set_synchronous_job, g_strdup (mode), g_free,
+                      NULL, NULL);
 }
 
-static GrlCaps *
-grl_metadata_store_source_get_caps (GrlSource *source,
-                                    GrlSupportedOps operation)
+static StoreRow *
+lookup_pending_write (GrlMetadataStoreSource *source,
+                      const gchar *source_id,
+                      const gchar *media_id)
 {
-  static GrlCaps *caps = NULL;
-  GList * keys;
-
-  if (caps == NULL) {
-      caps = grl_caps_new ();
-      keys = grl_metadata_key_list_new (GRL_METADATA_KEY_FAVOURITE,
-                                        GRL_METADATA_KEY_SOURCE,
-                                        GRL_METADATA_KEY_INVALID);
-      grl_caps_set_key_filter (caps, keys);
-      g_list_free (keys);
-      grl_caps_set_type_filter (caps, GRL_TYPE_FILTER_ALL);
-  }
+  StoreRow lookup = { (gchar *) source_id, (gchar *) media_id };
 
-  return caps;
+  return g_hash_table_lookup (source->priv->pending, &lookup);
 }
 
+/* Returns TRUE if the pending entry holds a value for all the requested keys
+   handled by the store, so the database does not need to be queried */
 static gboolean
-grl_metadata_store_source_may_resolve (GrlSource *source,
-                                       GrlMedia *media,
-                                       GrlKeyID key_id,
-                                       GList **missing_keys)
+pending_write_covers_keys (StoreRow *pw, GList *keys)
 {
-  if (!(key_id == GRL_METADATA_KEY_RATING
-        || key_id == GRL_METADATA_KEY_PLAY_COUNT
-        || key_id == GRL_METADATA_KEY_LAST_PLAYED
-        || key_id == GRL_METADATA_KEY_LAST_POSITION
-        || key_id == GRL_METADATA_KEY_FAVOURITE))
-    return FALSE;
-
+  GList *iter;
 
-  if (media) {
-    if (!(grl_media_is_video (media) ||
-          grl_media_is_audio (media) ||
-          key_id == GRL_METADATA_KEY_FAVOURITE))
-      /* the keys we handle for now only make sense for audio and video,
-         with exception of the 'favourite' key, valid as well for pictures
-         and containers */
+  for (iter = keys; iter; iter = g_list_next (iter)) {
+    if (get_column_name_from_key_id (GRLPOINTER_TO_KEYID (iter->data)) &&
+        !g_list_find (pw->keys, iter->data)) {
       return FALSE;
-
-    if (grl_data_has_key (GRL_DATA (media), GRL_METADATA_KEY_ID))
-      return TRUE;
+    }
   }
 
-  if (missing_keys)
-    *missing_keys = grl_metadata_key_list_new (GRL_METADATA_KEY_ID, NULL);
-
-  return FALSE;
+  return TRUE;
 }
 
 static void
-grl_metadata_store_source_resolve (GrlSource *source,
-                                   GrlSourceResolveSpec *rs)
+fill_metadata_from_pending_write (GrlMedia *media, GList *keys, StoreRow *pw)
 {
-  const gchar *source_id, *media_id;
-  sqlite3_stmt *stmt;
-  GError *error = NULL;
-
-  GRL_DEBUG (__FUNCTION__);
+  GList *iter;
 
-  source_id = grl_media_get_source (rs->media);
-  media_id = grl_media_get_id (rs->media);
+  for (iter = keys; iter; iter = g_list_next (iter)) {
+    if (g_list_find (pw->keys, iter->data)) {
+      set_media_key_from_row (media, GRLPOINTER_TO_KEYID (iter->data), pw);
+    }
+  }
+}
+
+static GList *
+queue_keys (GrlMetadataStoreSource *source,
+            const gchar *source_id,
+            const gchar *media_id,
+            GList *keys,
+            GrlMedia *media,
+            GError **error)
+{
+  GList *failed_keys;
+  StoreRow *pw;
+  gboolean is_new = FALSE;
+
+  pw = lookup_pending_write (source, source_id, media_id);
+  if (!pw) {
+    pw = store_row_new (source_id, media_id, get_media_type (media));
+    is_new = TRUE;
+  }
+
+  /* Newer values replace the ones already buffered */
+  failed_keys = fill_row_from_media (pw, keys, media);
+
+  if (!pw->keys) {
+    GRL_WARNING ("Failed to update metadata, none of the specified "
+                 "keys is writable");
+    *error = g_error_new (GRL_CORE_ERROR,
+                          GRL_CORE_ERROR_STORE_METADATA_FAILED,
+                          _("Failed to update metadata: %s"),
+                          _("specified keys are not writable"));
+    store_row_free (pw);
+    return failed_keys;
+  }
+
+  if (is_new) {
+    g_hash_table_add (source->priv->pending, pw);
+  }
+
+  if (g_hash_table_size (source->priv->pending) >= source->priv->flush_max_pending) {
+    flush_pending_writes (source);
+  } else if (source->priv->flush_id == 0) {
+    source->priv->flush_id = g_timeout_add_seconds (source->priv->flush_interval,
+                                                    flush_pending_writes_cb,
+                                                    source);
+  }
+
+  return failed_keys;
+}
+
+/* Runs in the database worker */
+static gboolean
+flush_pending_writes_job (sqlite3 *db, gpointer data, GError **error)
+{
+  GHashTable *pending = data;
+  GHashTableIter iter;
+  StoreRow *pw;
+  GError *write_error = NULL;
+
+  GRL_DEBUG ("Flushing %u pending writes", g_hash_table_size (pending));
+
+  sqlite3_exec (db, GRL_SQL_BEGIN_TRANSACTION, NULL, NULL, NULL);
+
+  g_hash_table_iter_init (&iter, pending);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &pw, NULL)) {
+    if (!write_row (db, pw, &write_error)) {
+      GRL_WARNING ("Dropping buffered update for '%s - %s': %s",
+                   pw->source_id, pw->media_id, write_error->message);
+      g_clear_error (&write_error);
+    }
+  }
+
+  if (sqlite3_exec (db, GRL_SQL_COMMIT_TRANSACTION, NULL, NULL, NULL) != SQLITE_OK) {
+    GRL_WARNING ("Failed to commit buffered updates: %s", sqlite3_errmsg (db));
+    sqlite3_exec (db, GRL_SQL_ROLLBACK_TRANSACTION, NULL, NULL, NULL);
+  }
+
+  return TRUE;
+}
+
+static void
+flush_pending_writes (GrlMetadataStoreSource *source)
+{
+  GHashTable *pending;
+
+  g_clear_handle_id (&source->priv->flush_id, g_source_remove);
+
+  if (g_hash_table_size (source->priv->pending) == 0) {
+    return;
+  }
+
+  /* The worker takes over the buffered rows. As jobs are run in order, any
+     query pushed after this already sees them in the database. */
+  pending = source->priv->pending;
+  source->priv->pending = g_hash_table_new_full (store_row_hash,
+                                                 store_row_equal,
+                                                 (GDestroyNotify) store_row_free,
+                                                 NULL);
+
+  grl_db_worker_push (source->priv->worker, NULL,
+                      flush_pending_writes_job,
+                      pending, (GDestroyNotify) g_hash_table_unref,
+                      NULL, NULL);
+}
+
+static gboolean
+flush_pending_writes_cb (gpointer user_data)
+{
+  GrlMetadataStoreSource *source = GRL_METADATA_STORE_SOURCE (user_data);
+
+  source->priv->flush_id = 0;
+  flush_pending_writes (source);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+pending_resolve_free (PendingResolve *pr)
+{
+  g_slice_free (PendingResolve, pr);
+}
+
+/* Answers the resolves still waiting for their batch, so none is left
+   without a callback when the source goes away */
+static void
+cancel_pending_resolves (GrlMetadataStoreSource *source)
+{
+  PendingResolve *pr;
+  GError *error;
+
+  if (g_queue_is_empty (source->priv->resolves)) {
+    return;
+  }
+
+  error = g_error_new_literal (G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                               _("Operation was cancelled"));
+
+  while ((pr = g_queue_pop_head (source->priv->resolves))) {
+    pr->rs->callback (pr->rs->source, pr->rs->operation_id, pr->rs->media,
+                      pr->rs->user_data, error);
+    pending_resolve_free (pr);
+  }
+
+  g_error_free (error);
+}
+
+static void
+resolve_batch_free (ResolveBatch *batch)
+{
+  g_list_free_full (batch->resolves, (GDestroyNotify) pending_resolve_free);
+  g_free (batch->source_id);
+  g_ptr_array_unref (batch->media_ids);
+  g_hash_table_unref (batch->rows);
+  g_slice_free (ResolveBatch, batch);
+}
+
+/* Runs in the database worker. Resolves all the media ids in @data, which
+   share the same source id, with a single query */
+static gboolean
+resolve_batch_job (sqlite3 *db, gpointer data, GError **error)
+{
+  ResolveBatch *batch = data;
+  sqlite3_stmt *stmt = NULL;
+  GString *placeholders;
+  StoreRow *row;
+  gchar *sql;
+  guint i;
+  gint r, idx;
+
+  placeholders = g_string_new ("?");
+  for (i = 1; i < batch->media_ids->len; i++) {
+    g_string_append (placeholders, ", ?");
+  }
+  sql = g_strdup_printf (GRL_SQL_GET_METADATA_BATCH, placeholders->str);
+  g_string_free (placeholders, TRUE);
+
+  GRL_DEBUG ("Resolving %u items from '%s' in a batch",
+             batch->media_ids->len, batch->source_id);
+
+  r = sqlite3_prepare_v2 (db, sql, -1, &stmt, NULL);
+  g_free (sql);
+
+  if (r != SQLITE_OK) {
+    GRL_WARNING ("Failed to get metadata: %s", sqlite3_errmsg (db));
+    g_set_error_literal (error,
+                         GRL_CORE_ERROR,
+                         GRL_CORE_ERROR_RESOLVE_FAILED,
+                         _("Failed to resolve"));
+    return FALSE;
+  }
+
+  idx = 0;
+  sqlite3_bind_text (stmt, ++idx, batch->source_id, -1, SQLITE_STATIC);
+  for (i = 0; i < batch->media_ids->len; i++) {
+    sqlite3_bind_text (stmt, ++idx,
+                       g_ptr_array_index (batch->media_ids, i), -1, SQLITE_STATIC);
+  }
+
+  while ((r = sqlite3_step (stmt)) == SQLITE_BUSY);
+
+  while (r == SQLITE_ROW) {
+    row = store_row_new_from_stmt (stmt);
+    if (row->media_id && !g_hash_table_contains (batch->rows, row->media_id)) {
+      g_hash_table_insert (batch->rows, row->media_id, row);
+    } else {
+      store_row_free (row);
+    }
+    r = sqlite3_step (stmt);
+  }
+
+  /* Items with no info in DB are not an error */
+  sqlite3_finalize (stmt);
+
+  return TRUE;
+}
+
+static void
+resolve_batch_done (GObject *object, GAsyncResult *result, gpointer user_data)
+{
+  ResolveBatch *batch = user_data;
+  PendingResolve *pr;
+  StoreRow *row;
+  StoreRow *pw;
+  GList *l;
+  GError *error = NULL;
+
+  grl_db_worker_finish (result, &error);
+  if (error) {
+    error->code = GRL_CORE_ERROR_RESOLVE_FAILED;
+  }
+
+  for (l = batch->resolves; l; l = g_list_next (l)) {
+    pr = l->data;
+    if (!error) {
+      row = g_hash_table_lookup (batch->rows, pr->media_id);
+      if (row) {
+        fill_metadata_from_row (pr->rs->media, pr->rs->keys, row);
+      }
+      /* Buffered updates are newer than what is in the database */
+      pw = lookup_pending_write (batch->source, pr->source_id, pr->media_id);
+      if (pw) {
+        fill_metadata_from_pending_write (pr->rs->media, pr->rs->keys, pw);
+      }
+    }
+    pr->rs->callback (pr->rs->source, pr->rs->operation_id, pr->rs->media,
+                      pr->rs->user_data, error);
+  }
+
+  g_clear_error (&error);
+  resolve_batch_free (batch);
+}
+
+static void
+push_resolve_batch (GrlMetadataStoreSource *source, GList *resolves)
+{
+  ResolveBatch *batch;
+  PendingResolve *pr;
+  GHashTable *seen;
+  GList *l;
+
+  batch = g_slice_new0 (ResolveBatch);
+  batch->source = source;
+  batch->resolves = resolves;
+  batch->source_id = g_strdup (((PendingResolve *) resolves->data)->source_id);
+  batch->media_ids = g_ptr_array_new_with_free_func (g_free);
+  batch->rows = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                       NULL, (GDestroyNotify) store_row_free);
+
+  /* The same media may be resolved several times in a batch */
+  seen = g_hash_table_new (g_str_hash, g_str_equal);
+  for (l = resolves; l; l = g_list_next (l)) {
+    pr = l->data;
+    if (g_hash_table_add (seen, (gpointer) pr->media_id)) {
+      g_ptr_array_add (batch->media_ids, g_strdup (pr->media_id));
+    }
+  }
+  g_hash_table_unref (seen);
+
+  grl_db_worker_push (source->priv->worker, source,
+                      resolve_batch_job, batch, NULL,
+                      resolve_batch_done, batch);
+}
+
+static gboolean
+resolve_pending_cb (gpointer user_data)
+{
+  GrlMetadataStoreSource *source = GRL_METADATA_STORE_SOURCE (user_data);
+  GHashTable *by_source;
+  GHashTableIter iter;
+  GList *entries, *batch, *last;
+  PendingResolve *pr;
+
+  source->priv->resolve_id = 0;
+
+  /* Group the queued resolves per source id */
+  by_source = g_hash_table_new (g_str_hash, g_str_equal);
+  while ((pr = g_queue_pop_head (source->priv->resolves))) {
+    entries = g_hash_table_lookup (by_source, pr->source_id);
+    g_hash_table_insert (by_source, (gpointer) pr->source_id,
+                         g_list_prepend (entries, pr));
+  }
+
+  g_hash_table_iter_init (&iter, by_source);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entries)) {
+    entries = g_list_reverse (entries);
+    while (entries) {
+      /* Split in chunks to keep the number of bound parameters bounded */
+      batch = entries;
+      last = g_list_nth (batch, RESOLVE_BATCH_SIZE - 1);
+      if (last && last->next) {
+        entries = last->next;
+        entries->prev = NULL;
+        last->next = NULL;
+      } else {
+        entries = NULL;
+      }
+      push_resolve_batch (source, batch);
+    }
+  }
+
+  g_hash_table_unref (by_source);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+store_data_free (StoreData *sd)
+{
+  store_row_free (sd->row);
+  g_list_free (sd->failed_keys);
+  g_slice_free (StoreData, sd);
+}
+
+static void
+store_metadata_done (GObject *object, GAsyncResult *result, gpointer user_data)
+{
+  StoreData *sd = user_data;
+  GrlSourceStoreMetadataSpec *sms = sd->sms;
+  GError *error = NULL;
+
+  if (!grl_db_worker_finish (result, &error)) {
+    if (error) {
+      error->code = GRL_CORE_ERROR_STORE_METADATA_FAILED;
+    }
+    g_list_free (sd->failed_keys);
+    sd->failed_keys = g_list_copy (sms->keys);
+  }
+
+  sms->callback (sms->source, sms->media, sd->failed_keys, sms->user_data, error);
+
+  g_clear_error (&error);
+  store_data_free (sd);
+}
+
+static void
+search_data_free (SearchData *sd)
+{
+  g_free (sd->sql);
+  g_free (sd->filter_source);
+  g_list_free_full (sd->rows, (GDestroyNotify) store_row_free);
+  g_slice_free (SearchData, sd);
+}
+
+/* Runs in the database worker */
+static gboolean
+search_job (sqlite3 *db, gpointer data, GError **error)
+{
+  SearchData *sd = data;
+  sqlite3_stmt *sql_stmt = NULL;
+  guint count;
+  gint r;
+  gint i;
+
+  r = sqlite3_prepare_v2 (db, sd->sql, -1, &sql_stmt, NULL);
+
+  if (r != SQLITE_OK) {
+    GRL_WARNING ("Failed to search in the metadata store: %s", sqlite3_errmsg (db));
+    g_set_error (error,
+                 GRL_CORE_ERROR,
+                 GRL_CORE_ERROR_SEARCH_FAILED,
+                 _("Failed to search: %s"),
+                 sqlite3_errmsg (db));
+    return FALSE;
+  }
+
+  count = 1;
+
+  if (sd->filter_favourite) {
+    sqlite3_bind_int (sql_stmt, count++, (gint) sd->favourite);
+  }
+
+  if (sd->filter_source) {
+    sqlite3_bind_text (sql_stmt, count++, sd->filter_source, -1, SQLITE_STATIC);
+  }
+
+  if (sd->filter_type) {
+    for (i = 0; i < G_N_ELEMENTS (sd->type_filter); i++) {
+      sqlite3_bind_int (sql_stmt, count++, sd->type_filter[i]);
+    }
+  }
+
+  while ((r = sqlite3_step (sql_stmt)) == SQLITE_BUSY);
+
+  while (r == SQLITE_ROW) {
+    sd->rows = g_list_prepend (sd->rows, store_row_new_from_stmt (sql_stmt));
+    r = sqlite3_step (sql_stmt);
+  }
+
+  if (r != SQLITE_DONE) {
+    GRL_WARNING ("Failed to search in the metadata store: %s", sqlite3_errmsg (db));
+    g_set_error (error,
+                 GRL_CORE_ERROR,
+                 GRL_CORE_ERROR_SEARCH_FAILED,
+                 _("Failed to search: %s"),
+                 sqlite3_errmsg (db));
+    sqlite3_finalize (sql_stmt);
+    return FALSE;
+  }
+
+  sqlite3_finalize (sql_stmt);
+
+  return TRUE;
+}
+
+static void
+search_done (GObject *object, GAsyncResult *result, gpointer user_data)
+{
+  SearchData *sd = user_data;
+  GrlSourceSearchSpec *ss = sd->ss;
+  GError *error = NULL;
+  GrlMedia *media;
+  GList *iter;
+  guint count;
+
+  if (!grl_db_worker_finish (result, &error)) {
+    if (error) {
+      error->code = GRL_CORE_ERROR_SEARCH_FAILED;
+    }
+    ss->callback (ss->source, ss->operation_id, NULL, 0, ss->user_data, error);
+    g_clear_error (&error);
+    search_data_free (sd);
+    return;
+  }
+
+  count = g_list_length (sd->rows);
+  if (count > 0) {
+    iter = sd->rows;
+    while (iter) {
+      media = create_media ((StoreRow *) iter->data, ss->keys);
+      ss->callback (ss->source,
+                    ss->operation_id,
+                    media,
+                    --count,
+                    ss->user_data,
+                    NULL);
+      iter = g_list_next (iter);
+    }
+  } else {
+    ss->callback (ss->source, ss->operation_id, NULL, 0, ss->user_data, NULL);
+  }
+
+  search_data_free (sd);
+}
+
+/* ================== API Implementation ================ */
+
+
+static const GList *
+grl_metadata_store_source_supported_keys (GrlSource *source)
+{
+  static GList *keys = NULL;
+  if (!keys) {
+    keys = grl_metadata_key_list_new (GRL_METADATA_KEY_RATING,
+                                      GRL_METADATA_KEY_PLAY_COUNT,
+                                      GRL_METADATA_KEY_LAST_PLAYED,
+                                      GRL_METADATA_KEY_LAST_POSITION,
+                                      GRL_METADATA_KEY_FAVOURITE,
+                                      NULL);
+  }
+  return keys;
+}
+
+static const GList *
+grl_metadata_store_source_writable_keys (GrlSource *source)
+{
+  static GList *keys = NULL;
+  if (!keys) {
+    keys = grl_metadata_key_list_new (GRL_METADATA_KEY_RATING,
+                                      GRL_METADATA_KEY_PLAY_COUNT,
+                                      GRL_METADATA_KEY_LAST_PLAYED,
+                                      GRL_METADATA_KEY_LAST_POSITION,
+                                      GRL_METADATA_KEY_FAVOURITE,
+                                      NULL);
+  }
+  return keys;
+}
+
+static GrlCaps *
+grl_metadata_store_source_get_caps (GrlSource *source,
+                                    GrlSupportedOps operation)
+{
+  static GrlCaps *caps = NULL;
+  GList * keys;
+
+  if (caps == NULL) {
+      caps = grl_caps_new ();
+      keys = grl_metadata_key_list_new (GRL_METADATA_KEY_FAVOURITE,
+                                        GRL_METADATA_KEY_SOURCE,
+                                        GRL_METADATA_KEY_INVALID);
+      grl_caps_set_key_filter (caps, keys);
+      g_list_free (keys);
+      grl_caps_set_type_filter (caps, GRL_TYPE_FILTER_ALL);
+  }
+
+  return caps;
+}
+
+static gboolean
+grl_metadata_store_source_may_resolve (GrlSource *source,
+                                       GrlMedia *media,
+                                       GrlKeyID key_id,
+                                       GList **missing_keys)
+{
+  if (!(key_id == GRL_METADATA_KEY_RATING
+        || key_id == GRL_METADATA_KEY_PLAY_COUNT
+        || key_id == GRL_METADATA_KEY_LAST_PLAYED
+        || key_id == GRL_METADATA_KEY_LAST_POSITION
+        || key_id == GRL_METADATA_KEY_FAVOURITE))
+    return FALSE;
+
+
+  if (media) {
+    if (!(grl_media_is_video (media) ||
+          grl_media_is_audio (media) ||
+          key_id == GRL_METADATA_KEY_FAVOURITE))
+      /* the keys we handle for now only make sense for audio and video,
+         with exception of the 'favourite' key, valid as well for pictures
+         and containers */
+      return FALSE;
+
+    if (grl_data_has_key (GRL_DATA (media), GRL_METADATA_KEY_ID))
+      return TRUE;
+  }
+
+  if (missing_keys)
+    *missing_keys = grl_metadata_key_list_new (GRL_METADATA_KEY_ID, NULL);
+
+  return FALSE;
+}
+
+
+static void
+grl_metadata_store_source_resolve (GrlSource *source,
+                                   GrlSourceResolveSpec *rs)
+{
+  GrlMetadataStoreSource *store_source = GRL_METADATA_STORE_SOURCE (source);
+  const gchar *source_id, *media_id;
+  PendingResolve *pr;
+  StoreRow *pw;
+  GError *error = NULL;
+
+  GRL_DEBUG (__FUNCTION__);
+
+  source_id = grl_media_get_source (rs->media);
+  media_id = grl_media_get_id (rs->media);
 
   /* We need the source id */
   if (!source_id) {
@@ -793,18 +1461,24 @@ grl_metadata_store_source_resolve (GrlSource *source,
     media_id = "";
   }
 
-  stmt = query_metadata_store (GRL_METADATA_STORE_SOURCE (source)->priv->db,
-			       source_id, media_id);
-  if (stmt) {
-    fill_metadata (rs->media, rs->keys, stmt);
+  /* Buffered updates are newer than what is in the database */
+  pw = lookup_pending_write (store_source, source_id, media_id);
+  if (pw && pending_write_covers_keys (pw, rs->keys)) {
+    fill_metadata_from_pending_write (rs->media, rs->keys, pw);
     rs->callback (rs->source, rs->operation_id, rs->media, rs->user_data, NULL);
-  } else {
-    GRL_WARNING ("Failed to resolve metadata");
-    error = g_error_new_literal (GRL_CORE_ERROR,
-                                 GRL_CORE_ERROR_RESOLVE_FAILED,
-                                 _("Failed to resolve"));
-    rs->callback (rs->source, rs->operation_id, rs->media, rs->user_data, error);
-    g_error_free (error);
+    return;
+  }
+
+  /* Resolves are usually issued for a whole browse page at once, so queue
+     them and answer all of them with a single query */
+  pr = g_slice_new0 (PendingResolve);
+  pr->rs = rs;
+  pr->source_id = source_id;
+  pr->media_id = media_id;
+  g_queue_push_tail (store_source->priv->resolves, pr);
+
+  if (store_source->priv->resolve_id == 0) {
+    store_source->priv->resolve_id = g_idle_add (resolve_pending_cb, source);
   }
 }
 
@@ -814,9 +1488,11 @@ grl_metadata_store_source_store_metadata (GrlSource *source,
 {
   GRL_DEBUG ("grl_metadata_store_source_set_metadata");
 
+  GrlMetadataStoreSource *store_source = GRL_METADATA_STORE_SOURCE (source);
   const gchar *media_id, *source_id;
   GError *error = NULL;
   GList *failed_keys = NULL;
+  StoreData *sd;
 
   source_id = grl_media_get_source (sms->media);
   media_id = grl_media_get_id (sms->media);
@@ -829,16 +1505,43 @@ grl_metadata_store_source_store_metadata (GrlSource *source,
                          _("Failed to update metadata: %s"),
                          _("“source-id” not available"));
     failed_keys = g_list_copy (sms->keys);
-  } else {
-    /* Special case for root categories */
-    if (!media_id) {
-      media_id = "";
-    }
+    goto done;
+  }
 
-    failed_keys = write_keys (GRL_METADATA_STORE_SOURCE (source)->priv->db,
-                              source_id, media_id, sms, &error);
+  /* Special case for root categories */
+  if (!media_id) {
+    media_id = "";
+  }
+
+  if (store_source->priv->write_behind) {
+    failed_keys = queue_keys (store_source, source_id, media_id,
+                              sms->keys, sms->media, &error);
+    goto done;
   }
 
+  sd = g_slice_new0 (StoreData);
+  sd->sms = sms;
+  sd->row = store_row_new (source_id, media_id, get_media_type (sms->media));
+  sd->failed_keys = fill_row_from_media (sd->row, sms->keys, sms->media);
+
+  if (!sd->row->keys) {
+    GRL_WARNING ("Failed to update metadata, none of the specified "
+                 "keys is writable");
+    error = g_error_new (GRL_CORE_ERROR,
+                         GRL_CORE_ERROR_STORE_METADATA_FAILED,
+                         _("Failed to update metadata: %s"),
+                         _("specified keys are not writable"));
+    failed_keys = g_steal_pointer (&sd->failed_keys);
+    store_data_free (sd);
+    goto done;
+  }
+
+  grl_db_worker_push (store_source->priv->worker, source,
+                      write_row_job, sd, NULL,
+                      store_metadata_done, sd);
+  return;
+
+ done:
   sms->callback (sms->source, sms->media, failed_keys, sms->user_data, error);
 
   g_clear_error (&error);
@@ -849,33 +1552,20 @@ static void
 grl_metadata_store_source_search (GrlSource *source,
                                   GrlSourceSearchSpec *ss)
 {
-  sqlite3_stmt *sql_stmt = NULL;
-  sqlite3 *db;
-  gchar *sql;
-  gint r;
-  gint i;
-  GError *error = NULL;
-  GrlMedia *media;
-  GList *iter, *medias = NULL;
+  GrlMetadataStoreSource *store_source = GRL_METADATA_STORE_SOURCE (source);
+  SearchData *sd;
   GValue *filter_favourite_val;
   GValue *filter_source_val;
   GrlTypeFilter filter_type_val;
   GString *filters;
-  guint count;
-  gint type_filter[3];
 
   GRL_DEBUG (__FUNCTION__);
 
-  db = GRL_METADATA_STORE_SOURCE (source)->priv->db;
-  if (!db) {
-    GRL_WARNING ("Can't execute operation: no database connection.");
-    error = g_error_new_literal (GRL_CORE_ERROR,
-                                 GRL_CORE_ERROR_QUERY_FAILED,
-                                 _("No database connection"));
-    ss->callback (ss->source, ss->operation_id, NULL, 0, ss->user_data, error);
-    g_error_free (error);
-    return;
-  }
+  /* Search results come from the database only */
+  flush_pending_writes (store_source);
+
+  sd = g_slice_new0 (SearchData);
+  sd->ss = ss;
 
   filters = g_string_new ("");
 
@@ -886,10 +1576,13 @@ grl_metadata_store_source_search (GrlSource *source,
   filter_type_val = grl_operation_options_get_type_filter (ss->options);
 
   if (filter_favourite_val) {
+    sd->filter_favourite = TRUE;
+    sd->favourite = g_value_get_boolean (filter_favourite_val);
     filters = g_string_append (filters, GRL_SQL_FAVOURITE_FILTER);
   }
 
   if (filter_source_val) {
+    sd->filter_source = g_value_dup_string (filter_source_val);
     if (filters->len > 0) {
       filters = g_string_append (filters, " AND ");
     }
@@ -897,21 +1590,22 @@ grl_metadata_store_source_search (GrlSource *source,
   }
 
   if (filter_type_val != GRL_TYPE_FILTER_ALL) {
+    sd->filter_type = TRUE;
     /* Fill the type_filter array */
     if (filter_type_val & GRL_TYPE_FILTER_AUDIO) {
-      type_filter[0] = MEDIA_AUDIO;
+      sd->type_filter[0] = MEDIA_AUDIO;
     } else {
-      type_filter[0] = -1;
+      sd->type_filter[0] = -1;
     }
     if (filter_type_val & GRL_TYPE_FILTER_VIDEO) {
-      type_filter[1] = MEDIA_VIDEO;
+      sd->type_filter[1] = MEDIA_VIDEO;
     } else {
-      type_filter[1] = -1;
+      sd->type_filter[1] = -1;
     }
     if (filter_type_val & GRL_TYPE_FILTER_IMAGE) {
-      type_filter[2] = MEDIA_IMAGE;
+      sd->type_filter[2] = MEDIA_IMAGE;
     } else {
-      type_filter[2] = -1;
+      sd->type_filter[2] = -1;
     }
     if (filters->len > 0) {
       filters = g_string_append (filters, " AND ");
@@ -920,86 +1614,19 @@ grl_metadata_store_source_search (GrlSource *source,
   }
 
   if (filters->len > 0) {
-    sql = g_strdup_printf (GRL_SQL_SEARCH_FILTER,
-                           filters->str,
-                           grl_operation_options_get_count (ss->options),
-                           grl_operation_options_get_skip (ss->options));
+    sd->sql = g_strdup_printf (GRL_SQL_SEARCH_FILTER,
+                               filters->str,
+                               grl_operation_options_get_count (ss->options),
+                               grl_operation_options_get_skip (ss->options));
   } else {
-    sql = g_strdup_printf (GRL_SQL_SEARCH,
-                           grl_operation_options_get_count (ss->options),
-                           grl_operation_options_get_skip (ss->options));
+    sd->sql = g_strdup_printf (GRL_SQL_SEARCH,
+                               grl_operation_options_get_count (ss->options),
+                               grl_operation_options_get_skip (ss->options));
   }
 
-  r = sqlite3_prepare_v2 (db, sql, -1, &sql_stmt, NULL);
-
-  g_free (sql);
   g_string_free (filters, TRUE);
 
-  if (r != SQLITE_OK) {
-    GRL_WARNING ("Failed to search in the metadata store: %s", sqlite3_errmsg (db));
-    error = g_error_new (GRL_CORE_ERROR,
-                         GRL_CORE_ERROR_SEARCH_FAILED,
-                         _("Failed to search: %s"),
-                         sqlite3_errmsg (db));
-    ss->callback (ss->source, ss->operation_id, NULL, 0, ss->user_data, error);
-    g_error_free (error);
-    return;
-  }
-
-  count = 1;
-
-  if (filter_favourite_val) {
-    sqlite3_bind_int (sql_stmt, count++, (gint) g_value_get_boolean (filter_favourite_val));
-  }
-
-  if (filter_source_val) {
-    sqlite3_bind_text (sql_stmt, count++, g_value_get_string (filter_source_val), -1, SQLITE_STATIC);
-  }
-
-  if (filter_type_val != GRL_TYPE_FILTER_ALL) {
-    for (i = 0; i < G_N_ELEMENTS (type_filter); i++) {
-      sqlite3_bind_int (sql_stmt, count++, type_filter[i]);
-    }
-  }
-
-  while ((r = sqlite3_step (sql_stmt)) == SQLITE_BUSY);
-
-  count = 0;
-  while (r == SQLITE_ROW) {
-    media = create_media (sql_stmt, ss->keys);
-    medias = g_list_prepend (medias, media);
-    count++;
-    r = sqlite3_step (sql_stmt);
-  }
-
-  if (r != SQLITE_DONE) {
-    GRL_WARNING ("Failed to search in the metadata store: %s", sqlite3_errmsg (db));
-    error = g_error_new (GRL_CORE_ERROR,
-                         GRL_CORE_ERROR_SEARCH_FAILED,
-                         _("Failed to search: %s"),
-                         sqlite3_errmsg (db));
-    ss->callback (ss->source, ss->operation_id, NULL, 0, ss->user_data, error);
-    g_error_free (error);
-    sqlite3_finalize (sql_stmt);
-    return;
-  }
-
-  sqlite3_finalize (sql_stmt);
-
-  if (count > 0) {
-    iter = medias;
-    while (iter) {
-      media = GRL_MEDIA (iter->data);
-      ss->callback (ss->source,
-                    ss->operation_id,
-                    media,
-                    --count,
-                    ss->user_data,
-                    NULL);
-      iter = g_list_next (iter);
-    }
-    g_list_free (medias);
-  } else {
-    ss->callback (ss->source, ss->operation_id, NULL, 0, ss->user_data, NULL);
-  }
+  grl_db_worker_push (store_source->priv->worker, source,
+                      search_job, sd, NULL,
+                      search_done, sd);
 }
@@ -34,6 +34,7 @@
 #include <string.h>
 #include <totem-pl-parser.h>
 
+#include "grl-db-worker.h"
 #include "grl-podcasts.h"
 
 #define GRL_ROOT_TITLE "Podcasts"
@@ -137,6 +138,10 @@ GRL_LOG_DOMAIN_STATIC(podcasts_log_domain);
   "    image=? "                                \
   "WHERE id=?"
 
+#define GRL_SQL_BEGIN_TRANSACTION "BEGIN TRANSACTION"
+#define GRL_SQL_COMMIT_TRANSACTION "COMMIT TRANSACTION"
+#define GRL_SQL_ROLLBACK_TRANSACTION "ROLLBACK TRANSACTION"
+
 /* --- Other --- */
 
 #define DEFAULT_CACHE_TIME (24 * 60 * 60)
@@ -194,7 +199,8 @@ typedef struct {
 } Entry;
 
 struct _GrlPodcastsPrivate {
-  sqlite3 *db;
+  /* All SQLite calls are run in this worker thread */
+  GrlDbWorker *worker;
   GrlNetWc *wc;
   gboolean notify_changes;
   gint cache_time;
@@ -223,8 +229,52 @@ typedef struct {
   guint parse_index;
   guint parse_valid_index;
   GrlMedia *last_media;
+  /* Parsed entries, stored in the database once the whole feed is done */
+  GPtrArray *entries;
 } OperationSpecParse;
 
+/* Plain copy of a podcasts or streams row, built in the database worker */
+typedef struct {
+  gchar *id;
+  gchar *title;
+  gchar *url;
+  gchar *desc;
+  gchar *mime;
+  gchar *date;
+  gchar *image;
+  gchar *last_refreshed;
+  guint duration;
+  guint childcount;
+} DbRow;
+
+typedef struct {
+  gchar *sql;
+  gboolean is_podcast;
+  guint error_code;
+  /* DbRow results, filled by the worker */
+  GList *rows;
+  gpointer spec;
+} DbQuery;
+
+typedef struct {
+  gchar *podcast_id;
+  PodcastData *podcast_data;
+} RefreshData;
+
+typedef struct {
+  GrlSourceStoreSpec *ss;
+  GList *keylist;
+  gchar *url;
+  gchar *title;
+  gchar *desc;
+  gint64 id;
+} StorePodcastData;
+
+typedef struct {
+  gchar *podcast_id;
+  GPtrArray *entries;
+} StoreStreamsData;
+
 static GrlPodcastsSource *grl_podcasts_source_new (void);
 
 static void grl_podcasts_source_finalize (GObject *plugin);
@@ -362,46 +412,19 @@ grl_podcasts_source_class_init (GrlPodcastsSourceClass * klass)
   source_class->notify_change_stop = grl_podcasts_source_notify_change_stop;
 }
 
-static void
-grl_podcasts_source_init (GrlPodcastsSource *source)
+static gboolean
+init_db (sqlite3 *db, gpointer data, GError **error)
 {
   gint r;
-  gchar *path;
-  gchar *db_path;
   gchar *sql_error = NULL;
 
-  source->priv = grl_podcasts_source_get_instance_private (source);
-
-  path = g_strconcat (g_get_user_data_dir (),
-                      G_DIR_SEPARATOR_S, "grilo-plugins",
-                      NULL);
-
-  if (!g_file_test (path, G_FILE_TEST_IS_DIR)) {
-    g_mkdir_with_parents (path, 0775);
-  }
-
-  GRL_DEBUG ("Opening database connection...");
-  db_path = g_strconcat (path, G_DIR_SEPARATOR_S, GRL_SQL_DB, NULL);
-  r = sqlite3_open (db_path, &source->priv->db);
-  g_free (path);
-  g_free (db_path);
-
-  if (r) {
-    g_critical ("Failed to open database '%s': %s",
-		db_path, sqlite3_errmsg (source->priv->db));
-    sqlite3_close (source->priv->db);
-    source->priv->db = NULL;
-    return;
-  }
-  GRL_DEBUG ("  OK");
-
   GRL_DEBUG ("Checking database tables...");
-  r = sqlite3_exec (source->priv->db, GRL_SQL_CREATE_TABLE_PODCASTS,
+  r = sqlite3_exec (db, GRL_SQL_CREATE_TABLE_PODCASTS,
 		    NULL, NULL, &sql_error);
 
   if (!r) {
     /* TODO: if this fails, sqlite stays in an unreliable state fix that */
-    r = sqlite3_exec (source->priv->db, GRL_SQL_CREATE_TABLE_STREAMS,
+    r = sqlite3_exec (db, GRL_SQL_CREATE_TABLE_STREAMS,
 		      NULL, NULL, &sql_error);
   }
   if (r) {
@@ -411,11 +434,37 @@ grl_podcasts_source_init (GrlPodcastsSource *source)
     } else {
       GRL_WARNING ("Failed to create database tables.");
     }
-    sqlite3_close (source->priv->db);
-    source->priv->db = NULL;
-    return;
+    g_set_error_literal (error,
+                         GRL_CORE_ERROR,
+                         GRL_CORE_ERROR_QUERY_FAILED,
+                         _("Failed to create database tables"));
+    return FALSE;
   }
   GRL_DEBUG ("  OK");
+
+  return TRUE;
+}
+
+static void
+grl_podcasts_source_init (GrlPodcastsSource *source)
+{
+  gchar *path;
+  gchar *db_path;
+
+  source->priv = grl_podcasts_source_get_instance_private (source);
+
+  path = g_strconcat (g_get_user_data_dir (),
+                      G_DIR_SEPARATOR_S, "grilo-plugins",
+                      NULL);
+
+  if (!g_file_test (path, G_FILE_TEST_IS_DIR)) {
+    g_mkdir_with_parents (path, 0775);
+  }
+
+  db_path = g_strconcat (path, G_DIR_SEPARATOR_S, GRL_SQL_DB, NULL);
+  source->priv->worker = grl_db_worker_new (db_path, init_db);
+  g_free (path);
+  g_free (db_path);
 }
 
 static void
@@ -429,8 +478,8 @@ grl_podcasts_source_finalize (GObject *object)
 
   g_clear_object (&source->priv->wc);
 
-  if (source->priv->db)
-    sqlite3_close (source->priv->db);
+  /* Waits for the queued jobs */
+  grl_db_worker_free (source->priv->worker);
 
   G_OBJECT_CLASS (grl_podcasts_source_parent_class)->finalize (object);
 }
@@ -677,120 +726,171 @@ build_media_from_entry (Entry *entry)
   return media;
 }
 
+static void
+free_db_row (DbRow *row)
+{
+  g_free (row->id);
+  g_free (row->title);
+  g_free (row->url);
+  g_free (row->desc);
+  g_free (row->mime);
+  g_free (row->date);
+  g_free (row->image);
+  g_free (row->last_refreshed);
+  g_slice_free (DbRow, row);
+}
+
+static DbRow *
+db_row_new_from_stmt (sqlite3_stmt *sql_stmt, gboolean is_podcast)
+{
+  DbRow *row = g_slice_new0 (DbRow);
+
+  if (is_podcast) {
+    row->id = g_strdup ((gchar *) sqlite3_column_text (sql_stmt, PODCAST_ID));
+    row->title = g_strdup ((gchar *) sqlite3_column_text (sql_stmt, PODCAST_TITLE));
+    row->url = g_strdup ((gchar *) sqlite3_column_text (sql_stmt, PODCAST_URL));
+    row->desc = g_strdup ((gchar *) sqlite3_column_text (sql_stmt, PODCAST_DESC));
+    row->last_refreshed =
+      g_strdup ((gchar *) sqlite3_column_text (sql_stmt, PODCAST_LAST_REFRESHED));
+    row->image = g_strdup ((gchar *) sqlite3_column_text (sql_stmt, PODCAST_IMAGE));
+    /* Streams are only counted when listing podcasts */
+    if (sqlite3_column_count (sql_stmt) > PODCAST_LAST) {
+      row->childcount = (guint) sqlite3_column_int (sql_stmt, PODCAST_LAST);
+    }
+  } else {
+    row->mime = g_strdup ((gchar *) sqlite3_column_text (sql_stmt, STREAM_MIME));
+    row->url = g_strdup ((gchar *) sqlite3_column_text (sql_stmt, STREAM_URL));
+    row->title = g_strdup ((gchar *) sqlite3_column_text (sql_stmt, STREAM_TITLE));
+    row->date = g_strdup ((gchar *) sqlite3_column_text (sql_stmt, STREAM_DATE));
+    row->desc = g_strdup ((gchar *) sqlite3_column_text (sql_stmt, STREAM_DESC));
+    row->duration = sqlite3_column_int (sql_stmt, STREAM_LENGTH);
+    row->image = g_strdup ((gchar *) sqlite3_column_text (sql_stmt, STREAM_IMAGE));
+  }
+
+  return row;
+}
+
 static GrlMedia *
-build_media_from_stmt (GrlMedia *content,
-		       sqlite3_stmt *sql_stmt,
-		       gboolean is_podcast)
+build_media_from_row (GrlMedia *content,
+                      DbRow *row,
+                      gboolean is_podcast)
 {
   GrlMedia *media;
-  gchar *id;
-  gchar *title;
-  gchar *url;
-  gchar *desc;
-  gchar *mime;
-  gchar *date;
-  gchar *image;
-  guint duration;
-  guint childcount;
 
   if (is_podcast) {
-    id = (gchar *) sqlite3_column_text (sql_stmt, PODCAST_ID);
-    title = (gchar *) sqlite3_column_text (sql_stmt, PODCAST_TITLE);
-    url = (gchar *) sqlite3_column_text (sql_stmt, PODCAST_URL);
-    desc = (gchar *) sqlite3_column_text (sql_stmt, PODCAST_DESC);
-    image = (gchar *) sqlite3_column_text (sql_stmt, PODCAST_IMAGE);
-    childcount = (guint) sqlite3_column_int (sql_stmt, PODCAST_LAST);
-    media = build_media (content, is_podcast, id,
-                         title, url, desc, NULL, NULL, image, 0, childcount);
+    media = build_media (content, is_podcast, row->id,
+                         row->title, row->url, row->desc, NULL, NULL,
+                         row->image, 0, row->childcount);
   } else {
-    mime = (gchar *) sqlite3_column_text (sql_stmt, STREAM_MIME);
-    url = (gchar *) sqlite3_column_text (sql_stmt, STREAM_URL);
-    title = (gchar *) sqlite3_column_text (sql_stmt, STREAM_TITLE);
-    date = (gchar *) sqlite3_column_text (sql_stmt, STREAM_DATE);
-    desc = (gchar *) sqlite3_column_text (sql_stmt, STREAM_DESC);
-    duration = sqlite3_column_int (sql_stmt, STREAM_LENGTH);
-    image = (gchar *) sqlite3_column_text (sql_stmt, STREAM_IMAGE);
-    media = build_media (content, is_podcast, url,
-                         title, url, desc, mime, date, image, duration, 0);
+    media = build_media (content, is_podcast, row->url,
+                         row->title, row->url, row->desc, row->mime, row->date,
+                         row->image, row->duration, 0);
   }
 
   return media;
 }
 
 static void
-produce_podcast_contents_from_db (OperationSpec *os)
+db_query_free (DbQuery *query)
 {
-  sqlite3 *db;
-  gchar *sql;
+  g_free (query->sql);
+  g_list_free_full (query->rows, (GDestroyNotify) free_db_row);
+  g_slice_free (DbQuery, query);
+}
+
+/* Runs in the database worker */
+static gboolean
+query_rows_job (sqlite3 *db, gpointer data, GError **error)
+{
+  DbQuery *query = data;
   sqlite3_stmt *sql_stmt = NULL;
-  GList *iter, *medias = NULL;
-  guint count = 0;
-  GrlMedia *media;
   gint r;
-  GError *error = NULL;
 
-  GRL_DEBUG ("produce_podcast_contents_from_db");
+  GRL_DEBUG ("%s", query->sql);
+  r = sqlite3_prepare_v2 (db, query->sql, strlen (query->sql), &sql_stmt, NULL);
 
-  db = GRL_PODCASTS_SOURCE (os->source)->priv->db;
-  /* Check if searching or browsing */
-  if (os->is_query) {
-    if (os->text) {
-      /* Search text */
-      sql = g_strdup_printf (GRL_SQL_GET_PODCAST_STREAMS_BY_TEXT,
-                             os->text, os->text, os->text, os->text,
-                             os->count, os->skip);
-    } else {
-      /* Return all */
-      sql = g_strdup_printf (GRL_SQL_GET_PODCAST_STREAMS_ALL,
-                             os->count, os->skip);
+  if (r == SQLITE_OK) {
+    while ((r = sqlite3_step (sql_stmt)) == SQLITE_BUSY);
+
+    while (r == SQLITE_ROW) {
+      query->rows = g_list_prepend (query->rows,
+                                    db_row_new_from_stmt (sql_stmt,
+                                                          query->is_podcast));
+      r = sqlite3_step (sql_stmt);
     }
-  } else {
-    sql = g_strdup_printf (GRL_SQL_GET_PODCAST_STREAMS,
-                           os->media_id, os->count, os->skip);
   }
-  GRL_DEBUG ("%s", sql);
-  r = sqlite3_prepare_v2 (db, sql, strlen (sql), &sql_stmt, NULL);
-  g_free (sql);
 
-  if (r != SQLITE_OK) {
-    GRL_WARNING ("Failed to retrieve podcast streams: %s", sqlite3_errmsg (db));
-    error = g_error_new (GRL_CORE_ERROR,
-                         os->error_code,
-                         _("Failed to get podcast streams: %s"),
-                         sqlite3_errmsg (db));
-    os->callback (os->source, os->operation_id, NULL, 0, os->user_data, error);
-    g_error_free (error);
-    return;
+  if (r != SQLITE_DONE) {
+    if (query->is_podcast) {
+      GRL_WARNING ("Failed to retrieve podcasts: %s", sqlite3_errmsg (db));
+      g_set_error (error,
+                   GRL_CORE_ERROR,
+                   query->error_code,
+                   _("Failed to get podcasts list: %s"),
+                   sqlite3_errmsg (db));
+    } else {
+      GRL_WARNING ("Failed to retrieve podcast streams: %s", sqlite3_errmsg (db));
+      g_set_error (error,
+                   GRL_CORE_ERROR,
+                   query->error_code,
+                   _("Failed to get podcast streams: %s"),
+                   sqlite3_errmsg (db));
+    }
+    sqlite3_finalize (sql_stmt);
+    return FALSE;
   }
 
-  while ((r = sqlite3_step (sql_stmt)) == SQLITE_BUSY);
+  sqlite3_finalize (sql_stmt);
+  query->rows = g_list_reverse (query->rows);
 
-  while (r == SQLITE_ROW) {
-    media = build_media_from_stmt (NULL, sql_stmt, FALSE);
-    medias = g_list_prepend (medias, media);
-    count++;
-    r = sqlite3_step (sql_stmt);
-  }
+  return TRUE;
+}
 
-  if (r != SQLITE_DONE) {
-    GRL_WARNING ("Failed to retrieve podcast streams: %s", sqlite3_errmsg (db));
-    error = g_error_new (GRL_CORE_ERROR,
-                         os->error_code,
-                         _("Failed to get podcast streams: %s"),
-                         sqlite3_errmsg (db));
+/* Runs @sql in the database worker. @callback is called in the main context
+   with the DbQuery holding the results as user data */
+static void
+query_rows (GrlPodcastsSource *source,
+            gchar *sql,
+            gboolean is_podcast,
+            guint error_code,
+            gpointer spec,
+            GAsyncReadyCallback callback)
+{
+  DbQuery *query;
+
+  query = g_slice_new0 (DbQuery);
+  query->sql = sql;
+  query->is_podcast = is_podcast;
+  query->error_code = error_code;
+  query->spec = spec;
+
+  grl_db_worker_push (source->priv->worker, source,
+                      query_rows_job, query, NULL,
+                      callback, query);
+}
+
+static void
+produce_rows_done (GObject *object, GAsyncResult *result, gpointer user_data)
+{
+  DbQuery *query = user_data;
+  OperationSpec *os = query->spec;
+  GError *error = NULL;
+  GrlMedia *media;
+  GList *iter;
+  guint count;
+
+  if (!grl_db_worker_finish (result, &error)) {
+    error->code = os->error_code;
     os->callback (os->source, os->operation_id, NULL, 0, os->user_data, error);
     g_error_free (error);
-    sqlite3_finalize (sql_stmt);
-    return;
+    goto free_resources;
   }
 
-  sqlite3_finalize (sql_stmt);
-
+  count = g_list_length (query->rows);
   if (count > 0) {
-    medias = g_list_reverse (medias);
-    iter = medias;
+    iter = query->rows;
     while (iter) {
-      media = GRL_MEDIA (iter->data);
+      media = build_media_from_row (NULL, iter->data, query->is_podcast);
       os->callback (os->source,
 		    os->operation_id,
 		    media,
@@ -799,13 +899,46 @@ produce_podcast_contents_from_db (OperationSpec *os)
 		    NULL);
       iter = g_list_next (iter);
     }
-    g_list_free (medias);
   } else {
     os->callback (os->source, os->operation_id, NULL, 0, os->user_data, NULL);
   }
+
+ free_resources:
+  g_slice_free (OperationSpec, os);
+  db_query_free (query);
 }
 
+/* Takes ownership of @os */
 static void
+produce_podcast_contents_from_db (OperationSpec *os)
+{
+  gchar *sql;
+
+  GRL_DEBUG ("produce_podcast_contents_from_db");
+
+  /* Check if searching or browsing */
+  if (os->is_query) {
+    if (os->text) {
+      /* Search text */
+      sql = g_strdup_printf (GRL_SQL_GET_PODCAST_STREAMS_BY_TEXT,
+                             os->text, os->text, os->text, os->text,
+                             os->count, os->skip);
+    } else {
+      /* Return all */
+      sql = g_strdup_printf (GRL_SQL_GET_PODCAST_STREAMS_ALL,
+                             os->count, os->skip);
+    }
+  } else {
+    sql = g_strdup_printf (GRL_SQL_GET_PODCAST_STREAMS,
+                           os->media_id, os->count, os->skip);
+  }
+
+  query_rows (GRL_PODCASTS_SOURCE (os->source), sql, FALSE, os->error_code,
+              os, produce_rows_done);
+}
+
+/* Runs in the database worker */
+static gboolean
 remove_podcast_streams (sqlite3 *db, const gchar *podcast_id, GError **error)
 {
   gchar *sql;
@@ -818,33 +951,36 @@ remove_podcast_streams (sqlite3 *db, const gchar *podcast_id, GError **error)
   g_free (sql);
   if (r) {
     GRL_WARNING ("Failed to remove podcast streams cache: %s", sql_error);
-    *error = g_error_new (GRL_CORE_ERROR,
-                          GRL_CORE_ERROR_REMOVE_FAILED,
-                          _("Failed to remove: %s"),
-                          sql_error);
-    sqlite3_free (error);
+    g_set_error (error,
+                 GRL_CORE_ERROR,
+                 GRL_CORE_ERROR_REMOVE_FAILED,
+                 _("Failed to remove: %s"),
+                 sql_error);
+    sqlite3_free (sql_error);
+    return FALSE;
   }
+
+  return TRUE;
 }
 
-static void
-remove_podcast (GrlPodcastsSource *podcasts_source,
-                const gchar *podcast_id,
-                GError **error)
+/* Runs in the database worker */
+static gboolean
+remove_podcast (sqlite3 *db, gpointer data, GError **error)
 {
+  const gchar *podcast_id = data;
   gint r;
   gchar *sql_error;
   gchar *sql;
 
   GRL_DEBUG ("remove_podcast");
 
-  remove_podcast_streams (podcasts_source->priv->db, podcast_id, error);
-  if (*error) {
-    return;
+  if (!remove_podcast_streams (db, podcast_id, error)) {
+    return FALSE;
   }
 
   sql = g_strdup_printf (GRL_SQL_REMOVE_PODCAST, podcast_id);
   GRL_DEBUG ("%s", sql);
-  r = sqlite3_exec (podcasts_source->priv->db, sql, NULL, NULL, &sql_error);
+  r = sqlite3_exec (db, sql, NULL, NULL, &sql_error);
   g_free (sql);
 
   if (r != SQLITE_OK) {
@@ -855,19 +991,17 @@ remove_podcast (GrlPodcastsSource *podcasts_source,
                  _("Failed to remove: %s"),
                  sql_error);
     sqlite3_free (sql_error);
-  } else if (podcasts_source->priv->notify_changes) {
-    grl_source_notify_change (GRL_SOURCE (podcasts_source),
-                              NULL,
-                              GRL_CONTENT_REMOVED,
-                              TRUE);
+    return FALSE;
   }
+
+  return TRUE;
 }
 
-static void
-remove_stream (GrlPodcastsSource *podcasts_source,
-               const gchar *url,
-               GError **error)
+/* Runs in the database worker */
+static gboolean
+remove_stream (sqlite3 *db, gpointer data, GError **error)
 {
+  const gchar *url = data;
   gint r;
   gchar *sql_error;
   gchar *sql;
@@ -876,7 +1010,7 @@ remove_stream (GrlPodcastsSource *podcasts_source,
 
   sql = g_strdup_printf (GRL_SQL_REMOVE_STREAM, url);
   GRL_DEBUG ("%s", sql);
-  r = sqlite3_exec (podcasts_source->priv->db, sql, NULL, NULL, &sql_error);
+  r = sqlite3_exec (db, sql, NULL, NULL, &sql_error);
   g_free (sql);
 
   if (r != SQLITE_OK) {
@@ -887,100 +1021,170 @@ remove_stream (GrlPodcastsSource *podcasts_source,
                  _("Failed to remove: %s"),
                  sql_error);
     sqlite3_free (sql_error);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+remove_done (GObject *object, GAsyncResult *result, gpointer user_data)
+{
+  GrlPodcastsSource *podcasts_source = GRL_PODCASTS_SOURCE (object);
+  GrlSourceRemoveSpec *rs = user_data;
+  GError *error = NULL;
+
+  if (!grl_db_worker_finish (result, &error)) {
+    error->code = GRL_CORE_ERROR_REMOVE_FAILED;
   } else if (podcasts_source->priv->notify_changes) {
     grl_source_notify_change (GRL_SOURCE (podcasts_source),
                               NULL,
                               GRL_CONTENT_REMOVED,
                               TRUE);
   }
+
+  rs->callback (rs->source, rs->media, rs->user_data, error);
+  g_clear_error (&error);
 }
 
 static void
-store_podcast (GrlPodcastsSource *podcasts_source,
-               GList **keylist,
-               GrlMedia *podcast,
-               GError **error)
+free_store_podcast_data (StorePodcastData *sd)
 {
-  gint r;
-  sqlite3_stmt *sql_stmt = NULL;
-  const gchar *title;
-  const gchar *url;
-  const gchar *desc;
-  gchar *id;
-
-  GRL_DEBUG ("store_podcast");
+  g_list_free (sd->keylist);
+  g_free (sd->url);
+  g_free (sd->title);
+  g_free (sd->desc);
+  g_slice_free (StorePodcastData, sd);
+}
 
-  title = grl_media_get_title (podcast);
-  url = grl_media_get_url (podcast);
-  desc = grl_media_get_description (podcast);
+/* Runs in the database worker */
+static gboolean
+store_podcast_job (sqlite3 *db, gpointer data, GError **error)
+{
+  StorePodcastData *sd = data;
+  sqlite3_stmt *sql_stmt = NULL;
+  gint r;
 
   GRL_DEBUG ("%s", GRL_SQL_STORE_PODCAST);
-  r = sqlite3_prepare_v2 (podcasts_source->priv->db,
+  r = sqlite3_prepare_v2 (db,
 			  GRL_SQL_STORE_PODCAST,
 			  strlen (GRL_SQL_STORE_PODCAST),
 			  &sql_stmt, NULL);
   if (r != SQLITE_OK) {
-    GRL_WARNING ("Failed to store podcast '%s': %s", title,
-                 sqlite3_errmsg (podcasts_source->priv->db));
+    GRL_WARNING ("Failed to store podcast '%s': %s", sd->title,
+                 sqlite3_errmsg (db));
     g_set_error (error,
                  GRL_CORE_ERROR,
                  GRL_CORE_ERROR_STORE_FAILED,
                  _("Failed to store: %s"),
-                 sqlite3_errmsg (podcasts_source->priv->db));
-    return;
-  }
-
-  sqlite3_bind_text (sql_stmt, 1, url, -1, SQLITE_STATIC);
-  *keylist = g_list_remove (*keylist,
-                            GRLKEYID_TO_POINTER (GRL_METADATA_KEY_URL));
-
-  if (title) {
-    sqlite3_bind_text (sql_stmt, 2, title, -1, SQLITE_STATIC);
-    *keylist = g_list_remove (*keylist,
-                              GRLKEYID_TO_POINTER (GRL_METADATA_KEY_TITLE));
-  } else {
-    sqlite3_bind_text (sql_stmt, 2, url, -1, SQLITE_STATIC);
+                 sqlite3_errmsg (db));
+    return FALSE;
   }
 
-  if (desc) {
-    sqlite3_bind_text (sql_stmt, 3, desc, -1, SQLITE_STATIC);
-    *keylist = g_list_remove (*keylist,
-                              GRLKEYID_TO_POINTER (GRL_METADATA_KEY_DESCRIPTION));
-  } else {
-    sqlite3_bind_text (sql_stmt, 3, "", -1, SQLITE_STATIC);
-  }
+  sqlite3_bind_text (sql_stmt, 1, sd->url, -1, SQLITE_STATIC);
+  sqlite3_bind_text (sql_stmt, 2, sd->title, -1, SQLITE_STATIC);
+  sqlite3_bind_text (sql_stmt, 3, sd->desc, -1, SQLITE_STATIC);
 
   while ((r = sqlite3_step (sql_stmt)) == SQLITE_BUSY);
 
   if (r != SQLITE_DONE) {
-    GRL_WARNING ("Failed to store podcast '%s': %s", title,
-                 sqlite3_errmsg (podcasts_source->priv->db));
+    GRL_WARNING ("Failed to store podcast '%s': %s", sd->title,
+                 sqlite3_errmsg (db));
     g_set_error (error,
                  GRL_CORE_ERROR,
                  GRL_CORE_ERROR_STORE_FAILED,
                  _("Failed to store: %s"),
-                 sqlite3_errmsg (podcasts_source->priv->db));
+                 sqlite3_errmsg (db));
     sqlite3_finalize (sql_stmt);
-    return;
+    return FALSE;
   }
 
   sqlite3_finalize (sql_stmt);
 
-  id = g_strdup_printf ("%llu",
-                        sqlite3_last_insert_rowid (podcasts_source->priv->db));
-  grl_media_set_id (podcast, id);
-  g_free (id);
+  sd->id = sqlite3_last_insert_rowid (db);
 
-  if (podcasts_source->priv->notify_changes) {
-    grl_source_notify_change (GRL_SOURCE (podcasts_source),
-                              NULL,
-                              GRL_CONTENT_ADDED,
-                              FALSE);
-  }
+  return TRUE;
 }
 
 static void
-store_stream (sqlite3 *db, const gchar *podcast_id, Entry *entry)
+store_podcast_done (GObject *object, GAsyncResult *result, gpointer user_data)
+{
+  GrlPodcastsSource *podcasts_source = GRL_PODCASTS_SOURCE (object);
+  StorePodcastData *sd = user_data;
+  GrlSourceStoreSpec *ss = sd->ss;
+  GError *error = NULL;
+  gchar *id;
+
+  if (!grl_db_worker_finish (result, &error)) {
+    error->code = GRL_CORE_ERROR_STORE_FAILED;
+  } else {
+    id = g_strdup_printf ("%" G_GINT64_FORMAT, sd->id);
+    grl_media_set_id (ss->media, id);
+    g_free (id);
+
+    if (podcasts_source->priv->notify_changes) {
+      grl_source_notify_change (GRL_SOURCE (podcasts_source),
+                                NULL,
+                                GRL_CONTENT_ADDED,
+                                FALSE);
+    }
+  }
+
+  ss->callback (ss->source, ss->media, sd->keylist, ss->user_data, error);
+
+  g_clear_error (&error);
+  free_store_podcast_data (sd);
+}
+
+/* Takes ownership of @keylist */
+static void
+store_podcast (GrlPodcastsSource *podcasts_source,
+               GList *keylist,
+               GrlSourceStoreSpec *ss)
+{
+  StorePodcastData *sd;
+  const gchar *title;
+  const gchar *url;
+  const gchar *desc;
+
+  GRL_DEBUG ("store_podcast");
+
+  title = grl_media_get_title (ss->media);
+  url = grl_media_get_url (ss->media);
+  desc = grl_media_get_description (ss->media);
+
+  sd = g_slice_new0 (StorePodcastData);
+  sd->ss = ss;
+  sd->url = g_strdup (url);
+  keylist = g_list_remove (keylist,
+                           GRLKEYID_TO_POINTER (GRL_METADATA_KEY_URL));
+
+  if (title) {
+    sd->title = g_strdup (title);
+    keylist = g_list_remove (keylist,
+                             GRLKEYID_TO_POINTER (GRL_METADATA_KEY_TITLE));
+  } else {
+    sd->title = g_strdup (url);
+  }
+
+  if (desc) {
+    sd->desc = g_strdup (desc);
+    keylist = g_list_remove (keylist,
+                             GRLKEYID_TO_POINTER (GRL_METADATA_KEY_DESCRIPTION));
+  } else {
+    sd->desc = g_strdup ("");
+  }
+
+  sd->keylist = keylist;
+
+  grl_db_worker_push (podcasts_source->priv->worker, podcasts_source,
+                      store_podcast_job, sd, NULL,
+                      store_podcast_done, sd);
+}
+
+/* Runs in the database worker */
+static void
+store_stream (sqlite3 *db, const gchar *podcast_id, Entry *entry)
 {
   gint r;
   guint seconds;
@@ -1022,6 +1226,53 @@ store_stream (sqlite3 *db, const gchar *podcast_id, Entry *entry)
   sqlite3_finalize (sql_stmt);
 }
 
+
+static void
+free_store_streams_data (StoreStreamsData *sd)
+{
+  g_free (sd->podcast_id);
+  g_ptr_array_unref (sd->entries);
+  g_slice_free (StoreStreamsData, sd);
+}
+
+/* Runs in the database worker */
+static gboolean
+store_streams_job (sqlite3 *db, gpointer data, GError **error)
+{
+  StoreStreamsData *sd = data;
+  guint i;
+
+  sqlite3_exec (db, GRL_SQL_BEGIN_TRANSACTION, NULL, NULL, NULL);
+
+  for (i = 0; i < sd->entries->len; i++) {
+    store_stream (db, sd->podcast_id, g_ptr_array_index (sd->entries, i));
+  }
+
+  if (sqlite3_exec (db, GRL_SQL_COMMIT_TRANSACTION, NULL, NULL, NULL) != SQLITE_OK) {
+    GRL_WARNING ("Failed to store podcast streams: %s", sqlite3_errmsg (db));
+    sqlite3_exec (db, GRL_SQL_ROLLBACK_TRANSACTION, NULL, NULL, NULL);
+  }
+
+  return TRUE;
+}
+
+static void
+store_streams (GrlPodcastsSource *podcasts_source,
+               const gchar *podcast_id,
+               GPtrArray *entries)
+{
+  StoreStreamsData *sd;
+
+  sd = g_slice_new0 (StoreStreamsData);
+  sd->podcast_id = g_strdup (podcast_id);
+  sd->entries = g_ptr_array_ref (entries);
+
+  grl_db_worker_push (podcasts_source->priv->worker, NULL,
+                      store_streams_job,
+                      sd, (GDestroyNotify) free_store_streams_data,
+                      NULL, NULL);
+}
+
 static PodcastData *
 parse_podcast_data (xmlDocPtr doc, xmlXPathObjectPtr xpathObj)
 {
@@ -1098,6 +1349,7 @@ parse_entry (xmlDocPtr doc, xmlNodePtr entry, Entry *data)
   }
 }
 
+/* Runs in the database worker */
 static void
 touch_podcast (sqlite3 *db, const gchar *podcast_id, PodcastData *data)
 {
@@ -1140,6 +1392,41 @@ touch_podcast (sqlite3 *db, const gchar *podcast_id, PodcastData *data)
   g_free (now_str);
 }
 
+static void
+free_refresh_data (RefreshData *rd)
+{
+  g_free (rd->podcast_id);
+  free_podcast_data (rd->podcast_data);
+  g_slice_free (RefreshData, rd);
+}
+
+/* Runs in the database worker */
+static gboolean
+refresh_podcast_job (sqlite3 *db, gpointer data, GError **error)
+{
+  RefreshData *rd = data;
+
+  /* First, remove old entries for this podcast */
+  if (!remove_podcast_streams (db, rd->podcast_id, error)) {
+    return FALSE;
+  }
+
+  /* Then update the podcast data, including the last_refreshed date */
+  touch_podcast (db, rd->podcast_id, rd->podcast_data);
+
+  return TRUE;
+}
+
+static void
+free_operation_spec_parse (OperationSpecParse *osp)
+{
+  g_clear_pointer (&osp->entries, g_ptr_array_unref);
+  xmlXPathFreeObject (osp->xpathObj);
+  xmlXPathFreeContext (osp->xpathCtx);
+  xmlFreeDoc (osp->doc);
+  g_slice_free (OperationSpecParse, osp);
+}
+
 static gboolean
 parse_entry_idle (gpointer user_data)
 {
@@ -1160,6 +1447,7 @@ parse_entry_idle (gpointer user_data)
   /* Check if entry is valid */
   if (!entry->url || entry->url[0] == '\0') {
     GRL_DEBUG ("Podcast stream has no URL, skipping");
+    free_entry (entry);
   } else {
     /* Provide results to user as fast as possible */
     if (osp->parse_valid_index >= osp->os->skip &&
@@ -1186,15 +1474,17 @@ parse_entry_idle (gpointer user_data)
 
     osp->parse_valid_index++;
 
-    /* And store stream in database cache */
-    store_stream (GRL_PODCASTS_SOURCE (osp->os->source)->priv->db,
-		  osp->os->media_id, entry);
+    /* And keep stream for the database cache */
+    g_ptr_array_add (osp->entries, entry);
   }
 
   osp->parse_index++;
-  free_entry (entry);
 
   if (osp->parse_index >= osp->parse_count) {
+    /* Store all the streams in a single transaction. Database jobs are run
+       in order, so queries issued after the last result see them */
+    store_streams (GRL_PODCASTS_SOURCE (osp->os->source),
+                   osp->os->media_id, osp->entries);
     /* Send last result */
     osp->os->callback (osp->os->source,
 		       osp->os->operation_id,
@@ -1213,26 +1503,76 @@ parse_entry_idle (gpointer user_data)
       g_object_unref (media);
     }
     g_slice_free (OperationSpec, osp->os);
-    xmlXPathFreeObject (osp->xpathObj);
-    xmlXPathFreeContext (osp->xpathCtx);
-    xmlFreeDoc (osp->doc);
-    g_slice_free (OperationSpecParse, osp);
+    free_operation_spec_parse (osp);
+    return FALSE;
   }
 
-  return osp->parse_index < osp->parse_count;
+  return TRUE;
+}
+
+static void
+refresh_podcast_done (GObject *object, GAsyncResult *result, gpointer user_data)
+{
+  OperationSpecParse *osp = user_data;
+  OperationSpec *os = osp->os;
+  GrlMedia *podcast;
+  GError *error = NULL;
+  guint id;
+
+  if (!grl_db_worker_finish (result, &error)) {
+    error->code = os->error_code;
+    os->callback (os->source,
+		  os->operation_id,
+		  NULL,
+		  0,
+		  os->user_data,
+		  error);
+    g_error_free (error);
+    goto free_resources;
+  }
+
+  /* If the feed contains no streams, notify and bail out */
+  GRL_DEBUG ("Got %d streams", osp->parse_count);
+
+  if (osp->parse_count == 0) {
+    if (GRL_PODCASTS_SOURCE (os->source)->priv->notify_changes) {
+      podcast = grl_media_container_new ();
+      grl_media_set_id (podcast, os->media_id);
+      grl_source_notify_change (GRL_SOURCE (os->source),
+                                podcast,
+                                GRL_CONTENT_CHANGED,
+                                FALSE);
+      g_object_unref (podcast);
+    }
+    os->callback (os->source,
+		  os->operation_id,
+		  NULL,
+		  0,
+		  os->user_data,
+		  NULL);
+    goto free_resources;
+  }
+
+  /* Otherwise parse the streams in idle loop to prevent blocking */
+  id = g_idle_add (parse_entry_idle, osp);
+  g_source_set_name_by_id (id, "[podcasts] parse_entry_idle");
+  return;
+
+ free_resources:
+  g_slice_free (OperationSpec, os);
+  free_operation_spec_parse (osp);
 }
 
 static void
 parse_feed (OperationSpec *os, const gchar *str, GError **error)
 {
   GrlPodcastsSource *source;
-  GrlMedia *podcast = NULL;
   xmlDocPtr doc = NULL;
   xmlXPathContextPtr xpathCtx = NULL;
   xmlXPathObjectPtr xpathObj = NULL;
-  guint stream_count;
   PodcastData *podcast_data = NULL;
-  guint id;
+  OperationSpecParse *osp;
+  RefreshData *rd;
 
   GRL_DEBUG ("parse_feed");
 
@@ -1288,7 +1628,6 @@ parse_feed (OperationSpec *os, const gchar *str, GError **error)
       GRL_DEBUG ("Podcast feed is up-to-date");
       /* We do not need to parse again, we already have the contents in cache */
       produce_podcast_contents_from_db (os);
-      g_slice_free (OperationSpec, os);
       goto free_resources;
     }
   }
@@ -1305,50 +1644,23 @@ parse_feed (OperationSpec *os, const gchar *str, GError **error)
     goto free_resources;
   }
 
-  /* Feed is ok, let's process it */
-
-  /* First, remove old entries for this podcast */
-  remove_podcast_streams (source->priv->db,  os->media_id, error);
-  if (*error) {
-    (*error)->code = os->error_code;
-    goto free_resources;
-  }
-
-  /* Then update the podcast data, including the last_refreshed date */
-  touch_podcast (source->priv->db, os->media_id, podcast_data);
-
-  /* If the feed contains no streams, notify and bail out */
-  stream_count = xpathObj->nodesetval ? xpathObj->nodesetval->nodeNr : 0;
-  GRL_DEBUG ("Got %d streams", stream_count);
-
-  if (stream_count <= 0) {
-    if (GRL_PODCASTS_SOURCE (os->source)->priv->notify_changes) {
-      podcast = grl_media_container_new ();
-      grl_media_set_id (podcast, os->media_id);
-      grl_source_notify_change (GRL_SOURCE (os->source),
-                                podcast,
-                                GRL_CONTENT_CHANGED,
-                                FALSE);
-      g_object_unref (podcast);
-    }
-    os->callback (os->source,
-		  os->operation_id,
-		  NULL,
-		  0,
-		  os->user_data,
-		  NULL);
-    goto free_resources;
-  }
-
-  /* Otherwise parse the streams in idle loop to prevent blocking */
-  OperationSpecParse *osp = g_slice_new0 (OperationSpecParse);
+  /* Feed is ok, let's process it once the old entries are removed */
+  osp = g_slice_new0 (OperationSpecParse);
   osp->os = os;
   osp->doc = doc;
   osp->xpathCtx = xpathCtx;
   osp->xpathObj = xpathObj;
-  osp->parse_count = stream_count;
-  id = g_idle_add (parse_entry_idle, osp);
-  g_source_set_name_by_id (id, "[podcasts] parse_entry_idle");
+  osp->parse_count = xpathObj->nodesetval ? xpathObj->nodesetval->nodeNr : 0;
+  osp->entries = g_ptr_array_new_with_free_func ((GDestroyNotify) free_entry);
+
+  rd = g_slice_new0 (RefreshData);
+  rd->podcast_id = g_strdup (os->media_id);
+  rd->podcast_data = podcast_data;
+
+  grl_db_worker_push (source->priv->worker, source,
+                      refresh_podcast_job,
+                      rd, (GDestroyNotify) free_refresh_data,
+                      refresh_podcast_done, osp);
   return;
 
  free_resources:
@@ -1384,102 +1696,82 @@ read_feed_cb (gchar *xmldata, gpointer user_data)
   }
 }
 
-static sqlite3_stmt *
-get_podcast_info (sqlite3 *db, const gchar *podcast_id)
+static void
+get_podcast_info (GrlPodcastsSource *source,
+                  const gchar *podcast_id,
+                  guint error_code,
+                  gpointer spec,
+                  GAsyncReadyCallback callback)
 {
-  gint r;
-  sqlite3_stmt *sql_stmt = NULL;
-  gchar *sql;
-
   GRL_DEBUG ("get_podcast_info");
 
-  sql = g_strdup_printf (GRL_SQL_GET_PODCAST_BY_ID, podcast_id);
-  GRL_DEBUG ("%s", sql);
-  r = sqlite3_prepare_v2 (db, sql, strlen (sql), &sql_stmt, NULL);
-  g_free (sql);
-
-  if (r != SQLITE_OK) {
-    GRL_WARNING ("Failed to retrieve podcast '%s': %s",
-                 podcast_id, sqlite3_errmsg (db));
-    return NULL;
-  }
-
-  while ((r = sqlite3_step (sql_stmt)) == SQLITE_BUSY);
-
-  if (r == SQLITE_ROW) {
-    return sql_stmt;
-  } else {
-    GRL_WARNING ("Failed to retrieve podcast information: %s",
-                 sqlite3_errmsg (db));
-    sqlite3_finalize (sql_stmt);
-    return NULL;
-  }
+  query_rows (source,
+              g_strdup_printf (GRL_SQL_GET_PODCAST_BY_ID, podcast_id),
+              TRUE, error_code, spec, callback);
 }
 
 static void
-produce_podcast_contents (OperationSpec *os)
+produce_podcast_contents_done (GObject *object,
+                               GAsyncResult *result,
+                               gpointer user_data)
 {
-  sqlite3_stmt *sql_stmt = NULL;
-  sqlite3 *db;
+  DbQuery *query = user_data;
+  OperationSpec *os = query->spec;
+  DbRow *row;
   GError *error;
-  gchar *url;
-
-  GRL_DEBUG ("produce_podcast_contents");
 
-  /* First we get some information about the podcast */
-  db = GRL_PODCASTS_SOURCE (os->source)->priv->db;
-  sql_stmt = get_podcast_info (db, os->media_id);
-  if (sql_stmt) {
-    gchar *lr_str;
+  if (!grl_db_worker_finish (result, NULL) || !query->rows) {
+    GRL_WARNING ("Failed to retrieve podcast information");
+    error = g_error_new_literal (GRL_CORE_ERROR,
+                                 os->error_code,
+                                 _("Failed to get podcast information"));
+    os->callback (os->source, os->operation_id, NULL, 0, os->user_data, error);
+    g_error_free (error);
+    g_slice_free (OperationSpec, os);
+  } else {
     GTimeVal lr;
     GTimeVal now;
 
+    row = query->rows->data;
+
     /* Check if we have to refresh the podcast */
-    lr_str = (gchar *) sqlite3_column_text (sql_stmt, PODCAST_LAST_REFRESHED);
-    GRL_DEBUG ("Podcast last-refreshed: '%s'", lr_str);
-    g_time_val_from_iso8601 (lr_str ? lr_str : "", &lr);
+    GRL_DEBUG ("Podcast last-refreshed: '%s'", row->last_refreshed);
+    g_time_val_from_iso8601 (row->last_refreshed ? row->last_refreshed : "", &lr);
     os->last_refreshed = lr.tv_sec;
     g_get_current_time (&now);
     now.tv_sec -= GRL_PODCASTS_SOURCE (os->source)->priv->cache_time;
-    if (lr_str == NULL || now.tv_sec >= lr.tv_sec) {
+    if (row->last_refreshed == NULL || now.tv_sec >= lr.tv_sec) {
       /* We have to read the podcast feed again */
       GRL_DEBUG ("Refreshing podcast '%s'...", os->media_id);
-      url = g_strdup ((gchar *) sqlite3_column_text (sql_stmt, PODCAST_URL));
-      read_url_async (GRL_PODCASTS_SOURCE (os->source), url, read_feed_cb, os);
-      g_free (url);
+      read_url_async (GRL_PODCASTS_SOURCE (os->source), row->url, read_feed_cb, os);
     } else {
       /* We can read the podcast entries from the database cache */
       produce_podcast_contents_from_db (os);
-      g_slice_free (OperationSpec, os);
     }
-    sqlite3_finalize (sql_stmt);
-  } else {
-    error = g_error_new_literal (GRL_CORE_ERROR,
-                                 os->error_code,
-                                 _("Failed to get podcast information"));
-    os->callback (os->source, os->operation_id, NULL, 0, os->user_data, error);
-    g_error_free (error);
-    g_slice_free (OperationSpec, os);
   }
+
+  db_query_free (query);
+}
+
+/* Takes ownership of @os */
+static void
+produce_podcast_contents (OperationSpec *os)
+{
+  GRL_DEBUG ("produce_podcast_contents");
+
+  /* First we get some information about the podcast */
+  get_podcast_info (GRL_PODCASTS_SOURCE (os->source), os->media_id,
+                    os->error_code, os, produce_podcast_contents_done);
 }
 
+/* Takes ownership of @os */
 static void
 produce_podcasts (OperationSpec *os)
 {
-  gint r;
-  sqlite3_stmt *sql_stmt = NULL;
-  sqlite3 *db;
-  GrlMedia *media;
-  GError *error = NULL;
-  GList *medias = NULL;
-  guint count = 0;
-  GList *iter;
   gchar *sql;
 
   GRL_DEBUG ("produce_podcasts");
 
-  db = GRL_PODCASTS_SOURCE (os->source)->priv->db;
-
   if (os->is_query) {
     /* Query */
     sql = g_strdup_printf (GRL_SQL_GET_PODCASTS_BY_QUERY,
@@ -1488,122 +1780,74 @@ produce_podcasts (OperationSpec *os)
     /* Browse */
     sql = g_strdup_printf (GRL_SQL_GET_PODCASTS, os->count, os->skip);
   }
-  GRL_DEBUG ("%s", sql);
-  r = sqlite3_prepare_v2 (db, sql, strlen (sql), &sql_stmt, NULL);
-  g_free (sql);
-
-  if (r != SQLITE_OK) {
-    GRL_WARNING ("Failed to retrieve podcasts: %s", sqlite3_errmsg (db));
-    error = g_error_new (GRL_CORE_ERROR,
-                         os->error_code,
-                         _("Failed to get podcasts list: %s"),
-                         sqlite3_errmsg (db));
-    os->callback (os->source, os->operation_id, NULL, 0, os->user_data, error);
-    g_error_free (error);
-    goto free_resources;
-  }
-
-  while ((r = sqlite3_step (sql_stmt)) == SQLITE_BUSY);
-
-  while (r == SQLITE_ROW) {
-    media = build_media_from_stmt (NULL, sql_stmt, TRUE);
-    medias = g_list_prepend (medias, media);
-    count++;
-    r = sqlite3_step (sql_stmt);
-  }
-
-  if (r != SQLITE_DONE) {
-    GRL_WARNING ("Failed to retrieve podcasts: %s", sqlite3_errmsg (db));
-    error = g_error_new (GRL_CORE_ERROR,
-                         os->error_code,
-                         _("Failed to get podcasts list: %s"),
-                         sqlite3_errmsg (db));
-    os->callback (os->source, os->operation_id, NULL, 0, os->user_data, error);
-    g_error_free (error);
-    goto free_resources;
-  }
-
-  if (count > 0) {
-    medias = g_list_reverse (medias);
-    iter = medias;
-    while (iter) {
-      media = GRL_MEDIA (iter->data);
-      os->callback (os->source,
-		    os->operation_id,
-		    media,
-		    --count,
-		    os->user_data,
-		    NULL);
-      iter = g_list_next (iter);
-    }
-    g_list_free (medias);
-  } else {
-    os->callback (os->source, os->operation_id, NULL, 0, os->user_data, NULL);
-  }
 
- free_resources:
-  g_clear_pointer (&sql_stmt, sqlite3_finalize);
+  query_rows (GRL_PODCASTS_SOURCE (os->source), sql, TRUE, os->error_code,
+              os, produce_rows_done);
 }
 
 static void
-stream_resolve (GrlSourceResolveSpec *rs)
+stream_resolve_done (GObject *object, GAsyncResult *result, gpointer user_data)
 {
-  gint r;
-  sqlite3_stmt *sql_stmt = NULL;
-  sqlite3 *db;
+  DbQuery *query = user_data;
+  GrlSourceResolveSpec *rs = query->spec;
   GError *error = NULL;
-  gchar *sql;
-  const gchar *id;
 
-  GRL_DEBUG (__FUNCTION__);
-
-  db = GRL_PODCASTS_SOURCE (rs->source)->priv->db;
-
-  id = grl_media_get_id (rs->media);
-  sql = g_strdup_printf (GRL_SQL_GET_PODCAST_STREAM, id);
-  GRL_DEBUG ("%s", sql);
-  r = sqlite3_prepare_v2 (db, sql, strlen (sql), &sql_stmt, NULL);
-  g_free (sql);
-
-  if (r != SQLITE_OK) {
-    GRL_WARNING ("Failed to get podcast stream: %s", sqlite3_errmsg (db));
+  if (grl_db_worker_finish (result, NULL) && query->rows) {
+    build_media_from_row (rs->media, query->rows->data, FALSE);
+    rs->callback (rs->source, rs->operation_id, rs->media, rs->user_data, NULL);
+  } else {
+    GRL_WARNING ("Failed to get podcast stream '%s'", grl_media_get_id (rs->media));
     error = g_error_new_literal (GRL_CORE_ERROR,
                                  GRL_CORE_ERROR_RESOLVE_FAILED,
                                  _("Failed to get podcast stream metadata"));
     rs->callback (rs->source, rs->operation_id, rs->media, rs->user_data, error);
     g_error_free (error);
-    return;
   }
 
-  while ((r = sqlite3_step (sql_stmt)) == SQLITE_BUSY);
+  db_query_free (query);
+}
 
-  if (r == SQLITE_ROW) {
-    build_media_from_stmt (rs->media, sql_stmt, FALSE);
+static void
+stream_resolve (GrlSourceResolveSpec *rs)
+{
+  GRL_DEBUG (__FUNCTION__);
+
+  query_rows (GRL_PODCASTS_SOURCE (rs->source),
+              g_strdup_printf (GRL_SQL_GET_PODCAST_STREAM,
+                               grl_media_get_id (rs->media)),
+              FALSE, GRL_CORE_ERROR_RESOLVE_FAILED,
+              rs, stream_resolve_done);
+}
+
+static void
+podcast_resolve_done (GObject *object, GAsyncResult *result, gpointer user_data)
+{
+  DbQuery *query = user_data;
+  GrlSourceResolveSpec *rs = query->spec;
+  GError *error = NULL;
+
+  if (grl_db_worker_finish (result, NULL) && query->rows) {
+    build_media_from_row (rs->media, query->rows->data, TRUE);
     rs->callback (rs->source, rs->operation_id, rs->media, rs->user_data, NULL);
   } else {
-    GRL_WARNING ("Failed to get podcast stream: %s", sqlite3_errmsg (db));
+    GRL_WARNING ("Failed to get podcast '%s'", grl_media_get_id (rs->media));
     error = g_error_new_literal (GRL_CORE_ERROR,
                                  GRL_CORE_ERROR_RESOLVE_FAILED,
-                                 _("Failed to get podcast stream metadata"));
+                                 _("Failed to get podcast metadata"));
     rs->callback (rs->source, rs->operation_id, rs->media, rs->user_data, error);
     g_error_free (error);
   }
 
-  sqlite3_finalize (sql_stmt);
+  db_query_free (query);
 }
 
 static void
 podcast_resolve (GrlSourceResolveSpec *rs)
 {
-  sqlite3_stmt *sql_stmt = NULL;
-  sqlite3 *db;
-  GError *error = NULL;
   const gchar *id;
 
   GRL_DEBUG (__FUNCTION__);
 
-  db = GRL_PODCASTS_SOURCE (rs->source)->priv->db;
-
   id = grl_media_get_id (rs->media);
   if (!id) {
     /* Root category: special case */
@@ -1612,20 +1856,9 @@ podcast_resolve (GrlSourceResolveSpec *rs)
     return;
   }
 
-  sql_stmt = get_podcast_info (db, id);
-
-  if (sql_stmt) {
-    build_media_from_stmt (rs->media, sql_stmt, TRUE);
-    rs->callback (rs->source, rs->operation_id, rs->media, rs->user_data, NULL);
-    sqlite3_finalize (sql_stmt);
-  } else {
-    GRL_WARNING ("Failed to get podcast: %s", sqlite3_errmsg (db));
-    error = g_error_new_literal (GRL_CORE_ERROR,
-                                 GRL_CORE_ERROR_RESOLVE_FAILED,
-                                 _("Failed to get podcast metadata"));
-    rs->callback (rs->source, rs->operation_id, rs->media, rs->user_data, error);
-    g_error_free (error);
-  }
+  get_podcast_info (GRL_PODCASTS_SOURCE (rs->source), id,
+                    GRL_CORE_ERROR_RESOLVE_FAILED,
+                    rs, podcast_resolve_done);
 }
 
 static gboolean
@@ -1658,19 +1891,6 @@ grl_podcasts_source_browse (GrlSource *source,
   GRL_DEBUG ("grl_podcasts_source_browse");
 
   OperationSpec *os;
-  GrlPodcastsSource *podcasts_source;
-  GError *error = NULL;
-
-  podcasts_source = GRL_PODCASTS_SOURCE (source);
-  if (!podcasts_source->priv->db) {
-    GRL_WARNING ("Can't execute operation: no database connection.");
-    error = g_error_new_literal (GRL_CORE_ERROR,
-                                 GRL_CORE_ERROR_BROWSE_FAILED,
-                                 _("No database connection"));
-    bs->callback (bs->source, bs->operation_id, NULL, 0, bs->user_data, error);
-    g_error_free (error);
-    return;
-  }
 
   /* Configure browse operation */
   os = g_slice_new0 (OperationSpec);
@@ -1686,11 +1906,9 @@ grl_podcasts_source_browse (GrlSource *source,
   if (!os->media_id) {
     /* Browsing podcasts list */
     produce_podcasts (os);
-    g_slice_free (OperationSpec, os);
   } else {
     /* Browsing a particular podcast. We may need to parse
-       the feed (async) and in that case we will need to keep
-       os, so we do not free os here */
+       the feed (async) after reading the podcast information */
     produce_podcast_contents (os);
   }
 }
@@ -1701,20 +1919,7 @@ grl_podcasts_source_search (GrlSource *source,
 {
   GRL_DEBUG (__FUNCTION__);
 
-  GrlPodcastsSource *podcasts_source;
   OperationSpec *os;
-  GError *error = NULL;
-
-  podcasts_source = GRL_PODCASTS_SOURCE (source);
-  if (!podcasts_source->priv->db) {
-    GRL_WARNING ("Can't execute operation: no database connection.");
-    error = g_error_new_literal (GRL_CORE_ERROR,
-                                 GRL_CORE_ERROR_QUERY_FAILED,
-                                 _("No database connection"));
-    ss->callback (ss->source, ss->operation_id, NULL, 0, ss->user_data, error);
-    g_error_free (error);
-    return;
-  }
 
   os = g_slice_new0 (OperationSpec);
   os->source = ss->source;
@@ -1727,7 +1932,6 @@ grl_podcasts_source_search (GrlSource *source,
   os->is_query = TRUE;
   os->error_code = GRL_CORE_ERROR_SEARCH_FAILED;
   produce_podcast_contents_from_db (os);
-  g_slice_free (OperationSpec, os);
 }
 
 static void
@@ -1735,20 +1939,7 @@ grl_podcasts_source_query (GrlSource *source, GrlSourceQuerySpec *qs)
 {
   GRL_DEBUG ("grl_podcasts_source_query");
 
-  GrlPodcastsSource *podcasts_source;
   OperationSpec *os;
-  GError *error = NULL;
-
-  podcasts_source = GRL_PODCASTS_SOURCE (source);
-  if (!podcasts_source->priv->db) {
-    GRL_WARNING ("Can't execute operation: no database connection.");
-    error = g_error_new_literal (GRL_CORE_ERROR,
-                                 GRL_CORE_ERROR_QUERY_FAILED,
-                                 _("No database connection"));
-    qs->callback (qs->source, qs->operation_id, NULL, 0, qs->user_data, error);
-    g_error_free (error);
-    return;
-  }
 
   os = g_slice_new0 (OperationSpec);
   os->source = qs->source;
@@ -1761,7 +1952,6 @@ grl_podcasts_source_query (GrlSource *source, GrlSourceQuerySpec *qs)
   os->is_query = TRUE;
   os->error_code = GRL_CORE_ERROR_QUERY_FAILED;
   produce_podcasts (os);
-  g_slice_free (OperationSpec, os);
 }
 
 static void
@@ -1770,21 +1960,8 @@ grl_podcasts_source_resolve (GrlSource *source,
 {
   GRL_DEBUG (__FUNCTION__);
 
-  GrlPodcastsSource *podcasts_source;
-  GError *error = NULL;
   const gchar *media_id;
 
-  podcasts_source = GRL_PODCASTS_SOURCE (source);
-  if (!podcasts_source->priv->db) {
-    GRL_WARNING ("Can't execute operation: no database connection.");
-    error = g_error_new_literal (GRL_CORE_ERROR,
-                                 GRL_CORE_ERROR_RESOLVE_FAILED,
-                                 _("No database connection"));
-    rs->callback (rs->source, rs->operation_id, rs->media, rs->user_data, error);
-    g_error_free (error);
-    return;
-  }
-
   media_id = grl_media_get_id (rs->media);
   if (!media_id || media_id_is_podcast (media_id)) {
     podcast_resolve (rs);
@@ -1813,14 +1990,13 @@ grl_podcasts_source_store (GrlSource *source, GrlSourceStoreSpec *ss)
                          _("Failed to store: %s"),
                          _("URL required"));
   } else {
-    store_podcast (GRL_PODCASTS_SOURCE (ss->source),
-                   &keylist,
-                   ss->media,
-                   &error);
+    store_podcast (GRL_PODCASTS_SOURCE (ss->source), keylist, ss);
+    return;
   }
 
   ss->callback (ss->source, ss->media, keylist, ss->user_data, error);
   g_clear_error (&error);
+  g_list_free (keylist);
 }
 
 static void
@@ -1828,16 +2004,17 @@ grl_podcasts_source_remove (GrlSource *source,
                             GrlSourceRemoveSpec *rs)
 {
   GRL_DEBUG (__FUNCTION__);
-  GError *error = NULL;
+  GrlDbWorkerFunc remove_func;
+
   if (media_id_is_podcast (rs->media_id)) {
-    remove_podcast (GRL_PODCASTS_SOURCE (rs->source),
-		    rs->media_id, &error);
+    remove_func = remove_podcast;
   } else {
-    remove_stream (GRL_PODCASTS_SOURCE (rs->source),
-		   rs->media_id, &error);
+    remove_func = remove_stream;
   }
-  rs->callback (rs->source, rs->media, rs->user_data, error);
-  g_clear_error (&error);
+
+  grl_db_worker_push (GRL_PODCASTS_SOURCE (source)->priv->worker, source,
+                      remove_func, g_strdup (rs->media_id), g_free,
+                      remove_done, rs);
 }
 
 static gboolean
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "grl-lru-cache.h"
+#include "grl-shoutcast-cache.h"
+
+typedef struct {
+  GrlShoutcastList *list;
+  gint64            expires;
+} CacheEntry;
+
+struct _GrlShoutcastCache {
+  guint        ttl;
+  /* Key -> CacheEntry */
+  GrlLruCache *lists;
+};
+
+static void
+shoutcast_entry_free (GrlShoutcastEntry *entry)
+{
+  g_free (entry->name);
+  g_free (entry->id);
+  g_free (entry->mime);
+  g_free (entry->bitrate);
+  g_free (entry->genre);
+  g_slice_free (GrlShoutcastEntry, entry);
+}
+
+GrlShoutcastList *
+grl_shoutcast_list_new (gboolean stations, guint limit)
+{
+  GrlShoutcastList *list;
+
+  list = g_rc_box_new0 (GrlShoutcastList);
+  list->entries = g_ptr_array_new_with_free_func ((GDestroyNotify) shoutcast_entry_free);
+  list->stations = stations;
+  list->limit = limit;
+
+  return list;
+}
+
+GrlShoutcastList *
+grl_shoutcast_list_ref (GrlShoutcastList *list)
+{
+  return g_rc_box_acquire (list);
+}
+
+static void
+shoutcast_list_clear (GrlShoutcastList *list)
+{
+  g_ptr_array_unref (list->entries);
+}
+
+void
+grl_shoutcast_list_unref (GrlShoutcastList *list)
+{
+  g_rc_box_release_full (list, (GDestroyNotify) shoutcast_list_clear);
+}
+
+void
+grl_shoutcast_list_add (GrlShoutcastList *list,
+                        const gchar *name,
+                        const gchar *id,
+                        const gchar *mime,
+                        const gchar *bitrate,
+                        const gchar *genre)
+{
+  GrlShoutcastEntry *entry;
+
+  entry = g_slice_new (GrlShoutcastEntry);
+  entry->name = g_strdup (name);
+  entry->id = g_strdup (id);
+  entry->mime = g_strdup (mime);
+  entry->bitrate = g_strdup (bitrate);
+  entry->genre = g_strdup (genre);
+
+  g_ptr_array_add (list->entries, entry);
+}
+
+/* Returns: %TRUE if @list holds the first @limit entries, that is, as many
+ * or more were requested, or the server had fewer. */
+gboolean
+grl_shoutcast_list_covers (GrlShoutcastList *list, guint limit)
+{
+  return limit <= list->limit || list->entries->len < list->limit;
+}
+
+static void
+cache_entry_free (CacheEntry *entry)
+{
+  grl_shoutcast_list_unref (entry->list);
+  g_slice_free (CacheEntry, entry);
+}
+
+GrlShoutcastCache *
+grl_shoutcast_cache_new (guint max_lists, guint ttl)
+{
+  GrlShoutcastCache *cache;
+
+  cache = g_slice_new (GrlShoutcastCache);
+  cache->ttl = ttl;
+  cache->lists = grl_lru_cache_new (max_lists,
+                                    (GDestroyNotify) cache_entry_free);
+
+  return cache;
+}
+
+void
+grl_shoutcast_cache_free (GrlShoutcastCache *cache)
+{
+  grl_lru_cache_free (cache->lists);
+  g_slice_free (GrlShoutcastCache, cache);
+}
+
+/* Returns: (transfer none): the list cached for @key, or %NULL if there is
+ * none or it expired */
+GrlShoutcastList *
+grl_shoutcast_cache_lookup (GrlShoutcastCache *cache,
+                            const gchar *key)
+{
+  CacheEntry *entry;
+
+  if (!grl_lru_cache_lookup (cache->lists, key, (gpointer *) &entry))
+    return NULL;
+
+  if (entry->expires <= g_get_monotonic_time ()) {
+    grl_lru_cache_remove (cache->lists, key);
+    return NULL;
+  }
+
+  return entry->list;
+}
+
+/* Caches @list for @key, unless a list with more entries already is */
+void
+grl_shoutcast_cache_insert (GrlShoutcastCache *cache,
+                            const gchar *key,
+                            GrlShoutcastList *list)
+{
+  CacheEntry *entry;
+
+  if (cache->ttl == 0)
+    return;
+
+  if (grl_lru_cache_lookup (cache->lists, key, (gpointer *) &entry) &&
+      entry->list->limit > list->limit &&
+      entry->expires > g_get_monotonic_time ())
+    return;
+
+  entry = g_slice_new (CacheEntry);
+  entry->list = grl_shoutcast_list_ref (list);
+  entry->expires = g_get_monotonic_time () + (gint64) cache->ttl * G_USEC_PER_SEC;
+
+  grl_lru_cache_insert (cache->lists, key, entry);
+}
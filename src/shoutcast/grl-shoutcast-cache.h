@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef _GRL_SHOUTCAST_CACHE_H_
+#define _GRL_SHOUTCAST_CACHE_H_
+
+#include <glib.h>
+
+/* Number of genre and station lists kept in memory */
+#define GRL_SHOUTCAST_CACHE_MAX_LISTS 32
+
+/* Seconds after which a list is fetched again */
+#define GRL_SHOUTCAST_CACHE_DEFAULT_TTL 300
+
+typedef struct {
+  gchar *name;
+  /* Only set for stations */
+  gchar *id;
+  gchar *mime;
+  gchar *bitrate;
+  gchar *genre;
+} GrlShoutcastEntry;
+
+/* The parsed entries of a response, shared by the operations reading it */
+typedef struct {
+  /* GrlShoutcastEntry */
+  GPtrArray *entries;
+  /* Whether entries are stations, or genres */
+  gboolean   stations;
+  /* Number of entries that were requested */
+  guint      limit;
+} GrlShoutcastList;
+
+GrlShoutcastList *grl_shoutcast_list_new (gboolean stations, guint limit);
+
+GrlShoutcastList *grl_shoutcast_list_ref (GrlShoutcastList *list);
+
+void grl_shoutcast_list_unref (GrlShoutcastList *list);
+
+void grl_shoutcast_list_add (GrlShoutcastList *list,
+                             const gchar *name,
+                             const gchar *id,
+                             const gchar *mime,
+                             const gchar *bitrate,
+                             const gchar *genre);
+
+gboolean grl_shoutcast_list_covers (GrlShoutcastList *list, guint limit);
+
+/* Lists of the most recently used genres and searches, until they expire */
+typedef struct _GrlShoutcastCache GrlShoutcastCache;
+
+GrlShoutcastCache *grl_shoutcast_cache_new (guint max_lists, guint ttl);
+
+void grl_shoutcast_cache_free (GrlShoutcastCache *cache);
+
+GrlShoutcastList *grl_shoutcast_cache_lookup (GrlShoutcastCache *cache,
+                                              const gchar *key);
+
+void grl_shoutcast_cache_insert (GrlShoutcastCache *cache,
+                                 const gchar *key,
+                                 GrlShoutcastList *list);
+
+#endif /* _GRL_SHOUTCAST_CACHE_H_ */
@@ -30,13 +30,16 @@
 #include <net/grl-net.h>
 #include <glib/gi18n-lib.h>
 #include <libxml/parser.h>
-#include <libxml/xpath.h>
 
 #include "grl-shoutcast.h"
+#include "grl-shoutcast-cache.h"
 
-#define EXPIRE_CACHE_TIMEOUT 300
+#define SHOUTCAST_DEV_KEY   "dev-key"
+#define SHOUTCAST_CACHE_TTL "cache-ttl"
 
-#define SHOUTCAST_DEV_KEY "dev-key"
+/* Station lists are fetched at least this long, so paging through them
+   does not need a request per page */
+#define SHOUTCAST_MIN_FETCH_LIMIT 64
 
 /* --------- Logging  -------- */
 
@@ -62,18 +65,19 @@ GRL_LOG_DOMAIN_STATIC(shoutcast_log_domain);
 struct _GrlShoutcastSourcePriv {
   gchar *dev_key;
   GrlNetWc *wc;
-  GCancellable *cancellable;
-  gchar *cached_page;
-  gboolean cached_page_expired;
+  GrlShoutcastCache *cache;
+  /* Cache key -> Fetch in flight */
+  GHashTable *fetches;
 };
 
+typedef struct _Fetch Fetch;
+
 typedef struct {
   GrlMedia *media;
   GrlSource *source;
   GrlSourceResolveCb resolve_cb;
   GrlSourceResultCb result_cb;
   gboolean cancelled;
-  gboolean cache;
   gchar *filter_entry;
   gchar *genre;
   gint error_code;
@@ -82,11 +86,24 @@ typedef struct {
   gpointer user_data;
   guint count;
   guint skip;
-  xmlDocPtr xml_doc;
-  xmlNodePtr xml_entries;
+  /* Fetch the operation waits for, if any */
+  Fetch *fetch;
+  GrlShoutcastList *list;
+  guint position;
 } OperationData;
 
-static GrlShoutcastSource *grl_shoutcast_source_new (const gchar *dev_key);
+/* A request in flight, shared by every operation needing the same list */
+struct _Fetch {
+  GrlShoutcastSource *source;
+  gchar *key;
+  guint limit;
+  GCancellable *cancellable;
+  /* OperationData */
+  GList *waiters;
+};
+
+static GrlShoutcastSource *grl_shoutcast_source_new (const gchar *dev_key,
+                                                     guint cache_ttl);
 
 gboolean grl_shoutcast_plugin_init (GrlRegistry *registry,
                                     GrlPlugin *plugin,
@@ -106,9 +123,11 @@ static void grl_shoutcast_source_search (GrlSource *source,
 static void grl_shoutcast_source_cancel (GrlSource *source,
                                          guint operation_id);
 
-static void read_url_async (GrlShoutcastSource *source,
-                            const gchar *url,
-                            OperationData *op_data);
+static void read_list_async (GrlShoutcastSource *source,
+                             const gchar *key,
+                             const gchar *url,
+                             guint limit,
+                             OperationData *op_data);
 
 static void grl_shoutcast_source_finalize (GObject *object);
 
@@ -122,6 +141,7 @@ grl_shoutcast_plugin_init (GrlRegistry *registry,
   gchar *dev_key;
   GrlConfig *config;
   gint config_count;
+  guint cache_ttl = GRL_SHOUTCAST_CACHE_DEFAULT_TTL;
   GrlShoutcastSource *source;
 
   GRL_LOG_DOMAIN_INIT (shoutcast_log_domain, "shoutcast");
@@ -149,7 +169,11 @@ grl_shoutcast_plugin_init (GrlRegistry *registry,
     return FALSE;
   }
 
-  source = grl_shoutcast_source_new (dev_key);
+  if (grl_config_has_param (config, SHOUTCAST_CACHE_TTL)) {
+    cache_ttl = MAX (grl_config_get_int (config, SHOUTCAST_CACHE_TTL), 0);
+  }
+
+  source = grl_shoutcast_source_new (dev_key, cache_ttl);
   grl_registry_register_source (registry,
                                 plugin,
                                 GRL_SOURCE (source),
@@ -178,7 +202,8 @@ GRL_PLUGIN_DEFINE (GRL_MAJOR,
 G_DEFINE_TYPE_WITH_PRIVATE (GrlShoutcastSource, grl_shoutcast_source, GRL_TYPE_SOURCE)
 
 static GrlShoutcastSource *
-grl_shoutcast_source_new (const gchar *dev_key)
+grl_shoutcast_source_new (const gchar *dev_key,
+                          guint cache_ttl)
 {
   GrlShoutcastSource *source;
   const char *tags[] = {
@@ -197,6 +222,8 @@ grl_shoutcast_source_new (const gchar *dev_key)
                           NULL);
 
   source->priv->dev_key = g_strdup (dev_key);
+  source->priv->cache = grl_shoutcast_cache_new (GRL_SHOUTCAST_CACHE_MAX_LISTS,
+                                                 cache_ttl);
 
   return source;
 }
@@ -220,7 +247,7 @@ static void
 grl_shoutcast_source_init (GrlShoutcastSource *source)
 {
   source->priv = grl_shoutcast_source_get_instance_private (source);
-  source->priv->cached_page_expired = TRUE;
+  source->priv->fetches = g_hash_table_new (g_str_hash, g_str_equal);
 }
 
 static void
@@ -228,9 +255,10 @@ grl_shoutcast_source_finalize (GObject *object)
 {
   GrlShoutcastSource *self = GRL_SHOUTCAST_SOURCE (object);
 
+  /* Fetches keep the source alive, so there are none left */
+  g_clear_pointer (&self->priv->fetches, g_hash_table_unref);
+  g_clear_pointer (&self->priv->cache, grl_shoutcast_cache_free);
   g_clear_object (&self->priv->wc);
-  g_clear_pointer (&self->priv->cancellable, g_cancellable_cancel);
-  g_clear_pointer (&self->priv->cached_page, g_free);
   g_clear_pointer (&self->priv->dev_key, g_free);
 
   G_OBJECT_CLASS (grl_shoutcast_source_parent_class)->finalize (object);
@@ -238,24 +266,42 @@ grl_shoutcast_source_finalize (GObject *object)
 
 /* ======================= Private ==================== */
 
-static gint
-xml_count_nodes (xmlNodePtr node)
+static void
+operation_data_free (OperationData *op_data)
 {
-  gint count = 0;
+  g_clear_pointer (&op_data->list, grl_shoutcast_list_unref);
+  g_free (op_data->filter_entry);
+  g_free (op_data->genre);
+  g_slice_free (OperationData, op_data);
+}
 
-  while (node) {
-    count++;
-    node = node->next;
+/* Reports the end of the operation, with @error if it failed */
+static void
+operation_finish (OperationData *op_data, const GError *error)
+{
+  if (op_data->media) {
+    op_data->resolve_cb (op_data->source,
+                         op_data->operation_id,
+                         op_data->media,
+                         op_data->user_data,
+                         error);
+  } else {
+    op_data->result_cb (op_data->source,
+                        op_data->operation_id,
+                        NULL,
+                        0,
+                        op_data->user_data,
+                        error);
   }
 
-  return count;
+  operation_data_free (op_data);
 }
 
 static GrlMedia *
-build_media_from_genre (OperationData *op_data)
+build_media_from_genre (OperationData *op_data,
+                        GrlShoutcastEntry *entry)
 {
   GrlMedia *media;
-  gchar *genre_name;
 
   if (op_data->media) {
     media = op_data->media;
@@ -263,41 +309,24 @@ build_media_from_genre (OperationData *op_data)
     media = grl_media_container_new ();
   }
 
-  genre_name = (gchar *) xmlGetProp (op_data->xml_entries,
-                                     (const xmlChar *) "name");
-
-  grl_media_set_id (media, genre_name);
-  grl_media_set_title (media, genre_name);
+  grl_media_set_id (media, entry->name);
+  grl_media_set_title (media, entry->name);
   grl_data_set_string (GRL_DATA (media),
                        GRL_METADATA_KEY_GENRE,
-                       genre_name);
-  g_free (genre_name);
+                       entry->name);
 
   return media;
 }
 
 static GrlMedia *
-build_media_from_station (OperationData *op_data)
+build_media_from_station (OperationData *op_data,
+                          GrlShoutcastEntry *entry)
 {
   GrlMedia *media;
-  gchar **station_genres = NULL;
+  const gchar *station_genre;
   gchar *media_id;
   gchar *media_url;
-  gchar *station_bitrate;
-  gchar *station_genre;
-  gchar *station_genre_field;
-  gchar *station_id;
-  gchar *station_mime;
-  gchar *station_name;
-
-  station_name = (gchar *) xmlGetProp (op_data->xml_entries,
-                                       (const xmlChar *) "name");
-  station_mime = (gchar *) xmlGetProp (op_data->xml_entries,
-                                       (const xmlChar *) "mt");
-  station_id = (gchar *) xmlGetProp (op_data->xml_entries,
-                                     (const xmlChar *) "id");
-  station_bitrate = (gchar *) xmlGetProp (op_data->xml_entries,
-                                          (const xmlChar *) "br");
+
   if (op_data->media) {
     media = op_data->media;
   } else {
@@ -307,226 +336,203 @@ build_media_from_station (OperationData *op_data)
   if (op_data->genre) {
     station_genre = op_data->genre;
   } else {
-    station_genre_field = (gchar *) xmlGetProp (op_data->xml_entries,
-                                                (const xmlChar *) "genre");
-    station_genres = g_strsplit (station_genre_field, " ", -1);
-    g_free (station_genre_field);
-    station_genre = station_genres[0];
+    station_genre = entry->genre;
   }
 
-  media_id = g_strconcat (station_genre, "/", station_id, NULL);
-  media_url = g_strdup_printf (SHOUTCAST_TUNE, station_id);
+  media_id = g_strconcat (station_genre, "/", entry->id, NULL);
+  media_url = g_strdup_printf (SHOUTCAST_TUNE, entry->id);
 
   grl_media_set_id (media, media_id);
-  grl_media_set_title (media, station_name);
-  grl_media_set_mime (media, station_mime);
+  grl_media_set_title (media, entry->name);
+  grl_media_set_mime (media, entry->mime);
   grl_media_set_genre (media, station_genre);
   grl_media_set_url (media, media_url);
-  grl_media_set_bitrate (media, atoi (station_bitrate));
+  grl_media_set_bitrate (media, entry->bitrate ? atoi (entry->bitrate) : 0);
 
-  g_free (station_name);
-  g_free (station_mime);
-  g_free (station_id);
-  g_free (station_bitrate);
   g_free (media_id);
   g_free (media_url);
-  g_clear_pointer (&station_genres, g_strfreev);
 
   return media;
 }
 
 static gboolean
-send_media (OperationData *op_data, GrlMedia *media)
+send_entries (OperationData *op_data)
 {
-  if (!op_data->cancelled) {
-    op_data->result_cb (op_data->source,
-                        op_data->operation_id,
-                        media,
-                        --op_data->to_send,
-                        op_data->user_data,
-                        NULL);
+  GrlShoutcastEntry *entry;
+  GrlMedia *media;
 
-    op_data->xml_entries = op_data->xml_entries->next;
+  if (op_data->cancelled) {
+    operation_finish (op_data, NULL);
+    return FALSE;
+  }
+
+  entry = g_ptr_array_index (op_data->list->entries, op_data->position++);
+  if (op_data->list->stations) {
+    media = build_media_from_station (op_data, entry);
   } else {
-    op_data->result_cb (op_data->source,
-                        op_data->operation_id,
-                        NULL,
-                        0,
-                        op_data->user_data,
-                        NULL);
+    media = build_media_from_genre (op_data, entry);
   }
 
-  if (op_data->to_send == 0 || op_data->cancelled) {
-    xmlFreeDoc (op_data->xml_doc);
-    g_slice_free (OperationData, op_data);
+  op_data->result_cb (op_data->source,
+                      op_data->operation_id,
+                      media,
+                      --op_data->to_send,
+                      op_data->user_data,
+                      NULL);
+
+  if (op_data->to_send == 0) {
+    operation_data_free (op_data);
     return FALSE;
   } else {
     return TRUE;
   }
 }
 
-static gboolean
-send_genrelist_entries (OperationData *op_data)
-{
-  return send_media (op_data,
-                     build_media_from_genre (op_data));
-}
-
-static gboolean
-send_stationlist_entries (OperationData *op_data)
-{
-  return send_media (op_data,
-                     build_media_from_station (op_data));
-}
-
+/* Answers the operation from @list */
 static void
-xml_parse_result (const gchar *str, OperationData *op_data)
+send_list (OperationData *op_data, GrlShoutcastList *list)
 {
   GError *error = NULL;
-  gboolean stationlist_result;
-  gchar *xpath_expression;
-  xmlNodePtr node;
-  xmlXPathContextPtr xpath_ctx;
-  xmlXPathObjectPtr xpath_res;
-  guint id;
+  GrlShoutcastEntry *entry;
+  guint i, id;
 
   if (op_data->cancelled) {
-    op_data->result_cb (op_data->source,
-                        op_data->operation_id,
-                        NULL,
-                        0,
-                        op_data->user_data,
-                        NULL);
-    g_slice_free (OperationData, op_data);
+    operation_finish (op_data, NULL);
     return;
   }
 
-  op_data->xml_doc = xmlReadMemory (str, xmlStrlen ((xmlChar*) str), NULL, NULL,
-                                    XML_PARSE_RECOVER | XML_PARSE_NOBLANKS);
-  if (!op_data->xml_doc) {
-    error = g_error_new_literal (GRL_CORE_ERROR,
-                                 op_data->error_code,
-                                 _("Failed to parse response"));
-    goto finalize;
-  }
-
-  node = xmlDocGetRootElement (op_data->xml_doc);
-  if  (!node) {
-    error = g_error_new_literal (GRL_CORE_ERROR,
-                                 op_data->error_code,
-                                 _("Empty response"));
-    goto finalize;
-  }
-
-  stationlist_result = (xmlStrcmp (node->name,
-                                   (const xmlChar *) "stationlist") == 0);
-
-  op_data->xml_entries = node->xmlChildrenNode;
-
   /* Check if we are interesting only in updating a media (that is, a metadata()
      operation) or just browsing/searching */
   if (op_data->media) {
+    for (i = 0; i < list->entries->len; i++) {
+      entry = g_ptr_array_index (list->entries, i);
+      if (g_strcmp0 (list->stations ? entry->id : entry->name,
+                     op_data->filter_entry) == 0)
+        break;
+    }
 
-    /* Search for node */
-    xpath_ctx = xmlXPathNewContext (op_data->xml_doc);
-    if (xpath_ctx) {
-      if (stationlist_result) {
-        xpath_expression = g_strdup_printf ("//station[@id = \"%s\"]",
-                                            op_data->filter_entry);
+    if (i < list->entries->len) {
+      if (list->stations) {
+        build_media_from_station (op_data, entry);
       } else {
-        xpath_expression = g_strdup_printf ("//genre[@name = \"%s\"]",
-                                            op_data->filter_entry);
+        build_media_from_genre (op_data, entry);
       }
-      xpath_res = xmlXPathEvalExpression ((xmlChar *) xpath_expression,
-                                          xpath_ctx);
-      g_free (xpath_expression);
-
-      if (xpath_res && xpath_res->nodesetval->nodeTab &&
-          xpath_res->nodesetval->nodeTab[0]) {
-        op_data->xml_entries = xpath_res->nodesetval->nodeTab[0];
-        if (stationlist_result) {
-          build_media_from_station (op_data);
-        } else {
-          build_media_from_genre (op_data);
-        }
-      } else {
-        error = g_error_new (GRL_CORE_ERROR,
-                             op_data->error_code,
-                             _("Cannot find media %s"),
-                             grl_media_get_id (op_data->media));
-      }
-      g_clear_pointer (&xpath_res, xmlXPathFreeObject);
-      xmlXPathFreeContext (xpath_ctx);
     } else {
-      error = g_error_new_literal (GRL_CORE_ERROR,
-                                   op_data->error_code,
-                                   _("Failed to parse response"));
+      error = g_error_new (GRL_CORE_ERROR,
+                           op_data->error_code,
+                           _("Cannot find media %s"),
+                           grl_media_get_id (op_data->media));
     }
 
-    op_data->resolve_cb (op_data->source,
-                         op_data->operation_id,
-                         op_data->media,
-                         op_data->user_data,
-                         error);
-    goto free_resources;
-  }
-
-  if (stationlist_result) {
-    /* First node is "tunein"; skip it */
-    op_data->xml_entries = op_data->xml_entries->next;
-  }
-
-  /* Skip elements */
-  while (op_data->xml_entries && op_data->skip > 0) {
-    op_data->xml_entries = op_data->xml_entries->next;
-    op_data->skip--;
+    operation_finish (op_data, error);
+    g_clear_error (&error);
+    return;
   }
 
   /* Check if there are elements to send*/
-  if (!op_data->xml_entries || op_data->count == 0) {
-    goto finalize;
+  if (op_data->skip >= list->entries->len || op_data->count == 0) {
+    operation_finish (op_data, NULL);
+    return;
   }
 
   /* Compute how many items are to be sent */
-  op_data->to_send = xml_count_nodes (op_data->xml_entries);
-  if (op_data->to_send > op_data->count) {
-    op_data->to_send = op_data->count;
+  op_data->list = grl_shoutcast_list_ref (list);
+  op_data->position = op_data->skip;
+  op_data->to_send = MIN (list->entries->len - op_data->skip, op_data->count);
+
+  id = g_idle_add ((GSourceFunc) send_entries, op_data);
+  g_source_set_name_by_id (id, "[shoutcast] send_entries");
+}
+
+static gchar *
+xml_get_prop (xmlNodePtr node, const gchar *name)
+{
+  xmlChar *prop;
+  gchar *value;
+
+  prop = xmlGetProp (node, (const xmlChar *) name);
+  value = g_strdup ((gchar *) prop);
+  xmlFree (prop);
+
+  return value;
+}
+
+/* Returns: (transfer full): the genres or stations in @str, or %NULL with
+ * @message set if it is not a valid response. */
+static GrlShoutcastList *
+xml_parse_result (const gchar *str, guint limit, const gchar **message)
+{
+  GrlShoutcastList *list;
+  gboolean stationlist_result;
+  xmlDocPtr xml_doc;
+  xmlNodePtr node;
+
+  xml_doc = xmlReadMemory (str, xmlStrlen ((xmlChar*) str), NULL, NULL,
+                           XML_PARSE_RECOVER | XML_PARSE_NOBLANKS);
+  if (!xml_doc) {
+    *message = _("Failed to parse response");
+    return NULL;
   }
 
-  if (stationlist_result) {
-    id = g_idle_add ((GSourceFunc) send_stationlist_entries, op_data);
-    g_source_set_name_by_id (id, "[shoutcast] send_stationlist_entries");
-  } else {
-    id = g_idle_add ((GSourceFunc) send_genrelist_entries, op_data);
-    g_source_set_name_by_id (id, "[shoutcast] send_genrelist_entries");
+  node = xmlDocGetRootElement (xml_doc);
+  if  (!node) {
+    *message = _("Empty response");
+    xmlFreeDoc (xml_doc);
+    return NULL;
   }
 
-  return;
+  stationlist_result = (xmlStrcmp (node->name,
+                                   (const xmlChar *) "stationlist") == 0);
 
- finalize:
-  op_data->result_cb (op_data->source,
-                      op_data->operation_id,
-                      NULL,
-                      0,
-                      op_data->user_data,
-                      error);
+  list = grl_shoutcast_list_new (stationlist_result, limit);
 
- free_resources:
-  g_clear_pointer (&op_data->xml_doc, xmlFreeDoc);
-  g_clear_pointer (&op_data->filter_entry, g_free);
-  g_clear_error (&error);
+  /* Stations come after a "tunein" node, which is skipped */
+  for (node = node->xmlChildrenNode; node; node = node->next) {
+    gchar *name, *id, *mime, *bitrate, *genre_field;
+    gchar **station_genres;
 
-  g_slice_free (OperationData, op_data);
+    if (!stationlist_result) {
+      if (xmlStrcmp (node->name, (const xmlChar *) "genre") != 0)
+        continue;
+
+      name = xml_get_prop (node, "name");
+      grl_shoutcast_list_add (list, name, NULL, NULL, NULL, NULL);
+      g_free (name);
+      continue;
+    }
+
+    if (xmlStrcmp (node->name, (const xmlChar *) "station") != 0)
+      continue;
+
+    name = xml_get_prop (node, "name");
+    id = xml_get_prop (node, "id");
+    mime = xml_get_prop (node, "mt");
+    bitrate = xml_get_prop (node, "br");
+    genre_field = xml_get_prop (node, "genre");
+    station_genres = g_strsplit (genre_field ? genre_field : "", " ", 2);
+
+    grl_shoutcast_list_add (list, name, id, mime, bitrate, station_genres[0]);
+
+    g_strfreev (station_genres);
+    g_free (genre_field);
+    g_free (bitrate);
+    g_free (mime);
+    g_free (id);
+    g_free (name);
+  }
+
+  xmlFreeDoc (xml_doc);
+
+  return list;
 }
 
-static gboolean
-expire_cache (gpointer user_data)
+static void
+fetch_free (Fetch *fetch)
 {
-  GrlShoutcastSource *source = GRL_SHOUTCAST_SOURCE (user_data);
-
-  GRL_DEBUG ("Cached page expired");
-  source->priv->cached_page_expired = TRUE;
-  return FALSE;
+  g_object_unref (fetch->cancellable);
+  g_object_unref (fetch->source);
+  g_free (fetch->key);
+  g_slice_free (Fetch, fetch);
 }
 
 static void
@@ -536,73 +542,142 @@ read_done_cb (GObject *source_object,
 {
   GError *error = NULL;
   GError *wc_error = NULL;
-  OperationData *op_data = (OperationData *) user_data;
-  GrlShoutcastSource *source = GRL_SHOUTCAST_SOURCE (op_data->source);
-  gboolean cache;
+  Fetch *fetch = user_data;
+  GrlShoutcastSource *source = fetch->source;
+  GrlShoutcastList *list = NULL;
+  const gchar *message = NULL;
   gchar *content = NULL;
+  GList *waiters, *l;
 
-  if (!grl_net_wc_request_finish (GRL_NET_WC (source_object),
-                            res,
-                            &content,
-                            NULL,
-                            &wc_error)) {
-    error = g_error_new (GRL_CORE_ERROR,
-                         op_data->error_code,
-                         _("Failed to connect: %s"),
-                         wc_error->message);
-    op_data->result_cb (op_data->source,
-                        op_data->operation_id,
-                        NULL,
-                        0,
-                        op_data->user_data,
-                        error);
-    g_error_free (wc_error);
-    g_error_free (error);
-    g_slice_free (OperationData, op_data);
+  if (g_hash_table_lookup (source->priv->fetches, fetch->key) == fetch) {
+    g_hash_table_remove (source->priv->fetches, fetch->key);
+  }
 
-    return;
+  if (!grl_net_wc_request_finish (GRL_NET_WC (source_object),
+                                  res,
+                                  &content,
+                                  NULL,
+                                  &wc_error)) {
+    message = wc_error->message;
+  } else {
+    list = xml_parse_result (content, fetch->limit, &message);
+    if (list) {
+      grl_shoutcast_cache_insert (source->priv->cache, fetch->key, list);
+    }
   }
 
-  cache = op_data->cache;
-  xml_parse_result (content, op_data);
-  if (cache && source->priv->cached_page_expired) {
-    guint id;
-    GRL_DEBUG ("Caching page");
-    g_free (source->priv->cached_page);
-    source->priv->cached_page = g_strdup (content);
-    source->priv->cached_page_expired = FALSE;
-    id = g_timeout_add_seconds (EXPIRE_CACHE_TIMEOUT, expire_cache, source);
-    g_source_set_name_by_id (id, "[shoutcast] expire_cache");
+  waiters = g_list_reverse (fetch->waiters);
+  for (l = waiters; l; l = l->next) {
+    OperationData *op_data = l->data;
+
+    op_data->fetch = NULL;
+
+    if (op_data->cancelled) {
+      operation_finish (op_data, NULL);
+    } else if (list) {
+      send_list (op_data, list);
+    } else {
+      if (wc_error) {
+        error = g_error_new (GRL_CORE_ERROR,
+                             op_data->error_code,
+                             _("Failed to connect: %s"),
+                             message);
+      } else {
+        error = g_error_new_literal (GRL_CORE_ERROR,
+                                     op_data->error_code,
+                                     message);
+      }
+      operation_finish (op_data, error);
+      g_clear_error (&error);
+    }
   }
+  g_list_free (waiters);
+
+  g_clear_pointer (&list, grl_shoutcast_list_unref);
+  g_clear_error (&wc_error);
+  fetch_free (fetch);
 }
 
 static gboolean
-read_cached_page (OperationData *op_data)
+read_cached_list (OperationData *op_data)
 {
-  gchar *cached_page = GRL_SHOUTCAST_SOURCE (op_data->source)->priv->cached_page;
-  xml_parse_result (cached_page, op_data);
+  GrlShoutcastList *list = g_steal_pointer (&op_data->list);
+
+  send_list (op_data, list);
+  grl_shoutcast_list_unref (list);
+
   return FALSE;
 }
 
+/* Answers @op_data from the list of @key, with at least @limit entries.
+ * The list is cached, and operations needing it while it is fetched wait
+ * for the same request. */
 static void
-read_url_async (GrlShoutcastSource *source,
-                const gchar *url,
-                OperationData *op_data)
+read_list_async (GrlShoutcastSource *source,
+                 const gchar *key,
+                 const gchar *url,
+                 guint limit,
+                 OperationData *op_data)
 {
-  if (op_data->cache && !source->priv->cached_page_expired) {
-    guint id;
-    GRL_DEBUG ("Using cached page");
-    id = g_idle_add ((GSourceFunc) read_cached_page, op_data);
-    g_source_set_name_by_id (id, "[shoutcast] read_cached_page");
-  } else {
-    if (!source->priv->wc)
-      source->priv->wc = grl_net_wc_new ();
+  GrlShoutcastList *list;
+  Fetch *fetch;
+  guint id;
 
-    source->priv->cancellable = g_cancellable_new ();
-    grl_net_wc_request_async (source->priv->wc, url,
-                              source->priv->cancellable,
-                              read_done_cb, op_data);
+  list = grl_shoutcast_cache_lookup (source->priv->cache, key);
+  if (list && grl_shoutcast_list_covers (list, limit)) {
+    GRL_DEBUG ("Using cached list for %s", key);
+    /* Answered later, like any other operation */
+    op_data->list = grl_shoutcast_list_ref (list);
+    id = g_idle_add ((GSourceFunc) read_cached_list, op_data);
+    g_source_set_name_by_id (id, "[shoutcast] read_cached_list");
+    return;
+  }
+
+  fetch = g_hash_table_lookup (source->priv->fetches, key);
+  if (fetch && fetch->limit >= limit) {
+    GRL_DEBUG ("Waiting for the list of %s being fetched", key);
+    fetch->waiters = g_list_prepend (fetch->waiters, op_data);
+    op_data->fetch = fetch;
+    return;
   }
+
+  if (!source->priv->wc)
+    source->priv->wc = grl_net_wc_new ();
+
+  fetch = g_slice_new0 (Fetch);
+  fetch->source = g_object_ref (source);
+  fetch->key = g_strdup (key);
+  fetch->limit = limit;
+  fetch->cancellable = g_cancellable_new ();
+  fetch->waiters = g_list_prepend (NULL, op_data);
+  op_data->fetch = fetch;
+
+  /* Replaces any smaller fetch in flight for later operations */
+  g_hash_table_insert (source->priv->fetches, fetch->key, fetch);
+
+  grl_net_wc_request_async (source->priv->wc, url,
+                            fetch->cancellable,
+                            read_done_cb, fetch);
+}
+
+/* Returns: the number of stations to fetch to get @skip and @count */
+static guint
+fetch_limit (guint skip, guint count)
+{
+  guint limit;
+
+  if (count > G_MAXINT - MIN (skip, G_MAXINT))
+    return G_MAXINT;
+
+  limit = skip + count;
+  if (limit <= SHOUTCAST_MIN_FETCH_LIMIT)
+    return SHOUTCAST_MIN_FETCH_LIMIT;
+
+  /* Next power of two, so paging does not refetch each time */
+  if (limit > G_MAXINT / 2)
+    return G_MAXINT;
+
+  return 1U << g_bit_storage (limit - 1);
 }
 
 /* ================== API Implementation ================ */
@@ -629,7 +704,9 @@ grl_shoutcast_source_resolve (GrlSource *source,
 {
   const gchar *media_id;
   gchar **id_tokens;
+  gchar *key = NULL;
   gchar *url = NULL;
+  guint limit = G_MAXINT;
   OperationData *data = NULL;
   GrlShoutcastSource *shoutcast_source = GRL_SHOUTCAST_SOURCE (source);
 
@@ -663,11 +740,13 @@ grl_shoutcast_source_resolve (GrlSource *source,
 
       /* Check if result is from a previous search */
       if (id_tokens[0][0] == '?') {
+        key = g_strconcat ("search:", id_tokens[0]+1, NULL);
         url = g_strdup_printf (SHOUTCAST_SEARCH_RADIOS,
                                shoutcast_source->priv->dev_key,
                                id_tokens[0]+1,
                                G_MAXINT);
       } else {
+        key = g_strconcat ("genre:", id_tokens[0], NULL);
         url = g_strdup_printf (SHOUTCAST_GET_RADIOS,
                                shoutcast_source->priv->dev_key,
                                id_tokens[0],
@@ -675,7 +754,8 @@ grl_shoutcast_source_resolve (GrlSource *source,
       }
     } else {
       data->filter_entry = g_strdup (id_tokens[0]);
-      data->cache = TRUE;
+      limit = 0;
+      key = g_strdup ("genres");
       url = g_strdup_printf (SHOUTCAST_GET_GENRES,
                              shoutcast_source->priv->dev_key);
     }
@@ -684,7 +764,8 @@ grl_shoutcast_source_resolve (GrlSource *source,
   }
 
   if (url) {
-    read_url_async (shoutcast_source, url, data);
+    read_list_async (shoutcast_source, key, url, limit, data);
+    g_free (key);
     g_free (url);
   } else {
     rs->callback (rs->source, rs->operation_id, rs->media, rs->user_data, NULL);
@@ -697,7 +778,9 @@ grl_shoutcast_source_browse (GrlSource *source,
 {
   OperationData *data;
   const gchar *container_id;
+  gchar *key;
   gchar *url;
+  guint limit;
   GrlShoutcastSource *shoutcast_source = GRL_SHOUTCAST_SOURCE (source);
 
   GRL_DEBUG ("grl_shoutcast_source_browse");
@@ -715,21 +798,26 @@ grl_shoutcast_source_browse (GrlSource *source,
 
   /* If it's root category send list of genres; else send list of radios */
   if (!container_id) {
-    data->cache = TRUE;
+    /* All genres come in one response */
+    limit = 0;
+    key = g_strdup ("genres");
     url = g_strdup_printf (SHOUTCAST_GET_GENRES,
                            shoutcast_source->priv->dev_key);
   } else {
+    limit = fetch_limit (data->skip, data->count);
+    key = g_strconcat ("genre:", container_id, NULL);
     url = g_strdup_printf (SHOUTCAST_GET_RADIOS,
                            shoutcast_source->priv->dev_key,
                            container_id,
-                           data->skip + data->count);
+                           limit);
     data->genre = g_strdup (container_id);
   }
 
   grl_operation_set_data (bs->operation_id, data);
 
-  read_url_async (shoutcast_source, url, data);
+  read_list_async (shoutcast_source, key, url, limit, data);
 
+  g_free (key);
   g_free (url);
 }
 
@@ -739,7 +827,9 @@ grl_shoutcast_source_search (GrlSource *source,
 {
   GError *error;
   OperationData *data;
+  gchar *key;
   gchar *url;
+  guint limit;
   GrlShoutcastSource *shoutcast_source = GRL_SHOUTCAST_SOURCE (source);
 
   /* Check if there is text to search */
@@ -770,13 +860,16 @@ grl_shoutcast_source_search (GrlSource *source,
 
   grl_operation_set_data (ss->operation_id, data);
 
+  limit = fetch_limit (data->skip, data->count);
+  key = g_strconcat ("search:", ss->text, NULL);
   url = g_strdup_printf (SHOUTCAST_SEARCH_RADIOS,
                          shoutcast_source->priv->dev_key,
                          ss->text,
-                         data->skip + data->count);
+                         limit);
 
-  read_url_async (GRL_SHOUTCAST_SOURCE (source), url, data);
+  read_list_async (shoutcast_source, key, url, limit, data);
 
+  g_free (key);
   g_free (url);
 }
 
@@ -785,17 +878,33 @@ grl_shoutcast_source_cancel (GrlSource *source, guint operation_id)
 {
   OperationData *op_data;
   GrlShoutcastSourcePrivate *priv = GRL_SHOUTCAST_SOURCE(source)->priv;
+  Fetch *fetch;
+  GList *l;
 
   GRL_DEBUG ("grl_shoutcast_source_cancel");
 
-  if (priv->cancellable && G_IS_CANCELLABLE (priv->cancellable)) {
-    g_cancellable_cancel (priv->cancellable);
+  op_data = (OperationData *) grl_operation_get_data (operation_id);
+
+  if (!op_data) {
+    return;
   }
-  priv->cancellable = NULL;
 
-  op_data = (OperationData *) grl_operation_get_data (operation_id);
+  op_data->cancelled = TRUE;
+
+  /* Only stop the request if no other operation waits for it */
+  fetch = op_data->fetch;
+  if (!fetch) {
+    return;
+  }
+
+  for (l = fetch->waiters; l; l = l->next) {
+    if (!((OperationData *) l->data)->cancelled) {
+      return;
+    }
+  }
 
-  if (op_data) {
-    op_data->cancelled = TRUE;
+  if (g_hash_table_lookup (priv->fetches, fetch->key) == fetch) {
+    g_hash_table_remove (priv->fetches, fetch->key);
   }
+  g_cancellable_cancel (fetch->cancellable);
 }
@@ -24,6 +24,7 @@
 #include "config.h"
 #endif
 
+#include <string.h>
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <glib/gi18n-lib.h>
@@ -34,6 +35,7 @@
 
 #include "grl-thetvdb.h"
 #include "thetvdb-resources.h"
+#include "thetvdb-cache.h"
 
 /* --------- Logging  -------- */
 
@@ -57,7 +59,19 @@ GRL_LOG_DOMAIN_STATIC (thetvdb_log_domain);
 #define THETVDB_STR_DELIMITER   "|"
 #define THETVDB_DEFAULT_LANG    "en"
 #define GRL_SQL_DB              "grl-thetvdb.db"
-#define GOM_DB_VERSION          3
+#define GOM_DB_VERSION          4
+/* Resources stored per transaction while importing a series */
+#define THETVDB_IMPORT_BATCH    256
+
+/* --- Refresh of cached series --- */
+#define THETVDB_STATUS_ENDED          "Ended"
+#define THETVDB_MAX_AGE_CONTINUING    (24 * 60 * 60)
+#define THETVDB_MAX_AGE_ENDED         (30 * 24 * 60 * 60)
+#define THETVDB_REFRESH_RETRY         (60 * 60)
+#define THETVDB_MAX_REFRESHES         2
+
+/* --- Configuration --- */
+#define GRILO_CONF_PREFETCH     "prefetch"
 
 /* --- XML Fields --- */
 #define THETVDB_ID              BAD_CAST "id"
@@ -111,6 +125,21 @@ struct _GrlTheTVDBPrivate {
   /* Hash table with a string as key (the show name) and a list as its value
    * (a list of OperationSpec *) */
   GHashTable    *ht_wait_list;
+
+  /* Most recently resolved shows, and the shows being loaded in it, with
+   * the same layout as ht_wait_list */
+  TheTVDBCache  *hot_cache;
+  GHashTable    *ht_loading;
+
+  /* When enabled, episodes are looked up in the database while their show
+   * is loaded in memory, instead of waiting for it */
+  gboolean       prefetch;
+
+  /* Stale series waiting to be downloaded again, and the time of the last
+   * attempt of each series, to not retry too often */
+  GQueue        *refresh_queue;
+  GHashTable    *ht_refreshed;
+  guint          refreshing;
 };
 
 typedef struct _OperationSpec {
@@ -204,6 +233,8 @@ grl_thetvdb_plugin_init (GrlRegistry *registry,
   }
 
   source = grl_thetvdb_source_new (api_key);
+  if (grl_config_has_param (config, GRILO_CONF_PREFETCH))
+    source->priv->prefetch = grl_config_get_boolean (config, GRILO_CONF_PREFETCH);
   grl_registry_register_source (registry,
                                 plugin,
                                 GRL_SOURCE (source),
@@ -398,6 +429,11 @@ grl_thetvdb_source_init (GrlTheTVDBSource *source)
   /* Creates our pending queue */
   source->priv->ht_wait_list = g_hash_table_new_full (g_str_hash, g_str_equal,
                                                       g_free, NULL);
+  source->priv->ht_loading = g_hash_table_new (g_str_hash, g_str_equal);
+  source->priv->hot_cache = thetvdb_cache_new (THETVDB_CACHE_MAX_SHOWS);
+  source->priv->refresh_queue = g_queue_new ();
+  source->priv->ht_refreshed = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                      g_free, g_free);
 
   source->priv->repository = gom_repository_new (source->priv->adapter);
   tables = g_list_prepend (NULL, GINT_TO_POINTER (SERIES_TYPE_RESOURCE));
@@ -418,6 +454,11 @@ grl_thetvdb_source_finalize (GObject *object)
 
   g_list_free (source->priv->supported_keys);
   g_hash_table_destroy (source->priv->ht_wait_list);
+  g_clear_pointer (&source->priv->ht_loading, g_hash_table_destroy);
+  g_clear_pointer (&source->priv->hot_cache, thetvdb_cache_free);
+  if (source->priv->refresh_queue != NULL)
+    g_queue_free_full (source->priv->refresh_queue, g_free);
+  g_clear_pointer (&source->priv->ht_refreshed, g_hash_table_destroy);
   g_clear_object (&source->priv->repository);
   g_clear_pointer (&source->priv->api_key, g_free);
 
@@ -486,139 +527,189 @@ get_pref_language (GrlTheTVDBSource *tvdb_source)
   return g_strdup (THETVDB_DEFAULT_LANG);
 }
 
-static EpisodeResource *
-xml_parse_and_save_episodes (GomRepository *repository,
-                             xmlDocPtr doc,
-                             const gchar *title,
-                             gint season_number,
-                             gint episode_number)
+static gchar *
+xml_get_child_string (xmlDocPtr doc,
+                      xmlNodePtr node,
+                      const xmlChar *name)
+{
+  xmlNodePtr child;
+  xmlChar *node_data;
+  gchar *str = NULL;
+
+  for (child = node->xmlChildrenNode; child != NULL; child = child->next) {
+    if (xmlStrcmp (child->name, name) != 0)
+      continue;
+
+    node_data = xmlNodeListGetString (doc, child->xmlChildrenNode, 1);
+    if (node_data != NULL) {
+      str = g_strdup ((gchar *) node_data);
+      xmlFree (node_data);
+    }
+    break;
+  }
+
+  return str;
+}
+
+/* Returns the resources of the episodes of the series already in the
+ * cache, with their episode-id as key. */
+static GHashTable *
+cache_get_episodes_sync (GomRepository *repository,
+                         const gchar *series_id)
 {
-  xmlNodePtr node, child;
+  GomResourceGroup *group;
+  GomFilter *filter;
+  GHashTable *episodes;
+  GValue value = { 0, };
+  GError *error = NULL;
+  guint i, count;
+
+  episodes = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                    g_free, g_object_unref);
+
+  g_value_init (&value, G_TYPE_STRING);
+  g_value_set_string (&value, series_id);
+  filter = gom_filter_new_eq (EPISODE_TYPE_RESOURCE,
+                              EPISODE_COLUMN_SERIES_ID,
+                              &value);
+  g_value_unset (&value);
+
+  group = gom_repository_find_sync (repository, EPISODE_TYPE_RESOURCE,
+                                    filter, &error);
+  g_object_unref (filter);
+  if (group == NULL)
+    goto get_episodes_end;
+
+  count = gom_resource_group_get_count (group);
+  if (count > 0 && !gom_resource_group_fetch_sync (group, 0, count, &error))
+    goto get_episodes_end;
+
+  for (i = 0; i < count; i++) {
+    GomResource *resource = gom_resource_group_get_index (group, i);
+    gchar *episode_id;
+
+    g_object_get (resource, EPISODE_COLUMN_EPISODE_ID, &episode_id, NULL);
+    if (episode_id != NULL)
+      g_hash_table_insert (episodes, episode_id, g_object_ref (resource));
+  }
+
+get_episodes_end:
+  if (error != NULL) {
+    GRL_DEBUG ("Failed to get cached episodes of series '%s' due %s",
+               series_id, error->message);
+    g_error_free (error);
+  }
+  g_clear_object (&group);
+  return episodes;
+}
+
+/* Episodes that were not in the cache yet are added to @added */
+static void
+xml_parse_episode (GomRepository *repository,
+                   GomResourceGroup *group,
+                   xmlNodePtr node,
+                   GHashTable *cached_episodes,
+                   GPtrArray *added)
+{
+  xmlDocPtr doc = node->doc;
+  xmlNodePtr child;
   xmlChar *node_data = NULL;
-  EpisodeResource *episode_resource= NULL;
+  EpisodeResource *eres = NULL;
+  gchar *episode_id;
 
-  /* Get ptr to <data> */
-  node = xmlDocGetRootElement (doc);
-  /* Get ptr to <Serie> */
-  node = node->xmlChildrenNode;
-  /* Iterate in the <Episode> nodes */
-  for (node = node->next; node != NULL; node = node->next) {
-    GError *error = NULL;
-    gint tmp_season_number = -1;
-    gint tmp_episode_number = -1;
-    gchar *tmp_title = NULL;
-    gboolean episode_found = FALSE;
-    EpisodeResource *eres;
+  /* Episodes already in the cache are updated instead of added again */
+  episode_id = xml_get_child_string (doc, node, THETVDB_ID);
+  if (episode_id != NULL)
+    eres = g_hash_table_lookup (cached_episodes, episode_id);
+  g_free (episode_id);
 
+  if (eres != NULL) {
+    g_object_ref (eres);
+  } else {
     eres = g_object_new (EPISODE_TYPE_RESOURCE,
                          "repository", repository,
                          NULL);
+    g_ptr_array_add (added, g_object_ref (eres));
+  }
 
-    for (child = node->xmlChildrenNode; child != NULL; child = child->next) {
-      node_data = xmlNodeListGetString (doc, child->xmlChildrenNode, 1);
-      if (node_data == NULL)
-        continue;
+  for (child = node->xmlChildrenNode; child != NULL; child = child->next) {
+    node_data = xmlNodeListGetString (doc, child->xmlChildrenNode, 1);
+    if (node_data == NULL)
+      continue;
+
+    if (xmlStrcasecmp (child->name, THETVDB_LANGUAGE) == 0) {
+      g_object_set (G_OBJECT (eres), EPISODE_COLUMN_LANGUAGE,
+                    (gchar *) node_data, NULL);
 
-      if (xmlStrcasecmp (child->name, THETVDB_LANGUAGE) == 0) {
-        g_object_set (G_OBJECT (eres), EPISODE_COLUMN_LANGUAGE,
-                      (gchar *) node_data, NULL);
+    } else if (xmlStrcmp (child->name, THETVDB_OVERVIEW) == 0) {
+      g_object_set (G_OBJECT (eres), EPISODE_COLUMN_OVERVIEW,
+                    (gchar *) node_data, NULL);
 
-      } else if (xmlStrcmp (child->name, THETVDB_OVERVIEW) == 0) {
-        g_object_set (G_OBJECT (eres), EPISODE_COLUMN_OVERVIEW,
-                      (gchar *) node_data, NULL);
+    } else if (xmlStrcmp (child->name, THETVDB_FIRST_AIRED) == 0) {
+      g_object_set (G_OBJECT (eres), EPISODE_COLUMN_FIRST_AIRED,
+                    (gchar *) node_data, NULL);
 
-      } else if (xmlStrcmp (child->name, THETVDB_FIRST_AIRED) == 0) {
-        g_object_set (G_OBJECT (eres), EPISODE_COLUMN_FIRST_AIRED,
-                      (gchar *) node_data, NULL);
+    } else if (xmlStrcmp (child->name, THETVDB_IMDB_ID) == 0) {
+      g_object_set (G_OBJECT (eres), EPISODE_COLUMN_IMDB_ID,
+                    (gchar *) node_data, NULL);
 
-      } else if (xmlStrcmp (child->name, THETVDB_IMDB_ID) == 0) {
-        g_object_set (G_OBJECT (eres), EPISODE_COLUMN_IMDB_ID,
-                      (gchar *) node_data, NULL);
+    } else if (xmlStrcmp (child->name, THETVDB_SEASON_ID) == 0) {
+      g_object_set (G_OBJECT (eres), EPISODE_COLUMN_SEASON_ID,
+                    (gchar *) node_data, NULL);
 
-      } else if (xmlStrcmp (child->name, THETVDB_SEASON_ID) == 0) {
-        g_object_set (G_OBJECT (eres), EPISODE_COLUMN_SEASON_ID,
-                      (gchar *) node_data, NULL);
+    } else if (xmlStrcmp (child->name, THETVDB_SERIE_ID) == 0) {
+      g_object_set (G_OBJECT (eres), EPISODE_COLUMN_SERIES_ID,
+                    (gchar *) node_data, NULL);
 
-      } else if (xmlStrcmp (child->name, THETVDB_SERIE_ID) == 0) {
-        g_object_set (G_OBJECT (eres), EPISODE_COLUMN_SERIES_ID,
-                      (gchar *) node_data, NULL);
+    } else if (xmlStrcmp (child->name, THETVDB_DIRECTOR) == 0) {
+      g_object_set (G_OBJECT (eres), EPISODE_COLUMN_DIRECTOR_NAMES,
+                    (gchar *) node_data, NULL);
 
-      } else if (xmlStrcmp (child->name, THETVDB_DIRECTOR) == 0) {
-        g_object_set (G_OBJECT (eres), EPISODE_COLUMN_DIRECTOR_NAMES,
-                      (gchar *) node_data, NULL);
+    } else if (xmlStrcmp (child->name, THETVDB_GUEST_STARS) == 0) {
+      g_object_set (G_OBJECT (eres), EPISODE_COLUMN_GUEST_STARS_NAMES,
+                    (gchar *) node_data, NULL);
 
-      } else if (xmlStrcmp (child->name, THETVDB_GUEST_STARS) == 0) {
-        g_object_set (G_OBJECT (eres), EPISODE_COLUMN_GUEST_STARS_NAMES,
-                      (gchar *) node_data, NULL);
+    } else if (xmlStrcmp (child->name, THETVDB_ID) == 0) {
+      g_object_set (G_OBJECT (eres), EPISODE_COLUMN_EPISODE_ID,
+                    (gchar *) node_data, NULL);
 
-      } else if (xmlStrcmp (child->name, THETVDB_ID) == 0) {
-        g_object_set (G_OBJECT (eres), EPISODE_COLUMN_EPISODE_ID,
-                      (gchar *) node_data, NULL);
+    } else if (xmlStrcmp (child->name, THETVDB_FILENAME) == 0) {
+      gchar *str = g_strdup_printf (THETVDB_BASE_IMG, (gchar *) node_data);
+      g_object_set (G_OBJECT (eres), EPISODE_COLUMN_URL_EPISODE_SCREEN,
+                    str, NULL);
+      g_free (str);
 
-      } else if (xmlStrcmp (child->name, THETVDB_FILENAME) == 0) {
-        gchar *str = g_strdup_printf (THETVDB_BASE_IMG, (gchar *) node_data);
-        g_object_set (G_OBJECT (eres), EPISODE_COLUMN_URL_EPISODE_SCREEN,
-                      str, NULL);
-        g_free (str);
+    } else if (xmlStrcmp (child->name, THETVDB_EPISODE_NAME) == 0) {
+      g_object_set (G_OBJECT (eres), EPISODE_COLUMN_EPISODE_NAME,
+                    (gchar *) node_data, NULL);
 
-      } else if (xmlStrcmp (child->name, THETVDB_EPISODE_NAME) == 0) {
-        g_object_set (G_OBJECT (eres), EPISODE_COLUMN_EPISODE_NAME,
-                      (gchar *) node_data, NULL);
-        tmp_title = g_strdup ((gchar *) node_data);
-
-      } else if (xmlStrcmp (child->name, THETVDB_RATING) == 0) {
-        gdouble num_double = g_ascii_strtod ((gchar *) node_data, NULL);
-        g_object_set (G_OBJECT (eres), EPISODE_COLUMN_RATING, num_double, NULL);
-
-      } else if (xmlStrcmp (child->name, THETVDB_SEASON_NUMBER) == 0) {
-        gint num = g_ascii_strtoull ((gchar *) node_data, NULL, 10);
-        g_object_set (G_OBJECT (eres), EPISODE_COLUMN_SEASON_NUMBER, num, NULL);
-        tmp_season_number = num;
-
-      } else if (xmlStrcmp (child->name, THETVDB_ABSOLUTE_NUMBER) == 0) {
-        gint num = g_ascii_strtoull ((gchar *) node_data, NULL, 10);
-        g_object_set (G_OBJECT (eres), EPISODE_COLUMN_ABSOLUTE_NUMBER,
-                      num, NULL);
-
-      } else if (xmlStrcmp (child->name, THETVDB_EPISODE_NUMBER) == 0) {
-        gint num = g_ascii_strtoull ((gchar *) node_data, NULL, 10);
-        g_object_set (G_OBJECT (eres), EPISODE_COLUMN_EPISODE_NUMBER,
-                      num, NULL);
-        tmp_episode_number = num;
-      }
+    } else if (xmlStrcmp (child->name, THETVDB_RATING) == 0) {
+      gdouble num_double = g_ascii_strtod ((gchar *) node_data, NULL);
+      g_object_set (G_OBJECT (eres), EPISODE_COLUMN_RATING, num_double, NULL);
 
-      if (node_data != NULL) {
-        xmlFree (node_data);
-        node_data = NULL;
-      }
-    }
+    } else if (xmlStrcmp (child->name, THETVDB_SEASON_NUMBER) == 0) {
+      gint num = g_ascii_strtoull ((gchar *) node_data, NULL, 10);
+      g_object_set (G_OBJECT (eres), EPISODE_COLUMN_SEASON_NUMBER, num, NULL);
 
-    /* Check if the episode is the same we want */
-    if (tmp_season_number == season_number
-        && tmp_episode_number == episode_number) {
-      episode_found = TRUE;
-      episode_resource = eres;
-    }
+    } else if (xmlStrcmp (child->name, THETVDB_ABSOLUTE_NUMBER) == 0) {
+      gint num = g_ascii_strtoull ((gchar *) node_data, NULL, 10);
+      g_object_set (G_OBJECT (eres), EPISODE_COLUMN_ABSOLUTE_NUMBER,
+                    num, NULL);
 
-    if (title != NULL && tmp_title != NULL
-        && g_ascii_strcasecmp (title, tmp_title) == 0) {
-      episode_found = TRUE;
-      episode_resource = eres;
+    } else if (xmlStrcmp (child->name, THETVDB_EPISODE_NUMBER) == 0) {
+      gint num = g_ascii_strtoull ((gchar *) node_data, NULL, 10);
+      g_object_set (G_OBJECT (eres), EPISODE_COLUMN_EPISODE_NUMBER,
+                    num, NULL);
     }
 
-    gom_resource_save_sync (GOM_RESOURCE (eres), &error);
-    if (error != NULL) {
-      GRL_DEBUG ("Failed to store episode '%s' due %s",
-                  tmp_title, error->message);
-      g_error_free (error);
+    if (node_data != NULL) {
+      xmlFree (node_data);
+      node_data = NULL;
     }
-
-    g_clear_pointer (&tmp_title, g_free);
-    if (!episode_found)
-      g_object_unref (eres);
   }
 
-  return episode_resource;
+  gom_resource_group_append (group, GOM_RESOURCE (eres));
+  g_object_unref (eres);
 }
 
 static gchar *
@@ -649,48 +740,80 @@ xml_parse_get_series_id (xmlDocPtr doc)
 }
 
 static void
-cache_save_fuzzy_series_names (GomRepository *repository,
-                               const gchar *fuzzy_name,
-                               const gchar *series_id)
+cache_add_fuzzy_series_names (GomRepository *repository,
+                              GomResourceGroup *group,
+                              const gchar *fuzzy_name,
+                              const gchar *series_id)
 {
-  GError *error = NULL;
   FuzzySeriesNamesResource *fsres =
     g_object_new (FUZZY_SERIES_NAMES_TYPE_RESOURCE,
                   "repository", repository,
                   FUZZY_SERIES_NAMES_COLUMN_FUZZY_NAME, fuzzy_name,
                   FUZZY_SERIES_NAMES_COLUMN_SERIES_ID, series_id,
                   NULL);
-  gom_resource_save_sync (GOM_RESOURCE (fsres), &error);
-  if (error != NULL) {
-    GRL_DEBUG ("Failed to store fuzzy series name '%s' due %s",
-               fuzzy_name, error->message);
+  gom_resource_group_append (group, GOM_RESOURCE (fsres));
+  g_object_unref (fsres);
+}
+
+static SeriesResource *
+cache_find_serie_sync (GomRepository *repository,
+                       const gchar *series_id)
+{
+  GomResource *resource;
+  GomFilter *filter;
+  GValue value = { 0, };
+  GError *error = NULL;
+
+  g_value_init (&value, G_TYPE_STRING);
+  g_value_set_string (&value, series_id);
+  filter = gom_filter_new_eq (SERIES_TYPE_RESOURCE,
+                              SERIES_COLUMN_SERIES_ID,
+                              &value);
+  g_value_unset (&value);
+
+  resource = gom_repository_find_one_sync (repository, SERIES_TYPE_RESOURCE,
+                                           filter, &error);
+  g_object_unref (filter);
+  if (resource == NULL) {
     g_error_free (error);
+    return NULL;
   }
-  g_object_unref (fsres);
+
+  return SERIES_RESOURCE (resource);
 }
 
 static SeriesResource *
-xml_parse_and_save_serie (GomRepository *repository,
-                          xmlDocPtr doc,
-                          const gchar *requested_show)
+xml_parse_serie (GomRepository *repository,
+                 GomResourceGroup *group,
+                 xmlNodePtr serie_node,
+                 const gchar *requested_show)
 {
+  xmlDocPtr doc = serie_node->doc;
   xmlNodePtr node;
   xmlChar *node_data = NULL;
-  SeriesResource *sres;
-  GError *error = NULL;
+  SeriesResource *sres = NULL;
+  gboolean is_new = FALSE;
   gchar *show = NULL;
-  gchar *series_id = NULL;
+  gchar *series_id;
 
-  sres = g_object_new (SERIES_TYPE_RESOURCE,
-                       "repository", repository,
-                       NULL);
+  /* Series already in the cache are updated instead of added again */
+  series_id = xml_get_child_string (doc, serie_node, THETVDB_ID);
+  if (series_id != NULL)
+    sres = cache_find_serie_sync (repository, series_id);
+  g_clear_pointer (&series_id, g_free);
+
+  if (sres == NULL) {
+    is_new = TRUE;
+    sres = g_object_new (SERIES_TYPE_RESOURCE,
+                         "repository", repository,
+                         NULL);
+  }
+
+  g_object_set (G_OBJECT (sres), SERIES_COLUMN_LAST_UPDATED,
+                g_get_real_time () / G_USEC_PER_SEC, NULL);
 
-  /* Get ptr to <data> */
-  node = xmlDocGetRootElement (doc);
-  /* Get ptr to <Serie> */
-  node = node->xmlChildrenNode;
   /* Iterate in the <Serie> */
-  for (node = node->xmlChildrenNode; node != NULL; node = node->next) {
+  for (node = serie_node->xmlChildrenNode; node != NULL; node = node->next) {
     node_data = xmlNodeListGetString (doc, node->xmlChildrenNode, 1);
     if (node_data == NULL)
       continue;
@@ -763,21 +886,17 @@ xml_parse_and_save_serie (GomRepository *repository,
     }
   }
 
-  gom_resource_save_sync (GOM_RESOURCE (sres), &error);
-  if (error != NULL) {
-    GRL_DEBUG ("Failed to store series '%s' due %s",
-                show, error->message);
-    g_error_free (error);
+  gom_resource_group_append (group, GOM_RESOURCE (sres));
 
-  } else if (series_id != NULL) {
+  if (is_new && series_id != NULL) {
     /* This is a new series to our db. Keep it on fuzzy naming db as well */
-      cache_save_fuzzy_series_names (repository, show, series_id);
+    cache_add_fuzzy_series_names (repository, group, show, series_id);
   }
 
   if (series_id != NULL && requested_show != NULL &&
       g_strcmp0 (show, requested_show) != 0) {
     /* Always save the user's requested show to our fuzzy naming db */
-    cache_save_fuzzy_series_names (repository, requested_show, series_id);
+    cache_add_fuzzy_series_names (repository, group, requested_show, series_id);
   }
 
   g_clear_pointer (&show, g_free);
@@ -1096,10 +1215,18 @@ web_request_succeed (const OperationSpec *os,
   const gchar *show;
   GList *wait_list, *it;
   GrlTheTVDBSource *tvdb_source;
+  gchar *series_id;
 
   tvdb_source = GRL_THETVDB_SOURCE (os->source);
   show = grl_media_get_show (os->media);
 
+  /* The series was updated, reload it in memory */
+  g_object_get (sres, SERIES_COLUMN_SERIES_ID, &series_id, NULL);
+  if (series_id != NULL) {
+    thetvdb_cache_remove_series (tvdb_source->priv->hot_cache, series_id);
+    g_free (series_id);
+  }
+
   wait_list = g_hash_table_lookup (tvdb_source->priv->ht_wait_list, show);
   for (it = wait_list; it != NULL; it = it->next) {
     OperationSpec *os = (OperationSpec *) it->data;
@@ -1140,16 +1267,16 @@ web_request_failed (const OperationSpec *os)
   g_hash_table_remove (tvdb_source->priv->ht_wait_list, show);
 }
 
-static gboolean
-unzip_all_series_data (gchar *zip,
-                       gsize zip_len,
-                       gchar *language,
-                       gchar **dest)
+/* Returns the archive positioned at the data of the series in @language, so
+ * it can be read without extracting it first. */
+static struct archive *
+unzip_open_series_data (gchar *zip,
+                        gsize zip_len,
+                        gchar *language)
 {
   struct archive *a;
   struct archive_entry *entry;
   gint r;
-  gboolean ret = FALSE;
   gchar *target_xml;
 
   a = archive_read_new ();
@@ -1157,7 +1284,8 @@ unzip_all_series_data (gchar *zip,
   r = archive_read_open_memory (a, zip, zip_len);
   if (r != ARCHIVE_OK) {
     GRL_DEBUG ("Fail to open archive.");
-    goto unzip_all_series_end;
+    archive_read_free (a);
+    return NULL;
   }
 
   target_xml = g_strdup_printf (THETVDB_ALL_DATA_XML, language);
@@ -1166,42 +1294,278 @@ unzip_all_series_data (gchar *zip,
 
     name = archive_entry_pathname (entry);
     GRL_DEBUG ("[ZIP] ENTRY-NAME: '%s'", name);
-    if (g_strcmp0 (name, target_xml) == 0) {
-      size_t size = archive_entry_size (entry);
-      char *buf;
-      ssize_t read;
-
-      buf = g_malloc (size + 1);
-      buf[size] = 0;
-      read = archive_read_data (a, buf, size);
-      if (read <= 0) {
-        g_free (buf);
-        if (read < 0)
-          GRL_DEBUG ("Fatal error reading '%s' in archive: %s",
-                     name, archive_error_string (a));
-        else
-          GRL_DEBUG ("Read an empty file from the archive");
-      } else {
-        *dest = buf;
-        break;
-      }
-    }
+    if (g_strcmp0 (name, target_xml) == 0)
+      break;
+
     archive_read_data_skip (a);
   }
-
   g_free (target_xml);
+
   if (r != ARCHIVE_OK) {
     if (r == ARCHIVE_FATAL) {
       GRL_WARNING ("Fatal error handling archive: %s",
                    archive_error_string (a));
+    } else {
+      GRL_DEBUG ("Series data not found in archive");
     }
-    goto unzip_all_series_end;
+    archive_read_free (a);
+    return NULL;
   }
 
-  ret = TRUE;
-unzip_all_series_end:
+  return a;
+}
+
+static int
+unzip_read_cb (void *context,
+               char *buffer,
+               int len)
+{
+  struct archive *a = context;
+  ssize_t read;
+
+  read = archive_read_data (a, buffer, len);
+  if (read < 0) {
+    GRL_DEBUG ("Fatal error reading archive: %s", archive_error_string (a));
+    return -1;
+  }
+
+  return read;
+}
+
+typedef struct {
+  gchar *zip_data;
+  gsize  zip_len;
+  gchar *lang;
+  gchar *requested_show;
+} ImportData;
+
+static void
+import_data_free (ImportData *data)
+{
+  g_free (data->zip_data);
+  g_free (data->lang);
+  g_free (data->requested_show);
+  g_slice_free (ImportData, data);
+}
+
+/* Stores the episodes of @group, and appends to @added_ids the database
+ * IDs of the ones in @added, which were not in the cache before */
+static gboolean
+import_write_episodes (GomResourceGroup *group,
+                       GPtrArray *added,
+                       GArray *added_ids,
+                       GError **error)
+{
+  gboolean stored;
+  gint64 id;
+  guint i;
+
+  GRL_DEBUG ("Storing %u episodes", gom_resource_group_get_count (group));
+  stored = gom_resource_group_write_sync (group, error);
+
+  for (i = 0; stored && i < added->len; i++) {
+    g_object_get (g_ptr_array_index (added, i), EPISODE_COLUMN_ID, &id, NULL);
+    g_array_append_val (added_ids, id);
+  }
+  g_ptr_array_set_size (added, 0);
+
+  return stored;
+}
+
+/* Removes the episodes stored by an import that failed afterwards */
+static void
+import_remove_episodes (GomRepository *repository,
+                        GArray *added_ids)
+{
+  EpisodeResource *eres;
+  GError *error = NULL;
+  guint i;
+
+  for (i = 0; i < added_ids->len; i++) {
+    eres = g_object_new (EPISODE_TYPE_RESOURCE,
+                         "repository", repository,
+                         EPISODE_COLUMN_ID, g_array_index (added_ids, gint64, i),
+                         NULL);
+    if (!gom_resource_delete_sync (GOM_RESOURCE (eres), &error)) {
+      GRL_DEBUG ("Failed to remove episode: %s", error->message);
+      g_clear_error (&error);
+    }
+    g_object_unref (eres);
+  }
+}
+
+/* Parses the series and all its episodes, and stores the episodes in
+ * transactions of THETVDB_IMPORT_BATCH resources, so the resources of a long
+ * series are not all kept in memory. The series itself, which tells the
+ * import is complete and fresh, is stored last; if the import fails before,
+ * the episodes it added are removed again. Runs in a worker thread, so the
+ * main loop is not blocked by the database. */
+static void
+import_series_thread (GTask *task,
+                      gpointer source_object,
+                      gpointer task_data,
+                      GCancellable *cancellable)
+{
+  GrlTheTVDBSource *tvdb_source = GRL_THETVDB_SOURCE (source_object);
+  GomRepository *repository = tvdb_source->priv->repository;
+  ImportData *data = task_data;
+  GomResourceGroup *group, *series_group = NULL;
+  GHashTable *cached_episodes = NULL;
+  GPtrArray *added;
+  GArray *added_ids;
+  SeriesResource *sres = NULL;
+  struct archive *a;
+  xmlTextReaderPtr reader;
+  xmlNodePtr node;
+  gchar *series_id;
+  GError *error = NULL;
+  gint ret;
+
+  a = unzip_open_series_data (data->zip_data, data->zip_len, data->lang);
+  if (a == NULL) {
+    g_task_return_new_error (task, GRL_CORE_ERROR, GRL_CORE_ERROR_RESOLVE_FAILED,
+                             "Failed to unzip data");
+    return;
+  }
+
+  /* The XML is parsed while it is uncompressed, one <Series> or <Episode>
+   * element at a time, so neither the whole file nor its tree is ever kept
+   * in memory. */
+  reader = xmlReaderForIO (unzip_read_cb, NULL, a, NULL, NULL,
+                           XML_PARSE_RECOVER | XML_PARSE_NOBLANKS);
+  if (reader == NULL) {
+    archive_read_free (a);
+    g_task_return_new_error (task, GRL_CORE_ERROR, GRL_CORE_ERROR_RESOLVE_FAILED,
+                             "Failed to load xml");
+    return;
+  }
+
+  group = gom_resource_group_new (repository);
+  added = g_ptr_array_new_with_free_func (g_object_unref);
+  added_ids = g_array_new (FALSE, FALSE, sizeof (gint64));
+
+  ret = xmlTextReaderRead (reader);
+  while (ret == 1) {
+    if (xmlTextReaderNodeType (reader) != XML_READER_TYPE_ELEMENT ||
+        xmlTextReaderDepth (reader) != 1) {
+      ret = xmlTextReaderRead (reader);
+      continue;
+    }
+
+    node = xmlTextReaderExpand (reader);
+    if (node == NULL) {
+      ret = -1;
+      break;
+    }
+
+    if (sres == NULL) {
+      /* The <Series> comes first, followed by its <Episode> elements */
+      series_group = gom_resource_group_new (repository);
+      sres = xml_parse_serie (repository, series_group, node, data->requested_show);
+
+      g_object_get (sres, SERIES_COLUMN_SERIES_ID, &series_id, NULL);
+      if (series_id != NULL) {
+        cached_episodes = cache_get_episodes_sync (repository, series_id);
+        g_free (series_id);
+      }
+    } else if (cached_episodes != NULL) {
+      xml_parse_episode (repository, group, node, cached_episodes, added);
+    }
+
+    if (gom_resource_group_get_count (group) >= THETVDB_IMPORT_BATCH) {
+      if (!import_write_episodes (group, added, added_ids, &error))
+        break;
+      g_object_unref (group);
+      group = gom_resource_group_new (repository);
+    }
+
+    ret = xmlTextReaderNext (reader);
+  }
+
+  xmlFreeTextReader (reader);
   archive_read_free (a);
-  return ret;
+  g_clear_pointer (&cached_episodes, g_hash_table_unref);
+
+  if (error == NULL && ret != 0) {
+    /* Reporting a partial series as imported would hide the missing
+     * episodes until the next refresh */
+    error = g_error_new (GRL_CORE_ERROR, GRL_CORE_ERROR_RESOLVE_FAILED,
+                         "Failed to parse the data of '%s'",
+                         data->requested_show);
+  } else if (error == NULL && sres == NULL) {
+    error = g_error_new_literal (GRL_CORE_ERROR, GRL_CORE_ERROR_RESOLVE_FAILED,
+                                 "Failed to load xml");
+  }
+
+  if (error == NULL &&
+      import_write_episodes (group, added, added_ids, &error)) {
+    GRL_DEBUG ("Storing series '%s'", data->requested_show);
+    gom_resource_group_write_sync (series_group, &error);
+  }
+  g_object_unref (group);
+  g_clear_object (&series_group);
+  g_ptr_array_unref (added);
+
+  if (error != NULL) {
+    GRL_DEBUG ("Failed to store series '%s' due %s",
+               data->requested_show, error->message);
+    /* Episodes already in the cache keep their new data, which is harmless
+     * as the series stays stale and is imported again */
+    import_remove_episodes (repository, added_ids);
+    g_array_unref (added_ids);
+    g_clear_object (&sres);
+    g_task_return_error (task, error);
+    return;
+  }
+  g_array_unref (added_ids);
+
+  g_task_return_pointer (task, sres, g_object_unref);
+}
+
+static void
+import_series_done (GObject *source_object,
+                    GAsyncResult *res,
+                    gpointer user_data)
+{
+  OperationSpec *os = (OperationSpec *) user_data;
+  SeriesResource *sres;
+  GError *err = NULL;
+
+  sres = g_task_propagate_pointer (G_TASK (res), &err);
+  if (sres == NULL) {
+    GRL_DEBUG ("Resolve operation failed due '%s'", err->message);
+    g_error_free (err);
+    web_request_failed (os);
+    return;
+  }
+
+  /* Data is committed: the waiting operations can look it up now */
+  web_request_succeed (os, sres);
+}
+
+static void
+import_series_async (GrlTheTVDBSource *tvdb_source,
+                     const gchar *zip_data,
+                     gsize zip_len,
+                     const gchar *lang,
+                     const gchar *requested_show,
+                     GAsyncReadyCallback callback,
+                     gpointer user_data)
+{
+  ImportData *data;
+  GTask *task;
+
+  data = g_slice_new0 (ImportData);
+  data->zip_data = g_malloc (zip_len);
+  memcpy (data->zip_data, zip_data, zip_len);
+  data->zip_len = zip_len;
+  data->lang = g_strdup (lang);
+  data->requested_show = g_strdup (requested_show);
+
+  task = g_task_new (tvdb_source, NULL, callback, user_data);
+  g_task_set_task_data (task, data, (GDestroyNotify) import_data_free);
+  g_task_run_in_thread (task, import_series_thread);
+  g_object_unref (task);
 }
 
 static void
@@ -1210,56 +1574,169 @@ web_get_all_zipped_done (GObject *source_object,
                          gpointer user_data)
 {
   gchar *zip_data;
-  gchar *xml_data;
   gsize zip_len;
   GError *err = NULL;
-  xmlDocPtr doc;
-  SeriesResource *sres = NULL;
-  EpisodeResource *eres;
   OperationSpec *os;
-  GrlTheTVDBSource *tvdb_source;
 
   os = (OperationSpec *) user_data;
-  tvdb_source = GRL_THETVDB_SOURCE (os->source);
 
   grl_net_wc_request_finish (GRL_NET_WC (source_object),
                              res, &zip_data, &zip_len, &err);
   if (err != NULL) {
     GRL_DEBUG ("Resolve operation failed due '%s'", err->message);
     g_error_free (err);
-    goto get_all_zipped_end;
+    web_request_failed (os);
+    return;
   }
 
-  if (!unzip_all_series_data (zip_data, zip_len, os->lang, &xml_data)) {
-    GRL_DEBUG ("Resolve operation failed while unzipping data");
-    goto get_all_zipped_end;
+  import_series_async (GRL_THETVDB_SOURCE (os->source), zip_data, zip_len,
+                       os->lang, grl_media_get_show (os->media),
+                       import_series_done, os);
+}
+
+/* ================== Refresh of stale series ================ */
+
+typedef struct {
+  GrlTheTVDBSource *source;
+  gchar            *series_id;
+} RefreshSpec;
+
+static void thetvdb_refresh_next (GrlTheTVDBSource *tvdb_source);
+
+static void
+refresh_spec_free (RefreshSpec *rs)
+{
+  GrlTheTVDBSource *tvdb_source = rs->source;
+
+  tvdb_source->priv->refreshing--;
+  thetvdb_refresh_next (tvdb_source);
+
+  g_object_unref (rs->source);
+  g_free (rs->series_id);
+  g_slice_free (RefreshSpec, rs);
+}
+
+static void
+refresh_import_done (GObject *source_object,
+                     GAsyncResult *res,
+                     gpointer user_data)
+{
+  RefreshSpec *rs = user_data;
+  SeriesResource *sres;
+  GError *err = NULL;
+
+  sres = g_task_propagate_pointer (G_TASK (res), &err);
+  if (sres == NULL) {
+    GRL_DEBUG ("Refresh of series %s failed due '%s'",
+               rs->series_id, err->message);
+    g_error_free (err);
+  } else {
+    GRL_DEBUG ("Series %s refreshed", rs->series_id);
+    thetvdb_cache_remove_series (rs->source->priv->hot_cache, rs->series_id);
+    g_object_unref (sres);
   }
 
-  if (!xml_load_data (xml_data, &doc)) {
-    GRL_DEBUG ("Resolve operation failed while loading xml");
-    g_free (xml_data);
-    goto get_all_zipped_end;
+  refresh_spec_free (rs);
+}
+
+static void
+refresh_get_all_zipped_done (GObject *source_object,
+                             GAsyncResult *res,
+                             gpointer user_data)
+{
+  RefreshSpec *rs = user_data;
+  gchar *zip_data;
+  gsize zip_len;
+  gchar *lang;
+  GError *err = NULL;
+
+  grl_net_wc_request_finish (GRL_NET_WC (source_object),
+                             res, &zip_data, &zip_len, &err);
+  if (err != NULL) {
+    GRL_DEBUG ("Refresh of series %s failed due '%s'",
+               rs->series_id, err->message);
+    g_error_free (err);
+    refresh_spec_free (rs);
+    return;
   }
-  g_free (xml_data);
-
-  sres = xml_parse_and_save_serie (tvdb_source->priv->repository, doc,
-                                   grl_media_get_show (os->media));
-  eres = xml_parse_and_save_episodes (tvdb_source->priv->repository, doc,
-                                      grl_media_get_title (os->media),
-                                      grl_media_get_season (os->media),
-                                      grl_media_get_episode (os->media));
-  xmlFreeDoc (doc);
 
-get_all_zipped_end:
-  if (sres != NULL) {
-    web_request_succeed (os, sres);
-    if (eres)
-      g_clear_object (&eres);
-  } else {
-    web_request_failed (os);
+  lang = get_pref_language (rs->source);
+  import_series_async (rs->source, zip_data, zip_len, lang, NULL,
+                       refresh_import_done, rs);
+  g_free (lang);
+}
+
+/* Downloads the queued series again, a few at a time */
+static void
+thetvdb_refresh_next (GrlTheTVDBSource *tvdb_source)
+{
+  while (tvdb_source->priv->refreshing < THETVDB_MAX_REFRESHES &&
+         !g_queue_is_empty (tvdb_source->priv->refresh_queue)) {
+    RefreshSpec *rs;
+    GrlNetWc *wc;
+    gchar *url;
+    gchar *lang;
+
+    rs = g_slice_new0 (RefreshSpec);
+    rs->source = g_object_ref (tvdb_source);
+    rs->series_id = g_queue_pop_head (tvdb_source->priv->refresh_queue);
+    tvdb_source->priv->refreshing++;
+
+    lang = get_pref_language (tvdb_source);
+    url = g_strdup_printf (THETVDB_GET_EPISODES, tvdb_source->priv->api_key,
+                           rs->series_id, lang);
+    g_free (lang);
+
+    GRL_DEBUG ("Refreshing series %s: %s", rs->series_id, url);
+    wc = grl_net_wc_new ();
+    grl_net_wc_request_async (wc, url, NULL, refresh_get_all_zipped_done, rs);
+    g_object_unref (wc);
+    g_free (url);
   }
 }
 
+/* Queues @sres to be downloaded again in the background if it is too old.
+ * Running shows are refreshed more often than ended ones. */
+static void
+thetvdb_refresh_if_stale (GrlTheTVDBSource *tvdb_source,
+                          SeriesResource *sres)
+{
+  gchar *series_id, *status;
+  gint64 last_updated, max_age, now;
+  gint64 *last_attempt;
+
+  g_object_get (sres,
+                SERIES_COLUMN_SERIES_ID, &series_id,
+                SERIES_COLUMN_STATUS, &status,
+                SERIES_COLUMN_LAST_UPDATED, &last_updated,
+                NULL);
+
+  now = g_get_real_time () / G_USEC_PER_SEC;
+  max_age = (g_strcmp0 (status, THETVDB_STATUS_ENDED) == 0) ?
+    THETVDB_MAX_AGE_ENDED : THETVDB_MAX_AGE_CONTINUING;
+  g_free (status);
+
+  if (series_id == NULL || now - last_updated < max_age)
+    goto refresh_end;
+
+  last_attempt = g_hash_table_lookup (tvdb_source->priv->ht_refreshed, series_id);
+  if (last_attempt != NULL && now - *last_attempt < THETVDB_REFRESH_RETRY)
+    goto refresh_end;
+
+  last_attempt = g_new (gint64, 1);
+  *last_attempt = now;
+  g_hash_table_insert (tvdb_source->priv->ht_refreshed,
+                       g_strdup (series_id), last_attempt);
+
+  GRL_DEBUG ("Series %s is stale", series_id);
+  g_queue_push_tail (tvdb_source->priv->refresh_queue, series_id);
+  series_id = NULL;
+  thetvdb_refresh_next (tvdb_source);
+
+refresh_end:
+  g_free (series_id);
+}
+
 static void
 web_get_series_done (GObject *source_object,
                      GAsyncResult *res,
@@ -1344,32 +1821,169 @@ thetvdb_execute_resolve_web (OperationSpec *os)
 }
 
 static void
-cache_find_episode_done (GObject *object,
-                         GAsyncResult *res,
-                         gpointer user_data)
+cache_find_episode_miss (OperationSpec *os)
+{
+  if (os->fetched_web == FALSE && os->cache_only == FALSE) {
+    /* Fetch web API in order to update current cache */
+    thetvdb_execute_resolve_web (os);
+    return;
+  }
+
+  /* The cache is up-to-date and it doesn't have this episode */
+  os->callback (os->source, os->operation_id, os->media, os->user_data, NULL);
+  free_operation_spec (os);
+}
+
+typedef struct {
+  GrlTheTVDBSource *source;
+  gchar            *show;
+  SeriesResource   *sres;
+  /* OperationSpec waiting for the show to be loaded */
+  GList            *waiters;
+} LoadSpec;
+
+static void
+cache_load_episodes_done (LoadSpec *load,
+                          GomResourceGroup *group,
+                          GError *err)
+{
+  GrlTheTVDBSource *tvdb_source = load->source;
+  GList *it;
+
+  if (err != NULL) {
+    GRL_DEBUG ("[Episode] Failed to load episodes of '%s' due '%s'",
+               load->show, err->message);
+  } else {
+    thetvdb_cache_insert (tvdb_source->priv->hot_cache,
+                          load->show,
+                          load->sres,
+                          group);
+  }
+
+  g_hash_table_remove (tvdb_source->priv->ht_loading, load->show);
+
+  for (it = load->waiters; it != NULL; it = it->next) {
+    if (err != NULL)
+      cache_find_episode_miss (it->data);
+    else
+      cache_find_episode (it->data);
+  }
+
+  g_list_free (load->waiters);
+  g_object_unref (load->sres);
+  g_object_unref (load->source);
+  g_free (load->show);
+  g_slice_free (LoadSpec, load);
+}
+
+static void
+cache_load_episodes_fetched (GObject *object,
+                             GAsyncResult *res,
+                             gpointer user_data)
+{
+  GomResourceGroup *group = GOM_RESOURCE_GROUP (object);
+  GError *err = NULL;
+
+  gom_resource_group_fetch_finish (group, res, &err);
+  cache_load_episodes_done ((LoadSpec *) user_data, group, err);
+  g_clear_error (&err);
+  g_object_unref (group);
+}
+
+static void
+cache_load_episodes_found (GObject *object,
+                           GAsyncResult *res,
+                           gpointer user_data)
+{
+  LoadSpec *load = (LoadSpec *) user_data;
+  GomResourceGroup *group;
+  GError *err = NULL;
+  guint count;
+
+  group = gom_repository_find_finish (GOM_REPOSITORY (object), res, &err);
+  if (group == NULL) {
+    cache_load_episodes_done (load, NULL, err);
+    g_error_free (err);
+    return;
+  }
+
+  count = gom_resource_group_get_count (group);
+  if (count == 0) {
+    cache_load_episodes_done (load, group, NULL);
+    g_object_unref (group);
+    return;
+  }
+
+  gom_resource_group_fetch_async (group, 0, count,
+                                  cache_load_episodes_fetched, load);
+}
+
+/* Loads all the episodes of the series @sres in the memory cache. @os, if
+ * not %NULL, looks for its episode again once it is done. */
+static void
+cache_load_episodes (GrlTheTVDBSource *tvdb_source,
+                     const gchar *show,
+                     SeriesResource *sres,
+                     OperationSpec *os)
+{
+  GomFilter *query;
+  GValue value_str = { 0, };
+  LoadSpec *load;
+  gchar *series_id;
+
+  /* If this show is being loaded already, wait. */
+  load = g_hash_table_lookup (tvdb_source->priv->ht_loading, show);
+  if (load != NULL) {
+    if (os != NULL)
+      load->waiters = g_list_append (load->waiters, os);
+    return;
+  }
+
+  load = g_slice_new0 (LoadSpec);
+  load->source = g_object_ref (tvdb_source);
+  load->show = g_strdup (show);
+  load->sres = g_object_ref (sres);
+  if (os != NULL)
+    load->waiters = g_list_append (NULL, os);
+  g_hash_table_insert (tvdb_source->priv->ht_loading, load->show, load);
+
+  g_object_get (sres, SERIES_COLUMN_SERIES_ID, &series_id, NULL);
+  g_value_init (&value_str, G_TYPE_STRING);
+  g_value_set_string (&value_str, series_id);
+  query = gom_filter_new_eq (EPISODE_TYPE_RESOURCE,
+                             EPISODE_COLUMN_SERIES_ID,
+                             &value_str);
+  g_value_unset (&value_str);
+  g_free (series_id);
+
+  gom_repository_find_async (tvdb_source->priv->repository,
+                             EPISODE_TYPE_RESOURCE,
+                             query,
+                             cache_load_episodes_found,
+                             load);
+  g_object_unref (query);
+}
+
+static void
+cache_find_episode_db_done (GObject *object,
+                            GAsyncResult *res,
+                            gpointer user_data)
 {
-  const gchar *show;
   OperationSpec *os;
   GomResource *resource;
   GError *err = NULL;
 
   os = (OperationSpec *) user_data;
-  show = grl_media_get_show (os->media);
 
   resource = gom_repository_find_one_finish (GOM_REPOSITORY (object),
                                              res,
                                              &err);
   if (resource == NULL) {
-    GRL_DEBUG ("[Episode] Cache miss with '%s' due '%s'", show, err->message);
+    GRL_DEBUG ("[Episode] Cache miss with '%s' due '%s'",
+               grl_media_get_show (os->media), err->message);
     g_error_free (err);
-
-    if (os->fetched_web == FALSE && os->cache_only == FALSE) {
-      /* Fetch web API in order to update current cache */
-      thetvdb_execute_resolve_web (os);
-      return;
-    }
-    /* The cache is up-to-date and it doesn't have this episode */
-    goto episode_done_end;
+    cache_find_episode_miss (os);
+    return;
   }
 
   thetvdb_update_media_from_resources (os->media,
@@ -1378,24 +1992,21 @@ cache_find_episode_done (GObject *object,
                                        EPISODE_RESOURCE (resource));
   g_object_unref (resource);
 
-episode_done_end:
   os->callback (os->source, os->operation_id, os->media, os->user_data, NULL);
   free_operation_spec (os);
 }
 
+/* Looks for the episode of @os in the database only */
 static void
-cache_find_episode (OperationSpec *os)
+cache_find_episode_db (OperationSpec *os)
 {
   GrlTheTVDBSource *tvdb_source;
   GomFilter *query, *by_series_id, *by_episode;
   GValue value_str = { 0, };
   gchar *series_id;
-  gchar *show;
   const gchar *title;
   gint season_number, episode_number;
 
-  GRL_DEBUG ("cache_find_episode");
-
   tvdb_source = GRL_THETVDB_SOURCE (os->source);
   title = grl_media_get_title (os->media);
   season_number = grl_media_get_season (os->media);
@@ -1403,21 +2014,15 @@ cache_find_episode (OperationSpec *os)
 
   g_object_get (os->serie_resource,
                 SERIES_COLUMN_SERIES_ID, &series_id,
-                SERIES_COLUMN_SERIES_NAME, &show,
                 NULL);
 
-  /* Check if this media is an Episode of a TV Show */
-  if (title == NULL && (season_number == 0 || episode_number == 0)) {
-    goto cache_episode_end;
-  }
-
-  /* Find the exactly episode using series-id and some episode specific info */
   g_value_init (&value_str, G_TYPE_STRING);
   g_value_set_string (&value_str, series_id);
   by_series_id = gom_filter_new_eq (EPISODE_TYPE_RESOURCE,
                                     EPISODE_COLUMN_SERIES_ID,
                                     &value_str);
   g_value_unset (&value_str);
+  g_free (series_id);
 
   if (season_number != 0 && episode_number != 0) {
     GomFilter *filter1, *filter2;
@@ -1456,11 +2061,59 @@ cache_find_episode (OperationSpec *os)
   gom_repository_find_one_async (tvdb_source->priv->repository,
                                  EPISODE_TYPE_RESOURCE,
                                  query,
-                                 cache_find_episode_done,
+                                 cache_find_episode_db_done,
                                  os);
   g_object_unref (query);
-  g_clear_pointer (&series_id, g_free);
-  g_clear_pointer (&show, g_free);
+}
+
+static void
+cache_find_episode (OperationSpec *os)
+{
+  GrlTheTVDBSource *tvdb_source;
+  EpisodeResource *eres;
+  const gchar *show;
+  const gchar *title;
+  gint season_number, episode_number;
+
+  GRL_DEBUG ("cache_find_episode");
+
+  tvdb_source = GRL_THETVDB_SOURCE (os->source);
+  show = grl_media_get_show (os->media);
+  title = grl_media_get_title (os->media);
+  season_number = grl_media_get_season (os->media);
+  episode_number = grl_media_get_episode (os->media);
+
+  /* Check if this media is an Episode of a TV Show */
+  if (title == NULL && (season_number == 0 || episode_number == 0)) {
+    goto cache_episode_end;
+  }
+
+  /* Find the exactly episode using some episode specific info */
+  if (!thetvdb_cache_lookup_episode (tvdb_source->priv->hot_cache, show,
+                                     title,
+                                     season_number, episode_number, &eres)) {
+    if (tvdb_source->priv->prefetch) {
+      /* Answer this one from the database while the show is loaded */
+      cache_load_episodes (tvdb_source, show, os->serie_resource, NULL);
+      cache_find_episode_db (os);
+    } else {
+      cache_load_episodes (tvdb_source, show, os->serie_resource, os);
+    }
+    return;
+  }
+
+  if (eres == NULL) {
+    GRL_DEBUG ("[Episode] Cache miss with '%s'", show);
+    cache_find_episode_miss (os);
+    return;
+  }
+
+  thetvdb_update_media_from_resources (os->media,
+                                       os->keys,
+                                       os->serie_resource,
+                                       eres);
+  os->callback (os->source, os->operation_id, os->media, os->user_data, NULL);
+  free_operation_spec (os);
   return;
 
 cache_episode_end:
@@ -1470,8 +2123,6 @@ cache_episode_end:
                                        os->serie_resource,
                                        NULL);
   os->callback (os->source, os->operation_id, os->media, os->user_data, NULL);
-  g_clear_pointer (&series_id, g_free);
-  g_clear_pointer (&show, g_free);
   free_operation_spec (os);
 }
 
@@ -1504,6 +2155,7 @@ cache_find_serie_done (GObject *object,
   }
 
   os->serie_resource = SERIES_RESOURCE (resource);
+  thetvdb_refresh_if_stale (GRL_THETVDB_SOURCE (os->source), os->serie_resource);
   cache_find_episode (os);
 }
 
@@ -1571,6 +2223,7 @@ thetvdb_execute_resolve_cache (OperationSpec *os)
 {
   const gchar *show;
   GrlTheTVDBSource *tvdb_source;
+  SeriesResource *sres;
   GomFilter *query;
   GValue value = { 0, };
 
@@ -1579,6 +2232,15 @@ thetvdb_execute_resolve_cache (OperationSpec *os)
   tvdb_source = GRL_THETVDB_SOURCE (os->source);
   show = grl_media_get_show (os->media);
 
+  /* Recently resolved shows are answered from memory */
+  sres = thetvdb_cache_lookup_series (tvdb_source->priv->hot_cache, show);
+  if (sres != NULL) {
+    thetvdb_refresh_if_stale (tvdb_source, sres);
+    os->serie_resource = g_object_ref (sres);
+    cache_find_episode (os);
+    return;
+  }
+
   /* Get series async */
   g_value_init (&value, G_TYPE_STRING);
   g_value_set_string (&value, show);
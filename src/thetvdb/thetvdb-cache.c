@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "grl-lru-cache.h"
+#include "thetvdb-cache.h"
+
+#define EPISODE_KEY(season, episode) \
+  GINT_TO_POINTER (((season) << 16) | ((episode) & 0xffff))
+
+typedef struct {
+  gchar          *series_id;
+  SeriesResource *sres;
+  /* Season and episode numbers -> EpisodeResource */
+  GHashTable     *by_number;
+  /* Casefolded episode name -> EpisodeResource */
+  GHashTable     *by_title;
+} CacheEntry;
+
+/* Casefolded show name -> CacheEntry */
+struct _TheTVDBCache {
+  GrlLruCache *shows;
+};
+
+static void
+cache_entry_free (CacheEntry *entry)
+{
+  g_hash_table_unref (entry->by_number);
+  g_hash_table_unref (entry->by_title);
+  g_object_unref (entry->sres);
+  g_free (entry->series_id);
+  g_slice_free (CacheEntry, entry);
+}
+
+static CacheEntry *
+cache_lookup (TheTVDBCache *cache,
+              const gchar *show)
+{
+  CacheEntry *entry = NULL;
+  gchar *key;
+
+  key = g_utf8_casefold (show, -1);
+  grl_lru_cache_lookup (cache->shows, key, (gpointer *) &entry);
+  g_free (key);
+
+  return entry;
+}
+
+TheTVDBCache *
+thetvdb_cache_new (guint max_shows)
+{
+  TheTVDBCache *cache;
+
+  cache = g_slice_new (TheTVDBCache);
+  cache->shows = grl_lru_cache_new (max_shows,
+                                    (GDestroyNotify) cache_entry_free);
+
+  return cache;
+}
+
+void
+thetvdb_cache_free (TheTVDBCache *cache)
+{
+  grl_lru_cache_free (cache->shows);
+  g_slice_free (TheTVDBCache, cache);
+}
+
+/* Adds @show, with its series resource and all its episodes resources */
+void
+thetvdb_cache_insert (TheTVDBCache *cache,
+                      const gchar *show,
+                      SeriesResource *sres,
+                      GomResourceGroup *episodes)
+{
+  CacheEntry *entry;
+  gchar *key;
+  guint i, count;
+
+  entry = g_slice_new (CacheEntry);
+  entry->sres = g_object_ref (sres);
+  entry->by_number = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                            NULL, g_object_unref);
+  entry->by_title = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                           g_free, g_object_unref);
+  g_object_get (sres, SERIES_COLUMN_SERIES_ID, &entry->series_id, NULL);
+
+  count = (episodes != NULL) ? gom_resource_group_get_count (episodes) : 0;
+  for (i = 0; i < count; i++) {
+    GomResource *eres = gom_resource_group_get_index (episodes, i);
+    gchar *name;
+    guint season, episode;
+
+    g_object_get (eres,
+                  EPISODE_COLUMN_EPISODE_NAME, &name,
+                  EPISODE_COLUMN_SEASON_NUMBER, &season,
+                  EPISODE_COLUMN_EPISODE_NUMBER, &episode,
+                  NULL);
+
+    if (season != 0 && episode != 0) {
+      g_hash_table_insert (entry->by_number,
+                           EPISODE_KEY (season, episode),
+                           g_object_ref (eres));
+    }
+
+    if (name != NULL) {
+      g_hash_table_insert (entry->by_title,
+                           g_utf8_casefold (name, -1),
+                           g_object_ref (eres));
+      g_free (name);
+    }
+  }
+
+  key = g_utf8_casefold (show, -1);
+  grl_lru_cache_insert (cache->shows, key, entry);
+  g_free (key);
+}
+
+/* Returns: (transfer none): the series resource of @show, or %NULL if it is
+ * not cached */
+SeriesResource *
+thetvdb_cache_lookup_series (TheTVDBCache *cache,
+                             const gchar *show)
+{
+  CacheEntry *entry;
+
+  entry = cache_lookup (cache, show);
+
+  return (entry != NULL) ? entry->sres : NULL;
+}
+
+/* Returns: %TRUE if @show is cached. In that case @eres is set to the
+ * episode matching @season_number and @episode_number, or @title if they
+ * are not set, or to %NULL if there is no such episode. */
+gboolean
+thetvdb_cache_lookup_episode (TheTVDBCache *cache,
+                              const gchar *show,
+                              const gchar *title,
+                              gint season_number,
+                              gint episode_number,
+                              EpisodeResource **eres)
+{
+  CacheEntry *entry;
+
+  entry = cache_lookup (cache, show);
+  if (entry == NULL)
+    return FALSE;
+
+  if (season_number != 0 && episode_number != 0) {
+    *eres = g_hash_table_lookup (entry->by_number,
+                                 EPISODE_KEY (season_number, episode_number));
+  } else if (title != NULL) {
+    gchar *key = g_utf8_casefold (title, -1);
+    *eres = g_hash_table_lookup (entry->by_title, key);
+    g_free (key);
+  } else {
+    *eres = NULL;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+entry_has_series_id (gpointer key,
+                     gpointer value,
+                     gpointer user_data)
+{
+  CacheEntry *entry = value;
+
+  return g_strcmp0 (entry->series_id, user_data) == 0;
+}
+
+/* Drops every show of the series identified by @series_id, for instance
+ * after it was updated in the database */
+void
+thetvdb_cache_remove_series (TheTVDBCache *cache,
+                             const gchar *series_id)
+{
+  grl_lru_cache_foreach_remove (cache->shows, entry_has_series_id,
+                                (gpointer) series_id);
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef _GRL_THETVDB_CACHE_H_
+#define _GRL_THETVDB_CACHE_H_
+
+#include "thetvdb-resources.h"
+
+/* Number of shows kept in memory */
+#define THETVDB_CACHE_MAX_SHOWS 16
+
+/* In-memory cache of the series and episodes resources of the most recently
+ * resolved shows, in front of the database. */
+typedef struct _TheTVDBCache TheTVDBCache;
+
+TheTVDBCache *thetvdb_cache_new (guint max_shows);
+
+void thetvdb_cache_free (TheTVDBCache *cache);
+
+void thetvdb_cache_insert (TheTVDBCache *cache,
+                           const gchar *show,
+                           SeriesResource *sres,
+                           GomResourceGroup *episodes);
+
+SeriesResource *thetvdb_cache_lookup_series (TheTVDBCache *cache,
+                                             const gchar *show);
+
+gboolean thetvdb_cache_lookup_episode (TheTVDBCache *cache,
+                                       const gchar *show,
+                                       const gchar *title,
+                                       gint season_number,
+                                       gint episode_number,
+                                       EpisodeResource **eres);
+
+void thetvdb_cache_remove_series (TheTVDBCache *cache,
+                                  const gchar *series_id);
+
+#endif /* _GRL_THETVDB_CACHE_H_ */
@@ -39,6 +39,7 @@ struct _SeriesResourcePrivate {
   gchar      *actor_names;
   gchar      *alias_names;
   gchar      *genres;
+  gint64      last_updated;
 };
 
 enum {
@@ -58,6 +59,7 @@ enum {
   PROP_URL_BANNER,
   PROP_URL_FANART,
   PROP_URL_POSTER,
+  PROP_LAST_UPDATED,
   LAST_PROP
 };
 
@@ -142,6 +144,9 @@ series_resource_get_property (GObject    *object,
   case PROP_URL_POSTER:
     g_value_set_string (value, resource->priv->url_poster);
     break;
+  case PROP_LAST_UPDATED:
+    g_value_set_int64 (value, resource->priv->last_updated);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
   }
@@ -214,6 +219,9 @@ series_resource_set_property (GObject      *object,
     g_clear_pointer (&resource->priv->url_poster, g_free);
     resource->priv->url_poster = g_value_dup_string (value);
     break;
+  case PROP_LAST_UPDATED:
+    resource->priv->last_updated = g_value_get_int64 (value);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
   }
@@ -326,6 +334,16 @@ series_resource_class_init (SeriesResourceClass *klass)
                                                 G_PARAM_READWRITE);
   g_object_class_install_property (object_class, PROP_URL_POSTER,
                                    specs[PROP_URL_POSTER]);
+
+  specs[PROP_LAST_UPDATED] = g_param_spec_int64 (SERIES_COLUMN_LAST_UPDATED,
+                                                 NULL, NULL,
+                                                 0, G_MAXINT64,
+                                                 0, G_PARAM_READWRITE);
+  g_object_class_install_property (object_class, PROP_LAST_UPDATED,
+                                   specs[PROP_LAST_UPDATED]);
+  gom_resource_class_set_property_new_in_version (resource_class,
+                                                  SERIES_COLUMN_LAST_UPDATED,
+                                                  4);
 }
 
 static void
@@ -71,6 +71,7 @@
 #define SERIES_COLUMN_URL_BANNER    "url-banner"
 #define SERIES_COLUMN_URL_FANART    "url-fanart"
 #define SERIES_COLUMN_URL_POSTER    "url-poster"
+#define SERIES_COLUMN_LAST_UPDATED  "last-updated"
 
 typedef struct _SeriesResource        SeriesResource;
 typedef struct _SeriesResourceClass   SeriesResourceClass;
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include <grilo.h>
+
+#include "grl-tmdb-cache.h"
+
+#define GRL_LOG_DOMAIN_DEFAULT tmdb_log_domain
+GRL_LOG_DOMAIN_EXTERN(tmdb_log_domain);
+
+/* Each entry is a file named after the checksum of its key, holding the
+ * expiration time on the first line and the response after it.
+ */
+
+struct _GrlTmdbCache {
+  char *path;
+  /* Casefolded title -> MovieIdEntry */
+  GHashTable *movie_ids;
+};
+
+struct _MovieIdEntry {
+  guint64 id;
+  gint64 expires;
+};
+
+typedef struct _MovieIdEntry MovieIdEntry;
+
+/* Private functions */
+
+static gint64
+now (void)
+{
+  return g_get_real_time () / G_USEC_PER_SEC;
+}
+
+static char *
+entry_path (GrlTmdbCache *cache, const char *key)
+{
+  char *checksum, *path;
+
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+  path = g_build_filename (cache->path, checksum, NULL);
+  g_free (checksum);
+
+  return path;
+}
+
+static void
+movie_id_entry_free (gpointer data)
+{
+  g_slice_free (MovieIdEntry, data);
+}
+
+/* Public functions */
+
+/**
+ * grl_tmdb_cache_new:
+ * Returns: (transfer full): A new #GrlTmdbCache, storing its entries in the
+ * user cache directory.
+ */
+GrlTmdbCache *
+grl_tmdb_cache_new (void)
+{
+  GrlTmdbCache *cache;
+
+  cache = g_slice_new0 (GrlTmdbCache);
+  cache->path = g_build_filename (g_get_user_cache_dir (),
+                                  "grilo-plugins",
+                                  "tmdb",
+                                  NULL);
+  cache->movie_ids = g_hash_table_new_full (g_str_hash,
+                                            g_str_equal,
+                                            g_free,
+                                            movie_id_entry_free);
+
+  if (g_mkdir_with_parents (cache->path, 0775) != 0) {
+    GRL_WARNING ("Could not create cache directory %s", cache->path);
+  }
+
+  return cache;
+}
+
+void
+grl_tmdb_cache_free (GrlTmdbCache *cache)
+{
+  g_hash_table_unref (cache->movie_ids);
+  g_free (cache->path);
+  g_slice_free (GrlTmdbCache, cache);
+}
+
+/**
+ * grl_tmdb_cache_lookup:
+ * @cache: Instance of #GrlTmdbCache
+ * @key: Key of the entry, usually the request URI
+ * @content: (out) (transfer full): Return location for the cached response
+ * @length: (out): Return location for the length of @content
+ * Returns: %TRUE if a valid entry was found, %FALSE if it is missing or
+ * expired.
+ */
+gboolean
+grl_tmdb_cache_lookup (GrlTmdbCache *cache,
+                       const char *key,
+                       char **content,
+                       gsize *length)
+{
+  char *path, *data, *body;
+  gsize data_length;
+  gint64 expires;
+
+  path = entry_path (cache, key);
+
+  if (!g_file_get_contents (path, &data, &data_length, NULL)) {
+    g_free (path);
+    return FALSE;
+  }
+
+  expires = g_ascii_strtoll (data, &body, 10);
+  if (*body != '\n' || expires < now ()) {
+    GRL_DEBUG ("Dropping expired cache entry for %s", key);
+    g_unlink (path);
+    g_free (path);
+    g_free (data);
+    return FALSE;
+  }
+  body++;
+
+  *length = data_length - (body - data);
+  memmove (data, body, *length + 1);
+  *content = data;
+
+  g_free (path);
+
+  return TRUE;
+}
+
+/**
+ * grl_tmdb_cache_store:
+ * @cache: Instance of #GrlTmdbCache
+ * @key: Key of the entry, usually the request URI
+ * @content: The response to cache
+ * @length: Length of @content
+ * @ttl: Time in seconds after which the entry expires
+ */
+void
+grl_tmdb_cache_store (GrlTmdbCache *cache,
+                      const char *key,
+                      const char *content,
+                      gsize length,
+                      gint64 ttl)
+{
+  GString *data;
+  char *path;
+  GError *error = NULL;
+
+  path = entry_path (cache, key);
+  data = g_string_sized_new (length + 24);
+  g_string_printf (data, "%" G_GINT64_FORMAT "\n", now () + ttl);
+  g_string_append_len (data, content, length);
+
+  if (!g_file_set_contents (path, data->str, data->len, &error)) {
+    GRL_DEBUG ("Could not cache %s: %s", key, error->message);
+    g_error_free (error);
+  }
+
+  g_string_free (data, TRUE);
+  g_free (path);
+}
+
+/**
+ * grl_tmdb_cache_lookup_movie_id:
+ * @cache: Instance of #GrlTmdbCache
+ * @title: Title that was searched for
+ * @id: (out): Return location for the movie identifier, 0 if the search had
+ * no match
+ * Returns: %TRUE if the result of searching for @title is known.
+ */
+gboolean
+grl_tmdb_cache_lookup_movie_id (GrlTmdbCache *cache,
+                                const char *title,
+                                guint64 *id)
+{
+  MovieIdEntry *entry;
+  char *key;
+
+  key = g_utf8_casefold (title, -1);
+  entry = g_hash_table_lookup (cache->movie_ids, key);
+
+  if (entry != NULL && entry->expires < now ()) {
+    g_hash_table_remove (cache->movie_ids, key);
+    entry = NULL;
+  }
+  g_free (key);
+
+  if (entry == NULL)
+    return FALSE;
+
+  *id = entry->id;
+
+  return TRUE;
+}
+
+/**
+ * grl_tmdb_cache_store_movie_id:
+ * @cache: Instance of #GrlTmdbCache
+ * @title: Title that was searched for
+ * @id: The movie identifier found, or 0 if there was no match
+ * @ttl: Time in seconds after which the entry expires
+ */
+void
+grl_tmdb_cache_store_movie_id (GrlTmdbCache *cache,
+                               const char *title,
+                               guint64 id,
+                               gint64 ttl)
+{
+  MovieIdEntry *entry;
+
+  entry = g_slice_new (MovieIdEntry);
+  entry->id = id;
+  entry->expires = now () + ttl;
+
+  g_hash_table_insert (cache->movie_ids, g_utf8_casefold (title, -1), entry);
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef _GRL_TMDB_CACHE_H_
+#define _GRL_TMDB_CACHE_H_
+
+#include <glib.h>
+
+/* Time to live of cached responses, in seconds */
+#define GRL_TMDB_CACHE_TTL_CONFIGURATION (3 * 24 * 60 * 60)
+#define GRL_TMDB_CACHE_TTL_SEARCH        (7 * 24 * 60 * 60)
+#define GRL_TMDB_CACHE_TTL_NO_MATCH      (24 * 60 * 60)
+#define GRL_TMDB_CACHE_TTL_DETAILS       (7 * 24 * 60 * 60)
+
+typedef struct _GrlTmdbCache GrlTmdbCache;
+
+GrlTmdbCache *
+grl_tmdb_cache_new (void);
+
+void
+grl_tmdb_cache_free (GrlTmdbCache *cache);
+
+gboolean
+grl_tmdb_cache_lookup (GrlTmdbCache *cache,
+                       const char *key,
+                       char **content,
+                       gsize *length);
+
+void
+grl_tmdb_cache_store (GrlTmdbCache *cache,
+                      const char *key,
+                      const char *content,
+                      gsize length,
+                      gint64 ttl);
+
+gboolean
+grl_tmdb_cache_lookup_movie_id (GrlTmdbCache *cache,
+                                const char *title,
+                                guint64 *id);
+
+void
+grl_tmdb_cache_store_movie_id (GrlTmdbCache *cache,
+                               const char *title,
+                               guint64 id,
+                               gint64 ttl);
+
+#endif /* _GRL_TMDB_CACHE_H_ */
@@ -24,6 +24,7 @@
 #include "config.h"
 #endif
 
+#include <stdlib.h>
 #include <string.h>
 
 #include <grilo.h>
@@ -59,6 +60,27 @@ struct _FilterClosure {
 
 typedef struct _FilterClosure FilterClosure;
 
+/* Paths are compiled once and kept for the lifetime of the process. Paths
+ * made only of members and indexes, which are most of them, are resolved by
+ * following them from the root instead of matching them against the whole
+ * document.
+ */
+struct _PathStep {
+  char *member;
+  guint index;
+};
+
+struct _CompiledPath {
+  /* Steps of a direct path, NULL for other paths */
+  GArray *steps;
+  JsonPath *path;
+};
+
+typedef struct _PathStep PathStep;
+typedef struct _CompiledPath CompiledPath;
+
+static GHashTable *compiled_paths = NULL;
+
 /* GObject setup functions */
 static void grl_tmdb_request_class_init (GrlTmdbRequestClass * klass);
 static void grl_tmdb_request_init (GrlTmdbRequest *self);
@@ -88,6 +110,8 @@ struct _GrlTmdbRequestPrivate {
   JsonParser *parser;
   GrlTmdbRequestDetail detail;
   GList *details;
+  GrlTmdbCache *cache;
+  char *cache_key;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (GrlTmdbRequest, grl_tmdb_request, G_TYPE_OBJECT)
@@ -178,6 +202,7 @@ grl_tmdb_request_finalize (GObject *object)
   g_list_free (self->priv->details);
   g_clear_pointer (&self->priv->api_key, g_free);
   g_clear_pointer (&self->priv->uri, g_free);
+  g_clear_pointer (&self->priv->cache_key, g_free);
   g_clear_pointer (&self->priv->args, g_hash_table_unref);
   g_clear_pointer (&self->priv->base, g_uri_unref);
   g_clear_object (&self->priv->parser);
@@ -203,6 +228,102 @@ grl_tmdb_request_constructed (GObject *object)
 
 
 /* Private functions */
+static GArray *
+parse_direct_path (const char *path)
+{
+  GArray *steps;
+  PathStep step;
+  const char *p, *end;
+  char *index_end;
+  guint i;
+
+  if (path[0] != '$')
+    return NULL;
+
+  steps = g_array_new (FALSE, FALSE, sizeof (PathStep));
+  for (p = path + 1; *p != '\0'; p = end) {
+    step.member = NULL;
+    step.index = 0;
+
+    if (p[0] == '.' && p[1] != '.' && p[1] != '*' && p[1] != '\0') {
+      end = p + 1 + strcspn (p + 1, ".[");
+      step.member = g_strndup (p + 1, end - p - 1);
+    } else if (p[0] == '[' && g_ascii_isdigit (p[1])) {
+      step.index = strtoul (p + 1, &index_end, 10);
+      if (*index_end != ']')
+        goto not_direct;
+      end = index_end + 1;
+    } else {
+      goto not_direct;
+    }
+
+    g_array_append_val (steps, step);
+  }
+
+  return steps;
+
+not_direct:
+  for (i = 0; i < steps->len; i++)
+    g_free (g_array_index (steps, PathStep, i).member);
+  g_array_free (steps, TRUE);
+
+  return NULL;
+}
+
+static CompiledPath *
+get_compiled_path (const char *path)
+{
+  CompiledPath *compiled;
+  GError *error = NULL;
+
+  if (compiled_paths == NULL)
+    compiled_paths = g_hash_table_new (g_str_hash, g_str_equal);
+
+  compiled = g_hash_table_lookup (compiled_paths, path);
+  if (compiled != NULL)
+    return compiled;
+
+  compiled = g_slice_new0 (CompiledPath);
+  compiled->steps = parse_direct_path (path);
+  if (compiled->steps == NULL) {
+    compiled->path = json_path_new ();
+    if (!json_path_compile (compiled->path, path, &error)) {
+      GRL_WARNING ("Invalid path %s: %s", path, error->message);
+      g_error_free (error);
+      g_clear_object (&compiled->path);
+    }
+  }
+
+  g_hash_table_insert (compiled_paths, g_strdup (path), compiled);
+
+  return compiled;
+}
+
+/* Returns the node at the end of a direct path, without copying it */
+static JsonNode *
+follow_path (JsonNode *node, GArray *steps)
+{
+  guint i;
+
+  for (i = 0; i < steps->len && node != NULL; i++) {
+    PathStep *step = &g_array_index (steps, PathStep, i);
+
+    if (step->member != NULL) {
+      if (!JSON_NODE_HOLDS_OBJECT (node))
+        return NULL;
+      node = json_object_get_member (json_node_get_object (node),
+                                     step->member);
+    } else {
+      if (!JSON_NODE_HOLDS_ARRAY (node) ||
+          step->index >= json_array_get_length (json_node_get_array (node)))
+        return NULL;
+      node = json_array_get_element (json_node_get_array (node), step->index);
+    }
+  }
+
+  return node;
+}
+
 static void
 fill_list_filtered (JsonArray *array,
                     guint index_,
@@ -242,45 +363,73 @@ get_list_with_filter (GrlTmdbRequest *self,
                       const char *path,
                       FilterClosure *closure)
 {
-  JsonNode *node, *element;
-  GError *error = NULL;
+  CompiledPath *compiled;
+  JsonNode *root, *node = NULL, *element;
   JsonArray *values;
 
-  node = json_path_query (path,
-                          json_parser_get_root (self->priv->parser),
-                          &error);
-  if (error != NULL) {
-    GRL_DEBUG ("Failed to get %s: %s", path, error->message);
-    g_error_free (error);
+  compiled = get_compiled_path (path);
+  root = json_parser_get_root (self->priv->parser);
+  if (root == NULL)
     return NULL;
-  }
 
-  if (!JSON_NODE_HOLDS_ARRAY (node)) {
-    json_node_free (node);
-    return NULL;
-  }
+  closure->list = NULL;
 
-  values = json_node_get_array (node);
-  if (json_array_get_length (values) == 0) {
-    json_node_free (node);
-    return NULL;
-  }
+  if (compiled->steps != NULL) {
+    element = follow_path (root, compiled->steps);
+    if (element == NULL || !JSON_NODE_HOLDS_ARRAY (element))
+      return NULL;
 
-  /* Check if we have array in array */
-  element = json_array_get_element (values, 0);
-  if (JSON_NODE_HOLDS_ARRAY (element)) {
     values = json_node_get_array (element);
-  }
+  } else {
+    if (compiled->path == NULL)
+      return NULL;
 
-  closure->list = NULL;
+    node = json_path_match (compiled->path, root);
+    values = json_node_get_array (node);
+    if (json_array_get_length (values) == 0) {
+      json_node_free (node);
+      return NULL;
+    }
+
+    /* Check if we have array in array */
+    element = json_array_get_element (values, 0);
+    if (JSON_NODE_HOLDS_ARRAY (element)) {
+      values = json_node_get_array (element);
+    }
+  }
 
   json_array_foreach_element (values, closure->callback, closure);
 
-  json_node_free (node);
+  if (node != NULL)
+    json_node_free (node);
 
   return closure->list;
 }
 
+static gint64
+cache_ttl (GrlTmdbRequest *self)
+{
+  GValue *value;
+  gint64 ttl = GRL_TMDB_CACHE_TTL_SEARCH;
+
+  if (g_str_equal (self->priv->uri, TMDB_API_CALL_CONFIGURATION))
+    return GRL_TMDB_CACHE_TTL_CONFIGURATION;
+
+  if (!g_str_equal (self->priv->uri, TMDB_API_CALL_SEARCH_MOVIE))
+    return GRL_TMDB_CACHE_TTL_DETAILS;
+
+  /* Titles without match are looked up again sooner */
+  value = grl_tmdb_request_get (self, "$.total_results");
+  if (value != NULL) {
+    if (g_value_get_int64 (value) == 0)
+      ttl = GRL_TMDB_CACHE_TTL_NO_MATCH;
+    g_value_unset (value);
+    g_free (value);
+  }
+
+  return ttl;
+}
+
 /* Callbacks */
 static void
 on_wc_request (GrlNetWc *wc,
@@ -291,24 +440,36 @@ on_wc_request (GrlNetWc *wc,
   char *content;
   gsize length = 0;
   GError *error = NULL;
+  GTask *task;
+
+  /* The callback may run the request again */
+  task = g_steal_pointer (&self->priv->task);
 
   if (!grl_net_wc_request_finish (wc, res, &content, &length, &error)) {
-    g_task_return_error (self->priv->task, error);
+    g_task_return_error (task, error);
 
     goto out;
   }
 
   if (!json_parser_load_from_data (self->priv->parser, content, length, &error)) {
     GRL_WARNING ("Could not parse JSON: %s", error->message);
-    g_task_return_error (self->priv->task, error);
+    g_task_return_error (task, error);
 
     goto out;
   }
 
-  g_task_return_boolean (self->priv->task, TRUE);
+  if (self->priv->cache != NULL) {
+    grl_tmdb_cache_store (self->priv->cache,
+                          self->priv->cache_key,
+                          content,
+                          length,
+                          cache_ttl (self));
+  }
+
+  g_task_return_boolean (task, TRUE);
 
 out:
-  g_object_unref (self->priv->task);
+  g_object_unref (task);
 }
 
 /* Public functions */
@@ -536,26 +697,18 @@ args_to_string (GHashTable *args)
 }
 
 /**
- * grl_tmdb_request_run_async:
+ * grl_tmdb_request_dup_call:
  * @self: Instance of GrlTmdbRequest
- * @callback: Callback to notify after the request is complete
- * @cancellable: (allow-none): An optional cancellable to cancel this operation
- * @user_data: User data to pass on to @callback.
- *
- * Schedule the request for execution.
+ * Returns: (transfer full): The complete URI requested, including arguments.
+ * Identical requests have the same one.
  */
-void
-grl_tmdb_request_run_async (GrlTmdbRequest *self,
-                            GrlNetWc *wc,
-                            GAsyncReadyCallback callback,
-                            GCancellable *cancellable,
-                            gpointer user_data)
+char *
+grl_tmdb_request_dup_call (GrlTmdbRequest *self)
 {
   g_autoptr(GUri) absolute_uri = NULL;
   g_autoptr(GUri) uri = NULL;
   g_autofree char *query = NULL;
   char *call, *new_call;
-  GHashTable *headers;
 
   absolute_uri = g_uri_parse_relative (self->priv->base, self->priv->uri, G_URI_FLAGS_NONE, NULL);
   query = args_to_string (self->priv->args);
@@ -575,6 +728,96 @@ grl_tmdb_request_run_async (GrlTmdbRequest *self,
     call = new_call;
   }
 
+  return call;
+}
+
+/**
+ * grl_tmdb_request_run_from_cache:
+ * @self: Instance of GrlTmdbRequest
+ * @cache: The #GrlTmdbCache to answer the request from
+ * @callback: Callback to notify after the request is complete
+ * @user_data: User data to pass on to @callback.
+ * Returns: %TRUE if @cache had a response for the request, in which case
+ * @callback will be called as with grl_tmdb_request_run_async(). %FALSE
+ * otherwise, and the request is not run.
+ */
+gboolean
+grl_tmdb_request_run_from_cache (GrlTmdbRequest *self,
+                                 GrlTmdbCache *cache,
+                                 GAsyncReadyCallback callback,
+                                 gpointer user_data)
+{
+  GTask *task;
+  char *call;
+  char *content;
+  gsize length;
+  gboolean parsed = FALSE;
+
+  call = grl_tmdb_request_dup_call (self);
+
+  if (grl_tmdb_cache_lookup (cache, call, &content, &length)) {
+    parsed = json_parser_load_from_data (self->priv->parser,
+                                         content,
+                                         length,
+                                         NULL);
+    g_free (content);
+  }
+
+  if (parsed) {
+    GRL_DEBUG ("Using cached response for %s", call);
+    task = g_task_new (G_OBJECT (self), NULL, callback, user_data);
+    g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
+  }
+
+  g_free (call);
+
+  return parsed;
+}
+
+/**
+ * grl_tmdb_request_share_response:
+ * @self: Instance of GrlTmdbRequest
+ * @other: A request identical to @self that completed successfully
+ *
+ * Makes @self return the values of the response to @other, instead of
+ * running it.
+ */
+void
+grl_tmdb_request_share_response (GrlTmdbRequest *self,
+                                 GrlTmdbRequest *other)
+{
+  g_object_unref (self->priv->parser);
+  self->priv->parser = g_object_ref (other->priv->parser);
+}
+
+/**
+ * grl_tmdb_request_run_async:
+ * @self: Instance of GrlTmdbRequest
+ * @wc: The #GrlNetWc used to run the request
+ * @cache: (allow-none): A #GrlTmdbCache to answer the request from, and to
+ * store its response in
+ * @callback: Callback to notify after the request is complete
+ * @cancellable: (allow-none): An optional cancellable to cancel this operation
+ * @user_data: User data to pass on to @callback.
+ *
+ * Schedule the request for execution.
+ */
+void
+grl_tmdb_request_run_async (GrlTmdbRequest *self,
+                            GrlNetWc *wc,
+                            GrlTmdbCache *cache,
+                            GAsyncReadyCallback callback,
+                            GCancellable *cancellable,
+                            gpointer user_data)
+{
+  char *call;
+  char *content;
+  gsize length;
+  GHashTable *headers;
+
+  call = grl_tmdb_request_dup_call (self);
+
   if (self->priv->task != NULL) {
       GRL_WARNING("Request %p to %s is already in progress", self, call);
       g_free (call);
@@ -586,6 +829,28 @@ grl_tmdb_request_run_async (GrlTmdbRequest *self,
                                  callback,
                                  user_data);
 
+  if (cache != NULL && grl_tmdb_cache_lookup (cache, call, &content, &length)) {
+    gboolean parsed;
+
+    parsed = json_parser_load_from_data (self->priv->parser,
+                                         content,
+                                         length,
+                                         NULL);
+    g_free (content);
+
+    if (parsed) {
+      GRL_DEBUG ("Using cached response for %s", call);
+      g_task_return_boolean (self->priv->task, TRUE);
+      g_clear_object (&self->priv->task);
+      g_free (call);
+      return;
+    }
+  }
+
+  self->priv->cache = cache;
+  g_free (self->priv->cache_key);
+  self->priv->cache_key = g_strdup (call);
+
   GRL_DEBUG ("Requesting %s", call);
 
   headers = g_hash_table_new (g_str_hash, g_str_equal);
@@ -641,31 +906,33 @@ GValue *
 grl_tmdb_request_get (GrlTmdbRequest *self,
                       const char *path)
 {
-  JsonNode *node;
-  JsonNode *element;
-  GError *error = NULL;
+  CompiledPath *compiled;
+  JsonNode *root, *node = NULL;
+  JsonNode *element = NULL;
   GValue *value = NULL;
   JsonArray *values;
 
-  node = json_path_query (path,
-                          json_parser_get_root (self->priv->parser),
-                          &error);
-  if (error != NULL) {
-    GRL_DEBUG ("Failed to get %s: %s", path, error->message);
-    g_error_free (error);
-
+  compiled = get_compiled_path (path);
+  root = json_parser_get_root (self->priv->parser);
+  if (root == NULL)
     return NULL;
-  }
 
-  values = json_node_get_array (node);
-  element = json_array_get_element (values, 0);
+  if (compiled->steps != NULL) {
+    element = follow_path (root, compiled->steps);
+  } else if (compiled->path != NULL) {
+    node = json_path_match (compiled->path, root);
+    values = json_node_get_array (node);
+    if (json_array_get_length (values) > 0)
+      element = json_array_get_element (values, 0);
+  }
 
-  if (JSON_NODE_HOLDS_VALUE (element)) {
+  if (element != NULL && JSON_NODE_HOLDS_VALUE (element)) {
     value = g_new0 (GValue, 1);
     json_node_get_value (element, value);
   }
 
-  json_node_free (node);
+  if (node != NULL)
+    json_node_free (node);
 
   return value;
 }
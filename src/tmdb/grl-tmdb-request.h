@@ -29,6 +29,8 @@
 
 #include <net/grl-net.h>
 
+#include "grl-tmdb-cache.h"
+
 #define GRL_TMDB_REQUEST_TYPE (grl_tmdb_request_get_type())
 #define GRL_TMDB_REQUEST(obj) \
   (G_TYPE_CHECK_INSTANCE_CAST ((obj), \
@@ -105,9 +107,23 @@ grl_tmdb_request_get_detail (GrlTmdbRequest *request);
 const char *
 grl_tmdb_request_get_uri (GrlTmdbRequest *request);
 
+char *
+grl_tmdb_request_dup_call (GrlTmdbRequest *request);
+
+gboolean
+grl_tmdb_request_run_from_cache (GrlTmdbRequest *request,
+                                 GrlTmdbCache *cache,
+                                 GAsyncReadyCallback callback,
+                                 gpointer user_data);
+
+void
+grl_tmdb_request_share_response (GrlTmdbRequest *request,
+                                 GrlTmdbRequest *other);
+
 void
 grl_tmdb_request_run_async (GrlTmdbRequest *request,
                             GrlNetWc *wc,
+                            GrlTmdbCache *cache,
                             GAsyncReadyCallback callback,
                             GCancellable *cancellable,
                             gpointer user_data);
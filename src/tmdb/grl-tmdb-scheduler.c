@@ -0,0 +1,460 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <grilo.h>
+#include <net/grl-net.h>
+
+#include "grl-tmdb-scheduler.h"
+
+#define GRL_LOG_DOMAIN_DEFAULT tmdb_log_domain
+GRL_LOG_DOMAIN_EXTERN(tmdb_log_domain);
+
+/* Requests refused for lack of capacity are retried this many times, after
+ * a delay doubled on each attempt. GrlNetWc does not give access to the
+ * Retry-After header, so the delay can not come from the server.
+ */
+#define MAX_RETRIES 3
+#define RETRY_DELAY_MS 2000
+
+/* All the requests of the source go through a token bucket: tokens are added
+ * at the configured rate up to a burst of one second worth of requests, and
+ * each request sent over the network takes one. Requests answered from the
+ * cache are not queued at all.
+ */
+
+struct _GrlTmdbScheduler {
+  GrlNetWc *wc;
+  GrlTmdbCache *cache;
+  double rate;
+  double tokens;
+  gint64 last_refill;
+  gint64 blocked_until;
+  guint max_in_flight;
+  guint in_flight;
+  guint timeout_id;
+  GQueue *queues[GRL_TMDB_SCHEDULER_PRIORITY_COUNT];
+  /* Request URI -> Job, for the queued and running ones */
+  GHashTable *jobs;
+  /* Cancels the running requests when the scheduler is freed */
+  GCancellable *cancellable;
+
+  /* Metrics */
+  guint completed;
+  gint64 total_latency;
+};
+
+struct _Waiter {
+  GrlTmdbRequest *request;
+  GAsyncReadyCallback callback;
+  gpointer user_data;
+};
+
+/* Identical requests share a job. The request of the first waiter is the one
+ * actually run, the other ones get its response. A running job outliving the
+ * scheduler has its scheduler unset.
+ */
+struct _Job {
+  GrlTmdbScheduler *scheduler;
+  char *call;
+  GrlTmdbSchedulerPriority priority;
+  GList *waiters;
+  gint64 queued_at;
+  guint attempts;
+  gboolean running;
+};
+
+typedef struct _Waiter Waiter;
+typedef struct _Job Job;
+
+static void dispatch (GrlTmdbScheduler *self);
+
+/* Private functions */
+
+static void
+waiter_free (gpointer data)
+{
+  Waiter *waiter = data;
+
+  g_object_unref (waiter->request);
+  g_slice_free (Waiter, waiter);
+}
+
+static void
+job_free (Job *job)
+{
+  g_list_free_full (job->waiters, waiter_free);
+  g_free (job->call);
+  g_slice_free (Job, job);
+}
+
+static void
+refill (GrlTmdbScheduler *self)
+{
+  gint64 now = g_get_monotonic_time ();
+
+  self->tokens += (now - self->last_refill) * self->rate / G_USEC_PER_SEC;
+  self->tokens = MIN (self->tokens, self->rate);
+  self->last_refill = now;
+}
+
+static Job *
+peek_next (GrlTmdbScheduler *self)
+{
+  guint i;
+
+  for (i = 0; i < GRL_TMDB_SCHEDULER_PRIORITY_COUNT; i++) {
+    if (!g_queue_is_empty (self->queues[i]))
+      return g_queue_peek_head (self->queues[i]);
+  }
+
+  return NULL;
+}
+
+static void
+log_stats (GrlTmdbScheduler *self)
+{
+  guint queued, in_flight, completed, latency;
+
+  grl_tmdb_scheduler_get_stats (self, &queued, &in_flight, &completed, &latency);
+  GRL_DEBUG ("Requests: %u queued, %u in flight, %u done, mean latency %u ms",
+             queued, in_flight, completed, latency);
+}
+
+static void
+complete_job (Job *job,
+              GrlTmdbRequest *request,
+              const GError *error)
+{
+  GList *l;
+
+  for (l = job->waiters; l != NULL; l = l->next) {
+    Waiter *waiter = l->data;
+    GTask *task;
+
+    if (error == NULL && waiter->request != request)
+      grl_tmdb_request_share_response (waiter->request, request);
+
+    task = g_task_new (waiter->request, NULL, waiter->callback, waiter->user_data);
+    if (error != NULL)
+      g_task_return_error (task, g_error_copy (error));
+    else
+      g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
+  }
+}
+
+/* Callbacks */
+
+static void
+on_request_done (GObject *source,
+                 GAsyncResult *result,
+                 gpointer user_data)
+{
+  Job *job = user_data;
+  GrlTmdbScheduler *self = job->scheduler;
+  GrlTmdbRequest *request = GRL_TMDB_REQUEST (source);
+  GError *error = NULL;
+  guint delay;
+
+  if (self == NULL) {
+    /* The scheduler is gone, and the request was cancelled */
+    grl_tmdb_request_run_finish (request, result, &error);
+    complete_job (job, request, error);
+    g_clear_error (&error);
+    job_free (job);
+    return;
+  }
+
+  self->in_flight--;
+
+  if (!grl_tmdb_request_run_finish (request, result, &error) &&
+      g_error_matches (error, GRL_NET_WC_ERROR, GRL_NET_WC_ERROR_UNAVAILABLE) &&
+      job->attempts < MAX_RETRIES) {
+    /* Most likely rate limited: hold every request, not only this one */
+    delay = RETRY_DELAY_MS << job->attempts;
+    job->attempts++;
+    GRL_DEBUG ("Retrying %s in %u ms: %s", job->call, delay, error->message);
+
+    self->blocked_until = MAX (self->blocked_until,
+                               g_get_monotonic_time () + delay * 1000);
+    job->running = FALSE;
+    g_queue_push_head (self->queues[job->priority], job);
+    g_error_free (error);
+
+    dispatch (self);
+    return;
+  }
+
+  g_hash_table_remove (self->jobs, job->call);
+  self->completed++;
+  self->total_latency += g_get_monotonic_time () - job->queued_at;
+  log_stats (self);
+
+  complete_job (job, request, error);
+  g_clear_error (&error);
+  job_free (job);
+
+  dispatch (self);
+}
+
+static gboolean
+on_timeout (gpointer user_data)
+{
+  GrlTmdbScheduler *self = user_data;
+
+  self->timeout_id = 0;
+  dispatch (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+dispatch (GrlTmdbScheduler *self)
+{
+  gint64 now, delay = 0;
+  Job *job;
+  Waiter *waiter;
+
+  while (self->in_flight < self->max_in_flight &&
+         (job = peek_next (self)) != NULL) {
+    now = g_get_monotonic_time ();
+    if (now < self->blocked_until) {
+      delay = self->blocked_until - now;
+      break;
+    }
+
+    refill (self);
+    if (self->tokens < 1) {
+      delay = (1 - self->tokens) * G_USEC_PER_SEC / self->rate;
+      break;
+    }
+    self->tokens -= 1;
+
+    g_queue_pop_head (self->queues[job->priority]);
+    job->running = TRUE;
+    self->in_flight++;
+
+    waiter = job->waiters->data;
+    grl_tmdb_request_run_async (waiter->request,
+                                self->wc,
+                                self->cache,
+                                on_request_done,
+                                self->cancellable,
+                                job);
+  }
+
+  if (delay > 0 && self->timeout_id == 0) {
+    self->timeout_id = g_timeout_add (delay / 1000 + 1, on_timeout, self);
+  }
+}
+
+/* Public functions */
+
+/**
+ * grl_tmdb_scheduler_new:
+ * @wc: The #GrlNetWc used to run the requests
+ * @cache: (allow-none): A #GrlTmdbCache to answer requests from
+ * Returns: (transfer full): A new #GrlTmdbScheduler with the default limits
+ */
+GrlTmdbScheduler *
+grl_tmdb_scheduler_new (GrlNetWc *wc, GrlTmdbCache *cache)
+{
+  GrlTmdbScheduler *self;
+  guint i;
+
+  self = g_slice_new0 (GrlTmdbScheduler);
+  self->wc = wc;
+  self->cache = cache;
+  self->jobs = g_hash_table_new (g_str_hash, g_str_equal);
+  self->cancellable = g_cancellable_new ();
+  for (i = 0; i < GRL_TMDB_SCHEDULER_PRIORITY_COUNT; i++)
+    self->queues[i] = g_queue_new ();
+
+  grl_tmdb_scheduler_set_limits (self,
+                                 GRL_TMDB_SCHEDULER_DEFAULT_RATE,
+                                 GRL_TMDB_SCHEDULER_DEFAULT_MAX_IN_FLIGHT);
+  self->tokens = self->rate;
+  self->last_refill = g_get_monotonic_time ();
+
+  return self;
+}
+
+/**
+ * grl_tmdb_scheduler_free:
+ * @self: Instance of #GrlTmdbScheduler
+ *
+ * Fails the queued requests with %G_IO_ERROR_CANCELLED and cancels the
+ * running ones, whose callbacks are still called once they are done.
+ */
+void
+grl_tmdb_scheduler_free (GrlTmdbScheduler *self)
+{
+  GHashTableIter iter;
+  GError *error;
+  Job *job;
+  guint i;
+
+  g_clear_handle_id (&self->timeout_id, g_source_remove);
+
+  error = g_error_new_literal (G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                               "Operation was cancelled");
+  for (i = 0; i < GRL_TMDB_SCHEDULER_PRIORITY_COUNT; i++) {
+    while ((job = g_queue_pop_head (self->queues[i])) != NULL) {
+      g_hash_table_remove (self->jobs, job->call);
+      complete_job (job, NULL, error);
+      job_free (job);
+    }
+    g_queue_free (self->queues[i]);
+  }
+  g_error_free (error);
+
+  /* Only running jobs are left, they are completed from on_request_done() */
+  g_hash_table_iter_init (&iter, self->jobs);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &job))
+    job->scheduler = NULL;
+  g_hash_table_unref (self->jobs);
+
+  g_cancellable_cancel (self->cancellable);
+  g_object_unref (self->cancellable);
+
+  g_slice_free (GrlTmdbScheduler, self);
+}
+
+/**
+ * grl_tmdb_scheduler_set_limits:
+ * @self: Instance of #GrlTmdbScheduler
+ * @rate: Maximum number of requests sent per second
+ * @max_in_flight: Maximum number of requests running at the same time
+ */
+void
+grl_tmdb_scheduler_set_limits (GrlTmdbScheduler *self,
+                               guint rate,
+                               guint max_in_flight)
+{
+  self->rate = MAX (rate, 1);
+  self->tokens = MIN (self->tokens, self->rate);
+  self->max_in_flight = MAX (max_in_flight, 1);
+}
+
+/**
+ * grl_tmdb_scheduler_push:
+ * @self: Instance of #GrlTmdbScheduler
+ * @request: The request to run
+ * @priority: Requests of higher priority are sent first
+ * @callback: Callback to notify after the request is complete, which calls
+ * grl_tmdb_request_run_finish() on @request
+ * @user_data: User data to pass on to @callback
+ *
+ * Runs @request once the rate and concurrency limits allow it, or right away
+ * if it can be answered from the cache. If an identical request is already
+ * queued or running, @request gets its response instead.
+ */
+void
+grl_tmdb_scheduler_push (GrlTmdbScheduler *self,
+                         GrlTmdbRequest *request,
+                         GrlTmdbSchedulerPriority priority,
+                         GAsyncReadyCallback callback,
+                         gpointer user_data)
+{
+  Waiter *waiter;
+  Job *job;
+  char *call;
+
+  if (self->cache != NULL &&
+      grl_tmdb_request_run_from_cache (request, self->cache, callback, user_data))
+    return;
+
+  waiter = g_slice_new (Waiter);
+  waiter->request = g_object_ref (request);
+  waiter->callback = callback;
+  waiter->user_data = user_data;
+
+  call = grl_tmdb_request_dup_call (request);
+  job = g_hash_table_lookup (self->jobs, call);
+
+  if (job != NULL) {
+    GRL_DEBUG ("Joining identical request %s", call);
+    job->waiters = g_list_append (job->waiters, waiter);
+
+    if (!job->running && priority < job->priority) {
+      g_queue_remove (self->queues[job->priority], job);
+      job->priority = priority;
+      g_queue_push_tail (self->queues[priority], job);
+    }
+
+    g_free (call);
+    return;
+  }
+
+  job = g_slice_new0 (Job);
+  job->scheduler = self;
+  job->call = call;
+  job->priority = priority;
+  job->waiters = g_list_prepend (NULL, waiter);
+  job->queued_at = g_get_monotonic_time ();
+
+  g_hash_table_insert (self->jobs, job->call, job);
+  g_queue_push_tail (self->queues[priority], job);
+
+  dispatch (self);
+}
+
+/**
+ * grl_tmdb_scheduler_get_stats:
+ * @self: Instance of #GrlTmdbScheduler
+ * @queued: (out) (allow-none): Return location for the number of requests
+ * waiting to be sent
+ * @in_flight: (out) (allow-none): Return location for the number of requests
+ * running
+ * @completed: (out) (allow-none): Return location for the number of requests
+ * sent over the network and done, identical requests counting once
+ * @mean_latency_ms: (out) (allow-none): Return location for the mean time
+ * between queueing a request and its completion
+ */
+void
+grl_tmdb_scheduler_get_stats (GrlTmdbScheduler *self,
+                              guint *queued,
+                              guint *in_flight,
+                              guint *completed,
+                              guint *mean_latency_ms)
+{
+  guint i;
+
+  if (queued != NULL) {
+    *queued = 0;
+    for (i = 0; i < GRL_TMDB_SCHEDULER_PRIORITY_COUNT; i++)
+      *queued += g_queue_get_length (self->queues[i]);
+  }
+
+  if (in_flight != NULL)
+    *in_flight = self->in_flight;
+
+  if (completed != NULL)
+    *completed = self->completed;
+
+  if (mean_latency_ms != NULL) {
+    *mean_latency_ms = self->completed > 0 ?
+      self->total_latency / self->completed / 1000 : 0;
+  }
+}
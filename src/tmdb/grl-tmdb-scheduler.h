@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef _GRL_TMDB_SCHEDULER_H_
+#define _GRL_TMDB_SCHEDULER_H_
+
+#include "grl-tmdb-request.h"
+
+#define GRL_TMDB_SCHEDULER_DEFAULT_RATE         4
+#define GRL_TMDB_SCHEDULER_DEFAULT_MAX_IN_FLIGHT 4
+
+enum _GrlTmdbSchedulerPriority {
+  GRL_TMDB_SCHEDULER_PRIORITY_FAST,
+  GRL_TMDB_SCHEDULER_PRIORITY_SLOW,
+  GRL_TMDB_SCHEDULER_PRIORITY_COUNT
+};
+typedef enum _GrlTmdbSchedulerPriority GrlTmdbSchedulerPriority;
+
+typedef struct _GrlTmdbScheduler GrlTmdbScheduler;
+
+GrlTmdbScheduler *
+grl_tmdb_scheduler_new (GrlNetWc *wc, GrlTmdbCache *cache);
+
+void
+grl_tmdb_scheduler_free (GrlTmdbScheduler *scheduler);
+
+void
+grl_tmdb_scheduler_set_limits (GrlTmdbScheduler *scheduler,
+                               guint rate,
+                               guint max_in_flight);
+
+void
+grl_tmdb_scheduler_push (GrlTmdbScheduler *scheduler,
+                         GrlTmdbRequest *request,
+                         GrlTmdbSchedulerPriority priority,
+                         GAsyncReadyCallback callback,
+                         gpointer user_data);
+
+void
+grl_tmdb_scheduler_get_stats (GrlTmdbScheduler *scheduler,
+                              guint *queued,
+                              guint *in_flight,
+                              guint *completed,
+                              guint *mean_latency_ms);
+
+#endif /* _GRL_TMDB_SCHEDULER_H_ */
@@ -34,6 +34,8 @@
 
 #include "grl-tmdb.h"
 #include "grl-tmdb-request.h"
+#include "grl-tmdb-cache.h"
+#include "grl-tmdb-scheduler.h"
 
 #define GRL_LOG_DOMAIN_DEFAULT tmdb_log_domain
 GRL_LOG_DOMAIN(tmdb_log_domain);
@@ -42,6 +44,9 @@ GRL_LOG_DOMAIN(tmdb_log_domain);
 #define SOURCE_NAME "TMDb Metadata Provider"
 #define SOURCE_DESC "A source for movie metadata from themoviedb.org"
 
+#define GRILO_CONF_REQUEST_RATE           "request-rate"
+#define GRILO_CONF_MAX_REQUESTS_IN_FLIGHT "max-requests-in-flight"
+
 #define SHOULD_RESOLVE(key) \
     g_hash_table_contains (closure->keys, GRLKEYID_TO_POINTER ((key)))
 
@@ -60,6 +65,8 @@ struct _GrlTmdbSourcePrivate {
   GHashTable *supported_keys;
   GHashTable *slow_keys;
   GrlNetWc *wc;
+  GrlTmdbCache *cache;
+  GrlTmdbScheduler *scheduler;
   GrlTmdbRequest *configuration;
   gboolean config_pending;
   GQueue *pending_resolves;
@@ -78,6 +85,8 @@ struct _ResolveClosure {
 struct _PendingRequest {
   GrlTmdbRequest *request;
   GAsyncReadyCallback callback;
+  GrlTmdbSchedulerPriority priority;
+  gboolean running;
 };
 
 typedef struct _ResolveClosure ResolveClosure;
@@ -130,6 +139,8 @@ grl_tmdb_source_plugin_init (GrlRegistry *registry,
 {
   GrlConfig *config;
   char *api_key;
+  guint rate = GRL_TMDB_SCHEDULER_DEFAULT_RATE;
+  guint max_in_flight = GRL_TMDB_SCHEDULER_DEFAULT_MAX_IN_FLIGHT;
 
   GRL_LOG_DOMAIN_INIT (tmdb_log_domain, "tmdb");
 
@@ -151,7 +162,13 @@ grl_tmdb_source_plugin_init (GrlRegistry *registry,
     return FALSE;
   }
 
+  if (grl_config_has_param (config, GRILO_CONF_REQUEST_RATE))
+    rate = MAX (grl_config_get_int (config, GRILO_CONF_REQUEST_RATE), 1);
+  if (grl_config_has_param (config, GRILO_CONF_MAX_REQUESTS_IN_FLIGHT))
+    max_in_flight = MAX (grl_config_get_int (config, GRILO_CONF_MAX_REQUESTS_IN_FLIGHT), 1);
+
   GrlTmdbSource *source = grl_tmdb_source_new (api_key);
+  grl_tmdb_scheduler_set_limits (source->priv->scheduler, rate, max_in_flight);
   grl_registry_register_source (registry,
                                        plugin,
                                        GRL_SOURCE (source),
@@ -311,7 +328,9 @@ grl_tmdb_source_init (GrlTmdbSource *self)
                     GRLKEYID_TO_POINTER (GRL_METADATA_KEY_PUBLICATION_DATE));
 
   self->priv->wc = grl_net_wc_new ();
-  grl_net_wc_set_throttling (self->priv->wc, 1);
+  self->priv->cache = grl_tmdb_cache_new ();
+  self->priv->scheduler = grl_tmdb_scheduler_new (self->priv->wc,
+                                                  self->priv->cache);
 
   self->priv->config_pending = FALSE;
   self->priv->pending_resolves = g_queue_new ();
@@ -363,11 +382,15 @@ grl_tmdb_source_finalize (GObject *object)
     self->priv->configuration = NULL;
   }
 
+  g_clear_pointer (&self->priv->scheduler, grl_tmdb_scheduler_free);
+
   if (self->priv->wc != NULL) {
     g_object_unref (self->priv->wc);
     self->priv->wc = NULL;
   }
 
+  g_clear_pointer (&self->priv->cache, grl_tmdb_cache_free);
+
   if (self->priv->pending_resolves != NULL) {
       g_queue_free_full (self->priv->pending_resolves,
                          (GDestroyNotify) resolve_closure_free);
@@ -431,6 +454,7 @@ resolve_closure_callback (ResolveClosure *closure,
 
 static void queue_request (ResolveClosure *closure,
                            GrlTmdbRequest *request,
+                           GrlTmdbSchedulerPriority priority,
                            GAsyncReadyCallback callback)
 {
   PendingRequest *pending_request;
@@ -438,6 +462,7 @@ static void queue_request (ResolveClosure *closure,
   pending_request = g_slice_new0 (PendingRequest);
   pending_request->request = request;
   pending_request->callback = callback;
+  pending_request->priority = priority;
 
   g_queue_push_tail (closure->pending_requests, pending_request);
 }
@@ -454,11 +479,15 @@ static int run_pending_requests (ResolveClosure *closure,
 
     PendingRequest *const pending_request = it->data;
 
-    grl_tmdb_request_run_async (pending_request->request,
-                                closure->self->priv->wc,
-                                pending_request->callback,
-                                NULL,
-                                closure);
+    if (pending_request->running)
+      continue;
+
+    pending_request->running = TRUE;
+    grl_tmdb_scheduler_push (closure->self->priv->scheduler,
+                             pending_request->request,
+                             pending_request->priority,
+                             pending_request->callback,
+                             closure);
 
     ++num_requests;
   }
@@ -976,6 +1005,10 @@ on_search_ready (GObject *source,
   value = grl_tmdb_request_get (request, "$.total_results");
   if (g_value_get_int64 (value) == 0) {
     /* Nothing found */
+    grl_tmdb_cache_store_movie_id (closure->self->priv->cache,
+                                   grl_media_get_title (closure->rs->media),
+                                   0,
+                                   GRL_TMDB_CACHE_TTL_NO_MATCH);
     resolve_closure_callback (closure, NULL);
     resolve_closure_free (closure);
     g_value_unset (value);
@@ -1009,6 +1042,11 @@ on_search_ready (GObject *source,
   g_value_unset (value);
   g_free (value);
 
+  grl_tmdb_cache_store_movie_id (closure->self->priv->cache,
+                                 grl_media_get_title (closure->rs->media),
+                                 closure->id,
+                                 GRL_TMDB_CACHE_TTL_SEARCH);
+
   if (grl_data_get_boolean (GRL_DATA (closure->rs->media), GRL_METADATA_KEY_TITLE_FROM_FILENAME)) {
     value = grl_tmdb_request_get (request, "$.results[0].title");
     if (value) {
@@ -1105,7 +1143,10 @@ static void queue_detail_request (ResolveClosure *closure,
   request = grl_tmdb_request_new_details (closure->self->priv->api_key,
                                           detail, closure->id);
 
-  queue_request (closure, request, on_request_ready);
+  queue_request (closure, request,
+                 closure->slow ? GRL_TMDB_SCHEDULER_PRIORITY_SLOW
+                               : GRL_TMDB_SCHEDULER_PRIORITY_FAST,
+                 on_request_ready);
 }
 
 static void resolve_slow_details (ResolveClosure *closure)
@@ -1156,7 +1197,8 @@ static void resolve_slow_details (ResolveClosure *closure)
                                                details, closure->id);
   g_list_free (details);
 
-  queue_request (closure, request, on_request_ready);
+  queue_request (closure, request, GRL_TMDB_SCHEDULER_PRIORITY_SLOW,
+                 on_request_ready);
 }
 
 static void
@@ -1205,7 +1247,7 @@ on_configuration_ready (GObject *source,
 
   g_queue_push_head (self->priv->pending_resolves, closure);
 
-  /* Flush queue. GrlNetWc will take care of throttling */
+  /* Flush queue. The scheduler will take care of throttling */
   while (!g_queue_is_empty (self->priv->pending_resolves)) {
     ResolveClosure *pending_closure;
 
@@ -1298,6 +1340,7 @@ grl_tmdb_source_resolve (GrlSource *source,
   const char *str_movie_id;
   GrlTmdbSource *self = GRL_TMDB_SOURCE (source);
   guint64 movie_id = 0;
+  gboolean from_title = FALSE;
   GList *it;
 
   if (!grl_media_is_video (rs->media)) {
@@ -1323,6 +1366,21 @@ grl_tmdb_source_resolve (GrlSource *source,
   if (movie_id == 0)
     title = grl_media_get_title (rs->media);
 
+  /* Titles searched for before are resolved by movie-id instead. */
+  if (title != NULL &&
+      grl_tmdb_cache_lookup_movie_id (self->priv->cache, title, &movie_id)) {
+    if (movie_id == 0) {
+      GRL_DEBUG ("No match for title \"%s\" (cached)", title);
+      rs->callback (source, rs->operation_id, rs->media, rs->user_data, NULL);
+      return;
+    }
+
+    GRL_DEBUG ("Title \"%s\" is movie #%" G_GUINT64_FORMAT " (cached)",
+               title, movie_id);
+    from_title = TRUE;
+    title = NULL;
+  }
+
   if (movie_id == 0 && title == NULL) {
     /* Can't search for anything without a title or the movie-id ... */
     rs->callback (source, rs->operation_id, rs->media, rs->user_data, NULL);
@@ -1356,6 +1414,19 @@ grl_tmdb_source_resolve (GrlSource *source,
   if (grl_operation_options_get_resolution_flags (rs->options) & GRL_RESOLVE_FAST_ONLY)
     closure->slow = FALSE;
 
+  /* Do what the search would have done with the matched movie. */
+  if (from_title) {
+    if (grl_data_get_boolean (GRL_DATA (rs->media), GRL_METADATA_KEY_TITLE_FROM_FILENAME))
+      g_hash_table_add (closure->keys, GRLKEYID_TO_POINTER (GRL_METADATA_KEY_TITLE));
+
+    if (SHOULD_RESOLVE (GRL_TMDB_METADATA_KEY_TMDB_ID)) {
+      char *tmdb_id = g_strdup_printf ("%" G_GUINT64_FORMAT, movie_id);
+      grl_data_set_string (GRL_DATA (rs->media),
+                           GRL_TMDB_METADATA_KEY_TMDB_ID, tmdb_id);
+      g_free (tmdb_id);
+    }
+  }
+
   /* We did not receive the config yet, queue request. Config callback will
    * take care of flushing the queue when ready.
    */
@@ -1369,14 +1440,16 @@ grl_tmdb_source_resolve (GrlSource *source,
     /* We need to fetch TMDb's configuration for the image paths */
     request = grl_tmdb_request_new_configuration (closure->self->priv->api_key);
     g_assert (g_queue_is_empty (closure->pending_requests));
-    queue_request (closure, request, on_configuration_ready);
+    queue_request (closure, request, GRL_TMDB_SCHEDULER_PRIORITY_FAST,
+                   on_configuration_ready);
     self->priv->config_pending = TRUE;
   }
 
   if (title) {
     GRL_DEBUG ("Running initial search for title \"%s\"...", title);
     request = grl_tmdb_request_new_search (closure->self->priv->api_key, title);
-    queue_request (closure, request, on_search_ready);
+    queue_request (closure, request, GRL_TMDB_SCHEDULER_PRIORITY_FAST,
+                   on_search_ready);
   } else {
     GRL_DEBUG ("Running %s lookup for movie #%" G_GUINT64_FORMAT "...",
                closure->slow ? "slow" : "fast", movie_id);
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "test_chromaprint_utils.h"
+#include <locale.h>
+#include <glib/gstdio.h>
+#include <grilo.h>
+
+/* Copies of each fixture resolved in performance mode, and otherwise */
+#define BENCH_N_COPIES 16
+#define CHECK_N_COPIES 2
+
+static const gchar *fixtures[] = {
+  CHROMAPRINT_PLUGIN_TEST_DATA_PATH "sample.flac",
+  CHROMAPRINT_PLUGIN_TEST_DATA_PATH "sample.ogg",
+};
+
+typedef struct {
+  GMainLoop *loop;
+  guint      pending;
+  guint      fingerprinted;
+} BenchData;
+
+static void
+resolve_done (GrlSource    *source,
+              guint         operation_id,
+              GrlMedia     *media,
+              gpointer      user_data,
+              const GError *error)
+{
+  BenchData *data = user_data;
+  GrlRegistry *registry;
+  GrlKeyID key_fingerprint;
+
+  g_assert_no_error (error);
+
+  registry = grl_registry_get_default ();
+  key_fingerprint = grl_registry_lookup_metadata_key (registry, "chromaprint");
+  if (grl_data_get_string (GRL_DATA (media), key_fingerprint) != NULL)
+    data->fingerprinted++;
+
+  g_object_unref (media);
+
+  if (--data->pending == 0)
+    g_main_loop_quit (data->loop);
+}
+
+/* Copies of the fixtures, so none of them is found in the cache */
+static GList *
+make_corpus (const gchar *dir, guint n_copies)
+{
+  GList *corpus = NULL;
+  guint i, j;
+
+  for (i = 0; i < n_copies; i++) {
+    for (j = 0; j < G_N_ELEMENTS (fixtures); j++) {
+      GError *error = NULL;
+      gchar *contents, *basename, *path;
+      gsize length;
+
+      g_file_get_contents (fixtures[j], &contents, &length, &error);
+      g_assert_no_error (error);
+
+      basename = g_path_get_basename (fixtures[j]);
+      path = g_strdup_printf ("%s/%02u-%s", dir, i, basename);
+      g_file_set_contents (path, contents, length, &error);
+      g_assert_no_error (error);
+
+      corpus = g_list_prepend (corpus, path);
+      g_free (basename);
+      g_free (contents);
+    }
+  }
+
+  return corpus;
+}
+
+static void
+test_throughput (void)
+{
+  GrlSource *source;
+  GrlRegistry *registry;
+  GrlOperationOptions *options;
+  GrlKeyID key_fingerprint;
+  GList *keys, *corpus, *l;
+  GError *error = NULL;
+  BenchData data = { 0, };
+  gchar *dir;
+  gdouble elapsed;
+
+  source = test_get_source ();
+  g_assert (source);
+
+  registry = grl_registry_get_default ();
+  key_fingerprint = grl_registry_lookup_metadata_key (registry, "chromaprint");
+  keys = grl_metadata_key_list_new (key_fingerprint,
+                                    GRL_METADATA_KEY_DURATION,
+                                    GRL_METADATA_KEY_INVALID);
+  options = grl_operation_options_new (NULL);
+  grl_operation_options_set_resolution_flags (options, GRL_RESOLVE_NORMAL);
+
+  dir = g_dir_make_tmp ("grl-chromaprint-XXXXXX", &error);
+  g_assert_no_error (error);
+  /* Outside of performance mode, only check that every file gets a
+   * fingerprint when they are all resolved at once */
+  corpus = make_corpus (dir, g_test_perf () ? BENCH_N_COPIES : CHECK_N_COPIES);
+
+  data.loop = g_main_loop_new (NULL, FALSE);
+  data.pending = g_list_length (corpus);
+
+  /* All at once, as when browsing a music library */
+  g_test_timer_start ();
+  for (l = corpus; l != NULL; l = l->next) {
+    GrlMedia *audio = grl_media_audio_new ();
+
+    grl_media_set_url (audio, l->data);
+    grl_source_resolve (source, audio, keys, options, resolve_done, &data);
+  }
+  g_main_loop_run (data.loop);
+  elapsed = g_test_timer_elapsed ();
+
+  g_assert_cmpuint (data.fingerprinted, ==, g_list_length (corpus));
+  if (g_test_perf ()) {
+    g_test_maximized_result (data.fingerprinted / elapsed,
+                             "%.1f files/s", data.fingerprinted / elapsed);
+  }
+
+  for (l = corpus; l != NULL; l = l->next)
+    g_unlink (l->data);
+  g_rmdir (dir);
+
+  g_list_free_full (corpus, g_free);
+  g_main_loop_unref (data.loop);
+  g_object_unref (options);
+  g_list_free (keys);
+  g_free (dir);
+}
+
+gint
+main (gint argc, gchar **argv)
+{
+  gint result;
+
+  setlocale (LC_ALL, "");
+
+  g_setenv ("GRL_PLUGIN_PATH", CHROMAPRINT_PLUGIN_PATH, TRUE);
+  g_setenv ("GRL_PLUGIN_LIST", CHROMAPRINT_ID, TRUE);
+
+  grl_init (&argc, &argv);
+  g_test_init (&argc, &argv, NULL);
+
+  test_setup_chromaprint ();
+
+  g_test_add_func ("/chromaprint/resolve/throughput", test_throughput);
+
+  result = g_test_run ();
+
+  test_shutdown_chromaprint ();
+
+  grl_deinit ();
+
+  return result;
+}
@@ -20,6 +20,9 @@ from dleynamediadevice import MAIN_IFACE as MEDIA_DEVICE_IFACE
 
 MAIN_IFACE = 'org.gnome.UPnP.MediaContainer2'
 
+# Like some real servers, return at most this many children per call
+LIST_CHILDREN_MAX = 100
+
 def load(mock, parameters):
     mock.AddMethods(MAIN_IFACE, [
         ('CreatePlaylist', 'ssssao', '', ''),
@@ -72,10 +75,9 @@ def CreateContainer(self, display_name, container_type, child_types):
                      out_signature='aa{sv}')
 def ListChildren(self, offset, count, prop_filter):
     children = [i for i in self.items if i['Parent'] == self.__dbus_object_path__]
-    if count:
-        children = children[offset:offset+count]
-    else:
-        children = children[offset:]
+    if not count or count > LIST_CHILDREN_MAX:
+        count = LIST_CHILDREN_MAX
+    children = children[offset:offset+count]
     return [filter_properties(i, prop_filter) for i in children]
 
 
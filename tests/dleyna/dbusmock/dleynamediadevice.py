@@ -48,6 +48,7 @@ def load(mock, parameters):
     mock.changes = None
     mock.changes_id = 0
     mock.changes_detailed = True
+    mock.next_child_id = 0
     # make queue_change() a real method of the mock object
     setattr(mock, 'queue_change', queue_change.__get__(mock, mock.__class__))
 
@@ -99,6 +100,48 @@ def CreateContainerInAnyContainer(self, display_name, container_type, child_type
 
     return (path)
 
+@dbus.service.method(MOCK_IFACE,
+                     in_signature='os', out_signature='o')
+def AddChild(self, parent, display_name):
+    """Add an item to a container, only reporting it as a queued change"""
+    child_id = self.next_child_id
+    self.next_child_id += 1
+
+    path = '{0}/new{1:03}'.format(parent, child_id)
+    self.items.append({
+        'DisplayName': display_name,
+        'Parent': dbus.ObjectPath(parent),
+        'Path': dbus.ObjectPath(path),
+        'Type': 'item.unclassified',
+        'TypeEx': 'item',
+      })
+    find_item(self.items, parent)['ChildCount'] += 1
+
+    self.queue_change ({
+        'ChangeType': CHANGE_TYPES['Add'],
+        'Path': dbus.ObjectPath(path),
+        'Parent': dbus.ObjectPath(parent)
+    })
+
+    return path
+
+@dbus.service.method(MOCK_IFACE,
+                     in_signature='o', out_signature='')
+def EmitContainerUpdateIDs(self, path):
+    """Report that the children of a container changed"""
+    self.changes_id += 1
+    self.EmitSignal(MAIN_IFACE, 'ContainerUpdateIDs', 'a(ou)', [[(path, dbus.UInt32(self.changes_id))]])
+
+@dbus.service.method(MOCK_IFACE,
+                     in_signature='', out_signature='')
+def BumpSystemUpdateID(self):
+    """Report that something changed somewhere on the server"""
+    self.changes_id += 1
+    update_id = dbus.UInt32(self.changes_id)
+    self.props[MAIN_IFACE]['SystemUpdateID'] = update_id
+    self.EmitSignal(dbus.PROPERTIES_IFACE, 'PropertiesChanged', 'sa{sv}as',
+                    [MAIN_IFACE, dbus.Dictionary({'SystemUpdateID': update_id}, signature='sv'), []])
+
 @dbus.service.method(MOCK_IFACE,
                      in_signature='', out_signature='')
 def FlushChanges(self):
@@ -118,6 +118,22 @@ ITEMS = [
       'TypeEx': 'item' },
 ]
 
+# A container with more children than the plugin requests at once
+MANY_CLIPS = 600
+ITEMS.append(
+    { 'DisplayName': 'Many clips',
+      'Path':   '{root}/22',
+      'Parent': '{root}/2',
+      'Type':   'container',
+      'TypeEx': 'container' })
+for i in range(MANY_CLIPS):
+    ITEMS.append(
+        { 'DisplayName': 'Clip {0:03}'.format(i),
+          'Path':   '{{root}}/22/{0:03}'.format(i),
+          'Parent': '{root}/22',
+          'Type':   'video',
+          'TypeEx': 'video' })
+
 # Populate initial ChildCounts
 for item in ITEMS:
     if item['Type'].startswith('container'):
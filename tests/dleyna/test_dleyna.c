@@ -166,6 +166,168 @@ test_browse (TestDleynaFixture *fixture,
   g_object_unref (options);
 }
 
+typedef struct {
+  GPtrArray *medias;
+  guint      remaining;
+  gboolean   finished;
+} PagedBrowseData;
+
+static void
+paged_browse_cb (GrlSource    *source,
+                 guint         operation_id,
+                 GrlMedia     *media,
+                 guint         remaining,
+                 gpointer      user_data,
+                 const GError *error)
+{
+  TestDleynaFixture *fixture = user_data;
+  PagedBrowseData *data = g_ptr_array_index (fixture->results, 0);
+
+  g_assert_no_error (error);
+  g_assert (!data->finished);
+
+  if (media != NULL) {
+    g_ptr_array_add (data->medias, media);
+  }
+
+  data->remaining = remaining;
+  if (remaining == 0) {
+    data->finished = TRUE;
+    test_dleyna_main_loop_quit (fixture);
+  }
+}
+
+/**
+ * test_browse_paged:
+ *
+ * Test that a container with more children than fit in a page, on a server
+ * returning fewer children than requested, is listed whole and in order.
+ */
+static void
+test_browse_paged (TestDleynaFixture *fixture,
+                   gconstpointer      user_data)
+{
+  GrlSource *source;
+  GrlOperationOptions *options;
+  GrlMedia *container;
+  GList *keys;
+  PagedBrowseData data = { NULL, };
+  guint i;
+
+  g_signal_connect (fixture->registry, "source-added", G_CALLBACK (main_loop_quit_on_source_cb), fixture);
+  test_dleyna_add_server (fixture);
+  test_dleyna_main_loop_run (fixture, 5);
+
+  source = grl_registry_lookup_source (fixture->registry, "grl-dleyna-c50bf388-042a-5326-af4b-6969e1bbc860");
+
+  data.medias = g_ptr_array_new_with_free_func (g_object_unref);
+  fixture->results = g_ptr_array_new ();
+  g_ptr_array_add (fixture->results, &data);
+
+  container = grl_media_container_new ();
+  grl_media_set_id (container, "dleyna:/com/intel/dLeynaServer/server/0/22");
+  options = grl_operation_options_new (NULL);
+  keys = grl_metadata_key_list_new (GRL_METADATA_KEY_TITLE, NULL);
+
+  grl_source_browse (source, container, keys, options, paged_browse_cb, fixture);
+  test_dleyna_main_loop_run (fixture, 10);
+
+  g_assert (data.finished);
+  g_assert_cmpuint (data.remaining, ==, 0);
+  g_assert_cmpuint (data.medias->len, ==, 600);
+  for (i = 0; i < data.medias->len; i++) {
+    GrlMedia *media = g_ptr_array_index (data.medias, i);
+    gchar *id = g_strdup_printf ("dleyna:/com/intel/dLeynaServer/server/0/22/%03u", i);
+
+    g_assert_cmpstr (grl_media_get_id (media), ==, id);
+    g_free (id);
+  }
+
+  g_list_free (keys);
+  g_object_unref (options);
+  g_object_unref (container);
+  g_ptr_array_unref (data.medias);
+}
+
+static guint
+count_children (GrlSource   *source,
+                const gchar *container_id)
+{
+  GrlOperationOptions *options;
+  GrlMedia *container;
+  GList *results;
+  GError *error = NULL;
+  guint count;
+
+  container = grl_media_container_new ();
+  grl_media_set_id (container, container_id);
+  options = grl_operation_options_new (NULL);
+
+  results = grl_source_browse_sync (source, container, NULL, options, &error);
+  g_assert_no_error (error);
+  count = g_list_length (results);
+
+  g_list_free_full (results, g_object_unref);
+  g_object_unref (options);
+  g_object_unref (container);
+
+  return count;
+}
+
+/* Lets the source handle the signals emitted by the server so far */
+static void
+dispatch_pending (void)
+{
+  while (g_main_context_iteration (NULL, FALSE));
+}
+
+/**
+ * test_browse_cache:
+ *
+ * Test that a cached browse is used until the server reports a change to the
+ * container, whether with Changed, ContainerUpdateIDs or SystemUpdateID.
+ */
+static void
+test_browse_cache (TestDleynaFixture *fixture,
+                   gconstpointer      user_data)
+{
+  GrlSource *source;
+  gchar *device = "/com/intel/dLeynaServer/server/0";
+  gchar *stuff = "/com/intel/dLeynaServer/server/0/3";
+  const gchar *stuff_id = "dleyna:/com/intel/dLeynaServer/server/0/3";
+
+  g_signal_connect (fixture->registry, "source-added", G_CALLBACK (main_loop_quit_on_source_cb), fixture);
+  test_dleyna_add_server (fixture);
+  test_dleyna_main_loop_run (fixture, 5);
+
+  source = grl_registry_lookup_source (fixture->registry, "grl-dleyna-c50bf388-042a-5326-af4b-6969e1bbc860");
+
+  test_dleyna_queue_changes (fixture, device, TRUE, TRUE);
+  g_assert_cmpuint (count_children (source, stuff_id), ==, 5);
+
+  /* Until reported, the new child is not seen */
+  test_dleyna_add_child (fixture, device, stuff, "New child 1");
+  g_assert_cmpuint (count_children (source, stuff_id), ==, 5);
+
+  test_dleyna_flush_changes (fixture, device);
+  dispatch_pending ();
+  g_assert_cmpuint (count_children (source, stuff_id), ==, 6);
+
+  test_dleyna_add_child (fixture, device, stuff, "New child 2");
+  g_assert_cmpuint (count_children (source, stuff_id), ==, 6);
+
+  test_dleyna_emit_container_update_ids (fixture, device, stuff);
+  dispatch_pending ();
+  g_assert_cmpuint (count_children (source, stuff_id), ==, 7);
+
+  test_dleyna_add_child (fixture, device, stuff, "New child 3");
+  g_assert_cmpuint (count_children (source, stuff_id), ==, 7);
+
+  test_dleyna_bump_system_update_id (fixture, device);
+  dispatch_pending ();
+  g_assert_cmpuint (count_children (source, stuff_id), ==, 8);
+}
+
 static void
 test_store (TestDleynaFixture *fixture,
             gconstpointer      user_data)
@@ -447,6 +609,10 @@ main(int argc, char **argv)
       test_dleyna_setup, test_discovery, test_dleyna_shutdown);
   g_test_add ("/dleyna/browse", TestDleynaFixture, NULL,
       test_dleyna_setup, test_browse, test_dleyna_shutdown);
+  g_test_add ("/dleyna/browse-paged", TestDleynaFixture, NULL,
+      test_dleyna_setup, test_browse_paged, test_dleyna_shutdown);
+  g_test_add ("/dleyna/browse-cache", TestDleynaFixture, NULL,
+      test_dleyna_setup, test_browse_cache, test_dleyna_shutdown);
   g_test_add ("/dleyna/resolve", TestDleynaFixture, NULL,
       test_dleyna_setup, test_resolve, test_dleyna_shutdown);
   g_test_add ("/dleyna/store", TestDleynaFixture, NULL,
@@ -139,3 +139,45 @@ test_dleyna_flush_changes (TestDleynaFixture *fixture,
                                G_DBUS_CALL_FLAGS_NONE, -1, NULL, &error);
   g_assert_no_error (error);
 }
+
+void
+test_dleyna_add_child (TestDleynaFixture *fixture,
+                       gchar             *device_path,
+                       gchar             *container_path,
+                       gchar             *display_name)
+{
+  GVariant *params;
+  GError *error = NULL;
+
+  params = g_variant_new ("(os)", container_path, display_name);
+  g_dbus_connection_call_sync (fixture->connection, "com.intel.dleyna-server", device_path,
+                               "org.freedesktop.DBus.Mock", "AddChild", params, NULL,
+                               G_DBUS_CALL_FLAGS_NONE, -1, NULL, &error);
+  g_assert_no_error (error);
+}
+
+void
+test_dleyna_emit_container_update_ids (TestDleynaFixture *fixture,
+                                       gchar             *device_path,
+                                       gchar             *container_path)
+{
+  GError *error = NULL;
+
+  g_dbus_connection_call_sync (fixture->connection, "com.intel.dleyna-server", device_path,
+                               "org.freedesktop.DBus.Mock", "EmitContainerUpdateIDs",
+                               g_variant_new ("(o)", container_path), NULL,
+                               G_DBUS_CALL_FLAGS_NONE, -1, NULL, &error);
+  g_assert_no_error (error);
+}
+
+void
+test_dleyna_bump_system_update_id (TestDleynaFixture *fixture,
+                                   gchar             *device_path)
+{
+  GError *error = NULL;
+
+  g_dbus_connection_call_sync (fixture->connection, "com.intel.dleyna-server", device_path,
+                               "org.freedesktop.DBus.Mock", "BumpSystemUpdateID", NULL, NULL,
+                               G_DBUS_CALL_FLAGS_NONE, -1, NULL, &error);
+  g_assert_no_error (error);
+}
@@ -54,5 +54,14 @@ void     test_dleyna_queue_changes         (TestDleynaFixture *fixture,
                                             gboolean           detailed);
 void     test_dleyna_flush_changes         (TestDleynaFixture *fixture,
                                             gchar             *device_path);
+void     test_dleyna_add_child             (TestDleynaFixture *fixture,
+                                            gchar             *device_path,
+                                            gchar             *container_path,
+                                            gchar             *display_name);
+void     test_dleyna_emit_container_update_ids (TestDleynaFixture *fixture,
+                                                gchar             *device_path,
+                                                gchar             *container_path);
+void     test_dleyna_bump_system_update_id (TestDleynaFixture *fixture,
+                                            gchar             *device_path);
 
 #endif /* _GRL_DLEYNA_TEST_UTILS_H_ */
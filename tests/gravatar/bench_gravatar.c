@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include <string.h>
+
+#include "grl-gravatar-avatar.h"
+
+#define CORPUS_N_FIELDS 256
+#define BENCH_N_RESOLVES 200000
+
+/* What the plugin used to do for every field */
+static gchar *
+regex_avatar_url (const gchar *field)
+{
+  static GRegex *email_regex = NULL;
+  GMatchInfo *match_info = NULL;
+  gchar *lowercased_field;
+  gchar *avatar = NULL;
+
+  if (!email_regex)
+    email_regex = g_regex_new ("[\\w-]+@([\\w-]+\\.)+[\\w-]+", G_REGEX_OPTIMIZE, 0, NULL);
+
+  lowercased_field = g_utf8_strdown (field, -1);
+
+  if (g_regex_match (email_regex, lowercased_field, 0, &match_info)) {
+    gchar *email = g_match_info_fetch (match_info, 0);
+    gchar *email_hash = g_compute_checksum_for_string (G_CHECKSUM_MD5, email, -1);
+
+    avatar = g_strdup_printf ("https://www.gravatar.com/avatar/%s.jpg", email_hash);
+    g_free (email_hash);
+    g_free (email);
+  }
+  g_match_info_free (match_info);
+  g_free (lowercased_field);
+
+  return avatar;
+}
+
+static const gchar *fields[] = {
+  "john@example.com",
+  "John Doe <John.Doe@Mail.Example.org>",
+  "The Beatles",
+  "Sigur Rós",
+  "a@b",
+  "a@b.c.",
+  "a@b..c",
+  "a@@b.c",
+  "x y@z.w@q.r",
+  "@b.c",
+  "foo-bar_baz@sub-domain.co.uk and friends",
+  "Jörg <jörg@exämple.de>",
+  "user@.com",
+  "user@com.",
+  "abc@def.ghi...jkl",
+  "",
+};
+
+static gchar *corpus[CORPUS_N_FIELDS];
+
+static void
+corpus_setup (void)
+{
+  gint i;
+
+  /* Mostly artist names, with a few email addresses */
+  for (i = 0; i < CORPUS_N_FIELDS; i++) {
+    if (i % 8 == 0)
+      corpus[i] = g_strdup_printf ("Artist %d <artist%d@example.com>", i, i);
+    else
+      corpus[i] = g_strdup_printf ("Artist number %d and the band", i);
+  }
+}
+
+static void
+corpus_teardown (void)
+{
+  gint i;
+
+  for (i = 0; i < CORPUS_N_FIELDS; i++)
+    g_free (corpus[i]);
+}
+
+static void
+test_avatar_matches_regex (void)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (fields); i++) {
+    gchar *expected = regex_avatar_url (fields[i]);
+    gchar *avatar = grl_gravatar_get_avatar_url (fields[i]);
+
+    g_assert_cmpstr (avatar, ==, expected);
+
+    g_free (avatar);
+    g_free (expected);
+  }
+}
+
+static void
+test_cache (void)
+{
+  GrlGravatarCache *cache;
+  gchar *avatar, *expected;
+  gint round, i;
+
+  /* Smaller than the corpus, so entries get evicted */
+  cache = grl_gravatar_cache_new (CORPUS_N_FIELDS / 4);
+
+  for (round = 0; round < 2; round++) {
+    for (i = 0; i < CORPUS_N_FIELDS; i++) {
+      expected = grl_gravatar_get_avatar_url (corpus[i]);
+      avatar = grl_gravatar_cache_get_avatar_url (cache, corpus[i]);
+      g_assert_cmpstr (avatar, ==, expected);
+      g_free (avatar);
+      g_free (expected);
+    }
+  }
+
+  g_assert_null (grl_gravatar_cache_get_avatar_url (cache, NULL));
+
+  grl_gravatar_cache_free (cache);
+}
+
+static void
+test_resolve_throughput (void)
+{
+  GrlGravatarCache *cache;
+  gdouble elapsed;
+  gint i;
+
+  if (!g_test_perf ()) {
+    g_test_skip ("Only run in performance mode");
+    return;
+  }
+
+  g_test_timer_start ();
+  for (i = 0; i < BENCH_N_RESOLVES; i++)
+    g_free (regex_avatar_url (corpus[i % CORPUS_N_FIELDS]));
+  elapsed = g_test_timer_elapsed ();
+  g_test_message ("regex: %.0f resolves/s", BENCH_N_RESOLVES / elapsed);
+
+  g_test_timer_start ();
+  for (i = 0; i < BENCH_N_RESOLVES; i++)
+    g_free (grl_gravatar_get_avatar_url (corpus[i % CORPUS_N_FIELDS]));
+  elapsed = g_test_timer_elapsed ();
+  g_test_message ("scanner: %.0f resolves/s", BENCH_N_RESOLVES / elapsed);
+
+  cache = grl_gravatar_cache_new (GRL_GRAVATAR_CACHE_MAX_FIELDS);
+  g_test_timer_start ();
+  for (i = 0; i < BENCH_N_RESOLVES; i++)
+    g_free (grl_gravatar_cache_get_avatar_url (cache, corpus[i % CORPUS_N_FIELDS]));
+  elapsed = g_test_timer_elapsed ();
+  grl_gravatar_cache_free (cache);
+
+  g_test_maximized_result (BENCH_N_RESOLVES / elapsed,
+                           "scanner and cache: %.0f resolves/s",
+                           BENCH_N_RESOLVES / elapsed);
+}
+
+int
+main(int argc, char **argv)
+{
+  gint result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  corpus_setup ();
+
+  g_test_add_func ("/gravatar/avatar/matches-regex", test_avatar_matches_regex);
+  g_test_add_func ("/gravatar/avatar/cache", test_cache);
+  g_test_add_func ("/gravatar/avatar/throughput", test_resolve_throughput);
+
+  result = g_test_run ();
+
+  corpus_teardown ();
+
+  return result;
+}
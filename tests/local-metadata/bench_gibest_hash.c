@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "grl-gibest-hash.h"
+
+#define CORPUS_N_FILES 64
+#define CORPUS_FILE_SIZE (1024 * 1024 + 123)
+#define BENCH_N_ROUNDS 20
+
+static gchar *corpus_dir = NULL;
+static gchar *corpus[CORPUS_N_FILES];
+
+static guint64
+reference_hash (const gchar *data,
+                gsize length)
+{
+  const gchar *tail = data + length - GRL_GIBEST_HASH_CHUNK_SIZE;
+  guint64 hash = 0;
+  gsize i;
+
+  for (i = 0; i < GRL_GIBEST_HASH_CHUNK_SIZE; i += 8) {
+    guint64 word;
+
+    memcpy (&word, data + i, 8);
+    hash += word;
+    memcpy (&word, tail + i, 8);
+    hash += word;
+  }
+
+  return hash + length;
+}
+
+static guint64
+hash_file (const gchar *path)
+{
+  GError *error = NULL;
+  guint64 hash = 0;
+  int fd;
+
+  fd = g_open (path, O_RDONLY, 0);
+  g_assert_cmpint (fd, >=, 0);
+  g_assert_true (grl_gibest_hash_fd (fd, &hash, &error));
+  g_assert_no_error (error);
+  close (fd);
+
+  return hash;
+}
+
+static void
+corpus_setup (void)
+{
+  GError *error = NULL;
+  GRand *rand;
+  gint i;
+
+  corpus_dir = g_dir_make_tmp ("grl-gibest-hash-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  rand = g_rand_new_with_seed (42);
+  for (i = 0; i < CORPUS_N_FILES; i++) {
+    guint32 *data;
+    gsize j;
+
+    data = g_new (guint32, CORPUS_FILE_SIZE / 4 + 1);
+    for (j = 0; j <= CORPUS_FILE_SIZE / 4; j++)
+      data[j] = g_rand_int (rand);
+
+    /* The size is not a multiple of 8, so the last chunk is not aligned */
+    corpus[i] = g_strdup_printf ("%s/%02d.bin", corpus_dir, i);
+    g_file_set_contents (corpus[i], (gchar *) data, CORPUS_FILE_SIZE, &error);
+    g_assert_no_error (error);
+    g_free (data);
+  }
+  g_rand_free (rand);
+}
+
+static void
+corpus_teardown (void)
+{
+  gint i;
+
+  for (i = 0; i < CORPUS_N_FILES; i++) {
+    g_unlink (corpus[i]);
+    g_free (corpus[i]);
+  }
+  g_rmdir (corpus_dir);
+  g_free (corpus_dir);
+}
+
+static void
+test_hash_matches_reference (void)
+{
+  GError *error = NULL;
+  gchar *data;
+  gsize length;
+
+  g_file_get_contents (corpus[0], &data, &length, &error);
+  g_assert_no_error (error);
+
+  g_assert_cmpuint (hash_file (corpus[0]), ==, reference_hash (data, length));
+
+  g_free (data);
+}
+
+static void
+test_hash_too_small (void)
+{
+  GError *error = NULL;
+  gchar *path;
+  guint64 hash;
+  int fd;
+
+  path = g_build_filename (corpus_dir, "small.bin", NULL);
+  g_file_set_contents (path, "small", -1, &error);
+  g_assert_no_error (error);
+
+  fd = g_open (path, O_RDONLY, 0);
+  g_assert_false (grl_gibest_hash_fd (fd, &hash, &error));
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_FAILED);
+  g_clear_error (&error);
+  close (fd);
+
+  g_unlink (path);
+  g_free (path);
+}
+
+static void
+test_hash_throughput (void)
+{
+  gdouble elapsed;
+  gint round, i;
+
+  if (!g_test_perf ()) {
+    g_test_skip ("Only run in performance mode");
+    return;
+  }
+
+  /* Warm up the page cache, so the kernel and read path are measured */
+  for (i = 0; i < CORPUS_N_FILES; i++)
+    hash_file (corpus[i]);
+
+  g_test_timer_start ();
+  for (round = 0; round < BENCH_N_ROUNDS; round++) {
+    for (i = 0; i < CORPUS_N_FILES; i++)
+      hash_file (corpus[i]);
+  }
+  elapsed = g_test_timer_elapsed ();
+
+  g_test_maximized_result (BENCH_N_ROUNDS * CORPUS_N_FILES / elapsed,
+                           "%.0f hashes/s",
+                           BENCH_N_ROUNDS * CORPUS_N_FILES / elapsed);
+}
+
+int
+main(int argc, char **argv)
+{
+  gint result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  corpus_setup ();
+
+  g_test_add_func ("/local-metadata/gibest-hash/reference", test_hash_matches_reference);
+  g_test_add_func ("/local-metadata/gibest-hash/too-small", test_hash_too_small);
+  g_test_add_func ("/local-metadata/gibest-hash/throughput", test_hash_throughput);
+
+  result = g_test_run ();
+
+  corpus_teardown ();
+
+  return result;
+}
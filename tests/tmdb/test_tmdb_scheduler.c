@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include <locale.h>
+#include <grilo.h>
+#include <net/grl-net.h>
+
+#include "grl-tmdb-scheduler.h"
+
+#define TMDB_TEST_API_KEY "TMDB_TEST_API_KEY"
+
+GRL_LOG_DOMAIN(tmdb_log_domain);
+
+static void
+request_done_cb (GObject *source,
+                 GAsyncResult *result,
+                 gpointer user_data)
+{
+  guint *pending = user_data;
+  GError *error = NULL;
+
+  grl_tmdb_request_run_finish (GRL_TMDB_REQUEST (source), result, &error);
+  g_assert_no_error (error);
+
+  (*pending)--;
+}
+
+static void
+wait_for_requests (guint *pending)
+{
+  while (*pending > 0)
+    g_main_context_iteration (NULL, TRUE);
+}
+
+static void
+assert_stats (GrlTmdbScheduler *scheduler,
+              guint queued,
+              guint in_flight,
+              guint completed)
+{
+  guint n_queued, n_in_flight, n_completed;
+
+  grl_tmdb_scheduler_get_stats (scheduler,
+                                &n_queued, &n_in_flight, &n_completed, NULL);
+  g_assert_cmpuint (n_queued, ==, queued);
+  g_assert_cmpuint (n_in_flight, ==, in_flight);
+  g_assert_cmpuint (n_completed, ==, completed);
+}
+
+static void
+test_scheduler_identical (void)
+{
+  GrlNetWc *wc;
+  GrlTmdbScheduler *scheduler;
+  GrlTmdbRequest *request;
+  guint pending = 0;
+  guint i;
+
+  wc = grl_net_wc_new ();
+  scheduler = grl_tmdb_scheduler_new (wc, NULL);
+  assert_stats (scheduler, 0, 0, 0);
+
+  for (i = 0; i < 3; i++) {
+    request = grl_tmdb_request_new_configuration (TMDB_TEST_API_KEY);
+    grl_tmdb_scheduler_push (scheduler, request,
+                             GRL_TMDB_SCHEDULER_PRIORITY_FAST,
+                             request_done_cb, &pending);
+    g_object_unref (request);
+    pending++;
+  }
+
+  /* The three requests share the one sent */
+  assert_stats (scheduler, 0, 1, 0);
+
+  wait_for_requests (&pending);
+  assert_stats (scheduler, 0, 0, 1);
+
+  grl_tmdb_scheduler_free (scheduler);
+  g_object_unref (wc);
+}
+
+static void
+test_scheduler_limits (void)
+{
+  GrlNetWc *wc;
+  GrlTmdbScheduler *scheduler;
+  GrlTmdbRequest *request;
+  guint pending = 0;
+  guint latency;
+
+  wc = grl_net_wc_new ();
+  scheduler = grl_tmdb_scheduler_new (wc, NULL);
+  grl_tmdb_scheduler_set_limits (scheduler, 1, 1);
+
+  request = grl_tmdb_request_new_configuration (TMDB_TEST_API_KEY);
+  grl_tmdb_scheduler_push (scheduler, request,
+                           GRL_TMDB_SCHEDULER_PRIORITY_SLOW,
+                           request_done_cb, &pending);
+  g_object_unref (request);
+  pending++;
+
+  request = grl_tmdb_request_new_details (TMDB_TEST_API_KEY,
+                                          GRL_TMDB_REQUEST_DETAIL_MOVIE,
+                                          10528);
+  grl_tmdb_scheduler_push (scheduler, request,
+                           GRL_TMDB_SCHEDULER_PRIORITY_FAST,
+                           request_done_cb, &pending);
+  g_object_unref (request);
+  pending++;
+
+  /* Only one request may run at a time */
+  assert_stats (scheduler, 1, 1, 0);
+
+  wait_for_requests (&pending);
+  assert_stats (scheduler, 0, 0, 2);
+
+  /* The second request waited a second for its token */
+  grl_tmdb_scheduler_get_stats (scheduler, NULL, NULL, NULL, &latency);
+  g_assert_cmpuint (latency, >=, 400);
+
+  grl_tmdb_scheduler_free (scheduler);
+  g_object_unref (wc);
+}
+
+int
+main(int argc, char **argv)
+{
+  gint result;
+
+  setlocale (LC_ALL, "");
+
+  /* We must set this before calling grl_init.
+   * See https://bugzilla.gnome.org/show_bug.cgi?id=685967#c17
+   */
+  g_setenv ("GRL_NET_MOCKED", GRILO_PLUGINS_TESTS_TMDB_DATA_PATH "fast-by-id.ini", TRUE);
+
+  grl_init (&argc, &argv);
+  g_test_init (&argc, &argv, NULL);
+
+  GRL_LOG_DOMAIN_INIT (tmdb_log_domain, "tmdb");
+
+  g_test_add_func ("/tmdb/scheduler/identical", test_scheduler_identical);
+  g_test_add_func ("/tmdb/scheduler/limits", test_scheduler_limits);
+
+  result = g_test_run ();
+
+  grl_deinit ();
+
+  return result;
+}
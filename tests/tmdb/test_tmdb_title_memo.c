@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include <locale.h>
+#include <grilo.h>
+#include "test_tmdb_utils.h"
+
+#define TMDB_PLUGIN_ID "grl-tmdb"
+
+static void
+resolve_title (GrlSource *source,
+               GrlOperationOptions *options,
+               GrlKeyID tmdb_id,
+               const gchar *title)
+{
+  GrlMedia *media = NULL;
+  GError *error = NULL;
+
+  media = grl_media_video_new ();
+  g_assert (media != NULL);
+  grl_media_set_title (media, title);
+
+  grl_source_resolve_sync (source,
+                           media,
+                           grl_source_supported_keys (source),
+                           options,
+                           &error);
+  g_assert_no_error (error);
+
+  g_assert_cmpstr (grl_data_get_string (GRL_DATA (media), tmdb_id), ==,
+                   "10528");
+  g_assert_cmpstr (grl_data_get_string (GRL_DATA (media), GRL_METADATA_KEY_ORIGINAL_TITLE), ==,
+                   "Sherlock Holmes");
+
+  g_clear_object (&media);
+}
+
+static void
+test_title_memo (void)
+{
+  GrlKeyID tmdb_id;
+  GrlRegistry *registry;
+  GrlOperationOptions *options = NULL;
+  GrlSource *source;
+
+  test_setup_tmdb ();
+
+  registry = grl_registry_get_default ();
+  tmdb_id = grl_registry_lookup_metadata_key (registry, "tmdb-id");
+  g_assert_cmpint (tmdb_id, !=, GRL_METADATA_KEY_INVALID);
+
+  options = grl_operation_options_new (NULL);
+  g_assert (options != NULL);
+  grl_operation_options_set_resolution_flags (options, GRL_RESOLVE_FAST_ONLY);
+
+  source = test_get_source();
+  g_assert (source);
+
+  /* The first resolution searches for the title. No search is mocked for
+   * the title spelled in lower case, nor cached on disk, so the second
+   * resolution only succeeds if the memo, which ignores case, goes straight
+   * to the details of the movie found */
+  resolve_title (source, options, tmdb_id, "TMDBTestTitle");
+  resolve_title (source, options, tmdb_id, "tmdbtesttitle");
+
+  g_clear_object (&options);
+
+  test_shutdown_tmdb ();
+}
+
+
+int
+main(int argc, char **argv)
+{
+  gint result;
+
+  setlocale (LC_ALL, "");
+
+  g_setenv ("GRL_PLUGIN_PATH", GRILO_PLUGINS_TESTS_TMDB_PLUGIN_PATH, TRUE);
+  g_setenv ("GRL_PLUGIN_LIST", TMDB_PLUGIN_ID, TRUE);
+
+  /* We must set this before calling grl_init.
+   * See https://bugzilla.gnome.org/show_bug.cgi?id=685967#c17
+   */
+  g_setenv ("GRL_NET_MOCKED", GRILO_PLUGINS_TESTS_TMDB_DATA_PATH "title-memo.ini", TRUE);
+
+  grl_init (&argc, &argv);
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/tmdb/title-memo", test_title_memo);
+
+  result = g_test_run ();
+
+  grl_deinit ();
+
+  return result;
+}